@@ -0,0 +1,81 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#ifndef COMPACT_GBUFFER_HLSLI
+#define COMPACT_GBUFFER_HLSLI
+
+#include <donut/shaders/packing.hlsli>
+
+// Compact G-buffer surface record, written by PostprocessGBuffer.hlsl and read by RAB_GetGBufferSurface.
+// Packs everything the resampling passes need from the G-buffer into 16 bytes, so that a neighbor tap
+// is one load instead of five texture fetches:
+//   .x = view depth as float32 with the low 8 mantissa bits replaced by roughness (8 bits)
+//   .y = shading normal, octahedral 12:12 | diffuse albedo R (8 bits, gamma)
+//   .z = geometry normal, octahedral 12:12 | diffuse albedo G (8 bits, gamma)
+//   .w = specular F0 RGB (8:8:8, gamma)    | diffuse albedo B (8 bits, gamma)
+
+uint ndirToOctUnorm24(float3 n)
+{
+    float2 p = ndirToOctSigned(n);
+    p = saturate(p.xy * 0.5 + 0.5);
+    return uint(p.x * 0xffe) | (uint(p.y * 0xffe) << 12);
+}
+
+float3 octToNdirUnorm24(uint pUnorm)
+{
+    float2 p;
+    p.x = saturate(float(pUnorm & 0xfff) / 0xffe);
+    p.y = saturate(float((pUnorm >> 12) & 0xfff) / 0xffe);
+    p = p * 2.0 - 1.0;
+    return octToNdirSigned(p);
+}
+
+// Maps a pixel to its record in the compact surface buffer. Records are stored in 8x8 pixel tiles
+// so that the 2D neighborhoods used by spatial resampling touch fewer cache lines.
+// The stride is the buffer width in pixels, a multiple of 8.
+uint getCompactGBufferSurfaceIndex(int2 pixelPosition, uint stride)
+{
+    uint2 tile = uint2(pixelPosition) >> 3;
+    uint2 pixelInTile = uint2(pixelPosition) & 7;
+    return ((tile.y * (stride >> 3) + tile.x) << 6) + (pixelInTile.y << 3) + pixelInTile.x;
+}
+
+// Takes the G-buffer values in their regular encodings, see RenderTargets.cpp
+uint4 packCompactGBufferSurface(float viewDepth, uint normal, uint geoNormal, uint diffuseAlbedo, uint specularRough)
+{
+    uint depthBits = (asuint(viewDepth) + 0x80) & ~0xffu;
+    uint diffuseGamma = Pack_R8G8B8A8_Gamma_UFLOAT(float4(Unpack_R11G11B10_UFLOAT(diffuseAlbedo), 0));
+
+    uint4 packed;
+    packed.x = depthBits | (specularRough >> 24);
+    packed.y = ndirToOctUnorm24(octToNdirUnorm32(normal)) | (diffuseGamma << 24);
+    packed.z = ndirToOctUnorm24(octToNdirUnorm32(geoNormal)) | ((diffuseGamma >> 8) << 24);
+    packed.w = (specularRough & 0xffffff) | ((diffuseGamma >> 16) << 24);
+    return packed;
+}
+
+float unpackCompactGBufferDepth(uint4 packed)
+{
+    return asfloat(packed.x & ~0xffu);
+}
+
+// Returns the specular and roughness in the R8G8B8A8_Gamma_UFLOAT encoding used by the G-buffer
+uint unpackCompactGBufferSpecularRough(uint4 packed)
+{
+    return (packed.w & 0xffffff) | (packed.x << 24);
+}
+
+float3 unpackCompactGBufferDiffuseAlbedo(uint4 packed)
+{
+    uint diffuseGamma = (packed.y >> 24) | ((packed.z >> 24) << 8) | ((packed.w >> 24) << 16);
+    return Unpack_R8G8B8A8_Gamma_UFLOAT(diffuseGamma).rgb;
+}
+
+#endif // COMPACT_GBUFFER_HLSLI
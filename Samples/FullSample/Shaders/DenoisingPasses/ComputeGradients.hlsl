@@ -172,5 +172,5 @@ void RayGen()
     }
 
     // Store the output
-    u_Gradients[int3(GlobalIndex, 0)] = min(gradient * RTXDI_GRAD_STORAGE_SCALE, RTXDI_GRAD_MAX_VALUE);
+    u_Gradients[int3(GlobalIndex, RTXDI_GRAD_INPUT_LAYER)] = min(gradient * RTXDI_GRAD_STORAGE_SCALE, RTXDI_GRAD_MAX_VALUE);
 }
\ No newline at end of file
@@ -21,19 +21,20 @@ Texture2D<float> t_PrevDiffuseConfidence : register(t2);
 Texture2D<float> t_PrevSpecularConfidence : register(t3);
 RWTexture2D<float> u_DiffuseConfidence : register(u0);
 RWTexture2D<float> u_SpecularConfidence : register(u1);
+RWTexture2D<float> u_ConfidenceTiles : register(u2);
 SamplerState s_Sampler : register(s0);
 
 // This shader implements the conversion of the filtered gradients into
 // the confidence channel suitable for NRD consumption, and applies an exponential
 // temporal filter on top of that confidence channel. Typically, the temporal filter
 // has very short history, like 1 frame or less, just to reduce the flicker.
+// Each thread group also stores the lowest confidence of its tile into u_ConfidenceTiles,
+// which the lighting passes of the next frame use to set their sample budgets.
 
-[numthreads(8, 8, 1)]
-void main(uint2 globalIdx : SV_DispatchThreadID)
-{
-    if (any(globalIdx.xy >= g_Const.viewportSize))
-        return;
+groupshared float s_MinConfidence[CONFIDENCE_TILE_SIZE * CONFIDENCE_TILE_SIZE];
 
+void ComputeConfidence(uint2 globalIdx, out float diffuseConfidence, out float specularConfidence)
+{
     // Convert the output pixel position into UV in the gradients texture.
     float2 inputPos = (float2(globalIdx) + 0.5) / RTXDI_GRAD_FACTOR;
 
@@ -50,8 +51,8 @@ void main(uint2 globalIdx : SV_DispatchThreadID)
     gradient.zw += g_Const.darknessBias * RTXDI_GRAD_STORAGE_SCALE;
 
     // Convert gradients to confidence.
-    float diffuseConfidence = saturate(1.0 - gradient.x / gradient.z);
-    float specularConfidence = saturate(1.0 - gradient.y / gradient.w);
+    diffuseConfidence = saturate(1.0 - gradient.x / gradient.z);
+    specularConfidence = saturate(1.0 - gradient.y / gradient.w);
 
     diffuseConfidence = saturate(pow(diffuseConfidence, g_Const.sensitivity));
     specularConfidence = saturate(pow(specularConfidence, g_Const.sensitivity));
@@ -60,11 +61,14 @@ void main(uint2 globalIdx : SV_DispatchThreadID)
     if (g_Const.blendFactor < 1.0)
     {
         // Find the previous input position using the motion vector.
+        // With dynamic resolution, the motion vectors are relative to the current viewport size,
+        // so the position has to be rescaled into the previous viewport.
         float2 motionVector = t_MotionVectors[globalIdx].xy;
         
-        int2 prevInputPos = int2(float2(globalIdx) + 0.5 + motionVector);
+        float2 prevPixelPos = (float2(globalIdx) + 0.5 + motionVector) * float2(g_Const.prevViewportSize) / float2(g_Const.viewportSize);
+        int2 prevInputPos = int2(prevPixelPos);
 
-        if (all(prevInputPos >= 0) && all(prevInputPos < g_Const.viewportSize))
+        if (all(prevInputPos >= 0) && all(prevInputPos < g_Const.prevViewportSize))
         {
             // Blend the history in a non-linear space to make the result
             // hold on to lower confidence values longer than to high confidence.
@@ -92,7 +96,36 @@ void main(uint2 globalIdx : SV_DispatchThreadID)
         }
     }
 
-    // Store the output
-    u_DiffuseConfidence[globalIdx] = diffuseConfidence;
-    u_SpecularConfidence[globalIdx] = specularConfidence;
+}
+
+[numthreads(CONFIDENCE_TILE_SIZE, CONFIDENCE_TILE_SIZE, 1)]
+void main(uint2 globalIdx : SV_DispatchThreadID, uint2 groupIdx : SV_GroupID, uint threadIdx : SV_GroupIndex)
+{
+    // Pixels outside of the viewport don't lower the tile confidence.
+    float minConfidence = 1.0;
+
+    if (all(globalIdx.xy < g_Const.viewportSize))
+    {
+        float diffuseConfidence, specularConfidence;
+        ComputeConfidence(globalIdx, diffuseConfidence, specularConfidence);
+
+        // Store the output
+        u_DiffuseConfidence[globalIdx] = diffuseConfidence;
+        u_SpecularConfidence[globalIdx] = specularConfidence;
+
+        minConfidence = min(diffuseConfidence, specularConfidence);
+    }
+
+    s_MinConfidence[threadIdx] = minConfidence;
+
+    for (uint stride = CONFIDENCE_TILE_SIZE * CONFIDENCE_TILE_SIZE / 2; stride > 0; stride /= 2)
+    {
+        GroupMemoryBarrierWithGroupSync();
+
+        if (threadIdx < stride)
+            s_MinConfidence[threadIdx] = min(s_MinConfidence[threadIdx], s_MinConfidence[threadIdx + stride]);
+    }
+
+    if (threadIdx == 0)
+        u_ConfidenceTiles[groupIdx] = s_MinConfidence[0];
 }
@@ -18,17 +18,71 @@ VK_PUSH_CONSTANT ConstantBuffer<FilterGradientsConstants> g_Const : register(b0)
 RWTexture2DArray<float4> u_Gradients : register(u0);
 
 // This shader implements an A-trous spatial filter on the gradients texture.
-// The filter is applied repeatedly to get a wide blur with relatively few texture samples.
+// The filter is applied repeatedly to get a wide blur with relatively few texture samples:
+// each pass takes 9 taps with a step that doubles from one pass to the next.
+//
+// All passes run in a single dispatch. Each thread group loads its tile of raw gradients plus an apron
+// that covers the combined footprint of all passes into groupshared memory, and then runs the passes there,
+// each one over the region that the remaining passes still need. The intermediate results are rounded
+// to FP16 like they would be when stored in the gradients texture, so that the output matches
+// the version that runs one dispatch per pass. See FilterGradientsReference(...) in FilterGradientsPass.cpp.
 
-[numthreads(8, 8, 1)]
-void main(uint2 globalIdx : SV_DispatchThreadID)
+static const int kTileSize = RTXDI_GRAD_FILTER_TILE_SIZE;
+static const int kApron = (1 << RTXDI_GRAD_FILTER_PASSES) - 1;
+
+// Regions are numbered by the filter stage: 0 holds the input, N holds the output of pass N-1.
+// Even regions use the first part of the shared array and odd regions use the second part,
+// so each pass reads one part and writes the other.
+static const int kInputRegionSize = kTileSize + 2 * kApron;
+static const int kFirstOutputRegionSize = kTileSize + 2 * (kApron - 1);
+
+groupshared uint2 s_Gradients[kInputRegionSize * kInputRegionSize + kFirstOutputRegionSize * kFirstOutputRegionSize];
+
+int GetRegionRadius(int stage)
+{
+    return kApron - ((1 << stage) - 1);
+}
+
+int GetRegionOffset(int stage)
 {
-    if (any(globalIdx.xy >= g_Const.viewportSize))
-        return;
+    return (stage & 1) ? kInputRegionSize * kInputRegionSize : 0;
+}
+
+int GetSharedIndex(int stage, int2 tileOrigin, int2 pos)
+{
+    const int radius = GetRegionRadius(stage);
+    const int regionSize = kTileSize + 2 * radius;
+    const int2 regionPos = pos - (tileOrigin - radius);
+
+    return GetRegionOffset(stage) + regionPos.y * regionSize + regionPos.x;
+}
 
+uint2 PackGradient(float4 gradient)
+{
+    return uint2(
+        f32tof16(gradient.x) | (f32tof16(gradient.y) << 16),
+        f32tof16(gradient.z) | (f32tof16(gradient.w) << 16));
+}
+
+float4 UnpackGradient(uint2 packed)
+{
+    return float4(
+        f16tof32(packed.x),
+        f16tof32(packed.x >> 16),
+        f16tof32(packed.y),
+        f16tof32(packed.y >> 16));
+}
+
+bool IsInsideViewport(int2 pos)
+{
+    return all(pos >= 0) && all(pos < int2(g_Const.viewportSize));
+}
+
+// Applies one pass of the filter at 'pos', reading the output of the previous pass from groupshared memory.
+float4 FilterPixel(int passIndex, int2 tileOrigin, int2 pos)
+{
     // The filtering step increases with each pass
-    int2 step = 1l << g_Const.passIndex;
-    const int inputBuffer = g_Const.passIndex & 1;
+    int2 step = 1l << passIndex;
 
     // Preserve the filter aspect ratio when the gradients are half-resolution in the X dimension
     if (g_Const.checkerboard)
@@ -41,21 +95,72 @@ void main(uint2 globalIdx : SV_DispatchThreadID)
     [unroll] for (int yy = -1; yy <= 1; ++yy)
     [unroll] for (int xx = -1; xx <= 1; ++xx)
     {
-        int2 pos = globalIdx.xy + int2(xx, yy) * step;
-        float4 c = u_Gradients[int3(pos, inputBuffer)];
+        int2 tapPos = pos + int2(xx, yy) * step;
 
-        if (all(pos >= 0) && all(pos < int2(g_Const.viewportSize)))
+        if (IsInsideViewport(tapPos))
         {
             // Triangular filter kernel produces a smooth result after a few iterations
             float w = (xx == 0 ? 1.0 : 0.5) * (yy == 0 ? 1.0 : 0.5);
 
-            acc += c * w;
+            acc += UnpackGradient(s_Gradients[GetSharedIndex(passIndex, tileOrigin, tapPos)]) * w;
             wSum += w;
         }
     }
 
-    // Normalize and store the output into the output buffer
-    acc /= wSum;
+    // The center tap is always inside the viewport, so wSum is at least 1
+    return acc / wSum;
+}
+
+[numthreads(RTXDI_GRAD_FILTER_TILE_SIZE, RTXDI_GRAD_FILTER_TILE_SIZE, 1)]
+void main(uint2 groupIdx : SV_GroupID, uint2 globalIdx : SV_DispatchThreadID, uint threadIdx : SV_GroupIndex)
+{
+    const uint numThreads = kTileSize * kTileSize;
+    const int2 tileOrigin = int2(groupIdx) * kTileSize;
+
+    uint textureWidth, textureHeight, textureLayers;
+    u_Gradients.GetDimensions(textureWidth, textureHeight, textureLayers);
+    const int2 textureSize = int2(textureWidth, textureHeight);
+
+    // Load the raw gradients of the tile and the apron. Positions outside of the texture read as zero.
+    for (uint index = threadIdx; index < kInputRegionSize * kInputRegionSize; index += numThreads)
+    {
+        const int2 pos = tileOrigin - kApron + int2(index % kInputRegionSize, index / kInputRegionSize);
 
-    u_Gradients[int3(globalIdx, !inputBuffer)] = acc;
+        float4 gradient = 0;
+        if (all(pos >= 0) && all(pos < textureSize))
+            gradient = u_Gradients[int3(pos, RTXDI_GRAD_INPUT_LAYER)];
+
+        s_Gradients[index] = PackGradient(gradient);
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // Run all passes but the last one over the shrinking regions in groupshared memory
+    [unroll]
+    for (int passIndex = 0; passIndex < RTXDI_GRAD_FILTER_PASSES - 1; passIndex++)
+    {
+        const int radius = GetRegionRadius(passIndex + 1);
+        const int regionSize = kTileSize + 2 * radius;
+
+        for (uint index = threadIdx; index < uint(regionSize * regionSize); index += numThreads)
+        {
+            const int2 pos = tileOrigin - radius + int2(index % regionSize, index / regionSize);
+
+            // Positions outside of the viewport are never used as taps. Inside the viewport, positions
+            // beyond the edge of the gradients texture read as zero, like the texture loads of a separate pass would.
+            float4 gradient = 0;
+            if (IsInsideViewport(pos) && all(pos < textureSize))
+                gradient = FilterPixel(passIndex, tileOrigin, pos);
+
+            s_Gradients[GetSharedIndex(passIndex + 1, tileOrigin, pos)] = PackGradient(gradient);
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    // The last pass only covers the tile and goes straight to the output
+    if (IsInsideViewport(globalIdx))
+    {
+        u_Gradients[int3(globalIdx, RTXDI_GRAD_OUTPUT_LAYER)] = FilterPixel(RTXDI_GRAD_FILTER_PASSES - 1, tileOrigin, globalIdx);
+    }
 }
@@ -0,0 +1,83 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Frustum culling for the indirect version of the rasterized G-buffer pass.
+// Every draw record gets two sets of draw arguments: one in the opaque range and one in the alpha tested range
+// that starts at 'drawCount'. The set that matches the material domain of the geometry gets one instance
+// if the geometry is visible, and the other set gets none, so that the draw order never changes
+// and the material domains can be edited at runtime without rebuilding the draw records on the CPU.
+
+#pragma pack_matrix(row_major)
+
+#include "ShaderParameters.h"
+
+#include <donut/shaders/bindless.h>
+#include <donut/shaders/material_cb.h>
+#include <donut/shaders/binding_helpers.hlsli>
+
+VK_PUSH_CONSTANT ConstantBuffer<GBufferCullingConstants> g_Const : register(b0);
+
+StructuredBuffer<InstanceData> t_InstanceData : register(t0);
+StructuredBuffer<GeometryData> t_GeometryData : register(t1);
+StructuredBuffer<MaterialConstants> t_MaterialConstants : register(t2);
+StructuredBuffer<GBufferDrawRecord> t_DrawRecords : register(t3);
+
+RWBuffer<uint> u_DrawArguments : register(u0);
+
+bool IsBoxInsideFrustum(float3 center, float3 extents)
+{
+    [unroll]
+    for (int i = 0; i < 6; i++)
+    {
+        const float4 plane = g_Const.frustumPlanes[i];
+
+        // Distance of the box corner that is furthest inside along the plane normal
+        const float distance = dot(plane.xyz, center) - dot(abs(plane.xyz), extents);
+
+        if (distance > plane.w)
+            return false;
+    }
+
+    return true;
+}
+
+void WriteDrawArguments(uint drawIndex, uint vertexCount, uint instanceCount, uint recordIndex)
+{
+    const uint offset = drawIndex * 4;
+    u_DrawArguments[offset + 0] = vertexCount;
+    u_DrawArguments[offset + 1] = instanceCount;
+    u_DrawArguments[offset + 2] = 0; // startVertexLocation
+    u_DrawArguments[offset + 3] = recordIndex; // startInstanceLocation, selects the record in the draw ID vertex stream
+}
+
+[numthreads(GBUFFER_CULLING_GROUP_SIZE, 1, 1)]
+void main(uint recordIndex : SV_DispatchThreadID)
+{
+    if (recordIndex >= g_Const.drawCount)
+        return;
+
+    const GBufferDrawRecord record = t_DrawRecords[recordIndex];
+    const InstanceData instance = t_InstanceData[record.instanceIndex];
+    const GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + record.geometryIndex];
+    const MaterialConstants material = t_MaterialConstants[geometry.materialIndex];
+
+    // Transform the object space box into a world space box that encloses it
+    const float3 objectCenter = (record.boundsMin + record.boundsMax) * 0.5;
+    const float3 objectExtents = (record.boundsMax - record.boundsMin) * 0.5;
+    const float3 center = mul(instance.transform, float4(objectCenter, 1.0)).xyz;
+    const float3 extents = mul(abs((float3x3)instance.transform), objectExtents);
+
+    const bool visible = IsBoxInsideFrustum(center, extents);
+
+    const bool isOpaque = material.domain == MaterialDomain_Opaque;
+
+    WriteDrawArguments(recordIndex, geometry.numIndices, (visible && isOpaque) ? 1 : 0, recordIndex);
+    WriteDrawArguments(g_Const.drawCount + recordIndex, geometry.numIndices, (visible && !isOpaque) ? 1 : 0, recordIndex);
+}
@@ -36,6 +36,22 @@ float evaluateIesProfile(int profileIndex, float3 emissionDirection_, float3 lig
     if (profileIndex < 0)
         return 1.0;
 
+    if (profileIndex & kIesProfileSymmetricBit)
+    {
+        // Rotationally symmetric profile: one fetch from the atlas row, no ONB or inverse trigonometry.
+        // The texel centers of a row span [-1, 1] exactly, so the sampler never wraps around.
+        const uint atlasIndex = uint(profileIndex) & kIesProfileAtlasIndexMask;
+        const uint atlasRow = (uint(profileIndex) & ~kIesProfileSymmetricBit) >> kIesProfileAtlasRowShift;
+
+        const float cosTheta = clamp(dot(emissionDirection_, lightPrimaryAxis), -1.0, 1.0);
+        const float u = (cosTheta * 0.5 + 0.5) * (float(IES_PROFILE_ATLAS_WIDTH - 1) / IES_PROFILE_ATLAS_WIDTH) + 0.5 / IES_PROFILE_ATLAS_WIDTH;
+        const float v = (float(atlasRow) + 0.5) / IES_PROFILE_ATLAS_ROWS;
+
+        Texture2D<float4> iesProfileAtlas = t_BindlessTextures[NonUniformResourceIndex(atlasIndex)];
+
+        return iesProfileAtlas.SampleLevel(IES_SAMPLER, float2(u, v), 0).x;
+    }
+
     float3 xAxis;
     float3 yAxis;
     branchlessONB(lightPrimaryAxis, xAxis, yAxis);
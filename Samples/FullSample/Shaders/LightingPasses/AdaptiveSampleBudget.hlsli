@@ -0,0 +1,37 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#ifndef ADAPTIVE_SAMPLE_BUDGET_HLSLI
+#define ADAPTIVE_SAMPLE_BUDGET_HLSLI
+
+// Returns the factor for the sample counts of the tile that contains the pixel.
+// t_ConfidenceTiles holds the lowest DI confidence of each tile from the previous frame, see ConfidencePass.hlsl.
+// Tiles where the lighting changed get more samples to rebuild their reservoirs faster,
+// and tiles with a converged history get fewer.
+float GetSampleBudgetScale(int2 pixelPosition)
+{
+    if (!g_Const.enableAdaptiveSampleBudget)
+        return 1.0;
+
+    float confidence = t_ConfidenceTiles[pixelPosition / CONFIDENCE_TILE_SIZE];
+
+    return lerp(g_Const.adaptiveBudgetMaxScale, g_Const.adaptiveBudgetMinScale, confidence);
+}
+
+// Scales a sample count, keeping at least one sample if the original count was nonzero.
+uint ApplySampleBudget(uint numSamples, float budgetScale)
+{
+    if (numSamples == 0)
+        return 0;
+
+    return max(1u, uint(float(numSamples) * budgetScale + 0.5));
+}
+
+#endif // ADAPTIVE_SAMPLE_BUDGET_HLSLI
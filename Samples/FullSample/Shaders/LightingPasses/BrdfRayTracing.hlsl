@@ -20,50 +20,57 @@
 #include <NRD.hlsli>
 #endif
 
+#include "SecondaryGBuffer.hlsli"
 #include "ShadingHelpers.hlsli"
 
+// This shader is compiled in several flavors, selected with BRDF_RAY_PASS:
+//  - BRDF_RAY_PASS_IN_PLACE: sample, trace and shade the BRDF ray of each pixel in one pass.
+//  - BRDF_RAY_PASS_BINNING: sample the rays and store them into u_BrdfRays, grouped by direction
+//    octant within each BRDF_RAY_BIN_TILE_SIZE^2 tile of pixels.
+//  - BRDF_RAY_PASS_SORTED: trace and shade the rays from u_BrdfRays in their binned order,
+//    writing the results back to the pixels that generated them.
+// The sorted flavor is only available with RayQuery, where the thread-to-ray mapping is under our control.
+//
+// The wavefront path runs after the binning pass and splits tracing from shading:
+//  - BRDF_RAY_PASS_WAVEFRONT_TRACE: trace the rays from u_BrdfRays without shading them, store the hits
+//    into u_BrdfRayHits, and append the ray indices to one queue per material domain of the hit surface.
+//  - BRDF_RAY_PASS_WAVEFRONT_ARGS: lay out the queues for the shading pass and write its dispatch arguments.
+//  - BRDF_RAY_PASS_WAVEFRONT_SHADE: shade the queued hits, so that each thread group only gets one domain.
+// The trace flavor has both RayQuery and TraceRay versions, the other two are compute only.
+#ifndef BRDF_RAY_PASS
+#define BRDF_RAY_PASS BRDF_RAY_PASS_IN_PLACE
+#endif
+
 static const float c_MaxIndirectRadiance = 10;
 
-#if USE_RAY_QUERY
-[numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
-void main(uint2 GlobalIndex : SV_DispatchThreadID)
-#else
-[shader("raygeneration")]
-void RayGen()
-#endif
+struct BrdfRaySample
 {
-#if !USE_RAY_QUERY
-    uint2 GlobalIndex = DispatchRaysIndex().xy;
-#endif
-    uint2 pixelPosition = RTXDI_ReservoirPosToPixelPos(GlobalIndex, g_Const.runtimeParams.activeCheckerboardField);
-
-    RAB_Surface surface = RAB_GetGBufferSurface(pixelPosition, false);
+    float3 direction;
+    float3 BRDF_over_PDF;
+    float overall_PDF;
+    bool isSpecularRay;
+    bool isDeltaSurface;
+    bool isBelowHorizon;
+};
 
-    if (!RAB_IsSurfaceValid(surface))
-        return;
+BrdfRaySample SampleBrdfRay(uint2 reservoirPosition, RAB_Surface surface)
+{
+    RAB_RandomSamplerState rng = RAB_InitRandomSampler(reservoirPosition, 5);
 
-    RAB_RandomSamplerState rng = RAB_InitRandomSampler(GlobalIndex, 5);
-    
     float3 tangent, bitangent;
     branchlessONB(surface.normal, tangent, bitangent);
 
-    float distance = max(1, 0.1 * length(surface.worldPos - g_Const.view.cameraDirectionOrPosition.xyz));
-
-    RayDesc ray;
-    ray.TMin = 0.001f * distance;
-    ray.TMax = 1000;
-
     float2 Rand;
     Rand.x = RAB_GetNextRandom(rng);
     Rand.y = RAB_GetNextRandom(rng);
 
     float3 V = normalize(g_Const.view.cameraDirectionOrPosition.xyz - surface.worldPos);
 
-    bool isSpecularRay = false;
-    bool isDeltaSurface = surface.material.roughness == 0;
+    BrdfRaySample brdfRay;
+    brdfRay.isSpecularRay = false;
+    brdfRay.isDeltaSurface = surface.material.roughness == 0;
+    brdfRay.isBelowHorizon = false;
     float specular_PDF;
-    float3 BRDF_over_PDF;
-    float overall_PDF;
 
     {
         float3 specularDirection;
@@ -71,13 +78,13 @@ void RayGen()
         {
             float3 Ve = float3(dot(V, tangent), dot(V, bitangent), dot(V, surface.normal));
             float3 He = sampleGGX_VNDF(Ve, surface.material.roughness, Rand);
-            float3 H = isDeltaSurface ? surface.normal : normalize(He.x * tangent + He.y * bitangent + He.z * surface.normal);
+            float3 H = brdfRay.isDeltaSurface ? surface.normal : normalize(He.x * tangent + He.y * bitangent + He.z * surface.normal);
             specularDirection = reflect(-V, H);
 
             float HoV = saturate(dot(H, V));
             float NoV = saturate(dot(surface.normal, V));
             float3 F = Schlick_Fresnel(surface.material.specularF0, HoV);
-            float G1 = isDeltaSurface ? 1.0 : (NoV > 0) ? G1_Smith(surface.material.roughness, NoV) : 0;
+            float G1 = brdfRay.isDeltaSurface ? 1.0 : (NoV > 0) ? G1_Smith(surface.material.roughness, NoV) : 0;
             specular_BRDF_over_PDF = F * G1;
         }
 
@@ -93,42 +100,56 @@ void RayGen()
         specular_PDF = saturate(calcLuminance(specular_BRDF_over_PDF) /
             calcLuminance(specular_BRDF_over_PDF + diffuse_BRDF_over_PDF * surface.material.diffuseAlbedo));
 
-        isSpecularRay = RAB_GetNextRandom(rng) < specular_PDF;
+        brdfRay.isSpecularRay = RAB_GetNextRandom(rng) < specular_PDF;
 
-        if (isSpecularRay)
+        if (brdfRay.isSpecularRay)
         {
-            ray.Direction = specularDirection;
-            BRDF_over_PDF = specular_BRDF_over_PDF / specular_PDF;
+            brdfRay.direction = specularDirection;
+            brdfRay.BRDF_over_PDF = specular_BRDF_over_PDF / specular_PDF;
         }
         else
         {
-            ray.Direction = diffuseDirection;
-            BRDF_over_PDF = diffuse_BRDF_over_PDF / (1.0 - specular_PDF);
+            brdfRay.direction = diffuseDirection;
+            brdfRay.BRDF_over_PDF = diffuse_BRDF_over_PDF / (1.0 - specular_PDF);
         }
 
-        const float specularLobe_PDF = ImportanceSampleGGX_VNDF_PDF(surface.material.roughness, surface.normal, V, ray.Direction);
-        const float diffuseLobe_PDF = saturate(dot(ray.Direction, surface.normal)) / c_pi;
+        const float specularLobe_PDF = ImportanceSampleGGX_VNDF_PDF(surface.material.roughness, surface.normal, V, brdfRay.direction);
+        const float diffuseLobe_PDF = saturate(dot(brdfRay.direction, surface.normal)) / c_pi;
 
         // For delta surfaces, we only pass the diffuse lobe to ReSTIR GI, and this pdf is for that.
-        overall_PDF = isDeltaSurface ? diffuseLobe_PDF : lerp(diffuseLobe_PDF, specularLobe_PDF, specular_PDF);
+        brdfRay.overall_PDF = brdfRay.isDeltaSurface ? diffuseLobe_PDF : lerp(diffuseLobe_PDF, specularLobe_PDF, specular_PDF);
     }
 
-    if (dot(surface.geoNormal, ray.Direction) <= 0.0)
+    if (dot(surface.geoNormal, brdfRay.direction) <= 0.0)
     {
-        BRDF_over_PDF = 0.0;
-        ray.TMax = 0;
+        brdfRay.BRDF_over_PDF = 0.0;
+        brdfRay.isBelowHorizon = true;
     }
 
+    return brdfRay;
+}
+
+RayDesc SetupBrdfRay(RAB_Surface surface, BrdfRaySample brdfRay)
+{
+    float distance = max(1, 0.1 * length(surface.worldPos - g_Const.view.cameraDirectionOrPosition.xyz));
+
+    RayDesc ray;
+    ray.TMin = 0.001f * distance;
+    ray.TMax = brdfRay.isBelowHorizon ? 0 : 1000;
     ray.Origin = surface.worldPos;
+    ray.Direction = brdfRay.direction;
 
-    float3 radiance = 0;
-    
+    return ray;
+}
+
+RayPayload TraceBrdfRay(RayDesc ray)
+{
     RayPayload payload = (RayPayload)0;
     payload.instanceID = ~0u;
     payload.throughput = 1.0;
 
     uint instanceMask = INSTANCE_MASK_OPAQUE;
-    
+
     if (g_Const.sceneConstants.enableAlphaTestedGeometry)
         instanceMask |= INSTANCE_MASK_ALPHA_TESTED;
 
@@ -137,7 +158,7 @@ void RayGen()
 
 #if USE_RAY_QUERY
     RayQuery<RAY_FLAG_SKIP_PROCEDURAL_PRIMITIVES> rayQuery;
-    
+
     rayQuery.TraceRayInline(SceneBVH, RAY_FLAG_NONE, instanceMask, ray);
 
     while (rayQuery.Proceed())
@@ -171,11 +192,25 @@ void RayGen()
     if (g_PerPassConstants.rayCountBufferIndex >= 0)
     {
         InterlockedAdd(u_RayCountBuffer[RAY_COUNT_TRACED(g_PerPassConstants.rayCountBufferIndex)], 1);
+
+        if (payload.instanceID != ~0u)
+            InterlockedAdd(u_RayCountBuffer[RAY_COUNT_HITS(g_PerPassConstants.rayCountBufferIndex)], 1);
     }
 
-    uint gbufferIndex = RTXDI_ReservoirPositionToPointer(g_Const.restirGI.reservoirBufferParams, GlobalIndex, 0);
-    
-    struct 
+    return payload;
+}
+
+void ShadeBrdfRay(uint2 reservoirPosition, uint2 pixelPosition, RAB_Surface surface, BrdfRaySample brdfRay, RayDesc ray, RayPayload payload)
+{
+    const bool isSpecularRay = brdfRay.isSpecularRay;
+    const bool isDeltaSurface = brdfRay.isDeltaSurface;
+    const float3 BRDF_over_PDF = brdfRay.BRDF_over_PDF;
+
+    float3 radiance = 0;
+
+    uint gbufferIndex = RTXDI_ReservoirPositionToPointer(g_Const.restirGI.reservoirBufferParams, reservoirPosition, 0);
+
+    struct
     {
         float3 position;
         float3 normal;
@@ -192,11 +227,6 @@ void RayGen()
 
     if (payload.instanceID != ~0u)
     {
-        if (g_PerPassConstants.rayCountBufferIndex >= 0)
-        {
-            InterlockedAdd(u_RayCountBuffer[RAY_COUNT_HITS(g_PerPassConstants.rayCountBufferIndex)], 1);
-        }
-
         GeometrySample gs = getGeometryFromHit(
             payload.instanceID,
             payload.geometryIndex,
@@ -204,7 +234,7 @@ void RayGen()
             payload.barycentrics,
             GeomAttr_Normal | GeomAttr_TexCoord | GeomAttr_Position,
             t_InstanceData, t_GeometryData, t_MaterialConstants);
-        
+
         MaterialSample ms = sampleGeometryMaterial(gs, 0, 0, 0,
             MatAttr_BaseColor | MatAttr_Emissive | MatAttr_MetalRough, s_MaterialSampler);
 
@@ -250,7 +280,7 @@ void RayGen()
     if (g_Const.enableBrdfIndirect)
     {
         SecondaryGBufferData secondaryGBufferData = (SecondaryGBufferData)0;
-        secondaryGBufferData.worldPos = secondarySurface.position;
+        SetSecondaryGBufferPosition(secondaryGBufferData, secondarySurface.position, surface.worldPos);
         secondaryGBufferData.normal = ndirToOctUnorm32(secondarySurface.normal);
         secondaryGBufferData.throughputAndFlags = Pack_R16G16B16A16_FLOAT(float4(payload.throughput * BRDF_over_PDF, 0));
         secondaryGBufferData.diffuseAlbedo = Pack_R11G11B10_UFLOAT(secondarySurface.diffuseAlbedo);
@@ -271,12 +301,12 @@ void RayGen()
 
             // The emission from the secondary surface needs to be added when creating the initial
             // GI reservoir sample in ShadeSecondarySurface.hlsl. It need to be stored separately.
-            secondaryGBufferData.emission = radiance;
+            SetSecondaryGBufferEmission(secondaryGBufferData, radiance);
             radiance = 0;
-            
-            secondaryGBufferData.pdf = overall_PDF;
+
+            secondaryGBufferData.pdf = brdfRay.overall_PDF;
         }
-        
+
         uint flags = 0;
         if (isSpecularRay) flags |= kSecondaryGBuffer_IsSpecularRay;
         if (isDeltaSurface) flags |= kSecondaryGBuffer_IsDeltaSurface;
@@ -298,7 +328,298 @@ void RayGen()
         specular = DemodulateSpecular(surface.material.specularF0, specular);
 
 
-        StoreShadingOutput(GlobalIndex, pixelPosition,
+        StoreShadingOutput(reservoirPosition, pixelPosition,
             surface.viewDepth, surface.material.roughness, diffuse, specular, payload.committedRayT, !g_Const.enableBrdfAdditiveBlend, !g_Const.enableBrdfIndirect);
     }
 }
+
+void TraceAndShadeBrdfRay(uint2 reservoirPosition, uint2 pixelPosition, RAB_Surface surface, BrdfRaySample brdfRay)
+{
+    RayDesc ray = SetupBrdfRay(surface, brdfRay);
+
+    RayPayload payload = TraceBrdfRay(ray);
+
+    ShadeBrdfRay(reservoirPosition, pixelPosition, surface, brdfRay, ray, payload);
+}
+
+#if BRDF_RAY_PASS != BRDF_RAY_PASS_IN_PLACE
+
+// The binned rays of one tile occupy a contiguous range of u_BrdfRays. The tiles are the same size
+// as the reservoir blocks, so the buffer uses the same addressing and size as the reservoir arrays.
+uint GetBrdfRayTileOffset(uint2 tileIndex)
+{
+    return tileIndex.y * g_Const.restirGI.reservoirBufferParams.reservoirBlockRowPitch
+        + tileIndex.x * (BRDF_RAY_BIN_TILE_SIZE * BRDF_RAY_BIN_TILE_SIZE);
+}
+
+BrdfRayData PackBrdfRay(uint2 reservoirPosition, BrdfRaySample brdfRay)
+{
+    uint flags = kBrdfRay_IsValid;
+    if (brdfRay.isSpecularRay) flags |= kBrdfRay_IsSpecularRay;
+    if (brdfRay.isDeltaSurface) flags |= kBrdfRay_IsDeltaSurface;
+    if (brdfRay.isBelowHorizon) flags |= kBrdfRay_IsBelowHorizon;
+
+    BrdfRayData rayData;
+    rayData.direction = brdfRay.direction;
+    rayData.overallPdf = brdfRay.overall_PDF;
+    rayData.brdfOverPdf = brdfRay.BRDF_over_PDF;
+    rayData.reservoirPositionAndFlags = (reservoirPosition.x & 0x3fff) | ((reservoirPosition.y & 0x3fff) << 14) | (flags << 28);
+    return rayData;
+}
+
+bool UnpackBrdfRay(BrdfRayData rayData, out uint2 reservoirPosition, out BrdfRaySample brdfRay)
+{
+    uint flags = rayData.reservoirPositionAndFlags >> 28;
+    reservoirPosition = uint2(rayData.reservoirPositionAndFlags & 0x3fff, (rayData.reservoirPositionAndFlags >> 14) & 0x3fff);
+
+    brdfRay.direction = rayData.direction;
+    brdfRay.overall_PDF = rayData.overallPdf;
+    brdfRay.BRDF_over_PDF = rayData.brdfOverPdf;
+    brdfRay.isSpecularRay = (flags & kBrdfRay_IsSpecularRay) != 0;
+    brdfRay.isDeltaSurface = (flags & kBrdfRay_IsDeltaSurface) != 0;
+    brdfRay.isBelowHorizon = (flags & kBrdfRay_IsBelowHorizon) != 0;
+
+    return (flags & kBrdfRay_IsValid) != 0;
+}
+
+// Maps a thread of a dispatch over the binning tiles to its slot in u_BrdfRays.
+// Each binning tile is traced by several consecutive thread groups, so that the threads of a wave
+// mostly get rays from the same origin tile and direction octant.
+uint GetBinnedBrdfRayIndex(uint2 globalIndex)
+{
+    const uint groupsPerTile = BRDF_RAY_BIN_TILE_SIZE / RTXDI_SCREEN_SPACE_GROUP_SIZE;
+    const uint2 groupIndex = globalIndex / RTXDI_SCREEN_SPACE_GROUP_SIZE;
+    const uint2 threadInGroup = globalIndex % RTXDI_SCREEN_SPACE_GROUP_SIZE;
+    const uint2 tileIndex = groupIndex / groupsPerTile;
+    const uint2 groupInTile = groupIndex % groupsPerTile;
+    const uint groupOffset = (groupInTile.y * groupsPerTile + groupInTile.x) * (RTXDI_SCREEN_SPACE_GROUP_SIZE * RTXDI_SCREEN_SPACE_GROUP_SIZE);
+
+    return GetBrdfRayTileOffset(tileIndex) + groupOffset + threadInGroup.y * RTXDI_SCREEN_SPACE_GROUP_SIZE + threadInGroup.x;
+}
+
+#endif
+
+#if BRDF_RAY_PASS == BRDF_RAY_PASS_BINNING
+
+// One bin per direction octant, plus one at the end for the threads that have no ray.
+static const uint c_NumBrdfRayBins = 9;
+
+groupshared uint s_BinCounts[c_NumBrdfRayBins];
+groupshared uint s_BinOffsets[c_NumBrdfRayBins];
+
+uint GetDirectionOctant(float3 direction)
+{
+    return (direction.x < 0 ? 1 : 0) | (direction.y < 0 ? 2 : 0) | (direction.z < 0 ? 4 : 0);
+}
+
+[numthreads(BRDF_RAY_BIN_TILE_SIZE, BRDF_RAY_BIN_TILE_SIZE, 1)]
+void main(uint2 GlobalIndex : SV_DispatchThreadID, uint2 GroupIndex : SV_GroupID, uint ThreadIndex : SV_GroupIndex)
+{
+    if (ThreadIndex < c_NumBrdfRayBins)
+        s_BinCounts[ThreadIndex] = 0;
+
+    GroupMemoryBarrierWithGroupSync();
+
+    uint2 pixelPosition = RTXDI_ReservoirPosToPixelPos(GlobalIndex, g_Const.runtimeParams.activeCheckerboardField);
+
+    RAB_Surface surface = RAB_GetGBufferSurface(pixelPosition, false);
+
+    // Threads without a valid surface still write a record so that every slot of the tile is initialized.
+    BrdfRayData rayData = (BrdfRayData)0;
+    uint bin = c_NumBrdfRayBins - 1;
+
+    if (RAB_IsSurfaceValid(surface))
+    {
+        BrdfRaySample brdfRay = SampleBrdfRay(GlobalIndex, surface);
+        rayData = PackBrdfRay(GlobalIndex, brdfRay);
+        bin = GetDirectionOctant(brdfRay.direction);
+    }
+
+    uint indexInBin;
+    InterlockedAdd(s_BinCounts[bin], 1, indexInBin);
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if (ThreadIndex == 0)
+    {
+        uint offset = 0;
+        for (uint i = 0; i < c_NumBrdfRayBins; i++)
+        {
+            s_BinOffsets[i] = offset;
+            offset += s_BinCounts[i];
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    u_BrdfRays[GetBrdfRayTileOffset(GroupIndex) + s_BinOffsets[bin] + indexInBin] = rayData;
+}
+
+#elif BRDF_RAY_PASS == BRDF_RAY_PASS_SORTED
+
+[numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
+void main(uint2 GlobalIndex : SV_DispatchThreadID)
+{
+    uint2 reservoirPosition;
+    BrdfRaySample brdfRay;
+    if (!UnpackBrdfRay(u_BrdfRays[GetBinnedBrdfRayIndex(GlobalIndex)], reservoirPosition, brdfRay))
+        return;
+
+    uint2 pixelPosition = RTXDI_ReservoirPosToPixelPos(reservoirPosition, g_Const.runtimeParams.activeCheckerboardField);
+
+    RAB_Surface surface = RAB_GetGBufferSurface(pixelPosition, false);
+
+    TraceAndShadeBrdfRay(reservoirPosition, pixelPosition, surface, brdfRay);
+}
+
+#elif BRDF_RAY_PASS == BRDF_RAY_PASS_WAVEFRONT_TRACE
+
+uint GetBrdfRayHitDomain(RayPayload payload)
+{
+    if (payload.instanceID == ~0u)
+        return BRDF_RAY_DOMAIN_MISS;
+
+    const InstanceData instance = t_InstanceData[payload.instanceID];
+    const GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + payload.geometryIndex];
+    const uint domain = t_MaterialConstants[geometry.materialIndex].domain;
+
+    if (domain == MaterialDomain_AlphaTested)
+        return BRDF_RAY_DOMAIN_ALPHA_TESTED;
+
+    if (domain == MaterialDomain_Transmissive ||
+        domain == MaterialDomain_TransmissiveAlphaTested ||
+        domain == MaterialDomain_TransmissiveAlphaBlended)
+        return BRDF_RAY_DOMAIN_TRANSMISSIVE;
+
+    return BRDF_RAY_DOMAIN_OPAQUE;
+}
+
+#if USE_RAY_QUERY
+[numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
+void main(uint2 GlobalIndex : SV_DispatchThreadID)
+#else
+[shader("raygeneration")]
+void RayGen()
+#endif
+{
+#if !USE_RAY_QUERY
+    uint2 GlobalIndex = DispatchRaysIndex().xy;
+#endif
+    const uint rayIndex = GetBinnedBrdfRayIndex(GlobalIndex);
+
+    uint2 reservoirPosition;
+    BrdfRaySample brdfRay;
+    if (!UnpackBrdfRay(u_BrdfRays[rayIndex], reservoirPosition, brdfRay))
+        return;
+
+    uint2 pixelPosition = RTXDI_ReservoirPosToPixelPos(reservoirPosition, g_Const.runtimeParams.activeCheckerboardField);
+
+    RAB_Surface surface = RAB_GetGBufferSurface(pixelPosition, false);
+
+    RayPayload payload = TraceBrdfRay(SetupBrdfRay(surface, brdfRay));
+
+    BrdfRayHitData hit;
+    hit.instanceID = payload.instanceID;
+    hit.geometryIndex = payload.geometryIndex;
+    hit.primitiveIndex = payload.primitiveIndex;
+    hit.hitDistance = payload.committedRayT;
+    hit.barycentrics = payload.barycentrics;
+    hit.throughput = Pack_R11G11B10_UFLOAT(payload.throughput);
+    hit.pad = 0;
+    u_BrdfRayHits[rayIndex] = hit;
+
+    // Append the ray to the queue of its domain. Each queue has room for every ray of the frame.
+    const uint domain = GetBrdfRayHitDomain(payload);
+
+    uint indexInQueue;
+    InterlockedAdd(u_BrdfRayQueueCounters[BRDF_RAY_QUEUE_COUNTS + domain], 1, indexInQueue);
+
+    u_BrdfRayQueues[domain * g_Const.restirGI.reservoirBufferParams.reservoirArrayPitch + indexInQueue] = rayIndex;
+}
+
+#elif BRDF_RAY_PASS == BRDF_RAY_PASS_WAVEFRONT_ARGS
+
+[numthreads(1, 1, 1)]
+void main()
+{
+    // Each domain starts at a thread group boundary, so that no group shades more than one domain
+    uint groupCount = 0;
+    for (uint domain = 0; domain < BRDF_RAY_DOMAIN_COUNT; domain++)
+    {
+        u_BrdfRayQueueCounters[BRDF_RAY_QUEUE_GROUP_OFFSETS + domain] = groupCount;
+
+        const uint rayCount = u_BrdfRayQueueCounters[BRDF_RAY_QUEUE_COUNTS + domain];
+        groupCount += (rayCount + BRDF_RAY_SHADE_GROUP_SIZE - 1) / BRDF_RAY_SHADE_GROUP_SIZE;
+    }
+
+    u_BrdfRayQueueCounters[BRDF_RAY_QUEUE_DISPATCH_ARGS + 0] = groupCount;
+    u_BrdfRayQueueCounters[BRDF_RAY_QUEUE_DISPATCH_ARGS + 1] = 1;
+    u_BrdfRayQueueCounters[BRDF_RAY_QUEUE_DISPATCH_ARGS + 2] = 1;
+}
+
+#elif BRDF_RAY_PASS == BRDF_RAY_PASS_WAVEFRONT_SHADE
+
+[numthreads(BRDF_RAY_SHADE_GROUP_SIZE, 1, 1)]
+void main(uint GroupIndex : SV_GroupID, uint ThreadIndex : SV_GroupIndex)
+{
+    uint domain = 0;
+    [unroll]
+    for (uint i = 1; i < BRDF_RAY_DOMAIN_COUNT; i++)
+    {
+        if (GroupIndex >= u_BrdfRayQueueCounters[BRDF_RAY_QUEUE_GROUP_OFFSETS + i])
+            domain = i;
+    }
+
+    const uint indexInQueue = (GroupIndex - u_BrdfRayQueueCounters[BRDF_RAY_QUEUE_GROUP_OFFSETS + domain]) * BRDF_RAY_SHADE_GROUP_SIZE + ThreadIndex;
+    if (indexInQueue >= u_BrdfRayQueueCounters[BRDF_RAY_QUEUE_COUNTS + domain])
+        return;
+
+    const uint rayIndex = u_BrdfRayQueues[domain * g_Const.restirGI.reservoirBufferParams.reservoirArrayPitch + indexInQueue];
+
+    uint2 reservoirPosition;
+    BrdfRaySample brdfRay;
+    UnpackBrdfRay(u_BrdfRays[rayIndex], reservoirPosition, brdfRay);
+
+    uint2 pixelPosition = RTXDI_ReservoirPosToPixelPos(reservoirPosition, g_Const.runtimeParams.activeCheckerboardField);
+
+    RAB_Surface surface = RAB_GetGBufferSurface(pixelPosition, false);
+
+    const BrdfRayHitData hit = u_BrdfRayHits[rayIndex];
+
+    RayPayload payload = (RayPayload)0;
+    payload.instanceID = hit.instanceID;
+    payload.geometryIndex = hit.geometryIndex;
+    payload.primitiveIndex = hit.primitiveIndex;
+    payload.committedRayT = hit.hitDistance;
+    payload.barycentrics = hit.barycentrics;
+    payload.throughput = Unpack_R11G11B10_UFLOAT(hit.throughput);
+
+    ShadeBrdfRay(reservoirPosition, pixelPosition, surface, brdfRay, SetupBrdfRay(surface, brdfRay), payload);
+}
+
+#else // BRDF_RAY_PASS_IN_PLACE
+
+#if USE_RAY_QUERY
+[numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
+void main(uint2 GlobalIndex : SV_DispatchThreadID)
+#else
+[shader("raygeneration")]
+void RayGen()
+#endif
+{
+#if !USE_RAY_QUERY
+    uint2 GlobalIndex = DispatchRaysIndex().xy;
+#endif
+    uint2 pixelPosition = RTXDI_ReservoirPosToPixelPos(GlobalIndex, g_Const.runtimeParams.activeCheckerboardField);
+
+    RAB_Surface surface = RAB_GetGBufferSurface(pixelPosition, false);
+
+    if (!RAB_IsSurfaceValid(surface))
+        return;
+
+    BrdfRaySample brdfRay = SampleBrdfRay(GlobalIndex, surface);
+
+    TraceAndShadeBrdfRay(GlobalIndex, pixelPosition, surface, brdfRay);
+}
+
+#endif
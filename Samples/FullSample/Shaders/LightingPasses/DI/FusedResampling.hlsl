@@ -31,6 +31,7 @@
 #endif
 
 #include "../ShadingHelpers.hlsli"
+#include "../AdaptiveSampleBudget.hlsli"
 
 #if USE_RAY_QUERY
 [numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
@@ -53,10 +54,12 @@ void RayGen()
 
     RAB_Surface surface = RAB_GetGBufferSurface(pixelPosition, false);
 
+    const float budgetScale = GetSampleBudgetScale(pixelPosition);
+
     RTXDI_SampleParameters sampleParams = RTXDI_InitSampleParameters(
-        g_Const.restirDI.initialSamplingParams.numPrimaryLocalLightSamples,
+        ApplySampleBudget(g_Const.restirDI.initialSamplingParams.numPrimaryLocalLightSamples, budgetScale),
         g_Const.restirDI.initialSamplingParams.numPrimaryInfiniteLightSamples,
-        g_Const.restirDI.initialSamplingParams.numPrimaryEnvironmentSamples,
+        ApplySampleBudget(g_Const.restirDI.initialSamplingParams.numPrimaryEnvironmentSamples, budgetScale),
         g_Const.restirDI.initialSamplingParams.numPrimaryBrdfSamples,
         g_Const.restirDI.initialSamplingParams.brdfCutoff,
         0.001f);
@@ -99,7 +102,7 @@ void RayGen()
     stparams.biasCorrectionMode = g_Const.restirDI.temporalResamplingParams.temporalBiasCorrection;
     stparams.depthThreshold = g_Const.restirDI.temporalResamplingParams.temporalDepthThreshold;
     stparams.normalThreshold = g_Const.restirDI.temporalResamplingParams.temporalNormalThreshold;
-    stparams.numSamples = g_Const.restirDI.spatialResamplingParams.numSpatialSamples + 1;
+    stparams.numSamples = ApplySampleBudget(g_Const.restirDI.spatialResamplingParams.numSpatialSamples, budgetScale) + 1;
     stparams.numDisocclusionBoostSamples = g_Const.restirDI.spatialResamplingParams.numDisocclusionBoostSamples;
     stparams.samplingRadius = g_Const.restirDI.spatialResamplingParams.spatialSamplingRadius;
     stparams.enableVisibilityShortcut = g_Const.restirDI.temporalResamplingParams.discardInvisibleSamples;
@@ -124,12 +127,14 @@ void RayGen()
     float3 specular = 0;
     float lightDistance = 0;
     float2 currLuminance = 0;
+    bool visibilityCached = false;
 
     if (RTXDI_IsValidDIReservoir(reservoir))
     {
         // lightSample is produced by the RTXDI_SampleLightsForSurface and RTXDI_SpatioTemporalResampling calls above
-        ShadeSurfaceWithLightSample(reservoir, surface, lightSample,
-            /* previousFrameTLAS = */ false, /* enableVisibilityReuse = */ true, diffuse, specular, lightDistance);
+        ShadeSurfaceWithCachedVisibility(reservoir, surface, lightSample,
+            /* previousFrameTLAS = */ false, /* enableVisibilityReuse = */ true, pixelPosition,
+            diffuse, specular, lightDistance, visibilityCached);
 
         currLuminance = float2(calcLuminance(diffuse * surface.material.diffuseAlbedo), calcLuminance(specular));
         
@@ -137,8 +142,8 @@ void RayGen()
     }
 
     // Store the sampled lighting luminance for the gradient pass.
-    // Discard the pixels where the visibility was reused, as gradients need actual visibility.
-    u_RestirLuminance[GlobalIndex] = currLuminance * (reservoir.age > 0 ? 0 : 1);
+    // Discard the pixels where the visibility was reused or cached, as gradients need actual visibility.
+    u_RestirLuminance[GlobalIndex] = currLuminance * (reservoir.age > 0 || visibilityCached ? 0 : 1);
 
     RTXDI_StoreDIReservoir(reservoir, g_Const.restirDI.reservoirBufferParams, GlobalIndex, g_Const.restirDI.bufferIndices.shadingInputBufferIndex);
 
@@ -14,6 +14,8 @@
 
 #include <Rtxdi/DI/InitialSampling.hlsli>
 
+#include "../AdaptiveSampleBudget.hlsli"
+
 #if USE_RAY_QUERY
 [numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
 void main(uint2 GlobalIndex : SV_DispatchThreadID)
@@ -35,10 +37,12 @@ void RayGen()
 
     RAB_Surface surface = RAB_GetGBufferSurface(pixelPosition, false);
 
+    const float budgetScale = GetSampleBudgetScale(pixelPosition);
+
     RTXDI_SampleParameters sampleParams = RTXDI_InitSampleParameters(
-        g_Const.restirDI.initialSamplingParams.numPrimaryLocalLightSamples,
+        ApplySampleBudget(g_Const.restirDI.initialSamplingParams.numPrimaryLocalLightSamples, budgetScale),
         g_Const.restirDI.initialSamplingParams.numPrimaryInfiniteLightSamples,
-        g_Const.restirDI.initialSamplingParams.numPrimaryEnvironmentSamples,
+        ApplySampleBudget(g_Const.restirDI.initialSamplingParams.numPrimaryEnvironmentSamples, budgetScale),
         g_Const.restirDI.initialSamplingParams.numPrimaryBrdfSamples,
         g_Const.restirDI.initialSamplingParams.brdfCutoff,
         0.001f);
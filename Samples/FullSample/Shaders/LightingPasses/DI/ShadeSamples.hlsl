@@ -50,6 +50,7 @@ void RayGen()
     float3 specular = 0;
     float lightDistance = 0;
     float2 currLuminance = 0;
+    bool visibilityCached = false;
 
     if (RTXDI_IsValidDIReservoir(reservoir))
     {
@@ -58,8 +59,9 @@ void RayGen()
         RAB_LightSample lightSample = RAB_SamplePolymorphicLight(lightInfo,
             surface, RTXDI_GetDIReservoirSampleUV(reservoir));
 
-        bool needToStore = ShadeSurfaceWithLightSample(reservoir, surface, lightSample,
-            /* previousFrameTLAS = */ false, /* enableVisibilityReuse = */ true, diffuse, specular, lightDistance);
+        bool needToStore = ShadeSurfaceWithCachedVisibility(reservoir, surface, lightSample,
+            /* previousFrameTLAS = */ false, /* enableVisibilityReuse = */ true, pixelPosition,
+            diffuse, specular, lightDistance, visibilityCached);
     
         currLuminance = float2(calcLuminance(diffuse * surface.material.diffuseAlbedo), calcLuminance(specular));
     
@@ -72,8 +74,8 @@ void RayGen()
     }
 
     // Store the sampled lighting luminance for the gradient pass.
-    // Discard the pixels where the visibility was reused, as gradients need actual visibility.
-    u_RestirLuminance[GlobalIndex] = currLuminance * (reservoir.age > 0 ? 0 : 1);
+    // Discard the pixels where the visibility was reused or cached, as gradients need actual visibility.
+    u_RestirLuminance[GlobalIndex] = currLuminance * (reservoir.age > 0 || visibilityCached ? 0 : 1);
     
 #if RTXDI_REGIR_MODE != RTXDI_REGIR_DISABLED
     if (g_Const.visualizeRegirCells)
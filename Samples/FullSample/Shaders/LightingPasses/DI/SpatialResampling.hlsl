@@ -14,6 +14,8 @@
 
 #include <Rtxdi/DI/SpatialResampling.hlsli>
 
+#include "../AdaptiveSampleBudget.hlsli"
+
 #if USE_RAY_QUERY
 [numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
 void main(uint2 GlobalIndex : SV_DispatchThreadID)
@@ -43,7 +45,7 @@ void RayGen()
 
         RTXDI_DISpatialResamplingParameters sparams;
         sparams.sourceBufferIndex = g_Const.restirDI.bufferIndices.spatialResamplingInputBufferIndex;
-        sparams.numSamples = g_Const.restirDI.spatialResamplingParams.numSpatialSamples;
+        sparams.numSamples = ApplySampleBudget(g_Const.restirDI.spatialResamplingParams.numSpatialSamples, GetSampleBudgetScale(pixelPosition));
         sparams.numDisocclusionBoostSamples = g_Const.restirDI.spatialResamplingParams.numDisocclusionBoostSamples;
         sparams.targetHistoryLength = g_Const.restirDI.temporalResamplingParams.maxHistoryLength;
         sparams.biasCorrectionMode = g_Const.restirDI.spatialResamplingParams.spatialBiasCorrection;
@@ -11,6 +11,7 @@
 #pragma pack_matrix(row_major)
 
 #include "../RtxdiApplicationBridge/RtxdiApplicationBridge.hlsli"
+#include "../SecondaryGBuffer.hlsli"
 #include "../ShadingHelpers.hlsli"
 
 #include <Rtxdi/GI/Reservoir.hlsli>
@@ -48,8 +49,8 @@ RTXDI_GIReservoir LoadInitialSampleReservoir(int2 reservoirPosition, RAB_Surface
     const float3 throughput = Unpack_R16G16B16A16_FLOAT(secondaryGBufferData.throughputAndFlags).rgb;
 
     // Note: the secondaryGBufferData.emission field contains the sampled radiance saved in ShadeSecondarySurfaces 
-    return RTXDI_MakeGIReservoir(secondaryGBufferData.worldPos,
-        normal, secondaryGBufferData.emission * throughput, secondaryGBufferData.pdf);
+    return RTXDI_MakeGIReservoir(GetSecondaryGBufferPosition(secondaryGBufferData, primarySurface.worldPos),
+        normal, GetSecondaryGBufferEmission(secondaryGBufferData) * throughput, secondaryGBufferData.pdf);
 }
 
 #if USE_RAY_QUERY
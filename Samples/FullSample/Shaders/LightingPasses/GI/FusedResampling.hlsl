@@ -40,8 +40,7 @@ void RayGen()
     const uint2 reservoirPosition = RTXDI_PixelPosToReservoirPos(pixelPosition, g_Const.runtimeParams.activeCheckerboardField);
     RTXDI_GIReservoir reservoir = RTXDI_LoadGIReservoir(g_Const.restirGI.reservoirBufferParams, reservoirPosition, g_Const.restirGI.bufferIndices.secondarySurfaceReSTIRDIOutputBufferIndex);
 
-    float3 motionVector = t_MotionVectors[pixelPosition].xyz;
-    motionVector = convertMotionVectorToPixelSpace(g_Const.view, g_Const.prevView, pixelPosition, motionVector);
+    float3 motionVector = GetGIScreenSpaceMotion(pixelPosition);
 
     if (RAB_IsSurfaceValid(primarySurface)) {
         RTXDI_GISpatioTemporalResamplingParameters stParams;
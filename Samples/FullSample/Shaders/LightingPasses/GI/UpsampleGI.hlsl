@@ -0,0 +1,94 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Resolves the output of the reduced resolution ReSTIR GI passes into the render resolution lighting textures.
+// Each pixel blends the 4 nearest GI grid samples with bilinear weights, scaled by the similarity of the
+// sample's G-buffer surface to the pixel's surface (joint bilateral upsampling).
+
+#pragma pack_matrix(row_major)
+
+#include "../RtxdiApplicationBridge/RtxdiApplicationBridge.hlsli"
+
+#ifdef WITH_NRD
+#define NRD_HEADER_ONLY
+#include <NRDEncoding.hlsli>
+#include <NRD.hlsli>
+#endif
+
+#include "../ShadingHelpers.hlsli"
+
+static const float kDepthSigma = 0.05; // relative view depth difference
+static const float kNormalPower = 32.0;
+static const float kMinTotalWeight = 1e-4;
+
+[numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
+void main(uint2 pixelPosition : SV_DispatchThreadID)
+{
+    if (any(pixelPosition >= g_Const.view.viewportSize))
+        return;
+
+    const RAB_Surface surface = GetRenderResolutionGBufferSurface(pixelPosition, false);
+
+    if (!RAB_IsSurfaceValid(surface))
+        return;
+
+    const int factor = int(g_Const.giDownscaleFactor);
+    const int2 giViewportSize = GetGIViewportSize(false);
+
+    // GI grid samples are located at the centers of their blocks
+    const float2 giPosition = (float2(pixelPosition) + 0.5) / float(factor) - 0.5;
+    const int2 basePosition = int2(floor(giPosition));
+    const float2 bilinear = giPosition - float2(basePosition);
+
+    float4 diffuseSum = 0;
+    float4 specularSum = 0;
+    float weightSum = 0;
+
+    [unroll]
+    for (int i = 0; i < 4; i++)
+    {
+        const int2 offset = int2(i & 1, i >> 1);
+        const int2 giPixelPosition = clamp(basePosition + offset, 0, giViewportSize - 1);
+
+        const RAB_Surface sampleSurface = RAB_GetGBufferSurface(giPixelPosition, false);
+        if (!RAB_IsSurfaceValid(sampleSurface))
+            continue;
+
+        float weight = (offset.x ? bilinear.x : 1.0 - bilinear.x) * (offset.y ? bilinear.y : 1.0 - bilinear.y);
+        weight *= exp(-abs(sampleSurface.viewDepth - surface.viewDepth) / (surface.viewDepth * kDepthSigma));
+        weight *= pow(saturate(dot(sampleSurface.normal, surface.normal)), kNormalPower);
+
+        diffuseSum += u_GIDiffuseLighting[giPixelPosition] * weight;
+        specularSum += u_GISpecularLighting[giPixelPosition] * weight;
+        weightSum += weight;
+    }
+
+    float4 diffuse;
+    float4 specular;
+
+    if (weightSum > kMinTotalWeight)
+    {
+        diffuse = diffuseSum / weightSum;
+        specular = specularSum / weightSum;
+    }
+    else
+    {
+        // None of the neighbors match the surface (thin geometry, silhouettes): fall back to the sample of this pixel's block
+        const int2 giPixelPosition = min(int2(pixelPosition) / factor, giViewportSize - 1);
+        diffuse = u_GIDiffuseLighting[giPixelPosition];
+        specular = u_GISpecularLighting[giPixelPosition];
+    }
+
+    // This pass replaces all the GI shading passes at render resolution, so it starts the accumulation
+    // when the BRDF pass would have done so, and always finalizes the output for the denoiser.
+    StoreRenderResolutionShadingOutput(pixelPosition, pixelPosition,
+        surface.viewDepth, surface.material.roughness, diffuse.rgb, specular.rgb, diffuse.w, specular.w,
+        !g_Const.enableBrdfAdditiveBlend, true);
+}
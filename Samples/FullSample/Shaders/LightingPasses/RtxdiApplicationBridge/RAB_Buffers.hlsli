@@ -15,6 +15,9 @@ Texture2D<uint> t_PrevGBufferSpecularRough : register(t9);
 Texture2D<float2> t_PrevRestirLuminance : register(t10);
 Texture2D<float4> t_MotionVectors : register(t11);
 Texture2D<float4> t_DenoiserNormalRoughness : register(t12);
+StructuredBuffer<uint4> t_GBufferSurfaces : register(t13);
+StructuredBuffer<uint4> t_PrevGBufferSurfaces : register(t14);
+Texture2D<float> t_ConfidenceTiles : register(t15);
 
 // Scene resources
 RaytracingAccelerationStructure SceneBVH : register(t30);
@@ -30,6 +33,8 @@ Buffer<uint> t_LightIndexMappingBuffer : register(t22);
 Texture2D t_EnvironmentPdfTexture : register(t23);
 Texture2D t_LocalLightPdfTexture : register(t24);
 StructuredBuffer<uint> t_GeometryInstanceToLight : register(t25);
+StructuredBuffer<PolymorphicLightInfo> t_InstancedLightBuffer : register(t26);
+StructuredBuffer<uint2> t_InstancedLightRefBuffer : register(t27);
 
 // Screen-sized UAVs
 RWStructuredBuffer<RTXDI_PackedDIReservoir> u_LightReservoirs : register(u0);
@@ -39,12 +44,19 @@ RWTexture2D<int2> u_TemporalSamplePositions : register(u3);
 RWTexture2DArray<float4> u_Gradients : register(u4);
 RWTexture2D<float2> u_RestirLuminance : register(u5);
 RWStructuredBuffer<RTXDI_PackedGIReservoir> u_GIReservoirs : register(u6);
+RWTexture2D<float4> u_GIDiffuseLighting : register(u7);
+RWTexture2D<float4> u_GISpecularLighting : register(u8);
+RWTexture2DArray<uint4> u_VisibilityCache : register(u9); // see LoadCachedFinalVisibility(...) in ShadingHelpers.hlsli
 
 // RTXDI UAVs
 RWBuffer<uint2> u_RisBuffer : register(u10);
 RWBuffer<uint4> u_RisLightDataBuffer : register(u11);
 RWBuffer<uint> u_RayCountBuffer : register(u12);
 RWStructuredBuffer<SecondaryGBufferData> u_SecondaryGBuffer : register(u13);
+RWStructuredBuffer<BrdfRayData> u_BrdfRays : register(u14);
+RWBuffer<uint> u_BrdfRayQueues : register(u15);
+RWBuffer<uint> u_BrdfRayQueueCounters : register(u16);
+RWStructuredBuffer<BrdfRayHitData> u_BrdfRayHits : register(u17);
 
 // Other
 ConstantBuffer<ResamplingConstants> g_Const : register(b0);
@@ -74,4 +86,47 @@ int RAB_TranslateLightIndex(uint lightIndex, bool currentToPrevious)
     return int(mappedIndexPlusOne) - 1;
 }
 
+// The ReSTIR GI passes can run on a grid that is coarser than the render resolution by g_Const.giDownscaleFactor,
+// see LightingPasses::RenderBrdfRays. Pixel positions in those passes are on that grid, and each of them
+// stands for the render resolution pixel in the middle of its block. The DI passes always use giDownscaleFactor = 0.
+bool IsReducedResolutionGI()
+{
+    return g_Const.giDownscaleFactor > 1;
+}
+
+int2 GetGIViewportSize(bool previousFrame)
+{
+    int2 viewportSize = previousFrame
+        ? int2(g_Const.prevView.viewportSize)
+        : int2(g_Const.view.viewportSize);
+
+    if (!IsReducedResolutionGI())
+        return viewportSize;
+
+    const int factor = int(g_Const.giDownscaleFactor);
+    return (viewportSize + factor - 1) / factor;
+}
+
+int2 GIPixelPosToRenderPixelPos(int2 giPixelPosition, bool previousFrame)
+{
+    if (!IsReducedResolutionGI())
+        return giPixelPosition;
+
+    const int factor = int(g_Const.giDownscaleFactor);
+    int2 pixelPosition = giPixelPosition * factor + factor / 2;
+
+    // Keep the centers of the partial blocks on the right and bottom edges inside the viewport,
+    // but leave positions that are outside of the GI grid outside, so that they are still rejected.
+    if (all(giPixelPosition >= 0) && all(giPixelPosition < GetGIViewportSize(previousFrame)))
+    {
+        int2 viewportSize = previousFrame
+            ? int2(g_Const.prevView.viewportSize)
+            : int2(g_Const.view.viewportSize);
+
+        pixelPosition = min(pixelPosition, viewportSize - 1);
+    }
+
+    return pixelPosition;
+}
+
 #endif // RAB_BUFFER_HLSLI
\ No newline at end of file
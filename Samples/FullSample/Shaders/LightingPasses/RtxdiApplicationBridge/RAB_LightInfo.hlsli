@@ -13,9 +13,26 @@ RAB_LightInfo RAB_EmptyLightInfo()
 }
 
 // Loads polymorphic light data from the global light buffer.
+// Each half of the light index space starts with the triangles of the instanced emissive meshes, see PrepareLightsPass.
+// Those are stored once per mesh in local space, and the light is composed from that triangle and the instance transform.
+// The other lights follow and are stored in the light buffer, which has no entries for the instanced lights.
 RAB_LightInfo RAB_LoadLightInfo(uint index, bool previousFrame)
 {
-    return t_LightDataBuffer[index];
+    uint bufferHalf = (index >= g_Const.lightBufferCapacity) ? 1 : 0;
+    uint indexInHalf = index - bufferHalf * g_Const.lightBufferCapacity;
+    uint numInstancedLights = g_Const.instancedLightCounts[bufferHalf];
+
+    if (indexInHalf < numInstancedLights)
+    {
+        uint2 instancedLightRef = t_InstancedLightRefBuffer[bufferHalf * g_Const.instancedLightCapacity + indexInHalf];
+        InstanceData instance = t_InstanceData[instancedLightRef.x];
+
+        return transformTriangleLight(t_InstancedLightBuffer[instancedLightRef.y],
+            previousFrame ? instance.prevTransform : instance.transform);
+    }
+
+    uint lightDataCapacity = g_Const.lightBufferCapacity - g_Const.instancedLightCapacity;
+    return t_LightDataBuffer[bufferHalf * lightDataCapacity + indexInHalf - numInstancedLights];
 }
 
 // Loads triangle light data from a tile produced by the presampling pass.
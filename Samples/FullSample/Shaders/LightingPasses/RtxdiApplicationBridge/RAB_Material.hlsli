@@ -55,6 +55,8 @@ RAB_Material RAB_GetGBufferMaterial(
     int2 pixelPosition,
     bool previousFrame)
 {
+    pixelPosition = GIPixelPosToRenderPixelPos(pixelPosition, previousFrame);
+
     if(previousFrame)
     {
         return GetGBufferMaterial(
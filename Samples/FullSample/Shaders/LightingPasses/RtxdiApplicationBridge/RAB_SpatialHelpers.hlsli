@@ -7,8 +7,9 @@
 // The simplest implementation will just return the input pixelPosition.
 int2 RAB_ClampSamplePositionIntoView(int2 pixelPosition, bool previousFrame)
 {
-    int width = int(g_Const.view.viewportSize.x);
-    int height = int(g_Const.view.viewportSize.y);
+    // The ReSTIR GI passes may run on a reduced resolution grid, see GetGIViewportSize.
+    int width = GetGIViewportSize(false).x;
+    int height = GetGIViewportSize(false).y;
 
     // Reflect the position across the screen edges.
     // Compared to simple clamping, this prevents the spread of colorful blobs from screen edges.
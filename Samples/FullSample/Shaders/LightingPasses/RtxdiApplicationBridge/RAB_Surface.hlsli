@@ -1,6 +1,7 @@
 #ifndef RTXDI_RAB_SURFACE_HLSLI
 #define RTXDI_RAB_SURFACE_HLSLI
 
+#include "../../CompactGBuffer.hlsli"
 #include "../../GBufferHelpers.hlsli"
 #include "../../SceneGeometry.hlsli"
 #include "../../ShaderParameters.h"
@@ -97,12 +98,58 @@ RAB_Surface GetGBufferSurface(
     return surface;
 }
 
+RAB_Surface UnpackCompactGBufferSurface(
+    uint4 packed,
+    int2 pixelPosition,
+    PlanarViewConstants view)
+{
+    RAB_Surface surface = RAB_EmptySurface();
 
-// Reads the G-buffer, either the current one or the previous one, and returns a surface.
-// If the provided pixel position is outside of the viewport bounds, the surface
-// should indicate that it's invalid when RAB_IsSurfaceValid is called on it.
-RAB_Surface RAB_GetGBufferSurface(int2 pixelPosition, bool previousFrame)
+    surface.viewDepth = unpackCompactGBufferDepth(packed);
+
+    if(surface.viewDepth == BACKGROUND_DEPTH)
+        return surface;
+
+    float4 specularRough = Unpack_R8G8B8A8_Gamma_UFLOAT(unpackCompactGBufferSpecularRough(packed));
+    surface.material.diffuseAlbedo = unpackCompactGBufferDiffuseAlbedo(packed);
+    surface.material.specularF0 = specularRough.rgb;
+    surface.material.roughness = specularRough.a;
+
+    surface.normal = octToNdirUnorm24(packed.y);
+    surface.geoNormal = octToNdirUnorm24(packed.z);
+    surface.worldPos = viewDepthToWorldPos(view, pixelPosition, surface.viewDepth);
+    surface.viewDir = normalize(view.cameraDirectionOrPosition.xyz - surface.worldPos);
+    surface.diffuseProbability = getSurfaceDiffuseProbability(surface);
+
+    return surface;
+}
+
+// Same as GetGBufferSurface, but reads the compact surface record written by PostprocessGBuffer.hlsl
+// with a single load instead of fetching from the five G-buffer textures.
+RAB_Surface GetCompactGBufferSurface(
+    int2 pixelPosition,
+    PlanarViewConstants view,
+    StructuredBuffer<uint4> surfaceBuffer)
 {
+    if (any(pixelPosition >= view.viewportSize))
+        return RAB_EmptySurface();
+
+    uint4 packed = surfaceBuffer[getCompactGBufferSurfaceIndex(pixelPosition, g_Const.compactGBufferSurfaceStride)];
+
+    return UnpackCompactGBufferSurface(packed, pixelPosition, view);
+}
+
+// Reads the G-buffer surface at a render resolution pixel position.
+RAB_Surface GetRenderResolutionGBufferSurface(int2 pixelPosition, bool previousFrame)
+{
+    if (g_Const.enableCompactGBufferSurfaces)
+    {
+        if (previousFrame)
+            return GetCompactGBufferSurface(pixelPosition, g_Const.prevView, t_PrevGBufferSurfaces);
+        else
+            return GetCompactGBufferSurface(pixelPosition, g_Const.view, t_GBufferSurfaces);
+    }
+
     if(previousFrame)
     {
         return GetGBufferSurface(
@@ -125,6 +172,17 @@ RAB_Surface RAB_GetGBufferSurface(int2 pixelPosition, bool previousFrame)
     }
 }
 
+// Reads the G-buffer, either the current one or the previous one, and returns a surface.
+// If the provided pixel position is outside of the viewport bounds, the surface
+// should indicate that it's invalid when RAB_IsSurfaceValid is called on it.
+// In the reduced resolution ReSTIR GI passes, the position is on the GI grid, see GIPixelPosToRenderPixelPos.
+RAB_Surface RAB_GetGBufferSurface(int2 pixelPosition, bool previousFrame)
+{
+    pixelPosition = GIPixelPosToRenderPixelPos(pixelPosition, previousFrame);
+
+    return GetRenderResolutionGBufferSurface(pixelPosition, previousFrame);
+}
+
 float3 worldToTangent(RAB_Surface surface, float3 w)
 {
     // reconstruct tangent frame based off worldspace normal
@@ -184,4 +242,19 @@ float RAB_GetSurfaceBrdfPdf(RAB_Surface surface, float3 dir)
     return pdf;
 }
 
+// Returns the pixel space motion of the surface at the given ReSTIR GI grid position, in units of that grid.
+// The motion vector is read at the render resolution pixel that the grid position stands for.
+float3 GetGIScreenSpaceMotion(int2 pixelPosition)
+{
+    const int2 renderPixelPosition = GIPixelPosToRenderPixelPos(pixelPosition, false);
+
+    float3 motionVector = t_MotionVectors[renderPixelPosition].xyz;
+    motionVector = convertMotionVectorToPixelSpace(g_Const.view, g_Const.prevView, renderPixelPosition, motionVector);
+
+    if (IsReducedResolutionGI())
+        motionVector.xy /= float(g_Const.giDownscaleFactor);
+
+    return motionVector;
+}
+
 #endif // RTXDI_RAB_SURFACE_HLSLI
\ No newline at end of file
@@ -0,0 +1,87 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#ifndef SECONDARY_GBUFFER_HLSLI
+#define SECONDARY_GBUFFER_HLSLI
+
+// Accessors for the fields of SecondaryGBufferData that are stored differently
+// in the compact layout, see USE_COMPACT_SECONDARY_GBUFFER in ShaderParameters.h.
+// The position is stored relative to the primary surface that the BRDF ray was traced from,
+// so the readers must pass the same primary surface position as the writer.
+
+uint Pack_R9G9B9E5_UFLOAT(float3 rgb)
+{
+    const int kMantissaBits = 9;
+    const int kExponentBias = 15;
+    const float kMaxValue = float((1 << kMantissaBits) - 1) / float(1 << kMantissaBits) * 65536.0;
+
+    rgb = clamp(rgb, 0, kMaxValue);
+    float maxChannel = max(max(rgb.r, rgb.g), rgb.b);
+
+    int exponent = max(-kExponentBias - 1, int(floor(log2(max(maxChannel, 1e-30))))) + 1;
+    float scale = exp2(float(kMantissaBits - exponent));
+
+    // Rounding can push the largest channel up to the next power of 2
+    if (uint(maxChannel * scale + 0.5) == (1u << kMantissaBits))
+    {
+        exponent += 1;
+        scale *= 0.5;
+    }
+
+    uint3 mantissa = uint3(rgb * scale + 0.5);
+    return mantissa.r | (mantissa.g << 9) | (mantissa.b << 18) | (uint(exponent + kExponentBias) << 27);
+}
+
+float3 Unpack_R9G9B9E5_UFLOAT(uint packed)
+{
+    uint3 mantissa = uint3(packed, packed >> 9, packed >> 18) & 0x1ff;
+    int exponent = int(packed >> 27) - 15 - 9;
+    return float3(mantissa) * exp2(float(exponent));
+}
+
+void SetSecondaryGBufferPosition(inout SecondaryGBufferData data, float3 worldPos, float3 primaryWorldPos)
+{
+#if USE_COMPACT_SECONDARY_GBUFFER
+    float3 offset = worldPos - primaryWorldPos;
+    data.hitDistance = length(offset);
+    data.direction = ndirToOctUnorm32(data.hitDistance > 0 ? offset / data.hitDistance : float3(0, 0, 1));
+#else
+    data.worldPos = worldPos;
+#endif
+}
+
+float3 GetSecondaryGBufferPosition(SecondaryGBufferData data, float3 primaryWorldPos)
+{
+#if USE_COMPACT_SECONDARY_GBUFFER
+    return primaryWorldPos + octToNdirUnorm32(data.direction) * data.hitDistance;
+#else
+    return data.worldPos;
+#endif
+}
+
+void SetSecondaryGBufferEmission(inout SecondaryGBufferData data, float3 emission)
+{
+#if USE_COMPACT_SECONDARY_GBUFFER
+    data.emission = Pack_R9G9B9E5_UFLOAT(emission);
+#else
+    data.emission = emission;
+#endif
+}
+
+float3 GetSecondaryGBufferEmission(SecondaryGBufferData data)
+{
+#if USE_COMPACT_SECONDARY_GBUFFER
+    return Unpack_R9G9B9E5_UFLOAT(data.emission);
+#else
+    return data.emission;
+#endif
+}
+
+#endif // SECONDARY_GBUFFER_HLSLI
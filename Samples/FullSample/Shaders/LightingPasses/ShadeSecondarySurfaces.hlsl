@@ -26,6 +26,7 @@
 #include <NRD.hlsli>
 #endif
 
+#include "SecondaryGBuffer.hlsli"
 #include "ShadingHelpers.hlsli"
 
 static const float c_MaxIndirectRadiance = 10;
@@ -64,10 +65,10 @@ void RayGen()
     const bool isEnvironmentMap = (secondaryFlags & kSecondaryGBuffer_IsEnvironmentMap) != 0;
 
     RAB_Surface secondarySurface;
-    float3 radiance = secondaryGBufferData.emission;
+    float3 radiance = GetSecondaryGBufferEmission(secondaryGBufferData);
 
     // Unpack the G-buffer data
-    secondarySurface.worldPos = secondaryGBufferData.worldPos;
+    secondarySurface.worldPos = GetSecondaryGBufferPosition(secondaryGBufferData, primarySurface.worldPos);
     secondarySurface.viewDepth = 1.0; // doesn't matter
     secondarySurface.normal = octToNdirUnorm32(secondaryGBufferData.normal);
     secondarySurface.geoNormal = secondarySurface.normal;
@@ -105,7 +106,7 @@ void RayGen()
             // Try to find this secondary surface in the G-buffer. If found, resample the lights
             // from that G-buffer surface into the reservoir using the spatial resampling function.
 
-            float4 secondaryClipPos = mul(float4(secondaryGBufferData.worldPos, 1.0), g_Const.view.matWorldToClip);
+            float4 secondaryClipPos = mul(float4(secondarySurface.worldPos, 1.0), g_Const.view.matWorldToClip);
             secondaryClipPos.xyz /= secondaryClipPos.w;
 
             if (all(abs(secondaryClipPos.xy) < 1.0) && secondaryClipPos.w > 0)
@@ -163,7 +164,7 @@ void RayGen()
         RTXDI_StoreGIReservoir(reservoir, g_Const.restirGI.reservoirBufferParams, reservoirPosition, g_Const.restirGI.bufferIndices.secondarySurfaceReSTIRDIOutputBufferIndex);
 
         // Save the initial sample radiance for MIS in the final shading pass
-        secondaryGBufferData.emission = outputShadingResult ? 0 : radiance;
+        SetSecondaryGBufferEmission(secondaryGBufferData, outputShadingResult ? 0 : radiance);
         u_SecondaryGBuffer[gbufferIndex] = secondaryGBufferData;
     }
 
@@ -37,19 +37,96 @@ SplitBrdf EvaluateBrdf(RAB_Surface surface, float3 samplePosition)
 
 #ifdef RTXDI_DIRESERVOIR_HLSLI
 
-bool ShadeSurfaceWithLightSample(
+// The visibility cache keeps the last final visibility traced for each pixel along with the light sample
+// and the surface it was traced for. Layer 0 holds the surface position and the light index,
+// layer 1 holds the sample position and the visibility. The cache is cleared to ~0, which never matches a light.
+// The light indices change every frame because the light buffer is double-buffered, so the light index
+// of an entry is rewritten on every frame that uses it, not only when a ray is traced.
+static const uint kVisibilityCacheSurfaceLayer = 0;
+static const uint kVisibilityCacheSampleLayer = 1;
+
+// Returns true if the pixel should trace the final visibility ray this frame even if the cache entry is valid,
+// so that changes in the occluders are picked up. A different subset of 1/N pixels is selected on each frame.
+bool IsVisibilityCacheRefreshPixel(uint2 pixelPosition)
+{
+    if (g_Const.visibilityCacheRefreshPeriod <= 1)
+        return true;
+
+    const uint pixelHash = RTXDI_JenkinsHash(pixelPosition.x + (pixelPosition.y << 16));
+    return (pixelHash + g_Const.frameIndex) % g_Const.visibilityCacheRefreshPeriod == 0;
+}
+
+// Returns the cached visibility if the entry matches the light sample and the surface.
+// On a hit, the entry's light index is updated to the current frame's index.
+bool LoadCachedFinalVisibility(
+    uint2 pixelPosition,
+    RAB_Surface surface,
+    RAB_LightSample lightSample,
+    uint lightIndex,
+    out float3 visibility)
+{
+    visibility = 0;
+
+    if (IsVisibilityCacheRefreshPixel(pixelPosition))
+        return false;
+
+    const uint4 surfaceEntry = u_VisibilityCache[uint3(pixelPosition, kVisibilityCacheSurfaceLayer)];
+    const uint4 sampleEntry = u_VisibilityCache[uint3(pixelPosition, kVisibilityCacheSampleLayer)];
+
+    // The entry was stored with the previous frame's light index
+    const int previousLightIndex = RAB_TranslateLightIndex(lightIndex, true);
+    if (previousLightIndex < 0 || uint(previousLightIndex) != surfaceEntry.w)
+        return false;
+
+    // Both positions may only move by a small fraction of their distance to the camera and to the surface, respectively
+    const float surfaceDistance = length(surface.worldPos - asfloat(surfaceEntry.xyz));
+    if (!(surfaceDistance <= g_Const.visibilityCacheMaxDistance * surface.viewDepth))
+        return false;
+
+    const float sampleDistance = length(lightSample.position - asfloat(sampleEntry.xyz));
+    if (!(sampleDistance <= g_Const.visibilityCacheMaxDistance * length(lightSample.position - surface.worldPos)))
+        return false;
+
+    visibility = Unpack_R11G11B10_UFLOAT(sampleEntry.w);
+
+    // Keep the positions that the visibility was traced for, so that they can't drift over many frames
+    u_VisibilityCache[uint3(pixelPosition, kVisibilityCacheSurfaceLayer)] = uint4(surfaceEntry.xyz, lightIndex);
+    return true;
+}
+
+void StoreFinalVisibilityInCache(
+    uint2 pixelPosition,
+    RAB_Surface surface,
+    RAB_LightSample lightSample,
+    uint lightIndex,
+    float3 visibility)
+{
+    u_VisibilityCache[uint3(pixelPosition, kVisibilityCacheSurfaceLayer)] = uint4(asuint(surface.worldPos), lightIndex);
+    u_VisibilityCache[uint3(pixelPosition, kVisibilityCacheSampleLayer)] = uint4(asuint(lightSample.position), Pack_R11G11B10_UFLOAT(visibility));
+}
+
+// Shades the surface with the reservoir's light sample, tracing the final visibility ray if it's enabled
+// and cannot be reused from the reservoir. When 'visibilityCachePixel' is non-negative, the final visibility
+// is also looked up in and stored to the visibility cache entry for that pixel, and 'visibilityCached' reports
+// whether the cached value was used instead of tracing a ray.
+// The visibility reused from the reservoir is stored in the cache too, so the entry follows the light index.
+// Returns true if the visibility was stored in the reservoir, which then needs to be written back.
+bool ShadeSurfaceWithCachedVisibility(
     inout RTXDI_DIReservoir reservoir,
     RAB_Surface surface,
     RAB_LightSample lightSample,
     bool previousFrameTLAS,
     bool enableVisibilityReuse,
+    int2 visibilityCachePixel,
     out float3 diffuse,
     out float3 specular,
-    out float lightDistance)
+    out float lightDistance,
+    out bool visibilityCached)
 {
     diffuse = 0;
     specular = 0;
     lightDistance = 0;
+    visibilityCached = false;
 
     if (lightSample.solidAnglePdf <= 0)
         return false;
@@ -69,7 +146,24 @@ bool ShadeSurfaceWithLightSample(
             visibilityReused = RTXDI_GetDIReservoirVisibility(reservoir, rparams, visibility);
         }
 
-        if (!visibilityReused)
+        const bool useVisibilityCache = g_Const.enableVisibilityCache && !previousFrameTLAS && all(visibilityCachePixel >= 0);
+        const uint lightIndex = RTXDI_GetDIReservoirLightIndex(reservoir);
+
+        if (visibilityReused && useVisibilityCache)
+        {
+            StoreFinalVisibilityInCache(visibilityCachePixel, surface, lightSample, lightIndex, visibility);
+        }
+        else if (!visibilityReused && useVisibilityCache)
+        {
+            visibilityCached = LoadCachedFinalVisibility(visibilityCachePixel, surface, lightSample, lightIndex, visibility);
+
+            if (visibilityCached)
+            {
+                REPORT_SAVED_RAY();
+            }
+        }
+
+        if (!visibilityReused && !visibilityCached)
         {
             if (previousFrameTLAS && g_Const.enablePreviousTLAS)
                 visibility = GetFinalVisibility(PrevSceneBVH, surface, lightSample.position);
@@ -77,6 +171,9 @@ bool ShadeSurfaceWithLightSample(
                 visibility = GetFinalVisibility(SceneBVH, surface, lightSample.position);
             RTXDI_StoreVisibilityInDIReservoir(reservoir, visibility, g_Const.restirDI.temporalResamplingParams.discardInvisibleSamples);
             needToStore = true;
+
+            if (useVisibilityCache)
+                StoreFinalVisibilityInCache(visibilityCachePixel, surface, lightSample, lightIndex, visibility);
         }
 
         lightSample.radiance *= visibility;
@@ -97,6 +194,21 @@ bool ShadeSurfaceWithLightSample(
     return needToStore;
 }
 
+bool ShadeSurfaceWithLightSample(
+    inout RTXDI_DIReservoir reservoir,
+    RAB_Surface surface,
+    RAB_LightSample lightSample,
+    bool previousFrameTLAS,
+    bool enableVisibilityReuse,
+    out float3 diffuse,
+    out float3 specular,
+    out float lightDistance)
+{
+    bool visibilityCached;
+    return ShadeSurfaceWithCachedVisibility(reservoir, surface, lightSample, previousFrameTLAS, enableVisibilityReuse,
+        /* visibilityCachePixel = */ -1, diffuse, specular, lightDistance, visibilityCached);
+}
+
 #endif // RTXDI_DIRESERVOIR_HLSLI
 
 float3 DemodulateSpecular(float3 surfaceSpecularF0, float3 specular)
@@ -105,14 +217,16 @@ float3 DemodulateSpecular(float3 surfaceSpecularF0, float3 specular)
 }
 
 
-void StoreShadingOutput(
+// Writes the lighting at a render resolution pixel, with separate hit distances for the diffuse and specular signals.
+void StoreRenderResolutionShadingOutput(
     uint2 reservoirPosition,
     uint2 pixelPosition,
     float viewDepth,
     float roughness,
     float3 diffuse,
     float3 specular,
-    float lightDistance,
+    float diffuseLightDistance,
+    float specularLightDistance,
     bool isFirstPass,
     bool isLastPass)
 {
@@ -120,18 +234,18 @@ void StoreShadingOutput(
         ? reservoirPosition
         : pixelPosition;
 
-    float diffuseHitT = lightDistance;
-    float specularHitT = lightDistance;
+    float diffuseHitT = diffuseLightDistance;
+    float specularHitT = specularLightDistance;
 
     if (!isFirstPass)
     {
         float4 priorDiffuse = u_DiffuseLighting[lightingTexturePos];
         float4 priorSpecular = u_SpecularLighting[lightingTexturePos];
 
-        if (calcLuminance(diffuse) > calcLuminance(priorDiffuse.rgb) || lightDistance == 0)
+        if (calcLuminance(diffuse) > calcLuminance(priorDiffuse.rgb) || diffuseLightDistance == 0)
             diffuseHitT = priorDiffuse.w;
 
-        if (calcLuminance(specular) > calcLuminance(priorSpecular.rgb) || lightDistance == 0)
+        if (calcLuminance(specular) > calcLuminance(priorSpecular.rgb) || specularLightDistance == 0)
             specularHitT = priorSpecular.w;
         
         diffuse += priorDiffuse.rgb;
@@ -187,4 +301,51 @@ void StoreShadingOutput(
     }
 }
 
+// Accumulates the lighting of a reduced resolution ReSTIR GI pass into the GI grid sized targets,
+// which are cleared every frame and resolved by the UpsampleGI pass. The hit distances are selected
+// the same way as in StoreRenderResolutionShadingOutput and kept in the alpha channels.
+void StoreReducedResolutionGIOutput(
+    uint2 giPixelPosition,
+    float3 diffuse,
+    float3 specular,
+    float lightDistance)
+{
+    float4 priorDiffuse = u_GIDiffuseLighting[giPixelPosition];
+    float4 priorSpecular = u_GISpecularLighting[giPixelPosition];
+
+    float diffuseHitT = lightDistance;
+    float specularHitT = lightDistance;
+
+    if (calcLuminance(diffuse) > calcLuminance(priorDiffuse.rgb) || lightDistance == 0)
+        diffuseHitT = priorDiffuse.w;
+
+    if (calcLuminance(specular) > calcLuminance(priorSpecular.rgb) || lightDistance == 0)
+        specularHitT = priorSpecular.w;
+
+    u_GIDiffuseLighting[giPixelPosition] = float4(priorDiffuse.rgb + diffuse, diffuseHitT);
+    u_GISpecularLighting[giPixelPosition] = float4(priorSpecular.rgb + specular, specularHitT);
+}
+
+void StoreShadingOutput(
+    uint2 reservoirPosition,
+    uint2 pixelPosition,
+    float viewDepth,
+    float roughness,
+    float3 diffuse,
+    float3 specular,
+    float lightDistance,
+    bool isFirstPass,
+    bool isLastPass)
+{
+    if (IsReducedResolutionGI())
+    {
+        // Checkerboard rendering is not used with reduced resolution GI, so both positions are on the GI grid
+        StoreReducedResolutionGIOutput(pixelPosition, diffuse, specular, lightDistance);
+        return;
+    }
+
+    StoreRenderResolutionShadingOutput(reservoirPosition, pixelPosition, viewDepth, roughness,
+        diffuse, specular, lightDistance, lightDistance, isFirstPass, isLastPass);
+}
+
 #endif // SHADING_HELPERS_HLSLI
\ No newline at end of file
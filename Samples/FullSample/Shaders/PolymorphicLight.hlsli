@@ -734,6 +734,23 @@ struct TriangleLight
     }
 };
 
+// Moves a triangle light stored in the local space of an instanced mesh into world space.
+PolymorphicLightInfo transformTriangleLight(PolymorphicLightInfo localLightInfo, float3x4 transform)
+{
+    TriangleLight triLight = TriangleLight::Create(localLightInfo);
+    triLight.base = mul(transform, float4(triLight.base, 1.0)).xyz;
+    triLight.edge1 = mul(transform, float4(triLight.edge1, 0.0)).xyz;
+    triLight.edge2 = mul(transform, float4(triLight.edge2, 0.0)).xyz;
+
+    PolymorphicLightInfo lightInfo = triLight.Store();
+
+    // Keep the packed radiance as is instead of quantizing it again
+    lightInfo.colorTypeAndFlags = localLightInfo.colorTypeAndFlags;
+    lightInfo.logRadiance = localLightInfo.logRadiance;
+
+    return lightInfo;
+}
+
 struct EnvironmentLight
 {
     int textureIndex;
@@ -12,13 +12,21 @@
 
 #include "ShaderParameters.h"
 
+#include <donut/shaders/binding_helpers.hlsli>
 #include <donut/shaders/packing.hlsli>
 #include <donut/shaders/utils.hlsli>
 
+#include "CompactGBuffer.hlsli"
+
 RWTexture2D<uint> u_SpecularRough : register(u0);
 RWTexture2D<float4> u_NormalRoughness : register(u1);
+RWStructuredBuffer<uint4> u_CompactSurfaces : register(u2);
 Texture2D<uint> t_Normals : register(t0);
 Texture2D<float> t_ViewDepth : register(t1);
+Texture2D<uint> t_GeoNormals : register(t2);
+Texture2D<uint> t_DiffuseAlbedo : register(t3);
+
+VK_PUSH_CONSTANT ConstantBuffer<PostprocessGBufferConstants> g_Const : register(b0);
 
 #define NRD_BILATERAL_WEIGHT_VIEWZ_SENSITIVITY 100.0
 #define NRD_BILATERAL_WEIGHT_CUTOFF            0.03
@@ -80,6 +88,17 @@ void main(uint2 pixelPosition : SV_DispatchThreadID)
     else 
         currentRoughnessModified = GetModifiedRoughnessFromNormalVariance(currentRoughness, averageNormal);
 
-    u_SpecularRough[pixelPosition] = Pack_R8G8B8A8_Gamma_UFLOAT(float4(specularRough.rgb, currentRoughnessModified));
+    uint packedSpecularRough = Pack_R8G8B8A8_Gamma_UFLOAT(float4(specularRough.rgb, currentRoughnessModified));
+    u_SpecularRough[pixelPosition] = packedSpecularRough;
     u_NormalRoughness[pixelPosition] = float4(currentNormal * 0.5 + 0.5, currentRoughness);
+
+    if (g_Const.writeCompactSurfaces && all(pixelPosition < g_Const.viewportSize))
+    {
+        u_CompactSurfaces[getCompactGBufferSurfaceIndex(pixelPosition, g_Const.compactSurfaceStride)] = packCompactGBufferSurface(
+            currentLinearZ,
+            t_Normals[pixelPosition],
+            t_GeoNormals[pixelPosition],
+            t_DiffuseAlbedo[pixelPosition],
+            packedSpecularRough);
+    }
 }
\ No newline at end of file
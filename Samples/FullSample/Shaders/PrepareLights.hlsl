@@ -20,6 +20,8 @@ VK_PUSH_CONSTANT ConstantBuffer<PrepareLightsConstants> g_Const : register(b0);
 RWStructuredBuffer<PolymorphicLightInfo> u_LightDataBuffer : register(u0);
 RWBuffer<uint> u_LightIndexMappingBuffer : register(u1);
 RWTexture2D<float> u_LocalLightPdfTexture : register(u2);
+RWStructuredBuffer<PolymorphicLightInfo> u_InstancedLightBuffer : register(u3);
+RWStructuredBuffer<uint2> u_InstancedLightRefBuffer : register(u4);
 StructuredBuffer<PrepareLightsTask> t_TaskBuffer : register(t0);
 StructuredBuffer<PolymorphicLightInfo> t_PrimitiveLights : register(t1);
 StructuredBuffer<InstanceData> t_InstanceData : register(t2);
@@ -36,37 +38,27 @@ VK_BINDING(1, 1) Texture2D t_BindlessTextures[] : register(t0, space2);
 
 bool FindTask(uint dispatchThreadId, out PrepareLightsTask task)
 {
-    // Use binary search to find the task that contains the current thread's output index:
-    //   task.lightBufferOffset <= dispatchThreadId < (task.lightBufferOffset + task.triangleCount)
+    // Use binary search to find the last task that starts at or before the current thread's output index.
+    // The tasks are sorted by their offsets and each one ends where the next one starts.
 
-    int left = 0;
-    int right = int(g_Const.numTasks) - 1;
+    if (g_Const.numTasks == 0 || dispatchThreadId >= g_Const.tasksEndOffset)
+        return false;
 
-    while (right >= left)
-    {
-        int middle = (left + right) / 2;
-        task = t_TaskBuffer[middle];
+    uint left = g_Const.firstTask;
+    uint right = g_Const.firstTask + g_Const.numTasks - 1;
 
-        int tri = int(dispatchThreadId) - int(task.lightBufferOffset); // signed
+    while (left < right)
+    {
+        uint middle = (left + right + 1) / 2;
 
-        if (tri < 0)
-        {
-            // Go left
-            right = middle - 1;
-        }
-        else if (tri < task.triangleCount)
-        {
-            // Found it!
-            return true;
-        }
+        if (t_TaskBuffer[middle].lightBufferOffset <= dispatchThreadId)
+            left = middle;
         else
-        {
-            // Go right
-            left = middle + 1;
-        }
+            right = middle - 1;
     }
 
-    return false;
+    task = t_TaskBuffer[left];
+    return task.lightBufferOffset <= dispatchThreadId;
 }
 
 [numthreads(256, 1, 1)]
@@ -78,14 +70,26 @@ void main(uint dispatchThreadId : SV_DispatchThreadID, uint groupThreadId : SV_G
         return;
 
     uint triangleIdx = dispatchThreadId - task.lightBufferOffset;
-    bool isPrimitiveLight = (task.instanceAndGeometryIndex & TASK_PRIMITIVE_LIGHT_BIT) != 0;
+    bool isPrimitiveLight = (task.instanceIndex & TASK_PRIMITIVE_LIGHT_BIT) != 0;
+    bool isInstancedLight = !isPrimitiveLight && task.instancedLightOffset != ~0u && !g_Const.bakeInstancedLights;
     
     PolymorphicLightInfo lightInfo = (PolymorphicLightInfo)0;
 
-    if (!isPrimitiveLight)
+    if (isInstancedLight)
     {
-        InstanceData instance = t_InstanceData[task.instanceAndGeometryIndex >> 12];
-        GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + task.instanceAndGeometryIndex & 0xfff];
+        // The triangle was baked in local space by the previous dispatch, only the instance transform is applied here.
+        // The lighting passes do the same in RAB_LoadLightInfo.
+        uint instancedLightIndex = task.instancedLightOffset + triangleIdx;
+        InstanceData instance = t_InstanceData[task.instanceIndex];
+
+        lightInfo = transformTriangleLight(u_InstancedLightBuffer[instancedLightIndex], instance.transform);
+
+        u_InstancedLightRefBuffer[g_Const.currentFrameInstancedLightOffset + dispatchThreadId] = uint2(task.instanceIndex, instancedLightIndex);
+    }
+    else if (!isPrimitiveLight)
+    {
+        InstanceData instance = t_InstanceData[task.instanceIndex];
+        GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + task.geometryIndex];
         MaterialConstants material = t_MaterialConstants[geometry.materialIndex];
 
         ByteAddressBuffer indexBuffer = t_BindlessBuffers[NonUniformResourceIndex(geometry.indexBufferIndex)];
@@ -99,9 +103,12 @@ void main(uint dispatchThreadId : SV_DispatchThreadID, uint groupThreadId : SV_G
         positions[1] = asfloat(vertexBuffer.Load3(geometry.positionOffset + indices[1] * c_SizeOfPosition));
         positions[2] = asfloat(vertexBuffer.Load3(geometry.positionOffset + indices[2] * c_SizeOfPosition));
         
-        positions[0] = mul(instance.transform, float4(positions[0], 1)).xyz;
-        positions[1] = mul(instance.transform, float4(positions[1], 1)).xyz;
-        positions[2] = mul(instance.transform, float4(positions[2], 1)).xyz;
+        if (!g_Const.bakeInstancedLights)
+        {
+            positions[0] = mul(instance.transform, float4(positions[0], 1)).xyz;
+            positions[1] = mul(instance.transform, float4(positions[1], 1)).xyz;
+            positions[2] = mul(instance.transform, float4(positions[2], 1)).xyz;
+        }
 
         float3 radiance = material.emissiveColor;
 
@@ -176,12 +183,20 @@ void main(uint dispatchThreadId : SV_DispatchThreadID, uint groupThreadId : SV_G
     }
     else
     {
-        uint primitiveLightIndex = task.instanceAndGeometryIndex & ~TASK_PRIMITIVE_LIGHT_BIT;
+        uint primitiveLightIndex = task.instanceIndex & ~TASK_PRIMITIVE_LIGHT_BIT;
         lightInfo = t_PrimitiveLights[primitiveLightIndex];
     }
 
+    if (g_Const.bakeInstancedLights)
+    {
+        u_InstancedLightBuffer[dispatchThreadId] = lightInfo;
+        return;
+    }
+
     uint lightBufferPtr = task.lightBufferOffset + triangleIdx;
-    u_LightDataBuffer[g_Const.currentFrameLightOffset + lightBufferPtr] = lightInfo;
+
+    if (!isInstancedLight)
+        u_LightDataBuffer[g_Const.currentFrameDataOffset + lightBufferPtr - g_Const.numInstancedLights] = lightInfo;
 
     // If this light has existed on the previous frame, write the index mapping information
     // so that temporal resampling can be applied to the light correctly when it changes
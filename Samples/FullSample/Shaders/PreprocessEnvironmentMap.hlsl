@@ -13,7 +13,12 @@
 #include <Rtxdi/Utils/Math.hlsli>
 #include <donut/shaders/binding_helpers.hlsli>
 
-RWTexture2D<float> u_IntegratedMips[] : register(u0);
+// The mip chain is written and, for the tail levels, read back by the last thread group,
+// so the writes of other groups must be visible to it.
+globallycoherent RWTexture2D<float> u_IntegratedMips[] : register(u0);
+
+// Number of thread groups that have finished the first part of the work. Reset by the last group.
+globallycoherent RWStructuredBuffer<uint> u_AtomicCounter : register(u0, space1);
 
 VK_PUSH_CONSTANT ConstantBuffer<PreprocessEnvironmentMapConstants> g_Const : register(b0);
 
@@ -40,7 +45,23 @@ float getPixelWeight(uint2 position)
 }
 #endif
 
-groupshared float s_weights[16];
+// Each thread group reduces a 32x32 block of mip 0 down to a single texel of mip 5,
+// then the last group to finish reduces the remaining levels down to 1x1, so that the whole
+// mip chain is built in one dispatch.
+// All reductions go through shared memory instead of wave intrinsics, so the pass does not depend on the wave size.
+
+groupshared float s_weights[256];
+groupshared uint s_finishedGroups;
+
+float loadQuadAverage(uint mipLevel, uint2 destPos)
+{
+    RWTexture2D<float> src = u_IntegratedMips[mipLevel];
+    uint2 sourcePos = destPos * 2;
+    return (src[sourcePos + int2(0, 0)]
+        + src[sourcePos + int2(0, 1)]
+        + src[sourcePos + int2(1, 0)]
+        + src[sourcePos + int2(1, 1)]) * 0.25;
+}
 
 // Warning: do not change the group size. The algorithm is hardcoded to process 16x16 tiles.
 [numthreads(256, 1, 1)]
@@ -49,113 +70,94 @@ void main(uint2 GroupIndex : SV_GroupID, uint ThreadIndex : SV_GroupThreadID)
     uint2 LocalIndex = RTXDI_LinearIndexToZCurve(ThreadIndex);
     uint2 GlobalIndex = (GroupIndex * 16) + LocalIndex;
 
-    // Step 0: Load a 2x2 quad of pixels from the source texture or the source mip level.
+    // Step 0: Load a 2x2 quad of pixels from the source texture or mip 0.
     float4 sourceWeights;
+    uint2 sourcePos = GlobalIndex.xy * 2;
 #if INPUT_ENVIRONMENT_MAP
-    if (g_Const.sourceMipLevel == 0)
-    {
-        uint2 sourcePos = GlobalIndex.xy * 2;
-
-        sourceWeights.x = getPixelWeight(sourcePos + int2(0, 0));
-        sourceWeights.y = getPixelWeight(sourcePos + int2(0, 1));
-        sourceWeights.z = getPixelWeight(sourcePos + int2(1, 0));
-        sourceWeights.w = getPixelWeight(sourcePos + int2(1, 1));
-
-        RWTexture2D<float> dest = u_IntegratedMips[0];
-        dest[sourcePos + int2(0, 0)] = sourceWeights.x;
-        dest[sourcePos + int2(0, 1)] = sourceWeights.y;
-        dest[sourcePos + int2(1, 0)] = sourceWeights.z;
-        dest[sourcePos + int2(1, 1)] = sourceWeights.w;
-    }
-    else
+    sourceWeights.x = getPixelWeight(sourcePos + int2(0, 0));
+    sourceWeights.y = getPixelWeight(sourcePos + int2(0, 1));
+    sourceWeights.z = getPixelWeight(sourcePos + int2(1, 0));
+    sourceWeights.w = getPixelWeight(sourcePos + int2(1, 1));
+
+    RWTexture2D<float> dest = u_IntegratedMips[0];
+    dest[sourcePos + int2(0, 0)] = sourceWeights.x;
+    dest[sourcePos + int2(0, 1)] = sourceWeights.y;
+    dest[sourcePos + int2(1, 0)] = sourceWeights.z;
+    dest[sourcePos + int2(1, 1)] = sourceWeights.w;
+#else
+    RWTexture2D<float> src = u_IntegratedMips[0];
+    sourceWeights.x = src[sourcePos + int2(0, 0)];
+    sourceWeights.y = src[sourcePos + int2(0, 1)];
+    sourceWeights.z = src[sourcePos + int2(1, 0)];
+    sourceWeights.w = src[sourcePos + int2(1, 1)];
 #endif
-    {
-        uint2 sourcePos = GlobalIndex.xy * 2;
-
-        RWTexture2D<float> src = u_IntegratedMips[g_Const.sourceMipLevel];
-        sourceWeights.x = src[sourcePos + int2(0, 0)];
-        sourceWeights.y = src[sourcePos + int2(0, 1)];
-        sourceWeights.z = src[sourcePos + int2(1, 0)];
-        sourceWeights.w = src[sourcePos + int2(1, 1)];
-    }
 
-    uint mipLevelsToWrite = g_Const.numDestMipLevels - g_Const.sourceMipLevel - 1;
+    uint mipLevelsToWrite = g_Const.numDestMipLevels - 1;
     if (mipLevelsToWrite < 1) return;
 
     // Average those weights and write out the first mip.
     float weight = (sourceWeights.x + sourceWeights.y + sourceWeights.z + sourceWeights.w) * 0.25;
 
-    u_IntegratedMips[g_Const.sourceMipLevel + 1][GlobalIndex.xy] = weight;
+    u_IntegratedMips[1][GlobalIndex.xy] = weight;
 
-    if (mipLevelsToWrite < 2) return;
+    // Steps 1-4: Average groups of 4 values in shared memory. The threads are laid out in the Z-curve pattern,
+    // so every 4 consecutive values at a given stride form a 2x2 quad of the next mip level.
+    s_weights[ThreadIndex] = weight;
 
-    // The following sequence is an optimized hierarchical downsampling algorithm using wave ops.
-    // It assumes that the wave size is at least 16 lanes, which is true for both NV and AMD GPUs.
-    // It also assumes that the threads are laid out in the group using the Z-curve pattern.
-
-    // Step 1: Average 2x2 groups of pixels.
-    uint lane = WaveGetLaneIndex();
-    weight = (weight 
-        + WaveReadLaneAt(weight, lane + 1)
-        + WaveReadLaneAt(weight, lane + 2)
-        + WaveReadLaneAt(weight, lane + 3)) * 0.25;
-
-    if ((lane & 3) == 0)
+    uint groupMipLevels = min(mipLevelsToWrite, 5);
+    for (uint mipLevel = 2; mipLevel <= groupMipLevels; mipLevel++)
     {
-        u_IntegratedMips[g_Const.sourceMipLevel + 2][GlobalIndex.xy >> 1] = weight;
-    }
+        uint stride = 1u << ((mipLevel - 2) * 2);
+        bool active = (ThreadIndex & (stride * 4 - 1)) == 0;
 
-    if (mipLevelsToWrite < 3) return;
+        GroupMemoryBarrierWithGroupSync();
 
-    // Step 2: Average the previous results from 2 pixels away.
-    weight = (weight 
-        + WaveReadLaneAt(weight, lane + 4)
-        + WaveReadLaneAt(weight, lane + 8)
-        + WaveReadLaneAt(weight, lane + 12)) * 0.25;
+        if (active)
+        {
+            weight = (s_weights[ThreadIndex]
+                + s_weights[ThreadIndex + stride]
+                + s_weights[ThreadIndex + stride * 2]
+                + s_weights[ThreadIndex + stride * 3]) * 0.25;
 
-    if ((lane & 15) == 0)
-    {
-        u_IntegratedMips[g_Const.sourceMipLevel + 3][GlobalIndex.xy >> 2] = weight;
+            u_IntegratedMips[mipLevel][GlobalIndex.xy >> (mipLevel - 1)] = weight;
+        }
 
-        // Store the intermediate result into shared memory.
-        s_weights[ThreadIndex >> 4] = weight;
-    }
+        GroupMemoryBarrierWithGroupSync();
 
-    if (mipLevelsToWrite < 4) return;
+        if (active)
+            s_weights[ThreadIndex] = weight;
+    }
 
-    GroupMemoryBarrierWithGroupSync();
+    if (mipLevelsToWrite <= 5) return;
 
-    // The rest operates on a 4x4 group of values for the entire thread group
-    if (ThreadIndex >= 16)
-        return;
+    // Make this group's writes visible to the other groups, then count the group as finished.
+    DeviceMemoryBarrierWithGroupSync();
 
-    // Load the intermediate results
-    weight = s_weights[ThreadIndex];
+    if (ThreadIndex == 0)
+        InterlockedAdd(u_AtomicCounter[0], 1, s_finishedGroups);
 
-    // Change the output texture addressing because we'll be only writing a 2x2 block of pixels
-    GlobalIndex = (GroupIndex * 2) + (LocalIndex >> 1);
+    GroupMemoryBarrierWithGroupSync();
 
-    // Step 3: Average the previous results from adjacent threads, meaning from 4 pixels away.
-    weight = (weight 
-        + WaveReadLaneAt(weight, lane + 1)
-        + WaveReadLaneAt(weight, lane + 2)
-        + WaveReadLaneAt(weight, lane + 3)) * 0.25;
+    // Only the last group to finish continues, all the others are done.
+    if (s_finishedGroups != g_Const.numWorkGroups - 1)
+        return;
 
-    if ((lane & 3) == 0)
+    // Step 5: Reduce the remaining levels, one level at a time, with the whole group looping over the texels.
+    for (uint destMipLevel = 6; destMipLevel <= mipLevelsToWrite; destMipLevel++)
     {
-        u_IntegratedMips[g_Const.sourceMipLevel + 4][GlobalIndex.xy] = weight;
-    }
-
-    if (mipLevelsToWrite < 5) return;
+        uint2 destSize = max(g_Const.sourceSize >> destMipLevel, 1);
+        uint numTexels = destSize.x * destSize.y;
 
-    // Step 4: Average the previous results from 8 pixels away.
-    weight = (weight 
-        + WaveReadLaneAt(weight, lane + 4)
-        + WaveReadLaneAt(weight, lane + 8)
-        + WaveReadLaneAt(weight, lane + 12)) * 0.25;
+        for (uint texelIndex = ThreadIndex; texelIndex < numTexels; texelIndex += 256)
+        {
+            uint2 destPos = uint2(texelIndex % destSize.x, texelIndex / destSize.x);
+            u_IntegratedMips[destMipLevel][destPos] = loadQuadAverage(destMipLevel - 1, destPos);
+        }
 
-    if (lane == 0)
-    {
-        u_IntegratedMips[g_Const.sourceMipLevel + 5][GlobalIndex.xy >> 1] = weight;
+        DeviceMemoryBarrierWithGroupSync();
     }
-}
\ No newline at end of file
+
+    // Leave the counter ready for the next dispatch.
+    if (ThreadIndex == 0)
+        u_AtomicCounter[0] = 0;
+}
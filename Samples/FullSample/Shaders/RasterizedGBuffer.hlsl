@@ -38,9 +38,27 @@ RWBuffer<uint> u_RayCountBuffer : register(u0);
    support for SV_Barycentrics pixel shader inputs. It translates such inputs as BaryCoordSmoothAMD
    but NVIDIA drivers do not support that extension, and they need BaryCoordNV instead. */
 
+// With INDIRECT_DRAW, the instance and geometry indices come from the draw record selected by the
+// startInstanceLocation of the indirect draw arguments, and are passed to the pixel shader as an attribute.
+// Otherwise they come from the push constants set before each draw.
+#if INDIRECT_DRAW
+#define DRAW_INSTANCE_INDEX i_drawId.x
+#define DRAW_GEOMETRY_INDEX i_drawId.y
+#else
+#define DRAW_INSTANCE_INDEX g_Instance.instance
+#define DRAW_GEOMETRY_INDEX g_Instance.geometryIndex
+#endif
+
 void vs_main(
     in uint i_vertexID : SV_VertexID,
+#if INDIRECT_DRAW
+    in uint2 i_drawId : DRAW_ID,
+#endif
     out float4 o_position : SV_Position
+#if INDIRECT_DRAW
+    ,
+    nointerpolation out uint2 o_drawId : DRAW_ID
+#endif
 #ifdef SPIRV
     ,
     out float3 o_objectPos : OBJECTPOS,
@@ -51,8 +69,8 @@ void vs_main(
 #endif
     )
 {
-    InstanceData instance = t_InstanceData[g_Instance.instance];
-    GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + g_Instance.geometryIndex];
+    InstanceData instance = t_InstanceData[DRAW_INSTANCE_INDEX];
+    GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + DRAW_GEOMETRY_INDEX];
 
     ByteAddressBuffer indexBuffer = t_BindlessBuffers[NonUniformResourceIndex(geometry.indexBufferIndex)];
     ByteAddressBuffer vertexBuffer = t_BindlessBuffers[NonUniformResourceIndex(geometry.vertexBufferIndex)];
@@ -66,6 +84,9 @@ void vs_main(
     float4 clipSpacePosition = mul(float4(worldSpacePosition, 1.0), g_Const.view.matWorldToClip);
 
     o_position = clipSpacePosition;
+#if INDIRECT_DRAW
+    o_drawId = i_drawId;
+#endif
 
 #ifdef SPIRV
     o_objectPos = objectSpacePosition;
@@ -99,12 +120,43 @@ void vs_main(
 #endif
 }
 
+#if ALPHA_TESTED
+// Discards the pixel when the material of a non-opaque geometry makes it invisible in the G-buffer
+void alphaTest(GeometrySample gs, MaterialSample ms)
+{
+    bool alphaMask = (ms.opacity >= gs.material.alphaCutoff);
+
+    if (gs.material.domain == MaterialDomain_AlphaTested && !alphaMask)
+        discard;
+    else if (gs.material.domain == MaterialDomain_AlphaBlended)
+        clip(ms.opacity - 0.5); // no support for blending
+    else if (gs.material.domain == MaterialDomain_Transmissive ||
+        (gs.material.domain == MaterialDomain_TransmissiveAlphaTested && alphaMask) ||
+        gs.material.domain == MaterialDomain_TransmissiveAlphaBlended)
+    {
+        float throughput = ms.transmission;
+
+        if ((gs.material.flags & MaterialFlags_UseSpecularGlossModel) == 0)
+            throughput *= (1.0 - ms.metalness) * max(ms.baseColor.r, max(ms.baseColor.g, ms.baseColor.b));
+
+        if (gs.material.domain == MaterialDomain_TransmissiveAlphaBlended)
+            throughput *= (1.0 - ms.opacity);
+
+        if (throughput != 0)
+            discard;
+    }
+}
+#endif
+
 #if !ALPHA_TESTED
 [earlydepthstencil]
 #endif
 void ps_main(
     in float4 i_position : SV_Position,
     nointerpolation in uint i_primitiveID : SV_PrimitiveID,
+#if INDIRECT_DRAW
+    nointerpolation in uint2 i_drawId : DRAW_ID,
+#endif
 #ifdef SPIRV
     in float3 i_objectPos : OBJECTPOS,
     in float3 i_prevObjectPos : PREV_OBJECTPOS,
@@ -114,6 +166,9 @@ void ps_main(
 #else
     in float3 i_bary : SV_Barycentrics,
 #endif
+#if VISIBILITY_BUFFER
+    out uint2 o_visibility : SV_Target0
+#else
     out float o_viewDepth : SV_Target0,
     out uint o_diffuseAlbedo : SV_Target1,
     out uint o_specularRough : SV_Target2,
@@ -121,12 +176,13 @@ void ps_main(
     out uint o_geoNormal : SV_Target4,
     out float4 o_emissive : SV_Target5,
     out float4 o_motion : SV_Target6
+#endif
     )
 {
 #ifdef SPIRV
     GeometrySample gs = (GeometrySample)0;
-    gs.instance = t_InstanceData[g_Instance.instance];
-    gs.geometry = t_GeometryData[gs.instance.firstGeometryIndex + g_Instance.geometryIndex];
+    gs.instance = t_InstanceData[DRAW_INSTANCE_INDEX];
+    gs.geometry = t_GeometryData[gs.instance.firstGeometryIndex + DRAW_GEOMETRY_INDEX];
     gs.material = t_MaterialConstants[gs.geometry.materialIndex];
 
     gs.texcoord = i_texcoord;
@@ -136,10 +192,19 @@ void ps_main(
     gs.tangent.xyz = normalize(i_tangent.xyz);
     gs.tangent.w = i_tangent.w;
 #else
-    GeometrySample gs = getGeometryFromHit(g_Instance.instance, g_Instance.geometryIndex, i_primitiveID, i_bary.yz,
+    GeometrySample gs = getGeometryFromHit(DRAW_INSTANCE_INDEX, DRAW_GEOMETRY_INDEX, i_primitiveID, i_bary.yz,
         GeomAttr_All, t_InstanceData, t_GeometryData, t_MaterialConstants);
 #endif
 
+#if VISIBILITY_BUFFER
+    // Only the hit is stored, the material is evaluated for the visible pixels in VisibilityBufferResolve.hlsl
+#if ALPHA_TESTED
+    MaterialSample ms = sampleGeometryMaterial(gs, g_Const.textureLodBias, MatAttr_BaseColor | MatAttr_MetalRough | MatAttr_Transmission, s_MaterialSampler, g_Const.normalMapScale);
+    alphaTest(gs, ms);
+#endif
+
+    o_visibility = uint2(DRAW_INSTANCE_INDEX, (DRAW_GEOMETRY_INDEX << VISIBILITY_BUFFER_PRIMITIVE_BITS) | i_primitiveID);
+#else
     float3 worldSpacePosition = mul(gs.instance.transform, float4(gs.objectSpacePosition, 1.0)).xyz;
 #ifdef SPIRV
     gs.flatNormal = normalize(cross(ddy(worldSpacePosition), ddx(worldSpacePosition)));
@@ -157,27 +222,7 @@ void ps_main(
     ms.shadingNormal = getBentNormal(gs.flatNormal, ms.shadingNormal, viewDirection);
 
 #if ALPHA_TESTED
-    bool alphaMask = (ms.opacity >= gs.material.alphaCutoff);
-
-    if (gs.material.domain == MaterialDomain_AlphaTested && !alphaMask)
-        discard;
-    else if (gs.material.domain == MaterialDomain_AlphaBlended)
-        clip(ms.opacity - 0.5); // no support for blending
-    else if (gs.material.domain == MaterialDomain_Transmissive ||
-        (gs.material.domain == MaterialDomain_TransmissiveAlphaTested && alphaMask) ||
-        gs.material.domain == MaterialDomain_TransmissiveAlphaBlended)
-    {
-        float throughput = ms.transmission;
-
-        if ((gs.material.flags & MaterialFlags_UseSpecularGlossModel) == 0)
-            throughput *= (1.0 - ms.metalness) * max(ms.baseColor.r, max(ms.baseColor.g, ms.baseColor.b));
-
-        if (gs.material.domain == MaterialDomain_TransmissiveAlphaBlended)
-            throughput *= (1.0 - ms.opacity);
-
-        if (throughput != 0)
-            discard;
-    }
+    alphaTest(gs, ms);
 #endif
 
     if (all(g_Const.materialReadbackPosition == int2(i_position.xy)))
@@ -206,4 +251,5 @@ void ps_main(
     o_geoNormal = ndirToOctUnorm32(gs.flatNormal);
     o_emissive = float4(ms.emissiveColor, viewDistance); // viewDistance is here to enable glass ray tracing on all pixels
     o_motion = float4(motion, 0);
+#endif
 }
\ No newline at end of file
@@ -28,6 +28,33 @@
 #define RTXDI_GRAD_FACTOR 3
 #define RTXDI_GRAD_STORAGE_SCALE 256.0f
 #define RTXDI_GRAD_MAX_VALUE 65504.0f
+#define RTXDI_GRAD_INPUT_LAYER 1 // layer of the Gradients array written by ComputeGradients
+#define RTXDI_GRAD_OUTPUT_LAYER 0 // layer of the Gradients array written by FilterGradientsPass
+#define RTXDI_GRAD_FILTER_PASSES 4
+#define RTXDI_GRAD_FILTER_TILE_SIZE 8
+#define CONFIDENCE_TILE_SIZE 8
+
+#define BRDF_RAY_PASS_IN_PLACE 0
+#define BRDF_RAY_PASS_BINNING 1
+#define BRDF_RAY_PASS_SORTED 2
+#define BRDF_RAY_PASS_WAVEFRONT_TRACE 3
+#define BRDF_RAY_PASS_WAVEFRONT_ARGS 4
+#define BRDF_RAY_PASS_WAVEFRONT_SHADE 5
+#define BRDF_RAY_BIN_TILE_SIZE 16 // must match RTXDI_RESERVOIR_BLOCK_SIZE, see BrdfRayTracing.hlsl
+#define BRDF_RAY_SHADE_GROUP_SIZE 64
+
+// Material domains of the wavefront BRDF ray queues, see BrdfRayTracing.hlsl
+#define BRDF_RAY_DOMAIN_OPAQUE 0
+#define BRDF_RAY_DOMAIN_ALPHA_TESTED 1
+#define BRDF_RAY_DOMAIN_TRANSMISSIVE 2
+#define BRDF_RAY_DOMAIN_MISS 3
+#define BRDF_RAY_DOMAIN_COUNT 4
+
+// Layout of the wavefront BRDF ray queue counter buffer, in uints
+#define BRDF_RAY_QUEUE_COUNTS 0 // number of rays in each domain queue
+#define BRDF_RAY_QUEUE_GROUP_OFFSETS 4 // first shading thread group of each domain
+#define BRDF_RAY_QUEUE_DISPATCH_ARGS 8 // dispatchIndirect arguments of the shading pass
+#define BRDF_RAY_QUEUE_COUNTER_COUNT 12
 
 #define INSTANCE_MASK_OPAQUE 0x01
 #define INSTANCE_MASK_ALPHA_TESTED 0x02
@@ -56,13 +83,20 @@
 
 #define BACKGROUND_DEPTH 65504.f
 
-#define RAY_COUNT_TRACED(index) ((index) * 2)
-#define RAY_COUNT_HITS(index) ((index) * 2 + 1)
+// Each profiler section has 3 counters in the ray count buffer: rays traced, rays that hit something,
+// and rays that were not traced because their result was available from a cache.
+#define RAY_COUNT_STRIDE 3
+#define RAY_COUNT_TRACED(index) ((index) * RAY_COUNT_STRIDE)
+#define RAY_COUNT_HITS(index) ((index) * RAY_COUNT_STRIDE + 1)
+#define RAY_COUNT_SAVED(index) ((index) * RAY_COUNT_STRIDE + 2)
 
 #define REPORT_RAY(hit) if (g_PerPassConstants.rayCountBufferIndex >= 0) { \
     InterlockedAdd(u_RayCountBuffer[RAY_COUNT_TRACED(g_PerPassConstants.rayCountBufferIndex)], 1); \
     if (hit) InterlockedAdd(u_RayCountBuffer[RAY_COUNT_HITS(g_PerPassConstants.rayCountBufferIndex)], 1); }
 
+#define REPORT_SAVED_RAY() if (g_PerPassConstants.rayCountBufferIndex >= 0) { \
+    InterlockedAdd(u_RayCountBuffer[RAY_COUNT_SAVED(g_PerPassConstants.rayCountBufferIndex)], 1); }
+
 struct BrdfRayTracingConstants
 {
     PlanarViewConstants view;
@@ -75,14 +109,27 @@ struct PrepareLightsConstants
     uint numTasks;
     uint currentFrameLightOffset;
     uint previousFrameLightOffset;
+    uint firstTask;
+
+    // The instanced lights come first in the frame's part of the light buffer and have no LightDataBuffer entries,
+    // see RAB_LoadLightInfo
+    uint currentFrameDataOffset;
+    uint currentFrameInstancedLightOffset;
+    uint numInstancedLights;
+    uint bakeInstancedLights; // Write the local space triangles of the instanced geometries instead of the lights
+
+    uint tasksEndOffset; // The last task ends here, every other task ends where the next one starts
 };
 
+// The tasks of a dispatch cover consecutive light buffer ranges without gaps, in the order of their offsets,
+// so the number of lights in a task is not stored.
 struct PrepareLightsTask
 {
-    uint instanceAndGeometryIndex; // low 12 bits are geometryIndex, mid 19 bits are instanceIndex, high bit is TASK_PRIMITIVE_LIGHT_BIT
-    uint triangleCount;
+    uint instanceIndex; // or TASK_PRIMITIVE_LIGHT_BIT | primitive light index
+    uint geometryIndex; // within the mesh of the instance
     uint lightBufferOffset;
     int previousLightBufferOffset; // -1 means no previous data
+    uint instancedLightOffset; // first local space triangle in the InstancedLightBuffer, or ~0u for non-instanced meshes
 };
 
 struct RenderEnvironmentMapConstants
@@ -95,8 +142,8 @@ struct RenderEnvironmentMapConstants
 struct PreprocessEnvironmentMapConstants
 {
     uint2 sourceSize;
-    uint sourceMipLevel;
     uint numDestMipLevels;
+    uint numWorkGroups;
 };
 
 struct GBufferConstants
@@ -117,6 +164,60 @@ struct GBufferConstants
     float textureGradientScale; // 2^textureLodBias
 };
 
+#define GBUFFER_CULLING_GROUP_SIZE 64
+
+// One (instance, geometry) pair of the rasterized G-buffer, in the order of its draw arguments.
+// The IDs double as a per-instance vertex attribute for the indirect draws.
+struct GBufferDrawRecord
+{
+    uint instanceIndex;
+    uint geometryIndex;
+    uint2 pad1;
+
+    float3 boundsMin; // object space
+    uint pad2;
+
+    float3 boundsMax;
+    uint pad3;
+};
+
+struct GBufferCullingConstants
+{
+    float4 frustumPlanes[6]; // world space, xyz = normal, w = distance; outside when dot(normal, p) > distance
+
+    uint drawCount;
+    uint3 pad;
+};
+
+// Visibility buffer texel: x = instance index, y = (geometry index << VISIBILITY_BUFFER_PRIMITIVE_BITS) | primitive index.
+// Background pixels keep the clear value of VISIBILITY_BUFFER_EMPTY in x.
+#define VISIBILITY_BUFFER_PRIMITIVE_BITS 24
+#define VISIBILITY_BUFFER_EMPTY 0xffffffffu
+
+// Passes of VisibilityBufferResolve.hlsl, selected with VISIBILITY_RESOLVE_PASS
+#define VISIBILITY_RESOLVE_CLASSIFY 0
+#define VISIBILITY_RESOLVE_OFFSETS 1
+#define VISIBILITY_RESOLVE_SCATTER 2
+#define VISIBILITY_RESOLVE_SHADE 3
+#define VISIBILITY_RESOLVE_SHADE_GROUP_SIZE 64
+
+// Layout of the material bin buffer, with N = materialBinCount:
+// [0, N) pixel count per material, [N, 2N) write cursor per material, [2N, 2N+3) shading dispatch arguments, [2N+3] total pixel count
+#define VISIBILITY_RESOLVE_EXTRA_COUNTERS 4
+
+struct VisibilityResolveConstants
+{
+    uint materialBinCount;
+    uint3 pad;
+};
+
+struct PostprocessGBufferConstants
+{
+    uint2 viewportSize;
+    uint compactSurfaceStride;
+    uint writeCompactSurfaces;
+};
+
 struct GlassConstants
 {
     PlanarViewConstants view;
@@ -162,8 +263,8 @@ struct AccumulationConstants
 struct FilterGradientsConstants
 {
     uint2 viewportSize;
-    int passIndex;
     uint checkerboard;
+    uint pad;
 };
 
 struct ConfidenceConstants
@@ -177,6 +278,7 @@ struct ConfidenceConstants
     int inputBufferIndex;
 
     float blendFactor;
+    uint2 prevViewportSize;
 };
 
 struct VisualizationConstants
@@ -222,7 +324,7 @@ struct ResamplingConstants
     uint enableBrdfIndirect;
     uint enableBrdfAdditiveBlend;    
     uint enableAccumulation; // StoreShadingOutput
-    uint pad1;
+    uint enableCompactGBufferSurfaces;
 
     SceneConstants sceneConstants;
 
@@ -238,7 +340,22 @@ struct ResamplingConstants
     BRDFPathTracing_Parameters brdfPT;
 
     uint visualizeRegirCells;
-    uint3 pad2;
+    uint compactGBufferSurfaceStride;
+    uint enableAdaptiveSampleBudget;
+    uint pad3;
+
+    float adaptiveBudgetMinScale;
+    float adaptiveBudgetMaxScale;
+    uint giDownscaleFactor; // 0 or 1 = ReSTIR GI at render resolution, 2 = half, 4 = quarter
+    uint enableVisibilityCache;
+
+    uint visibilityCacheRefreshPeriod;
+    float visibilityCacheMaxDistance;
+    uint lightBufferCapacity; // light indices per frame
+    uint instancedLightCapacity; // instanced light indices per frame
+
+    uint2 instancedLightCounts; // per half of the light buffer, not per current/previous frame
+    uint2 pad2;
     
     uint2 environmentPdfTextureSize;
     uint2 localLightPdfTextureSize;
@@ -249,6 +366,27 @@ struct PerPassConstants
     int rayCountBufferIndex;
 };
 
+// Use the 36-byte SecondaryGBufferData layout instead of the 48-byte one.
+// Access the position and emission through the functions in SecondaryGBuffer.hlsli.
+#ifndef USE_COMPACT_SECONDARY_GBUFFER
+#define USE_COMPACT_SECONDARY_GBUFFER 1
+#endif
+
+#if USE_COMPACT_SECONDARY_GBUFFER
+struct SecondaryGBufferData
+{
+    float hitDistance;          // distance from the primary surface
+    uint direction;             // direction from the primary surface, octahedral 16:16
+    uint normal;
+    float pdf;
+
+    uint2 throughputAndFlags;   // .x = throughput.rg as float16, .y = throughput.b as float16, flags << 16
+    uint diffuseAlbedo;         // R11G11B10_UFLOAT
+    uint specularAndRoughness;  // R8G8B8A8_Gamma_UFLOAT
+
+    uint emission;              // R9G9B9E5_UFLOAT
+};
+#else
 struct SecondaryGBufferData
 {
     float3 worldPos;
@@ -261,6 +399,35 @@ struct SecondaryGBufferData
     float3 emission;
     float pdf;
 };
+#endif
+
+// A BRDF ray sampled by the binning pass and traced by the sorted pass, see BrdfRayTracing.hlsl
+struct BrdfRayData
+{
+    float3 direction;
+    float overallPdf;
+
+    float3 brdfOverPdf;
+    uint reservoirPositionAndFlags; // x in bits 0-13, y in bits 14-27, kBrdfRay_... flags in bits 28-31
+};
+
+// The result of tracing a BrdfRayData, stored at the same index by the wavefront trace pass
+struct BrdfRayHitData
+{
+    uint instanceID; // ~0u if the ray missed
+    uint geometryIndex;
+    uint primitiveIndex;
+    float hitDistance;
+
+    float2 barycentrics;
+    uint throughput; // R11G11B10_UFLOAT
+    uint pad;
+};
+
+static const uint kBrdfRay_IsValid = 1;
+static const uint kBrdfRay_IsSpecularRay = 2;
+static const uint kBrdfRay_IsDeltaSurface = 4;
+static const uint kBrdfRay_IsBelowHorizon = 8;
 
 static const uint kSecondaryGBuffer_IsSpecularRay = 1;
 static const uint kSecondaryGBuffer_IsDeltaSurface = 2;
@@ -270,6 +437,15 @@ static const uint kPolymorphicLightTypeShift = 24;
 static const uint kPolymorphicLightTypeMask = 0xf;
 static const uint kPolymorphicLightShapingEnableBit = 1 << 28;
 static const uint kPolymorphicLightIesProfileEnableBit = 1 << 29;
+
+// PolymorphicLightInfo::iesProfileIndex is either the bindless index of a 2D profile texture, or for
+// rotationally symmetric profiles, kIesProfileSymmetricBit | (atlas row << kIesProfileAtlasRowShift) | bindless index of the atlas.
+// The atlas rows are indexed by the cosine of the angle to the light axis, see IesProfileAtlas.h
+static const uint kIesProfileSymmetricBit = 1 << 30;
+static const uint kIesProfileAtlasRowShift = 16;
+static const uint kIesProfileAtlasIndexMask = 0xffff;
+#define IES_PROFILE_ATLAS_WIDTH 256
+#define IES_PROFILE_ATLAS_ROWS 64
 static const float kPolymorphicLightMinLog2Radiance = -8.f;
 static const float kPolymorphicLightMaxLog2Radiance = 40.f;
 
@@ -0,0 +1,167 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Resolves the visibility buffer written by RasterizedGBuffer.hlsl into the regular G-buffer.
+// The pixels are binned by material first, so that the threads of a wave mostly evaluate the same material:
+//  - VISIBILITY_RESOLVE_CLASSIFY: count the visible pixels of each material and write the background pixels.
+//  - VISIBILITY_RESOLVE_OFFSETS: turn the counts into the start of each material's range in the pixel list,
+//    and write the dispatch arguments of the shading pass.
+//  - VISIBILITY_RESOLVE_SCATTER: append each visible pixel to the range of its material.
+//  - VISIBILITY_RESOLVE_SHADE: reconstruct the hits of the binned pixels and evaluate their materials.
+// The barycentrics are not stored in the visibility buffer, they are recomputed by intersecting
+// the primary ray of the pixel with the triangle.
+
+#pragma pack_matrix(row_major)
+
+#define ENABLE_METAL_ROUGH_RECONSTRUCTION 1
+
+#include "ShaderParameters.h"
+#include "SceneGeometry.hlsli"
+#include "GBufferHelpers.hlsli"
+
+ConstantBuffer<GBufferConstants> g_Const : register(b0);
+VK_PUSH_CONSTANT ConstantBuffer<VisibilityResolveConstants> g_Resolve : register(b1);
+
+Texture2D<uint2> t_VisibilityBuffer : register(t0);
+
+RWBuffer<uint> u_MaterialBins : register(u9);
+RWBuffer<uint> u_PixelList : register(u10);
+
+#include "GBufferShading.hlsli"
+
+#define MATERIAL_COUNTS 0
+#define MATERIAL_CURSORS (g_Resolve.materialBinCount)
+#define SHADE_DISPATCH_ARGS (g_Resolve.materialBinCount * 2)
+#define TOTAL_PIXEL_COUNT (g_Resolve.materialBinCount * 2 + 3)
+
+struct VisibilityHit
+{
+    uint instanceIndex;
+    uint geometryIndex;
+    uint primitiveIndex;
+};
+
+bool loadVisibilityHit(uint2 pixelPosition, out VisibilityHit hit)
+{
+    const uint2 visibility = t_VisibilityBuffer[pixelPosition];
+
+    hit.instanceIndex = visibility.x;
+    hit.geometryIndex = visibility.y >> VISIBILITY_BUFFER_PRIMITIVE_BITS;
+    hit.primitiveIndex = visibility.y & ((1u << VISIBILITY_BUFFER_PRIMITIVE_BITS) - 1);
+
+    return visibility.x != VISIBILITY_BUFFER_EMPTY;
+}
+
+uint getMaterialBin(VisibilityHit hit)
+{
+    const InstanceData instance = t_InstanceData[hit.instanceIndex];
+    const GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + hit.geometryIndex];
+
+    return min(geometry.materialIndex, g_Resolve.materialBinCount - 1);
+}
+
+#if VISIBILITY_RESOLVE_PASS == VISIBILITY_RESOLVE_CLASSIFY
+
+[numthreads(16, 16, 1)]
+void main(uint2 pixelPosition : SV_DispatchThreadID)
+{
+    if (any(float2(pixelPosition) >= g_Const.view.viewportSize))
+        return;
+
+    VisibilityHit hit;
+    if (!loadVisibilityHit(pixelPosition, hit))
+    {
+        // Like the rasterized G-buffer, let the glass pass trace every pixel
+        writeBackgroundSurface(pixelPosition, setupPrimaryRay(pixelPosition, g_Const.view).TMax);
+        return;
+    }
+
+    InterlockedAdd(u_MaterialBins[MATERIAL_COUNTS + getMaterialBin(hit)], 1);
+}
+
+#elif VISIBILITY_RESOLVE_PASS == VISIBILITY_RESOLVE_OFFSETS
+
+[numthreads(1, 1, 1)]
+void main()
+{
+    uint offset = 0;
+    for (uint bin = 0; bin < g_Resolve.materialBinCount; bin++)
+    {
+        u_MaterialBins[MATERIAL_CURSORS + bin] = offset;
+        offset += u_MaterialBins[MATERIAL_COUNTS + bin];
+    }
+
+    u_MaterialBins[SHADE_DISPATCH_ARGS + 0] = (offset + VISIBILITY_RESOLVE_SHADE_GROUP_SIZE - 1) / VISIBILITY_RESOLVE_SHADE_GROUP_SIZE;
+    u_MaterialBins[SHADE_DISPATCH_ARGS + 1] = 1;
+    u_MaterialBins[SHADE_DISPATCH_ARGS + 2] = 1;
+    u_MaterialBins[TOTAL_PIXEL_COUNT] = offset;
+}
+
+#elif VISIBILITY_RESOLVE_PASS == VISIBILITY_RESOLVE_SCATTER
+
+[numthreads(16, 16, 1)]
+void main(uint2 pixelPosition : SV_DispatchThreadID)
+{
+    if (any(float2(pixelPosition) >= g_Const.view.viewportSize))
+        return;
+
+    VisibilityHit hit;
+    if (!loadVisibilityHit(pixelPosition, hit))
+        return;
+
+    uint index;
+    InterlockedAdd(u_MaterialBins[MATERIAL_CURSORS + getMaterialBin(hit)], 1, index);
+
+    u_PixelList[index] = pixelPosition.x | (pixelPosition.y << 16);
+}
+
+#elif VISIBILITY_RESOLVE_PASS == VISIBILITY_RESOLVE_SHADE
+
+[numthreads(VISIBILITY_RESOLVE_SHADE_GROUP_SIZE, 1, 1)]
+void main(uint index : SV_DispatchThreadID)
+{
+    if (index >= u_MaterialBins[TOTAL_PIXEL_COUNT])
+        return;
+
+    const uint packedPixel = u_PixelList[index];
+    const uint2 pixelPosition = uint2(packedPixel & 0xffff, packedPixel >> 16);
+
+    VisibilityHit hit;
+    loadVisibilityHit(pixelPosition, hit);
+
+    GeometrySample gs = getGeometryFromHit(hit.instanceIndex, hit.geometryIndex, hit.primitiveIndex, 0,
+        GeomAttr_Position, t_InstanceData, t_GeometryData, t_MaterialConstants);
+
+    float3 worldSpacePositions[3];
+    worldSpacePositions[0] = mul(gs.instance.transform, float4(gs.vertexPositions[0], 1.0)).xyz;
+    worldSpacePositions[1] = mul(gs.instance.transform, float4(gs.vertexPositions[1], 1.0)).xyz;
+    worldSpacePositions[2] = mul(gs.instance.transform, float4(gs.vertexPositions[2], 1.0)).xyz;
+
+    RayDesc ray = setupPrimaryRay(pixelPosition, g_Const.view);
+    float3 barycentrics = computeRayIntersectionBarycentrics(worldSpacePositions, ray.Origin, ray.Direction);
+
+    float3 worldSpacePosition = worldSpacePositions[0] * barycentrics.x
+        + worldSpacePositions[1] * barycentrics.y
+        + worldSpacePositions[2] * barycentrics.z;
+
+    // viewDistance is here to enable glass ray tracing on all pixels, like in the rasterized G-buffer
+    float viewDistance = length(worldSpacePosition - ray.Origin);
+
+    shadeSurface(
+        pixelPosition,
+        hit.instanceIndex,
+        hit.geometryIndex,
+        hit.primitiveIndex,
+        barycentrics.yz,
+        ray.Direction,
+        viewDistance);
+}
+
+#endif
@@ -0,0 +1,167 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "CommandRecorder.h"
+
+#include <taskflow/taskflow.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+CommandRecorder::CommandRecorder(nvrhi::IDevice* device, tf::Executor* executor)
+    : m_device(device)
+    , m_executor(executor)
+{
+}
+
+uint32_t CommandRecorder::AddSegment(const char* name, RecordCallback callback, std::initializer_list<uint32_t> dependencies,
+    nvrhi::CommandQueue queue)
+{
+    const uint32_t index = uint32_t(m_segments.size());
+
+    Segment segment;
+    segment.name = name;
+    segment.callback = std::move(callback);
+    segment.dependencies = dependencies;
+    segment.queue = queue;
+
+    for (uint32_t dependency : segment.dependencies)
+    {
+        // Dependencies on later segments would make the serial recording order invalid
+        assert(dependency < index);
+        (void)dependency;
+    }
+
+    m_segments.push_back(std::move(segment));
+
+    return index;
+}
+
+void CommandRecorder::RecordSegment(uint32_t index)
+{
+    nvrhi::ICommandList* commandList = m_commandLists[index];
+
+    commandList->open();
+    m_segments[index].callback(commandList);
+    commandList->close();
+}
+
+void CommandRecorder::Execute()
+{
+    if (m_segments.empty())
+        return;
+
+    // Command lists are persistent and reused between frames, one per segment slot
+    m_commandLists.resize(std::max(m_commandLists.size(), m_segments.size()));
+    for (size_t index = 0; index < m_segments.size(); index++)
+    {
+        nvrhi::CommandListHandle& commandList = m_commandLists[index];
+        if (!commandList || commandList->getDesc().queueType != m_segments[index].queue)
+        {
+            nvrhi::CommandListParameters params;
+            params.queueType = m_segments[index].queue;
+            commandList = m_device->createCommandList(params);
+        }
+    }
+
+    const auto startTime = std::chrono::steady_clock::now();
+
+    if (IsParallelRecordingEnabled() && m_segments.size() > 1)
+    {
+        tf::Taskflow taskflow;
+        std::vector<tf::Task> tasks;
+        tasks.reserve(m_segments.size());
+
+        for (uint32_t index = 0; index < uint32_t(m_segments.size()); index++)
+        {
+            tasks.push_back(taskflow.emplace([this, index]() { RecordSegment(index); }).name(m_segments[index].name));
+
+            for (uint32_t dependency : m_segments[index].dependencies)
+                tasks[dependency].precede(tasks[index]);
+        }
+
+        m_executor->run(taskflow).wait();
+    }
+    else
+    {
+        for (uint32_t index = 0; index < uint32_t(m_segments.size()); index++)
+            RecordSegment(index);
+    }
+
+    const auto endTime = std::chrono::steady_clock::now();
+    m_lastRecordingTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+
+    Submit();
+
+    m_segments.clear();
+}
+
+bool CommandRecorder::HasCrossQueueDependency(uint32_t index) const
+{
+    for (uint32_t dependency : m_segments[index].dependencies)
+    {
+        if (m_segments[dependency].queue != m_segments[index].queue)
+            return true;
+    }
+
+    return false;
+}
+
+void CommandRecorder::Submit()
+{
+    // Submission instance of every segment, used for cross-queue waits
+    std::vector<uint64_t> instances(m_segments.size(), 0);
+    std::vector<nvrhi::ICommandList*> batch;
+
+    size_t batchStart = 0;
+    while (batchStart < m_segments.size())
+    {
+        const nvrhi::CommandQueue queue = m_segments[batchStart].queue;
+
+        // A segment that waits for another queue starts a new batch, so that the preceding segments
+        // on this queue can execute while the other queue is still working
+        size_t batchEnd = batchStart + 1;
+        while (batchEnd < m_segments.size() && m_segments[batchEnd].queue == queue && !HasCrossQueueDependency(uint32_t(batchEnd)))
+            ++batchEnd;
+
+        // Make the batch wait for the latest dependency on each of the other queues
+        uint64_t waitInstances[uint32_t(nvrhi::CommandQueue::Count)] = {};
+        for (size_t index = batchStart; index < batchEnd; index++)
+        {
+            for (uint32_t dependency : m_segments[index].dependencies)
+            {
+                const nvrhi::CommandQueue dependencyQueue = m_segments[dependency].queue;
+                if (dependencyQueue != queue)
+                {
+                    uint64_t& waitInstance = waitInstances[uint32_t(dependencyQueue)];
+                    waitInstance = std::max(waitInstance, instances[dependency]);
+                }
+            }
+        }
+
+        for (uint32_t otherQueue = 0; otherQueue < uint32_t(nvrhi::CommandQueue::Count); otherQueue++)
+        {
+            if (waitInstances[otherQueue] != 0)
+                m_device->queueWaitForCommandList(queue, nvrhi::CommandQueue(otherQueue), waitInstances[otherQueue]);
+        }
+
+        batch.clear();
+        for (size_t index = batchStart; index < batchEnd; index++)
+            batch.push_back(m_commandLists[index]);
+
+        const uint64_t instance = m_device->executeCommandLists(batch.data(), batch.size(), queue);
+
+        for (size_t index = batchStart; index < batchEnd; index++)
+            instances[index] = instance;
+
+        batchStart = batchEnd;
+    }
+}
@@ -0,0 +1,79 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace tf
+{
+    class Executor;
+}
+
+// Records a frame as a sequence of segments, each into its own command list.
+// Segments whose CPU-side recording is independent are recorded concurrently on the executor's
+// worker threads, and all command lists are submitted in the order the segments were added,
+// so the GPU sees the same sequence of work as with a single command list.
+//
+// Segments can be placed on the compute queue. Consecutive segments on the same queue are submitted
+// as one batch, and a segment that depends on a segment from another queue starts a new batch
+// that waits for that queue.
+// Work on different queues only overlaps if the segments are added in an order that allows it,
+// i.e. an async segment should be added before the graphics work that it's supposed to overlap with.
+//
+// All resources used across segments must have keepInitialState = true, because nvrhi tracks
+// resource states per command list.
+class CommandRecorder
+{
+public:
+    typedef std::function<void(nvrhi::ICommandList* commandList)> RecordCallback;
+
+    CommandRecorder(nvrhi::IDevice* device, tf::Executor* executor);
+
+    // Adds a segment and returns its index. The segment is recorded after the recording of all
+    // 'dependencies' has finished, which must be indices of previously added segments.
+    // On the GPU, the segment also waits for the dependencies that are executed on a different queue.
+    uint32_t AddSegment(const char* name, RecordCallback callback, std::initializer_list<uint32_t> dependencies = {},
+        nvrhi::CommandQueue queue = nvrhi::CommandQueue::Graphics);
+
+    // Records all segments, serially or in parallel, submits the command lists and clears the segment list.
+    void Execute();
+
+    void SetParallelRecordingEnabled(bool enable) { m_parallelRecording = enable; }
+    [[nodiscard]] bool IsParallelRecordingEnabled() const { return m_parallelRecording && m_executor; }
+
+    // Wall-clock time spent recording the segments in the last Execute() call, in milliseconds.
+    [[nodiscard]] double GetLastRecordingTime() const { return m_lastRecordingTime; }
+
+private:
+    struct Segment
+    {
+        std::string name;
+        RecordCallback callback;
+        std::vector<uint32_t> dependencies;
+        nvrhi::CommandQueue queue = nvrhi::CommandQueue::Graphics;
+    };
+
+    void RecordSegment(uint32_t index);
+    [[nodiscard]] bool HasCrossQueueDependency(uint32_t index) const;
+    void Submit();
+
+    nvrhi::DeviceHandle m_device;
+    tf::Executor* m_executor;
+    bool m_parallelRecording = true;
+    double m_lastRecordingTime = 0.0;
+
+    std::vector<Segment> m_segments;
+    std::vector<nvrhi::CommandListHandle> m_commandLists;
+};
@@ -0,0 +1,75 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+DynamicResolutionController::DynamicResolutionController(const Parameters& params)
+    : m_params(params)
+    , m_scale(params.maxScale)
+{
+}
+
+void DynamicResolutionController::Reset(float scale)
+{
+    m_scale = Quantize(std::clamp(scale, m_params.minScale, m_params.maxScale));
+    m_framesSinceChange = 0;
+}
+
+float DynamicResolutionController::Quantize(float scale) const
+{
+    if (m_params.granularity <= 0.f)
+        return scale;
+
+    return std::round(scale / m_params.granularity) * m_params.granularity;
+}
+
+float DynamicResolutionController::Update(double frameTime)
+{
+    // Keep the scale within the limits even if they have been changed since the last update
+    const float clampedScale = std::clamp(m_scale, m_params.minScale, m_params.maxScale);
+    if (clampedScale != m_scale)
+    {
+        m_scale = clampedScale;
+        m_framesSinceChange = 0;
+        return m_scale;
+    }
+
+    // The measurement may still include frames rendered at the old scale
+    if (m_framesSinceChange < m_params.settleFrames)
+    {
+        ++m_framesSinceChange;
+        return m_scale;
+    }
+
+    if (frameTime <= 0.0 || m_params.targetFrameTime <= 0.f)
+        return m_scale;
+
+    const float ratio = m_params.targetFrameTime / float(frameTime);
+
+    // Hysteresis: don't react to the frame time fluctuating around the target
+    if (std::abs(ratio - 1.f) <= m_params.tolerance)
+        return m_scale;
+
+    // Frame time is proportional to the pixel count, which is proportional to the square of the scale
+    float desiredScale = m_scale * std::sqrt(ratio);
+    desiredScale = std::clamp(desiredScale, m_scale - m_params.maxStep, m_scale + m_params.maxStep);
+    desiredScale = std::clamp(Quantize(desiredScale), m_params.minScale, m_params.maxScale);
+
+    if (desiredScale != m_scale)
+    {
+        m_scale = desiredScale;
+        m_framesSinceChange = 0;
+    }
+
+    return m_scale;
+}
@@ -0,0 +1,58 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+// Adjusts the render resolution scale to keep the GPU frame time close to a target.
+// The render targets and the RTXDI resources are always allocated for the full render size,
+// and the scale only shrinks the view's viewport, so changing it never re-creates any resources.
+//
+// The controller assumes that the frame time is roughly proportional to the number of pixels,
+// i.e. to the square of the scale. To avoid oscillation, the scale is held while the frame time
+// is within a tolerance band around the target, the step per update is limited, and after
+// every change the controller waits for a few frames because the GPU timers lag behind.
+class DynamicResolutionController
+{
+public:
+    struct Parameters
+    {
+        float targetFrameTime = 16.6f; // milliseconds
+        float minScale = 0.5f;
+        float maxScale = 1.f;
+        float tolerance = 0.1f;        // relative half-width of the band around the target where the scale is held
+        float maxStep = 0.1f;          // maximum scale change per update
+        float granularity = 0.01f;     // the scale is quantized to this step
+        uint32_t settleFrames = 4;     // frames to wait after a change before the next measurement is trusted
+    };
+
+    DynamicResolutionController() = default;
+    explicit DynamicResolutionController(const Parameters& params);
+
+    void SetParameters(const Parameters& params) { m_params = params; }
+    [[nodiscard]] const Parameters& GetParameters() const { return m_params; }
+
+    // Starts from the given scale and discards the pending measurements.
+    void Reset(float scale);
+
+    // Consumes the GPU frame time of a recent frame in milliseconds, zero if not available,
+    // and returns the scale to use for the next frame.
+    float Update(double frameTime);
+
+    [[nodiscard]] float GetScale() const { return m_scale; }
+
+private:
+    [[nodiscard]] float Quantize(float scale) const;
+
+    Parameters m_params;
+    float m_scale = 1.f;
+    uint32_t m_framesSinceChange = 0;
+};
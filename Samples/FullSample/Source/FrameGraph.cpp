@@ -0,0 +1,869 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "FrameGraph.h"
+
+#include <nvrhi/utils.h>
+
+#if DONUT_WITH_DX12
+#include <d3d12.h>
+#endif
+
+#if DONUT_WITH_VULKAN
+#include <nvrhi/vulkan.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+
+static constexpr uint64_t c_DefaultPlacementAlignment = 64 * 1024;
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+    if (alignment == 0)
+        return value;
+
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// NVRHI doesn't expose aliasing barriers, so they are recorded through the native command list.
+// Devices without a native command list, such as the null device in the host tests, skip them.
+static void RecordAliasingBarrier(nvrhi::ICommandList* commandList, nvrhi::ITexture* before, nvrhi::ITexture* after)
+{
+    switch (commandList->getDevice()->getGraphicsAPI())
+    {
+#if DONUT_WITH_DX12
+    case nvrhi::GraphicsAPI::D3D12: {
+        ID3D12GraphicsCommandList* d3dCommandList = commandList->getNativeObject(nvrhi::ObjectTypes::D3D12_GraphicsCommandList);
+        if (!d3dCommandList)
+            break;
+
+        D3D12_RESOURCE_BARRIER barrier = {};
+        barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+        barrier.Aliasing.pResourceBefore = before->getNativeObject(nvrhi::ObjectTypes::D3D12_Resource);
+        barrier.Aliasing.pResourceAfter = after->getNativeObject(nvrhi::ObjectTypes::D3D12_Resource);
+        d3dCommandList->ResourceBarrier(1, &barrier);
+        break;
+    }
+#endif
+#if DONUT_WITH_VULKAN
+    case nvrhi::GraphicsAPI::VULKAN: {
+        VkCommandBuffer vkCommandBuffer = commandList->getNativeObject(nvrhi::ObjectTypes::VK_CommandBuffer);
+        if (!vkCommandBuffer)
+            break;
+
+        // The new image is transitioned out of the undefined layout by NVRHI, only the memory dependency
+        // on the writes to the previous image is missing
+        const vk::MemoryBarrier barrier(vk::AccessFlagBits::eMemoryWrite, vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite);
+        vk::CommandBuffer(vkCommandBuffer).pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eAllCommands,
+            vk::DependencyFlags(), barrier, nullptr, nullptr);
+        break;
+    }
+#endif
+    default:
+        (void)before;
+        (void)after;
+        break;
+    }
+}
+
+static bool AreTextureDescsEqual(const nvrhi::TextureDesc& a, const nvrhi::TextureDesc& b)
+{
+    return a.width == b.width
+        && a.height == b.height
+        && a.depth == b.depth
+        && a.arraySize == b.arraySize
+        && a.mipLevels == b.mipLevels
+        && a.sampleCount == b.sampleCount
+        && a.format == b.format
+        && a.dimension == b.dimension
+        && a.isRenderTarget == b.isRenderTarget
+        && a.isUAV == b.isUAV
+        && a.isTypeless == b.isTypeless
+        && a.debugName == b.debugName;
+}
+
+
+FrameGraphBuilder::FrameGraphBuilder(FrameGraph& graph, uint32_t passIndex)
+    : m_graph(graph)
+    , m_passIndex(passIndex)
+{
+}
+
+FrameGraphTexture FrameGraphBuilder::Read(FrameGraphTexture texture, nvrhi::ResourceStates state)
+{
+    assert(texture.IsValid());
+
+    FrameGraph::Access access;
+    access.kind = FrameGraph::ResourceKind::Texture;
+    access.index = texture.index;
+    access.state = state;
+    access.read = true;
+    m_graph.AddAccess(m_passIndex, access);
+
+    return texture;
+}
+
+FrameGraphBuffer FrameGraphBuilder::Read(FrameGraphBuffer buffer, nvrhi::ResourceStates state)
+{
+    assert(buffer.IsValid());
+
+    FrameGraph::Access access;
+    access.kind = FrameGraph::ResourceKind::Buffer;
+    access.index = buffer.index;
+    access.state = state;
+    access.read = true;
+    m_graph.AddAccess(m_passIndex, access);
+
+    return buffer;
+}
+
+FrameGraphTexture FrameGraphBuilder::Write(FrameGraphTexture texture, nvrhi::ResourceStates state, bool fullWrite)
+{
+    assert(texture.IsValid());
+
+    FrameGraph::Access access;
+    access.kind = FrameGraph::ResourceKind::Texture;
+    access.index = texture.index;
+    access.state = state;
+    access.write = true;
+    access.fullWrite = fullWrite;
+    m_graph.AddAccess(m_passIndex, access);
+
+    return texture;
+}
+
+FrameGraphBuffer FrameGraphBuilder::Write(FrameGraphBuffer buffer, nvrhi::ResourceStates state, bool fullWrite)
+{
+    assert(buffer.IsValid());
+
+    FrameGraph::Access access;
+    access.kind = FrameGraph::ResourceKind::Buffer;
+    access.index = buffer.index;
+    access.state = state;
+    access.write = true;
+    access.fullWrite = fullWrite;
+    m_graph.AddAccess(m_passIndex, access);
+
+    return buffer;
+}
+
+FrameGraphTexture FrameGraphBuilder::ReadWrite(FrameGraphTexture texture, nvrhi::ResourceStates state)
+{
+    assert(texture.IsValid());
+
+    FrameGraph::Access access;
+    access.kind = FrameGraph::ResourceKind::Texture;
+    access.index = texture.index;
+    access.state = state;
+    access.read = true;
+    access.write = true;
+    m_graph.AddAccess(m_passIndex, access);
+
+    return texture;
+}
+
+FrameGraphBuffer FrameGraphBuilder::ReadWrite(FrameGraphBuffer buffer, nvrhi::ResourceStates state)
+{
+    assert(buffer.IsValid());
+
+    FrameGraph::Access access;
+    access.kind = FrameGraph::ResourceKind::Buffer;
+    access.index = buffer.index;
+    access.state = state;
+    access.read = true;
+    access.write = true;
+    m_graph.AddAccess(m_passIndex, access);
+
+    return buffer;
+}
+
+void FrameGraphBuilder::SetSideEffects()
+{
+    m_graph.m_passes[m_passIndex].sideEffects = true;
+}
+
+
+FrameGraphResources::FrameGraphResources(const FrameGraph& graph)
+    : m_graph(graph)
+{
+}
+
+nvrhi::ITexture* FrameGraphResources::GetTexture(FrameGraphTexture texture) const
+{
+    if (!texture.IsValid())
+        return nullptr;
+
+    const auto& resource = m_graph.m_textures[texture.index];
+    return resource.imported ? resource.imported : resource.realized;
+}
+
+nvrhi::IBuffer* FrameGraphResources::GetBuffer(FrameGraphBuffer buffer) const
+{
+    if (!buffer.IsValid())
+        return nullptr;
+
+    return m_graph.m_buffers[buffer.index].imported;
+}
+
+
+FrameGraphTexture FrameGraph::ImportTexture(nvrhi::ITexture* texture, nvrhi::ResourceStates initialState, nvrhi::ResourceStates finalState)
+{
+    assert(texture);
+    assert(!m_compiled);
+
+    TextureResource resource;
+    resource.desc = texture->getDesc();
+    resource.imported = texture;
+    resource.initialState = initialState;
+    resource.finalState = finalState;
+    m_textures.push_back(resource);
+
+    return FrameGraphTexture{ uint32_t(m_textures.size() - 1) };
+}
+
+FrameGraphBuffer FrameGraph::ImportBuffer(nvrhi::IBuffer* buffer, nvrhi::ResourceStates initialState, nvrhi::ResourceStates finalState)
+{
+    assert(buffer);
+    assert(!m_compiled);
+
+    BufferResource resource;
+    resource.imported = buffer;
+    resource.initialState = initialState;
+    resource.finalState = finalState;
+    m_buffers.push_back(resource);
+
+    return FrameGraphBuffer{ uint32_t(m_buffers.size() - 1) };
+}
+
+FrameGraphTexture FrameGraph::CreateTexture(const nvrhi::TextureDesc& desc)
+{
+    assert(!m_compiled);
+
+    TextureResource resource;
+    resource.desc = desc;
+    resource.desc.isVirtual = true;
+    resource.desc.keepInitialState = false;
+    resource.desc.initialState = nvrhi::ResourceStates::Common;
+    m_textures.push_back(resource);
+
+    return FrameGraphTexture{ uint32_t(m_textures.size() - 1) };
+}
+
+void FrameGraph::MarkOutput(FrameGraphTexture texture)
+{
+    assert(texture.IsValid());
+    m_textures[texture.index].output = true;
+}
+
+void FrameGraph::MarkOutput(FrameGraphBuffer buffer)
+{
+    assert(buffer.IsValid());
+    m_buffers[buffer.index].output = true;
+}
+
+void FrameGraph::AddPass(const char* name, const SetupCallback& setup, ExecuteCallback execute)
+{
+    assert(!m_compiled);
+
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    m_passes.push_back(std::move(pass));
+
+    FrameGraphBuilder builder(*this, uint32_t(m_passes.size() - 1));
+    if (setup)
+        setup(builder);
+}
+
+void FrameGraph::AddAccess(uint32_t passIndex, const Access& access)
+{
+    auto& accesses = m_passes[passIndex].accesses;
+
+    // Merge repeated declarations of the same resource within one pass
+    for (Access& existing : accesses)
+    {
+        if (existing.kind == access.kind && existing.index == access.index)
+        {
+            existing.read |= access.read;
+            existing.write |= access.write;
+            existing.fullWrite = existing.write && !existing.read && (existing.fullWrite || access.fullWrite);
+            if (access.write)
+                existing.state = access.state;
+            return;
+        }
+    }
+
+    accesses.push_back(access);
+}
+
+void FrameGraph::CullPasses()
+{
+    // Walk the passes backwards, starting from the graph outputs and the passes with side effects.
+    // A pass is live if it writes anything that a later live pass, or the application, reads.
+    // A full write by a live pass satisfies the demand, so the earlier producers of that resource can be culled.
+
+    std::vector<bool> textureNeeded(m_textures.size());
+    std::vector<bool> bufferNeeded(m_buffers.size());
+
+    for (size_t i = 0; i < m_textures.size(); i++)
+        textureNeeded[i] = m_textures[i].output;
+
+    for (size_t i = 0; i < m_buffers.size(); i++)
+        bufferNeeded[i] = m_buffers[i].output;
+
+    for (int passIndex = int(m_passes.size()) - 1; passIndex >= 0; passIndex--)
+    {
+        Pass& pass = m_passes[passIndex];
+
+        bool live = pass.sideEffects;
+        for (const Access& access : pass.accesses)
+        {
+            if (!access.write)
+                continue;
+
+            if (access.kind == ResourceKind::Texture ? textureNeeded[access.index] : bufferNeeded[access.index])
+                live = true;
+        }
+
+        pass.culled = !live;
+        if (!live)
+            continue;
+
+        for (const Access& access : pass.accesses)
+        {
+            if (access.write && access.fullWrite && !access.read)
+            {
+                if (access.kind == ResourceKind::Texture)
+                    textureNeeded[access.index] = false;
+                else
+                    bufferNeeded[access.index] = false;
+            }
+        }
+
+        for (const Access& access : pass.accesses)
+        {
+            if (access.read)
+            {
+                if (access.kind == ResourceKind::Texture)
+                    textureNeeded[access.index] = true;
+                else
+                    bufferNeeded[access.index] = true;
+            }
+        }
+    }
+}
+
+void FrameGraph::ComputeLifetimes()
+{
+    for (uint32_t passIndex = 0; passIndex < uint32_t(m_passes.size()); passIndex++)
+    {
+        const Pass& pass = m_passes[passIndex];
+        if (pass.culled)
+            continue;
+
+        for (const Access& access : pass.accesses)
+        {
+            if (access.kind != ResourceKind::Texture)
+                continue;
+
+            TextureResource& texture = m_textures[access.index];
+            texture.firstPass = std::min(texture.firstPass, passIndex);
+            texture.lastPass = std::max(texture.lastPass, passIndex);
+        }
+    }
+}
+
+void FrameGraph::PlaceTransientTextures(const MemoryRequirementsCallback& memoryRequirements)
+{
+    struct Placement
+    {
+        uint32_t textureIndex;
+        uint64_t size;
+        uint64_t alignment;
+    };
+
+    std::vector<Placement> placements;
+
+    for (uint32_t textureIndex = 0; textureIndex < uint32_t(m_textures.size()); textureIndex++)
+    {
+        if (!IsTransient(textureIndex))
+            continue;
+
+        TextureResource& texture = m_textures[textureIndex];
+        m_statistics.numTransientTextures++;
+
+        if (texture.firstPass == ~0u)
+        {
+            m_statistics.numCulledTransientTextures++;
+            continue;
+        }
+
+        nvrhi::MemoryRequirements requirements = memoryRequirements
+            ? memoryRequirements(texture.desc)
+            : EstimateMemoryRequirements(texture.desc);
+
+        texture.heapSize = AlignUp(requirements.size, c_DefaultPlacementAlignment);
+        m_statistics.unaliasedTransientSize += texture.heapSize;
+
+        placements.push_back({ textureIndex, texture.heapSize, std::max<uint64_t>(requirements.alignment, c_DefaultPlacementAlignment) });
+    }
+
+    // Place the largest textures first; ties are broken by declaration order to keep the layout stable between frames.
+    std::stable_sort(placements.begin(), placements.end(), [](const Placement& a, const Placement& b)
+        { return a.size > b.size; });
+
+    std::vector<uint32_t> placed;
+    uint64_t heapSize = 0;
+
+    for (const Placement& placement : placements)
+    {
+        TextureResource& texture = m_textures[placement.textureIndex];
+
+        // Candidate offsets: the start of the heap and the end of every texture that is alive at the same time
+        std::vector<uint64_t> candidates = { 0 };
+        for (uint32_t otherIndex : placed)
+        {
+            const TextureResource& other = m_textures[otherIndex];
+            bool overlapInTime = other.firstPass <= texture.lastPass && texture.firstPass <= other.lastPass;
+            if (overlapInTime)
+                candidates.push_back(AlignUp(other.heapOffset + other.heapSize, placement.alignment));
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        for (uint64_t offset : candidates)
+        {
+            bool fits = true;
+            for (uint32_t otherIndex : placed)
+            {
+                const TextureResource& other = m_textures[otherIndex];
+                bool overlapInTime = other.firstPass <= texture.lastPass && texture.firstPass <= other.lastPass;
+                bool overlapInMemory = other.heapOffset < offset + placement.size && offset < other.heapOffset + other.heapSize;
+                if (overlapInTime && overlapInMemory)
+                {
+                    fits = false;
+                    break;
+                }
+            }
+
+            if (fits)
+            {
+                texture.heapOffset = offset;
+                break;
+            }
+        }
+
+        placed.push_back(placement.textureIndex);
+        heapSize = std::max(heapSize, texture.heapOffset + texture.heapSize);
+    }
+
+    m_statistics.transientHeapSize = heapSize;
+}
+
+void FrameGraph::PlanAliasingBarriers()
+{
+    // Textures that share heap memory never overlap in time. The previous occupant of a texture's memory is the
+    // overlapping texture that was used last before it in this graph, or, if there is none, the one used last
+    // in the graph overall, which held the memory at the end of the previous frame.
+    for (uint32_t textureIndex = 0; textureIndex < uint32_t(m_textures.size()); textureIndex++)
+    {
+        const TextureResource& texture = m_textures[textureIndex];
+        if (!IsTransient(textureIndex) || texture.firstPass == ~0u)
+            continue;
+
+        uint32_t previousOccupant = ~0u;
+        bool previousInThisFrame = false;
+
+        for (uint32_t otherIndex = 0; otherIndex < uint32_t(m_textures.size()); otherIndex++)
+        {
+            const TextureResource& other = m_textures[otherIndex];
+            if (otherIndex == textureIndex || !IsTransient(otherIndex) || other.firstPass == ~0u)
+                continue;
+
+            bool overlapInMemory = other.heapOffset < texture.heapOffset + texture.heapSize && texture.heapOffset < other.heapOffset + other.heapSize;
+            if (!overlapInMemory)
+                continue;
+
+            const bool inThisFrame = other.lastPass < texture.firstPass;
+            if (previousInThisFrame && !inThisFrame)
+                continue;
+
+            if (previousOccupant == ~0u || inThisFrame != previousInThisFrame || other.lastPass > m_textures[previousOccupant].lastPass)
+            {
+                previousOccupant = otherIndex;
+                previousInThisFrame = inThisFrame;
+            }
+        }
+
+        if (previousOccupant != ~0u)
+        {
+            m_passes[texture.firstPass].aliasingBarriers.push_back({ previousOccupant, textureIndex });
+            m_statistics.numAliasingBarriers++;
+        }
+    }
+}
+
+void FrameGraph::PlanBarriers()
+{
+    struct TrackedState
+    {
+        nvrhi::ResourceStates state = nvrhi::ResourceStates::Unknown;
+        bool pendingUavWrite = false;
+    };
+
+    std::vector<TrackedState> textureStates(m_textures.size());
+    std::vector<TrackedState> bufferStates(m_buffers.size());
+
+    for (size_t i = 0; i < m_textures.size(); i++)
+        textureStates[i].state = IsTransient(uint32_t(i)) ? nvrhi::ResourceStates::Common : m_textures[i].initialState;
+
+    for (size_t i = 0; i < m_buffers.size(); i++)
+        bufferStates[i].state = m_buffers[i].initialState;
+
+    for (uint32_t passIndex = 0; passIndex < uint32_t(m_passes.size()); passIndex++)
+    {
+        Pass& pass = m_passes[passIndex];
+        if (pass.culled)
+            continue;
+
+        for (const Access& access : pass.accesses)
+        {
+            TrackedState& tracked = (access.kind == ResourceKind::Texture) ? textureStates[access.index] : bufferStates[access.index];
+
+            if (access.kind == ResourceKind::Texture && IsTransient(access.index) && m_textures[access.index].firstPass == passIndex)
+            {
+                // The first access to a transient texture determines whether its (aliased) contents have to be initialized.
+                // Placed render targets and depth textures must start with a clear on D3D12 even if they are fully written.
+                const nvrhi::TextureDesc& desc = m_textures[access.index].desc;
+                const nvrhi::FormatInfo& formatInfo = nvrhi::getFormatInfo(desc.format);
+                const bool requiresClear = desc.isRenderTarget || formatInfo.hasDepth || formatInfo.hasStencil;
+
+                if (access.write && access.fullWrite && !access.read && !requiresClear)
+                {
+                    m_statistics.numSkippedClears++;
+                }
+                else
+                {
+                    pass.texturesToClear.push_back(access.index);
+                    m_statistics.numClears++;
+
+                    // The clear leaves the texture in a state that depends on the API, so always transition it
+                    tracked.state = nvrhi::ResourceStates::Unknown;
+                    tracked.pendingUavWrite = false;
+                }
+            }
+
+            Barrier barrier;
+            barrier.kind = access.kind;
+            barrier.index = access.index;
+            barrier.state = access.state;
+
+            if (tracked.state != access.state)
+            {
+                pass.barriers.push_back(barrier);
+                m_statistics.numBarriers++;
+            }
+            else if (access.state == nvrhi::ResourceStates::UnorderedAccess && tracked.pendingUavWrite)
+            {
+                // Same UAV state, but the previous live pass wrote the resource: order the accesses
+                barrier.uavBarrier = true;
+                pass.barriers.push_back(barrier);
+                m_statistics.numBarriers++;
+            }
+
+            tracked.state = access.state;
+            tracked.pendingUavWrite = access.write && access.state == nvrhi::ResourceStates::UnorderedAccess;
+        }
+    }
+
+    for (uint32_t textureIndex = 0; textureIndex < uint32_t(m_textures.size()); textureIndex++)
+    {
+        const TextureResource& texture = m_textures[textureIndex];
+        if (texture.imported && texture.finalState != nvrhi::ResourceStates::Unknown && textureStates[textureIndex].state != texture.finalState)
+        {
+            m_finalBarriers.push_back({ ResourceKind::Texture, textureIndex, texture.finalState, false });
+            m_statistics.numBarriers++;
+        }
+    }
+
+    for (uint32_t bufferIndex = 0; bufferIndex < uint32_t(m_buffers.size()); bufferIndex++)
+    {
+        const BufferResource& buffer = m_buffers[bufferIndex];
+        if (buffer.finalState != nvrhi::ResourceStates::Unknown && bufferStates[bufferIndex].state != buffer.finalState)
+        {
+            m_finalBarriers.push_back({ ResourceKind::Buffer, bufferIndex, buffer.finalState, false });
+            m_statistics.numBarriers++;
+        }
+    }
+}
+
+void FrameGraph::Compile(const MemoryRequirementsCallback& memoryRequirements)
+{
+    assert(!m_compiled);
+
+    m_statistics = Statistics();
+    m_statistics.numPasses = uint32_t(m_passes.size());
+
+    CullPasses();
+
+    for (const Pass& pass : m_passes)
+    {
+        if (pass.culled)
+            m_statistics.numCulledPasses++;
+    }
+
+    ComputeLifetimes();
+    PlaceTransientTextures(memoryRequirements);
+    PlanAliasingBarriers();
+    PlanBarriers();
+
+    m_compiled = true;
+}
+
+void FrameGraph::Execute(nvrhi::ICommandList* commandList, FrameGraphResourcePool& pool)
+{
+    if (!m_compiled)
+        Compile([&pool](const nvrhi::TextureDesc& desc) { return pool.GetMemoryRequirements(desc); });
+
+    pool.Realize(*this);
+
+    FrameGraphResources resources(*this);
+
+    auto applyBarrier = [commandList, &resources](const Barrier& barrier)
+    {
+        if (barrier.kind == ResourceKind::Texture)
+        {
+            nvrhi::ITexture* texture = resources.GetTexture(FrameGraphTexture{ barrier.index });
+            if (barrier.uavBarrier)
+                nvrhi::utils::TextureUavBarrier(commandList, texture);
+            else
+                commandList->setTextureState(texture, nvrhi::AllSubresources, barrier.state);
+        }
+        else
+        {
+            nvrhi::IBuffer* buffer = resources.GetBuffer(FrameGraphBuffer{ barrier.index });
+            if (barrier.uavBarrier)
+                nvrhi::utils::BufferUavBarrier(commandList, buffer);
+            else
+                commandList->setBufferState(buffer, barrier.state);
+        }
+    };
+
+    for (uint32_t passIndex = 0; passIndex < uint32_t(m_passes.size()); passIndex++)
+    {
+        const Pass& pass = m_passes[passIndex];
+        if (pass.culled)
+            continue;
+
+        // Transient textures start their lives in an undefined state
+        for (const Access& access : pass.accesses)
+        {
+            if (access.kind == ResourceKind::Texture && IsTransient(access.index) && m_textures[access.index].firstPass == passIndex)
+                commandList->beginTrackingTextureState(m_textures[access.index].realized, nvrhi::AllSubresources, nvrhi::ResourceStates::Common);
+        }
+
+        if (!pass.aliasingBarriers.empty())
+        {
+            // The previous occupants' transitions must be recorded before their memory is handed over
+            commandList->commitBarriers();
+
+            for (const AliasingBarrier& aliasing : pass.aliasingBarriers)
+                RecordAliasingBarrier(commandList, m_textures[aliasing.before].realized, m_textures[aliasing.after].realized);
+        }
+
+        for (uint32_t textureIndex : pass.texturesToClear)
+        {
+            nvrhi::ITexture* texture = m_textures[textureIndex].realized;
+            const nvrhi::TextureDesc& desc = m_textures[textureIndex].desc;
+            const nvrhi::FormatInfo& formatInfo = nvrhi::getFormatInfo(desc.format);
+
+            if (formatInfo.hasDepth || formatInfo.hasStencil)
+                commandList->clearDepthStencilTexture(texture, nvrhi::AllSubresources, formatInfo.hasDepth, desc.clearValue.r, formatInfo.hasStencil, 0);
+            else if (formatInfo.kind == nvrhi::FormatKind::Integer)
+                commandList->clearTextureUInt(texture, nvrhi::AllSubresources, 0);
+            else
+                commandList->clearTextureFloat(texture, nvrhi::AllSubresources, desc.useClearValue ? desc.clearValue : nvrhi::Color(0.f));
+        }
+
+        for (const Barrier& barrier : pass.barriers)
+            applyBarrier(barrier);
+        commandList->commitBarriers();
+
+        commandList->beginMarker(pass.name.c_str());
+        if (pass.execute)
+            pass.execute(commandList, resources);
+        commandList->endMarker();
+    }
+
+    for (const Barrier& barrier : m_finalBarriers)
+        applyBarrier(barrier);
+    commandList->commitBarriers();
+}
+
+bool FrameGraph::IsPassCulled(const char* name) const
+{
+    for (const Pass& pass : m_passes)
+    {
+        if (pass.name == name)
+            return pass.culled;
+    }
+
+    return true;
+}
+
+bool FrameGraph::IsTextureAllocated(FrameGraphTexture texture) const
+{
+    assert(texture.IsValid());
+    const TextureResource& resource = m_textures[texture.index];
+    return resource.imported || resource.firstPass != ~0u;
+}
+
+uint64_t FrameGraph::GetTransientTextureOffset(FrameGraphTexture texture) const
+{
+    assert(texture.IsValid());
+    return m_textures[texture.index].heapOffset;
+}
+
+nvrhi::MemoryRequirements FrameGraph::EstimateMemoryRequirements(const nvrhi::TextureDesc& desc)
+{
+    const nvrhi::FormatInfo& formatInfo = nvrhi::getFormatInfo(desc.format);
+    const uint32_t blockSize = std::max<uint32_t>(formatInfo.blockSize, 1);
+
+    uint64_t size = 0;
+    for (uint32_t mipLevel = 0; mipLevel < std::max(desc.mipLevels, 1u); mipLevel++)
+    {
+        uint64_t width = std::max(desc.width >> mipLevel, 1u);
+        uint64_t height = std::max(desc.height >> mipLevel, 1u);
+        uint64_t depth = std::max(desc.depth >> mipLevel, 1u);
+        uint64_t blocks = ((width + blockSize - 1) / blockSize) * ((height + blockSize - 1) / blockSize) * depth;
+        size += blocks * formatInfo.bytesPerBlock;
+    }
+
+    size *= std::max(desc.arraySize, 1u) * std::max(desc.sampleCount, 1u);
+
+    nvrhi::MemoryRequirements requirements;
+    requirements.alignment = c_DefaultPlacementAlignment;
+    requirements.size = AlignUp(size, c_DefaultPlacementAlignment);
+    return requirements;
+}
+
+
+FrameGraphResourcePool::FrameGraphResourcePool(nvrhi::IDevice* device)
+    : m_device(device)
+{
+}
+
+nvrhi::MemoryRequirements FrameGraphResourcePool::GetMemoryRequirements(const nvrhi::TextureDesc& desc)
+{
+    for (const CachedRequirements& cached : m_requirementsCache)
+    {
+        if (AreTextureDescsEqual(cached.desc, desc))
+            return cached.requirements;
+    }
+
+    nvrhi::TextureDesc virtualDesc = desc;
+    virtualDesc.isVirtual = true;
+    nvrhi::TextureHandle texture = m_device->createTexture(virtualDesc);
+
+    CachedRequirements cached;
+    cached.desc = desc;
+    cached.requirements = texture
+        ? m_device->getTextureMemoryRequirements(texture)
+        : FrameGraph::EstimateMemoryRequirements(desc);
+    m_requirementsCache.push_back(cached);
+
+    return cached.requirements;
+}
+
+void FrameGraphResourcePool::Reset()
+{
+    m_slots.clear();
+    m_heap = nullptr;
+    m_heapSize = 0;
+    m_oversizedFrames = 0;
+    m_requirementsCache.clear();
+    ++m_generation;
+}
+
+void FrameGraphResourcePool::Realize(FrameGraph& graph)
+{
+    std::vector<uint32_t> allocatedTextures;
+    for (uint32_t textureIndex = 0; textureIndex < uint32_t(graph.m_textures.size()); textureIndex++)
+    {
+        if (graph.IsTransient(textureIndex) && graph.m_textures[textureIndex].firstPass != ~0u)
+            allocatedTextures.push_back(textureIndex);
+    }
+
+    const uint64_t requiredHeapSize = graph.m_statistics.transientHeapSize;
+
+    // A larger heap is kept for a while so that toggling a mode back and forth doesn't re-create it every time,
+    // but it is released right away when nothing is transient, and shrunk when it stays too large.
+    if (m_heapSize > requiredHeapSize)
+        m_oversizedFrames++;
+    else
+        m_oversizedFrames = 0;
+
+    const bool shrinkHeap = m_heapSize > 0 && (requiredHeapSize == 0 || m_oversizedFrames >= c_HeapShrinkDelay);
+
+    // Reuse the placed textures if the layout didn't change since the previous frame
+    bool layoutMatches = !shrinkHeap
+        && (m_heap != nullptr || requiredHeapSize == 0)
+        && m_heapSize >= requiredHeapSize
+        && m_slots.size() == allocatedTextures.size();
+
+    for (size_t slotIndex = 0; layoutMatches && slotIndex < m_slots.size(); slotIndex++)
+    {
+        const auto& texture = graph.m_textures[allocatedTextures[slotIndex]];
+        const Slot& slot = m_slots[slotIndex];
+        layoutMatches = AreTextureDescsEqual(slot.desc, texture.desc) && slot.heapOffset == texture.heapOffset;
+    }
+
+    if (!layoutMatches)
+    {
+        m_slots.clear();
+
+        if (!m_heap || shrinkHeap || m_heapSize < requiredHeapSize)
+        {
+            m_heap = nullptr;
+            m_heapSize = requiredHeapSize;
+            m_oversizedFrames = 0;
+
+            if (m_heapSize > 0)
+            {
+                nvrhi::HeapDesc heapDesc;
+                heapDesc.capacity = m_heapSize;
+                heapDesc.type = nvrhi::HeapType::DeviceLocal;
+                heapDesc.debugName = "FrameGraphTransientHeap";
+                m_heap = m_device->createHeap(heapDesc);
+            }
+        }
+
+        for (uint32_t textureIndex : allocatedTextures)
+        {
+            const auto& texture = graph.m_textures[textureIndex];
+
+            Slot slot;
+            slot.desc = texture.desc;
+            slot.heapOffset = texture.heapOffset;
+            slot.texture = m_device->createTexture(texture.desc);
+            m_device->bindTextureMemory(slot.texture, m_heap, slot.heapOffset);
+            m_slots.push_back(slot);
+        }
+
+        ++m_generation;
+    }
+
+    for (size_t slotIndex = 0; slotIndex < m_slots.size(); slotIndex++)
+    {
+        auto& texture = graph.m_textures[allocatedTextures[slotIndex]];
+        texture.poolSlot = uint32_t(slotIndex);
+        texture.realized = m_slots[slotIndex].texture;
+    }
+}
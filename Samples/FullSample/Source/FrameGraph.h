@@ -0,0 +1,283 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A small frame graph: passes declare which textures and buffers they read and write,
+// and the graph derives the execution order, culls passes whose results are not consumed,
+// places transient textures into a shared aliased heap, and plans the state transitions,
+// aliasing barriers and first-use clears for every live pass.
+//
+// Compilation is a pure CPU step that does not touch the device, which makes it possible
+// to build and inspect graphs without a GPU. Execution records the live passes into a
+// command list, using a FrameGraphResourcePool to back the transient textures.
+
+class FrameGraph;
+class FrameGraphResourcePool;
+
+struct FrameGraphTexture
+{
+    uint32_t index = ~0u;
+
+    [[nodiscard]] bool IsValid() const { return index != ~0u; }
+};
+
+struct FrameGraphBuffer
+{
+    uint32_t index = ~0u;
+
+    [[nodiscard]] bool IsValid() const { return index != ~0u; }
+};
+
+class FrameGraphBuilder
+{
+public:
+    // Declares a read access. The texture or buffer must be produced by an earlier pass or imported.
+    FrameGraphTexture Read(FrameGraphTexture texture, nvrhi::ResourceStates state = nvrhi::ResourceStates::ShaderResource);
+    FrameGraphBuffer Read(FrameGraphBuffer buffer, nvrhi::ResourceStates state = nvrhi::ResourceStates::ShaderResource);
+
+    // Declares a write access. A full write overwrites every texel, so the previous contents are not needed
+    // and a transient texture does not have to be cleared before this pass - unless it's a render target or
+    // depth texture, which D3D12 requires to be cleared before any other use of its aliased memory.
+    FrameGraphTexture Write(FrameGraphTexture texture, nvrhi::ResourceStates state = nvrhi::ResourceStates::UnorderedAccess, bool fullWrite = true);
+    FrameGraphBuffer Write(FrameGraphBuffer buffer, nvrhi::ResourceStates state = nvrhi::ResourceStates::UnorderedAccess, bool fullWrite = true);
+
+    // Declares a read-modify-write access, such as additive blending or in-place filtering.
+    FrameGraphTexture ReadWrite(FrameGraphTexture texture, nvrhi::ResourceStates state = nvrhi::ResourceStates::UnorderedAccess);
+    FrameGraphBuffer ReadWrite(FrameGraphBuffer buffer, nvrhi::ResourceStates state = nvrhi::ResourceStates::UnorderedAccess);
+
+    // Passes with side effects (e.g. writing persistent history or readback data) are never culled.
+    void SetSideEffects();
+
+private:
+    friend class FrameGraph;
+    FrameGraphBuilder(FrameGraph& graph, uint32_t passIndex);
+
+    FrameGraph& m_graph;
+    uint32_t m_passIndex;
+};
+
+class FrameGraphResources
+{
+public:
+    [[nodiscard]] nvrhi::ITexture* GetTexture(FrameGraphTexture texture) const;
+    [[nodiscard]] nvrhi::IBuffer* GetBuffer(FrameGraphBuffer buffer) const;
+
+private:
+    friend class FrameGraph;
+    explicit FrameGraphResources(const FrameGraph& graph);
+
+    const FrameGraph& m_graph;
+};
+
+class FrameGraph
+{
+public:
+    typedef std::function<void(FrameGraphBuilder& builder)> SetupCallback;
+    typedef std::function<void(nvrhi::ICommandList* commandList, const FrameGraphResources& resources)> ExecuteCallback;
+    typedef std::function<nvrhi::MemoryRequirements(const nvrhi::TextureDesc& desc)> MemoryRequirementsCallback;
+
+    struct Statistics
+    {
+        uint32_t numPasses = 0;
+        uint32_t numCulledPasses = 0;
+        uint32_t numTransientTextures = 0;
+        uint32_t numCulledTransientTextures = 0;
+        uint32_t numBarriers = 0;
+        uint32_t numClears = 0;
+        uint32_t numSkippedClears = 0;
+        uint32_t numAliasingBarriers = 0;
+        uint64_t transientHeapSize = 0;    // bytes actually allocated with aliasing
+        uint64_t unaliasedTransientSize = 0; // bytes that would be needed without aliasing
+    };
+
+    FrameGraph() = default;
+    FrameGraph(const FrameGraph&) = delete;
+    FrameGraph& operator=(const FrameGraph&) = delete;
+
+    // Imports a persistent resource owned by the application. Its state is assumed to be 'initialState'
+    // at the beginning of the graph and is restored to 'finalState' at the end, unless that is Unknown.
+    FrameGraphTexture ImportTexture(nvrhi::ITexture* texture,
+        nvrhi::ResourceStates initialState = nvrhi::ResourceStates::Unknown,
+        nvrhi::ResourceStates finalState = nvrhi::ResourceStates::Unknown);
+    FrameGraphBuffer ImportBuffer(nvrhi::IBuffer* buffer,
+        nvrhi::ResourceStates initialState = nvrhi::ResourceStates::Unknown,
+        nvrhi::ResourceStates finalState = nvrhi::ResourceStates::Unknown);
+
+    // Declares a transient texture that only lives within this graph.
+    // Its memory is placed into the shared heap and may alias other transient textures.
+    FrameGraphTexture CreateTexture(const nvrhi::TextureDesc& desc);
+
+    // Marks a resource as a graph output: the passes that produce it are kept alive.
+    void MarkOutput(FrameGraphTexture texture);
+    void MarkOutput(FrameGraphBuffer buffer);
+
+    // Passes execute in the order in which they are added, minus the culled ones.
+    void AddPass(const char* name, const SetupCallback& setup, ExecuteCallback execute);
+
+    // Culls the unused passes, computes the transient lifetimes and heap placement, and plans the barriers.
+    // The callback provides texture memory requirements; when it's empty, they are estimated from the desc.
+    void Compile(const MemoryRequirementsCallback& memoryRequirements = nullptr);
+
+    // Records the live passes into the command list. Transient textures are taken from the pool.
+    void Execute(nvrhi::ICommandList* commandList, FrameGraphResourcePool& pool);
+
+    [[nodiscard]] const Statistics& GetStatistics() const { return m_statistics; }
+    [[nodiscard]] bool IsPassCulled(const char* name) const;
+    [[nodiscard]] bool IsTextureAllocated(FrameGraphTexture texture) const;
+    [[nodiscard]] uint64_t GetTransientTextureOffset(FrameGraphTexture texture) const;
+
+    static nvrhi::MemoryRequirements EstimateMemoryRequirements(const nvrhi::TextureDesc& desc);
+
+private:
+    friend class FrameGraphBuilder;
+    friend class FrameGraphResources;
+    friend class FrameGraphResourcePool;
+
+    enum class ResourceKind : uint8_t
+    {
+        Texture,
+        Buffer
+    };
+
+    struct Access
+    {
+        ResourceKind kind = ResourceKind::Texture;
+        uint32_t index = 0;
+        nvrhi::ResourceStates state = nvrhi::ResourceStates::Unknown;
+        bool read = false;
+        bool write = false;
+        bool fullWrite = false;
+    };
+
+    struct Barrier
+    {
+        ResourceKind kind = ResourceKind::Texture;
+        uint32_t index = 0;
+        nvrhi::ResourceStates state = nvrhi::ResourceStates::Unknown;
+        bool uavBarrier = false;
+    };
+
+    // Hands the heap range of a transient texture over from the texture that used it before
+    struct AliasingBarrier
+    {
+        uint32_t before = 0;
+        uint32_t after = 0;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        ExecuteCallback execute;
+        std::vector<Access> accesses;
+        bool sideEffects = false;
+
+        // Compiled data
+        bool culled = true;
+        std::vector<Barrier> barriers;
+        std::vector<AliasingBarrier> aliasingBarriers;
+        std::vector<uint32_t> texturesToClear;
+    };
+
+    struct TextureResource
+    {
+        nvrhi::TextureDesc desc;
+        nvrhi::ITexture* imported = nullptr;
+        nvrhi::ResourceStates initialState = nvrhi::ResourceStates::Unknown;
+        nvrhi::ResourceStates finalState = nvrhi::ResourceStates::Unknown;
+        bool output = false;
+
+        // Compiled data
+        uint32_t firstPass = ~0u;
+        uint32_t lastPass = 0;
+        uint64_t heapOffset = 0;
+        uint64_t heapSize = 0;
+        uint32_t poolSlot = ~0u;
+        nvrhi::ITexture* realized = nullptr;
+    };
+
+    struct BufferResource
+    {
+        nvrhi::IBuffer* imported = nullptr;
+        nvrhi::ResourceStates initialState = nvrhi::ResourceStates::Unknown;
+        nvrhi::ResourceStates finalState = nvrhi::ResourceStates::Unknown;
+        bool output = false;
+    };
+
+    void AddAccess(uint32_t passIndex, const Access& access);
+    void CullPasses();
+    void ComputeLifetimes();
+    void PlaceTransientTextures(const MemoryRequirementsCallback& memoryRequirements);
+    void PlanAliasingBarriers();
+    void PlanBarriers();
+
+    [[nodiscard]] bool IsTransient(uint32_t textureIndex) const { return m_textures[textureIndex].imported == nullptr; }
+
+    std::vector<Pass> m_passes;
+    std::vector<TextureResource> m_textures;
+    std::vector<BufferResource> m_buffers;
+    std::vector<Barrier> m_finalBarriers;
+    Statistics m_statistics;
+    bool m_compiled = false;
+};
+
+// Owns the heap and the placed textures that back the transient resources of frame graphs.
+// The textures are kept alive between frames and only re-created when the transient layout changes,
+// which allows passes to cache binding sets that refer to them - see GetGeneration().
+// The heap is released as soon as a graph has no transient textures, and re-created with a smaller size
+// when the graphs have needed less memory than it holds for c_HeapShrinkDelay consecutive frames.
+class FrameGraphResourcePool
+{
+public:
+    static constexpr uint32_t c_HeapShrinkDelay = 60;
+
+    explicit FrameGraphResourcePool(nvrhi::IDevice* device);
+
+    // Returns the actual memory requirements of a texture as reported by the device.
+    // Use this as the memory requirements callback for FrameGraph::Compile(...)
+    nvrhi::MemoryRequirements GetMemoryRequirements(const nvrhi::TextureDesc& desc);
+
+    // Incremented every time the placed textures are re-created.
+    [[nodiscard]] uint32_t GetGeneration() const { return m_generation; }
+    [[nodiscard]] uint64_t GetHeapSize() const { return m_heapSize; }
+
+    void Reset();
+
+private:
+    friend class FrameGraph;
+
+    struct Slot
+    {
+        nvrhi::TextureDesc desc;
+        uint64_t heapOffset = 0;
+        nvrhi::TextureHandle texture;
+    };
+
+    void Realize(FrameGraph& graph);
+
+    nvrhi::DeviceHandle m_device;
+    nvrhi::HeapHandle m_heap;
+    uint64_t m_heapSize = 0;
+    uint32_t m_oversizedFrames = 0;
+    std::vector<Slot> m_slots;
+    uint32_t m_generation = 0;
+
+    struct CachedRequirements
+    {
+        nvrhi::TextureDesc desc;
+        nvrhi::MemoryRequirements requirements;
+    };
+    std::vector<CachedRequirements> m_requirementsCache;
+};
@@ -0,0 +1,350 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "IesProfileAtlas.h"
+
+#include <donut/core/log.h>
+#include <donut/core/vfs/VFS.h>
+#include <donut/core/math/math.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <string_view>
+
+using namespace dm;
+#include "../shaders/ShaderParameters.h"
+
+// Horizontal slices that differ by less than this fraction of the peak intensity are considered the same
+static constexpr float c_SymmetryTolerance = 0.01f;
+
+static bool StartsWith(std::string_view text, std::string_view prefix)
+{
+    return text.substr(0, prefix.size()) == prefix;
+}
+
+// Linear interpolation in a table of ascending angles, returns the two indices and the weight of the second one
+static void FindInterval(const std::vector<float>& angles, float angle, size_t& index0, size_t& index1, float& weight)
+{
+    const auto upper = std::upper_bound(angles.begin(), angles.end(), angle);
+
+    if (upper == angles.begin())
+    {
+        index0 = index1 = 0;
+        weight = 0.f;
+        return;
+    }
+
+    if (upper == angles.end())
+    {
+        index0 = index1 = angles.size() - 1;
+        weight = 0.f;
+        return;
+    }
+
+    index1 = size_t(upper - angles.begin());
+    index0 = index1 - 1;
+
+    const float range = angles[index1] - angles[index0];
+    weight = (range > 0.f) ? (angle - angles[index0]) / range : 0.f;
+}
+
+bool IesProfile::Parse(const char* text, size_t size)
+{
+    const std::string_view content(text, size);
+
+    // The header is a sequence of keyword lines that ends with the TILT line
+    const size_t tiltPos = content.find("TILT=");
+    if (tiltPos == std::string_view::npos)
+        return false;
+
+    const size_t tiltEnd = content.find('\n', tiltPos);
+    if (tiltEnd == std::string_view::npos)
+        return false;
+
+    const std::string_view tilt = content.substr(tiltPos + 5, tiltEnd - tiltPos - 5);
+
+    // Everything after the TILT line is numbers separated by spaces, commas or line breaks
+    std::string numbers(content.substr(tiltEnd + 1));
+    std::replace(numbers.begin(), numbers.end(), ',', ' ');
+
+    std::vector<float> values;
+    const char* cursor = numbers.c_str();
+    while (true)
+    {
+        char* end = nullptr;
+        const float value = strtof(cursor, &end);
+        if (end == cursor)
+            break;
+
+        values.push_back(value);
+        cursor = end;
+    }
+
+    size_t next = 0;
+    if (StartsWith(tilt, "INCLUDE"))
+    {
+        // Lamp-to-luminaire geometry, number of tilt angles, the angles and the multipliers. The tilt is ignored.
+        if (values.size() < 2)
+            return false;
+
+        next = 2 + 2 * size_t(values[1]);
+    }
+    else if (!StartsWith(tilt, "NONE"))
+    {
+        donut::log::debug("IES profile %s references an external tilt file, ignoring it", name.c_str());
+    }
+
+    // Number of lamps, lumens per lamp, candela multiplier, number of vertical and horizontal angles,
+    // photometric type, units type, width, length, height, ballast factor, future use, input watts
+    constexpr size_t headerSize = 13;
+    if (values.size() < next + headerSize)
+        return false;
+
+    const float* header = values.data() + next;
+    const float multiplier = header[2];
+    const size_t verticalCount = size_t(header[3]);
+    const size_t horizontalCount = size_t(header[4]);
+    const int photometricType = int(header[5]);
+    next += headerSize;
+
+    if (verticalCount == 0 || horizontalCount == 0 || values.size() < next + verticalCount + horizontalCount + verticalCount * horizontalCount)
+        return false;
+
+    if (photometricType != 1)
+        donut::log::warning("IES profile %s is not of photometric type C, it will be interpreted as type C", name.c_str());
+
+    verticalAngles.assign(values.begin() + next, values.begin() + next + verticalCount);
+    next += verticalCount;
+    horizontalAngles.assign(values.begin() + next, values.begin() + next + horizontalCount);
+    next += horizontalCount;
+    candela.assign(values.begin() + next, values.begin() + next + verticalCount * horizontalCount);
+
+    if (!std::is_sorted(verticalAngles.begin(), verticalAngles.end()) || !std::is_sorted(horizontalAngles.begin(), horizontalAngles.end()))
+        return false;
+
+    maxCandela = 0.f;
+    for (float& value : candela)
+    {
+        value = std::max(value * multiplier, 0.f);
+        maxCandela = std::max(maxCandela, value);
+    }
+
+    if (maxCandela <= 0.f)
+        return false;
+
+    symmetric = true;
+    for (size_t h = 1; h < horizontalCount && symmetric; h++)
+    {
+        for (size_t v = 0; v < verticalCount; v++)
+        {
+            if (std::abs(candela[h * verticalCount + v] - candela[v]) > c_SymmetryTolerance * maxCandela)
+            {
+                symmetric = false;
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+float IesProfile::Evaluate(float theta, float phi) const
+{
+    if (theta < verticalAngles.front() || theta > verticalAngles.back())
+        return 0.f;
+
+    // Apply the symmetry implied by the range of horizontal angles: 0-90 is quadrant symmetric, 0-180 is bilateral
+    phi = std::fmod(phi, 360.f);
+    if (phi < 0.f)
+        phi += 360.f;
+
+    const float lastHorizontalAngle = horizontalAngles.back();
+    if (lastHorizontalAngle <= 180.f && phi > 180.f)
+        phi = 360.f - phi;
+    if (lastHorizontalAngle <= 90.f && phi > 90.f)
+        phi = 180.f - phi;
+
+    size_t v0, v1, h0, h1;
+    float vWeight, hWeight;
+    FindInterval(verticalAngles, theta, v0, v1, vWeight);
+    FindInterval(horizontalAngles, phi, h0, h1, hWeight);
+
+    const size_t verticalCount = verticalAngles.size();
+    const float slice0 = lerp(candela[h0 * verticalCount + v0], candela[h0 * verticalCount + v1], vWeight);
+    const float slice1 = lerp(candela[h1 * verticalCount + v0], candela[h1 * verticalCount + v1], vWeight);
+
+    return lerp(slice0, slice1, hWeight);
+}
+
+// The baked values keep the scale of the donut baker: candela times the multiplier from the file, not normalized.
+void IesProfile::Bake1D()
+{
+    // Texel i holds cos(theta) = 2 * i / (width - 1) - 1, see evaluateIesProfile in LightShaping.hlsli
+    bakedData.resize(IES_PROFILE_ATLAS_WIDTH);
+
+    for (uint32_t i = 0; i < IES_PROFILE_ATLAS_WIDTH; i++)
+    {
+        const float cosTheta = float(i) / float(IES_PROFILE_ATLAS_WIDTH - 1) * 2.f - 1.f;
+        const float theta = degrees(acosf(clamp(cosTheta, -1.f, 1.f)));
+
+        bakedData[i] = Evaluate(theta, 0.f);
+    }
+}
+
+void IesProfile::Bake2D()
+{
+    // The texture coordinates are theta / pi and atan2(y, x) / 2pi + 0.5, see evaluateIesProfile in LightShaping.hlsli
+    bakedData.resize(c_TextureWidth * c_TextureHeight);
+
+    for (uint32_t y = 0; y < c_TextureHeight; y++)
+    {
+        const float phi = ((float(y) + 0.5f) / float(c_TextureHeight) - 0.5f) * 360.f;
+
+        for (uint32_t x = 0; x < c_TextureWidth; x++)
+        {
+            const float theta = (float(x) + 0.5f) / float(c_TextureWidth) * 180.f;
+
+            bakedData[y * c_TextureWidth + x] = Evaluate(theta, phi);
+        }
+    }
+}
+
+IesProfileAtlas::IesProfileAtlas(nvrhi::IDevice* device, std::shared_ptr<donut::engine::DescriptorTableManager> descriptorTable)
+    : m_device(device)
+    , m_descriptorTable(std::move(descriptorTable))
+{
+}
+
+std::shared_ptr<IesProfile> IesProfileAtlas::LoadProfile(donut::vfs::IFileSystem& fs, const std::filesystem::path& path)
+{
+    std::shared_ptr<donut::vfs::IBlob> data = fs.readFile(path);
+    if (!data)
+    {
+        donut::log::warning("Couldn't read IES profile %s", path.generic_string().c_str());
+        return nullptr;
+    }
+
+    auto profile = std::make_shared<IesProfile>();
+    profile->name = path.filename().generic_string();
+
+    if (!profile->Parse(static_cast<const char*>(data->data()), data->size()))
+    {
+        donut::log::warning("Couldn't parse IES profile %s", path.generic_string().c_str());
+        return nullptr;
+    }
+
+    if (profile->symmetric)
+        profile->Bake1D();
+    else
+        profile->Bake2D();
+
+    return profile;
+}
+
+void IesProfileAtlas::SetProfiles(std::vector<std::shared_ptr<IesProfile>> profiles)
+{
+    m_profiles = std::move(profiles);
+    m_textures.clear();
+    m_descriptors.clear();
+    m_atlasRowCount = 0;
+    m_uploaded = false;
+
+    for (const auto& profile : m_profiles)
+    {
+        if (!profile->symmetric)
+            continue;
+
+        if (m_atlasRowCount < IES_PROFILE_ATLAS_ROWS)
+        {
+            profile->atlasRow = int(m_atlasRowCount++);
+            continue;
+        }
+
+        // The atlas is full, use a 2D texture
+        profile->symmetric = false;
+        profile->Bake2D();
+    }
+}
+
+void IesProfileAtlas::Upload(nvrhi::ICommandList* commandList)
+{
+    if (m_uploaded)
+        return;
+
+    m_uploaded = true;
+
+    nvrhi::TextureDesc textureDesc;
+    textureDesc.format = nvrhi::Format::R32_FLOAT;
+    textureDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    textureDesc.keepInitialState = true;
+
+    if (m_atlasRowCount != 0)
+    {
+        textureDesc.width = IES_PROFILE_ATLAS_WIDTH;
+        textureDesc.height = IES_PROFILE_ATLAS_ROWS;
+        textureDesc.debugName = "IesProfileAtlas";
+        nvrhi::TextureHandle atlas = m_device->createTexture(textureDesc);
+
+        donut::engine::DescriptorHandle descriptor = m_descriptorTable->CreateDescriptorHandle(nvrhi::BindingSetItem::Texture_SRV(0, atlas));
+        const int atlasIndex = descriptor.Get();
+        assert(uint32_t(atlasIndex) <= kIesProfileAtlasIndexMask);
+
+        std::vector<float> atlasData(IES_PROFILE_ATLAS_WIDTH * IES_PROFILE_ATLAS_ROWS, 0.f);
+
+        for (const auto& profile : m_profiles)
+        {
+            if (!profile->symmetric)
+                continue;
+
+            std::copy(profile->bakedData.begin(), profile->bakedData.end(), atlasData.begin() + profile->atlasRow * IES_PROFILE_ATLAS_WIDTH);
+            profile->shaderIndex = int(kIesProfileSymmetricBit | (uint32_t(profile->atlasRow) << kIesProfileAtlasRowShift) | uint32_t(atlasIndex));
+        }
+
+        commandList->writeTexture(atlas, 0, 0, atlasData.data(), IES_PROFILE_ATLAS_WIDTH * sizeof(float));
+
+        m_textures.push_back(atlas);
+        m_descriptors.push_back(std::move(descriptor));
+    }
+
+    textureDesc.width = IesProfile::c_TextureWidth;
+    textureDesc.height = IesProfile::c_TextureHeight;
+
+    for (const auto& profile : m_profiles)
+    {
+        if (profile->symmetric)
+            continue;
+
+        textureDesc.debugName = profile->name;
+        nvrhi::TextureHandle texture = m_device->createTexture(textureDesc);
+
+        donut::engine::DescriptorHandle descriptor = m_descriptorTable->CreateDescriptorHandle(nvrhi::BindingSetItem::Texture_SRV(0, texture));
+        profile->shaderIndex = descriptor.Get();
+
+        commandList->writeTexture(texture, 0, 0, profile->bakedData.data(), IesProfile::c_TextureWidth * sizeof(float));
+
+        m_textures.push_back(texture);
+        m_descriptors.push_back(std::move(descriptor));
+    }
+
+    donut::log::info("Uploaded %d IES profiles, %u of them in the symmetric profile atlas", int(m_profiles.size()), m_atlasRowCount);
+}
+
+const IesProfile* IesProfileAtlas::FindProfile(const std::string& name) const
+{
+    for (const auto& profile : m_profiles)
+    {
+        if (profile->name == name)
+            return profile.get();
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,91 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <donut/engine/DescriptorTableManager.h>
+#include <nvrhi/nvrhi.h>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace donut::vfs
+{
+    class IFileSystem;
+}
+
+// A photometric profile in the IES LM-63 format, parsed and baked on the CPU.
+// The baked intensities are in candela, including the candela multiplier of the file.
+struct IesProfile
+{
+    std::string name;
+
+    // Angles in degrees. The vertical angles are measured from the light axis.
+    std::vector<float> verticalAngles;
+    std::vector<float> horizontalAngles;
+    std::vector<float> candela; // [horizontal][vertical]
+    float maxCandela = 0.f; // used for the symmetry tolerance, the baked data is not normalized
+
+    // All horizontal slices are the same, so the profile only depends on the angle to the light axis
+    bool symmetric = false;
+
+    // IES_PROFILE_ATLAS_WIDTH values indexed by the cosine for symmetric profiles,
+    // c_TextureWidth x c_TextureHeight values indexed by (theta, phi) otherwise
+    std::vector<float> bakedData;
+
+    int atlasRow = -1; // assigned by IesProfileAtlas::SetProfiles
+
+    // Value of PolymorphicLightInfo::iesProfileIndex, valid after IesProfileAtlas::Upload
+    int shaderIndex = -1;
+
+    // Parses the profile, returns false if it's not a valid LM-63 file.
+    bool Parse(const char* text, size_t size);
+
+    // Interpolates the candela table, the angles are in degrees.
+    [[nodiscard]] float Evaluate(float theta, float phi) const;
+
+    void Bake1D();
+    void Bake2D();
+
+    static constexpr uint32_t c_TextureWidth = 256;  // theta
+    static constexpr uint32_t c_TextureHeight = 128; // phi
+};
+
+// Owns the GPU copies of the IES profiles. The rotationally symmetric profiles share one texture,
+// the profile atlas, where each of them is a row indexed by the cosine of the angle to the light axis.
+// The other profiles get a 2D texture each, indexed by the spherical angles like before.
+class IesProfileAtlas
+{
+public:
+    IesProfileAtlas(nvrhi::IDevice* device, std::shared_ptr<donut::engine::DescriptorTableManager> descriptorTable);
+
+    // Reads, parses and bakes one profile. Thread safe, returns nullptr on failure.
+    static std::shared_ptr<IesProfile> LoadProfile(donut::vfs::IFileSystem& fs, const std::filesystem::path& path);
+
+    // Takes the loaded profiles, assigns the atlas rows and bakes the symmetric profiles that don't fit as 2D.
+    void SetProfiles(std::vector<std::shared_ptr<IesProfile>> profiles);
+
+    // Creates the textures and writes the baked profiles. Only does anything on the first call after SetProfiles.
+    void Upload(nvrhi::ICommandList* commandList);
+
+    [[nodiscard]] const std::vector<std::shared_ptr<IesProfile>>& GetProfiles() const { return m_profiles; }
+    [[nodiscard]] const IesProfile* FindProfile(const std::string& name) const;
+
+private:
+    nvrhi::DeviceHandle m_device;
+    std::shared_ptr<donut::engine::DescriptorTableManager> m_descriptorTable;
+
+    std::vector<std::shared_ptr<IesProfile>> m_profiles;
+    std::vector<nvrhi::TextureHandle> m_textures;
+    std::vector<donut::engine::DescriptorHandle> m_descriptors;
+    uint32_t m_atlasRowCount = 0;
+    bool m_uploaded = false;
+};
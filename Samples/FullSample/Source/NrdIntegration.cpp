@@ -362,8 +362,9 @@ void NrdIntegration::RunDenoiserPasses(
     commonSettings.rectSize[0] = view.GetViewExtent().width();
     commonSettings.rectSize[1] = view.GetViewExtent().height();
 
-    commonSettings.rectSizePrev[0] = commonSettings.rectSize[0];
-    commonSettings.rectSizePrev[1] = commonSettings.rectSize[1];
+    // The render viewport may change every frame with dynamic resolution scaling
+    commonSettings.rectSizePrev[0] = viewPrev.GetViewExtent().width();
+    commonSettings.rectSizePrev[1] = viewPrev.GetViewExtent().height();
 
     commonSettings.rectOrigin[0] = 0;
     commonSettings.rectOrigin[1] = 0;
@@ -11,10 +11,16 @@
 #include "Profiler.h"
 #include <donut/app/DeviceManager.h>
 #include <imgui.h>
+#include <json/value.h>
+#include <algorithm>
 #include <sstream>
 
 #include "RenderTargets.h"
 
+#include <donut/core/math/math.h>
+
+using namespace dm;
+#include "../shaders/ShaderParameters.h"
 
 static const char* g_SectionNames[ProfilerSection::Count] = {
     "TLAS Update",
@@ -29,16 +35,21 @@ static const char* g_SectionNames[ProfilerSection::Count] = {
     "Temporal Resampling",
     "Spatial Resampling",
     "Shade Primary Surf.",
+    "BRDF Ray Binning",
     "BRDF or MIS Rays",
+    "BRDF Ray Hit Shading",
     "Shade Secondary Surf.",
     "GI - Temporal Resampling",
     "GI - Spatial Resampling",
     "GI - Fused Resampling",
     "GI - Final Shading",
+    "GI - Upsampling",
     "Gradients",
     "Denoising",
     "Glass",
     "TAA or DLSS",
+    "Light Prep. (Total)",
+    "G-Buffer + Light Prep.",
     "Frame Time (GPU)",
     "(Material Readback)"
 };
@@ -51,7 +62,7 @@ Profiler::Profiler(donut::app::DeviceManager& deviceManager)
         query = m_device->createTimerQuery();
 
     nvrhi::BufferDesc rayCountBufferDesc;
-    rayCountBufferDesc.byteSize = sizeof(uint32_t) * 2 * ProfilerSection::Count;
+    rayCountBufferDesc.byteSize = sizeof(uint32_t) * RAY_COUNT_STRIDE * ProfilerSection::Count;
     rayCountBufferDesc.format = nvrhi::Format::R32_UINT;
     rayCountBufferDesc.canHaveUAVs = true;
     rayCountBufferDesc.canHaveTypedViews = true;
@@ -87,14 +98,23 @@ void Profiler::EnableAccumulation(bool enable)
 
 void Profiler::ResetAccumulation()
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
     m_accumulatedFrames = 0;
     m_timerValues.fill(0.0);
     m_rayCounts.fill(0);
     m_hitCounts.fill(0);
+    m_savedRayCounts.fill(0);
+    m_recordingTime = 0.0;
+    m_recordingFrames = 0;
+    m_gbufferRecordingTime = 0.0;
+    m_gbufferRecordingFrames = 0;
 }
 
 void Profiler::ResolvePreviousFrame()
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
     m_activeBank = !m_activeBank;
 
     if (!m_enabled)
@@ -107,6 +127,7 @@ void Profiler::ResolvePreviousFrame()
         double time = 0;
         uint32_t rayCount = 0;
         uint32_t hitCount = 0;
+        uint32_t savedRayCount = 0;
 
         uint32_t timerIndex = section + m_activeBank * ProfilerSection::Count;
         
@@ -117,8 +138,9 @@ void Profiler::ResolvePreviousFrame()
 
             if (rayCountData)
             {
-                rayCount = rayCountData[section * 2];
-                hitCount = rayCountData[section * 2 + 1];
+                rayCount = rayCountData[RAY_COUNT_TRACED(section)];
+                hitCount = rayCountData[RAY_COUNT_HITS(section)];
+                savedRayCount = rayCountData[RAY_COUNT_SAVED(section)];
             }
         }
 
@@ -129,17 +151,19 @@ void Profiler::ResolvePreviousFrame()
             m_timerValues[section] += time;
             m_rayCounts[section] += rayCount;
             m_hitCounts[section] += hitCount;
+            m_savedRayCounts[section] += savedRayCount;
         }
         else
         {
             m_timerValues[section] = time;
             m_rayCounts[section] = rayCount;
             m_hitCounts[section] = hitCount;
+            m_savedRayCounts[section] = savedRayCount;
         }
     }
 
     if (rayCountData)
-        m_rayCounts[ProfilerSection::MaterialReadback] = rayCountData[ProfilerSection::MaterialReadback * 2];
+        m_rayCounts[ProfilerSection::MaterialReadback] = rayCountData[RAY_COUNT_TRACED(ProfilerSection::MaterialReadback)];
     else
         m_rayCounts[ProfilerSection::MaterialReadback] = 0;
 
@@ -175,7 +199,7 @@ void Profiler::EndFrame(nvrhi::ICommandList* commandList)
             0,
             m_rayCountBuffer,
             0,
-            ProfilerSection::Count * sizeof(uint32_t) * 2);
+            ProfilerSection::Count * sizeof(uint32_t) * RAY_COUNT_STRIDE);
     }
 }
 
@@ -186,6 +210,8 @@ void Profiler::BeginSection(nvrhi::ICommandList* commandList, const ProfilerSect
 
     uint32_t timerIndex = section + m_activeBank * ProfilerSection::Count;
     commandList->beginTimerQuery(m_timerQueries[timerIndex]);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
     m_timersUsed[timerIndex] = true;
 }
 
@@ -203,6 +229,54 @@ void Profiler::SetRenderTargets(const std::shared_ptr<RenderTargets>& renderTarg
     m_renderTargets = renderTargets;
 }
 
+void Profiler::AccumulateCpuTime(double& time, uint32_t& frames, double milliseconds) const
+{
+    // CPU time is known immediately, so it's accumulated separately from the GPU timers that lag by a frame
+    if (m_isAccumulating)
+    {
+        time += milliseconds;
+        frames += 1;
+    }
+    else
+    {
+        time = milliseconds;
+        frames = 1;
+    }
+}
+
+void Profiler::SetRecordingTime(double milliseconds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    AccumulateCpuTime(m_recordingTime, m_recordingFrames, milliseconds);
+}
+
+void Profiler::SetGBufferRecordingTime(double milliseconds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    AccumulateCpuTime(m_gbufferRecordingTime, m_gbufferRecordingFrames, milliseconds);
+}
+
+void Profiler::SetCompactGBufferSurfaces(bool enabled)
+{
+    m_compactGBufferSurfaces = enabled;
+}
+
+double Profiler::GetRecordingTime()
+{
+    if (m_recordingFrames == 0)
+        return 0.0;
+
+    return m_recordingTime / double(m_recordingFrames);
+}
+
+double Profiler::GetGBufferRecordingTime()
+{
+    if (m_gbufferRecordingFrames == 0)
+        return 0.0;
+
+    return m_gbufferRecordingTime / double(m_gbufferRecordingFrames);
+}
+
 double Profiler::GetTimer(ProfilerSection::Enum section)
 {
     if (m_accumulatedFrames == 0)
@@ -227,6 +301,29 @@ double Profiler::GetHitCount(ProfilerSection::Enum section)
     return double(m_hitCounts[section]) / double(m_accumulatedFrames);
 }
 
+double Profiler::GetSavedRayCount(ProfilerSection::Enum section)
+{
+    if (m_accumulatedFrames == 0)
+        return 0.0;
+
+    return double(m_savedRayCounts[section]) / double(m_accumulatedFrames);
+}
+
+double Profiler::GetLightPreparationOverlap()
+{
+    // The light preparation chain may run on the compute queue, concurrently with the G-buffer fill.
+    // The graphics queue time between the end of the frame setup and the start of lighting covers both,
+    // so whatever the sum of their times exceeds that span by is the overlap achieved.
+    const double lightPreparation = GetTimer(ProfilerSection::LightPreparation);
+    const double gbufferFill = GetTimer(ProfilerSection::GBufferFill);
+    const double span = GetTimer(ProfilerSection::GBufferAndLightPreparation);
+
+    if (lightPreparation == 0.0 || span == 0.0)
+        return 0.0;
+
+    return std::max(0.0, lightPreparation + gbufferFill - span);
+}
+
 int Profiler::GetMaterialReadback()
 {
     return int(m_rayCounts[ProfilerSection::MaterialReadback]) - 1;
@@ -257,6 +354,7 @@ void Profiler::BuildUI(const bool enableRayCounts)
     {
         if (section == ProfilerSection::InitialSamples ||
             section == ProfilerSection::Gradients || 
+            section == ProfilerSection::LightPreparation ||
             section == ProfilerSection::Frame)
             ImGui::Separator();
 
@@ -300,6 +398,25 @@ void Profiler::BuildUI(const bool enableRayCounts)
     }
 
     ImGui::EndTable();
+
+    // Rays skipped by the visibility cache, in the same units as the RPP column
+    if (enableRayCounts)
+    {
+        for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+        {
+            const double savedRayCount = GetSavedRayCount(ProfilerSection::Enum(section));
+            if (savedRayCount != 0.0)
+                ImGui::Text("%s: %.3f RPP saved by caching", g_SectionNames[section], savedRayCount / renderPixels);
+        }
+    }
+
+    const double overlap = GetLightPreparationOverlap();
+    if (overlap > 0.0)
+        ImGui::Text("Light Prep. Overlap: %.3f ms (%.0f%%)", overlap, 100.0 * overlap / GetTimer(ProfilerSection::LightPreparation));
+
+    ImGui::Text("Command Recording (CPU): %.3f ms", GetRecordingTime());
+    ImGui::Text("G-Buffer Recording (CPU): %.3f ms", GetGBufferRecordingTime());
+    ImGui::Text("G-Buffer Surfaces: %s", m_compactGBufferSurfaces ? "compact buffer" : "textures");
 }
 
 std::string Profiler::GetAsText()
@@ -341,15 +458,81 @@ std::string Profiler::GetAsText()
             text.precision(3);
             text << " (" << std::fixed << raysPerPixel << " rpp, ";
             text.precision(0);
-            text << hitPercentage << "% hits)";
+            text << hitPercentage << "% hits";
+
+            const double savedRayCount = GetSavedRayCount(ProfilerSection::Enum(section));
+            if (savedRayCount != 0.0)
+            {
+                text.precision(3);
+                text << ", " << std::fixed << savedRayCount / renderPixels << " rpp saved";
+            }
+
+            text << ")";
         }
 
         text << std::endl;
     }
 
+    const double overlap = GetLightPreparationOverlap();
+    if (overlap > 0.0)
+    {
+        text.precision(3);
+        text << "Light Prep. Overlap: " << std::fixed << overlap << " ms" << std::endl;
+    }
+
+    text.precision(3);
+    text << "Command Recording (CPU): " << std::fixed << GetRecordingTime() << " ms" << std::endl;
+    text << "G-Buffer Recording (CPU): " << std::fixed << GetGBufferRecordingTime() << " ms" << std::endl;
+
+    // The surface layout the resampling timings above were measured with
+    text << "G-Buffer Surfaces: " << (m_compactGBufferSurfaces ? "compact buffer" : "textures") << std::endl;
+
     return text.str();
 }
 
+// Same contents as GetAsText, with the section names as keys, for the benchmark scripts.
+Json::Value Profiler::GetAsJson()
+{
+    Json::Value root(Json::objectValue);
+
+    auto renderTargets = m_renderTargets.lock();
+    if (!renderTargets)
+        return root;
+
+    const int renderPixels = renderTargets->Size.x * renderTargets->Size.y;
+
+    root["renderer"] = m_deviceManager.GetRendererString();
+    root["width"] = renderTargets->Size.x;
+    root["height"] = renderTargets->Size.y;
+
+    Json::Value& sections = root["sections"] = Json::Value(Json::objectValue);
+    for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+    {
+        const double time = GetTimer(ProfilerSection::Enum(section));
+        const double rayCount = GetRayCount(ProfilerSection::Enum(section));
+
+        if (time == 0.0 && rayCount == 0.0)
+            continue;
+
+        Json::Value& node = sections[g_SectionNames[section]];
+        node["timeMs"] = time;
+
+        if (rayCount != 0.0)
+        {
+            node["raysPerPixel"] = rayCount / renderPixels;
+            node["hitsPerPixel"] = GetHitCount(ProfilerSection::Enum(section)) / renderPixels;
+            node["savedRaysPerPixel"] = GetSavedRayCount(ProfilerSection::Enum(section)) / renderPixels;
+        }
+    }
+
+    root["lightPreparationOverlapMs"] = GetLightPreparationOverlap();
+    root["commandRecordingMs"] = GetRecordingTime();
+    root["gbufferRecordingMs"] = GetGBufferRecordingTime();
+    root["compactGBufferSurfaces"] = m_compactGBufferSurfaces;
+
+    return root;
+}
+
 nvrhi::IBuffer* Profiler::GetRayCountBuffer() const
 {
     return m_rayCountBuffer;
@@ -13,11 +13,17 @@
 #include <nvrhi/nvrhi.h>
 #include <array>
 #include <memory>
+#include <mutex>
 
 #include "ProfilerSections.h"
 
 class RenderTargets;
 
+namespace Json
+{
+    class Value;
+}
+
 namespace donut::app
 {
     class DeviceManager;
@@ -38,18 +44,28 @@ public:
     void BeginSection(nvrhi::ICommandList* commandList, ProfilerSection::Enum section);
     void EndSection(nvrhi::ICommandList* commandList, ProfilerSection::Enum section);
     void SetRenderTargets(const std::shared_ptr<RenderTargets>& renderTargets);
+    void SetRecordingTime(double milliseconds);
+    void SetGBufferRecordingTime(double milliseconds);
+    void SetCompactGBufferSurfaces(bool enabled);
 
     double GetTimer(ProfilerSection::Enum section);
     double GetRayCount(ProfilerSection::Enum section);
     double GetHitCount(ProfilerSection::Enum section);
+    double GetSavedRayCount(ProfilerSection::Enum section);
+    double GetRecordingTime();
+    double GetGBufferRecordingTime();
+    double GetLightPreparationOverlap();
     int GetMaterialReadback();
 
     void BuildUI(bool enableRayCounts);
     std::string GetAsText();
+    Json::Value GetAsJson();
 
     [[nodiscard]] nvrhi::IBuffer* GetRayCountBuffer() const;
 
 private:
+    void AccumulateCpuTime(double& time, uint32_t& frames, double milliseconds) const;
+
     bool m_enabled = true;
     bool m_isAccumulating = false;
     uint32_t m_accumulatedFrames = 0;
@@ -59,7 +75,15 @@ private:
     std::array<double, ProfilerSection::Count> m_timerValues{};
     std::array<size_t, ProfilerSection::Count> m_rayCounts{};
     std::array<size_t, ProfilerSection::Count> m_hitCounts{};
+    std::array<size_t, ProfilerSection::Count> m_savedRayCounts{};
+    // Guards m_timersUsed and the CPU timings, which are written by the command list segments recorded in parallel
+    std::mutex m_mutex;
     std::array<bool, ProfilerSection::Count * 2> m_timersUsed{};
+    double m_recordingTime = 0.0;
+    uint32_t m_recordingFrames = 0;
+    double m_gbufferRecordingTime = 0.0;
+    uint32_t m_gbufferRecordingFrames = 0;
+    bool m_compactGBufferSurfaces = false;
 
     donut::app::DeviceManager& m_deviceManager;
     nvrhi::DeviceHandle m_device;
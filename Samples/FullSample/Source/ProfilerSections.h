@@ -26,16 +26,21 @@ struct ProfilerSection
         TemporalResampling,
         SpatialResampling,
         Shading,
+        BrdfRayBinning,
         BrdfRays,
+        BrdfRayHitShading,
         ShadeSecondary,
         GITemporalResampling,
         GISpatialResampling,
         GIFusedResampling,
         GIFinalShading,
+        GIUpsampling,
         Gradients,
         Denoising,
         Glass,
         Resolve,
+        LightPreparation,
+        GBufferAndLightPreparation,
         Frame,
 
         // Not really a section, just using a slot in the count buffer
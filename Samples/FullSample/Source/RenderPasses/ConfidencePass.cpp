@@ -38,6 +38,7 @@ ConfidencePass::ConfidencePass(
         nvrhi::BindingLayoutItem::Texture_SRV(3),
         nvrhi::BindingLayoutItem::Texture_UAV(0),
         nvrhi::BindingLayoutItem::Texture_UAV(1),
+        nvrhi::BindingLayoutItem::Texture_UAV(2),
         nvrhi::BindingLayoutItem::Sampler(0),
         nvrhi::BindingLayoutItem::PushConstants(0, sizeof(ConfidenceConstants))
     };
@@ -77,6 +78,7 @@ void ConfidencePass::CreateBindingSet(const RenderTargets& renderTargets)
             nvrhi::BindingSetItem::Texture_SRV(3, currentFrame ? renderTargets.PrevSpecularConfidence : renderTargets.SpecularConfidence),
             nvrhi::BindingSetItem::Texture_UAV(0, currentFrame ? renderTargets.DiffuseConfidence : renderTargets.PrevDiffuseConfidence),
             nvrhi::BindingSetItem::Texture_UAV(1, currentFrame ? renderTargets.SpecularConfidence : renderTargets.PrevSpecularConfidence),
+            nvrhi::BindingSetItem::Texture_UAV(2, renderTargets.ConfidenceTiles),
             nvrhi::BindingSetItem::Sampler(0, m_sampler),
             nvrhi::BindingSetItem::PushConstants(0, sizeof(ConfidenceConstants))
         };
@@ -94,6 +96,7 @@ void ConfidencePass::CreateBindingSet(const RenderTargets& renderTargets)
 void ConfidencePass::Render(
     nvrhi::ICommandList* commandList, 
     const donut::engine::IView& view,
+    const donut::engine::IView& previousView,
     float logDarknessBias,
     float sensitivity,
     float historyLength,
@@ -112,6 +115,7 @@ void ConfidencePass::Render(
     constants.checkerboard = checkerboard;
     constants.blendFactor = 1.f / (historyLength + 1.f);
     constants.inputBufferIndex = FilterGradientsPass::GetOutputBufferIndex();
+    constants.prevViewportSize = dm::uint2(previousView.GetViewExtent().width(), previousView.GetViewExtent().height());
 
     nvrhi::ComputeState state;
     state.bindings = { m_bindingSet };
@@ -121,8 +125,8 @@ void ConfidencePass::Render(
     commandList->setPushConstants(&constants, sizeof(constants));
     
     commandList->dispatch(
-        dm::div_ceil(view.GetViewExtent().width(), 8), 
-        dm::div_ceil(view.GetViewExtent().height(), 8), 
+        dm::div_ceil(view.GetViewExtent().width(), CONFIDENCE_TILE_SIZE), 
+        dm::div_ceil(view.GetViewExtent().height(), CONFIDENCE_TILE_SIZE), 
         1);
 
     commandList->endMarker();
@@ -16,13 +16,16 @@
 #include <donut/core/log.h>
 #include <nvrhi/utils.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
 using namespace donut::math;
 #include "../../shaders/ShaderParameters.h"
 
 using namespace donut::engine;
 
-static const int c_NumFilterPasses = 4;
-
 FilterGradientsPass::FilterGradientsPass(
     nvrhi::IDevice* device,
     std::shared_ptr<ShaderFactory> shaderFactory)
@@ -81,25 +84,204 @@ void FilterGradientsPass::Render(
     state.bindings = { m_bindingSet };
     state.pipeline = m_computePipeline;
     commandList->setComputeState(state);
+    commandList->setPushConstants(&constants, sizeof(constants));
+
+    // All filter passes run in one dispatch, see FilterGradientsPass.hlsl.
+    // Tiles past the end of the gradients texture would produce no output, so skip them.
+    const auto& gradientsDesc = m_gradientsTexture->getDesc();
+    commandList->dispatch(
+        dm::div_ceil(std::min(constants.viewportSize.x, gradientsDesc.width), RTXDI_GRAD_FILTER_TILE_SIZE),
+        dm::div_ceil(std::min(constants.viewportSize.y, gradientsDesc.height), RTXDI_GRAD_FILTER_TILE_SIZE),
+        1);
+
+    nvrhi::utils::TextureUavBarrier(commandList, m_gradientsTexture);
+    commandList->commitBarriers();
+
+    commandList->endMarker();
+
+    m_lastViewportSize = constants.viewportSize;
+    m_lastCheckerboard = checkerboard;
+}
+
+int FilterGradientsPass::GetOutputBufferIndex()
+{
+    return RTXDI_GRAD_OUTPUT_LAYER;
+}
+
+static float Fp16ToFp32(uint16_t value)
+{
+    const uint32_t sign = uint32_t(value & 0x8000) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1f;
+    const uint32_t mantissa = value & 0x3ff;
 
-    for (int passIndex = 0; passIndex < c_NumFilterPasses; passIndex++)
+    float magnitude;
+    if (exponent == 0)
+        magnitude = ldexpf(float(mantissa), -24); // zero or denormal
+    else if (exponent == 0x1f)
+        magnitude = mantissa ? NAN : INFINITY;
+    else
+        magnitude = ldexpf(float(mantissa | 0x400), int(exponent) - 25);
+
+    uint32_t bits;
+    memcpy(&bits, &magnitude, sizeof(bits));
+    bits |= sign;
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// CPU version of the filter, applied one pass at a time like the original multi-pass implementation:
+// every pass reads the previous pass output through the texture, where positions outside of the texture read as zero
+// and positions outside of the viewport are skipped. Works on a single-layer image of textureSize pixels.
+static std::vector<float4> FilterGradientsReference(const std::vector<float4>& input, int2 textureSize, int2 viewportSize, bool checkerboard)
+{
+    const int2 outputSize = min(textureSize, viewportSize);
+
+    std::vector<float4> source = input;
+    std::vector<float4> destination = input;
+
+    for (int passIndex = 0; passIndex < RTXDI_GRAD_FILTER_PASSES; passIndex++)
     {
-        constants.passIndex = passIndex;
-        commandList->setPushConstants(&constants, sizeof(constants));
+        int2 step = int2(1 << passIndex, 1 << passIndex);
+        if (checkerboard)
+            step.x >>= 1;
 
-        commandList->dispatch(
-            dm::div_ceil(view.GetViewExtent().width(), 8),
-            dm::div_ceil(view.GetViewExtent().height(), 8),
-            1);
+        for (int y = 0; y < outputSize.y; y++)
+        {
+            for (int x = 0; x < outputSize.x; x++)
+            {
+                float4 acc = float4::zero();
+                float wSum = 0.f;
 
-        nvrhi::utils::TextureUavBarrier(commandList, m_gradientsTexture);
-        commandList->commitBarriers();
+                for (int yy = -1; yy <= 1; ++yy)
+                {
+                    for (int xx = -1; xx <= 1; ++xx)
+                    {
+                        const int2 pos = int2(x, y) + int2(xx, yy) * step;
+                        if (pos.x < 0 || pos.y < 0 || pos.x >= viewportSize.x || pos.y >= viewportSize.y)
+                            continue;
+
+                        const float w = (xx == 0 ? 1.f : 0.5f) * (yy == 0 ? 1.f : 0.5f);
+
+                        if (pos.x < textureSize.x && pos.y < textureSize.y)
+                            acc += source[pos.y * textureSize.x + pos.x] * w;
+                        wSum += w;
+                    }
+                }
+
+                destination[y * textureSize.x + x] = acc / wSum;
+            }
+        }
+
+        std::swap(source, destination);
     }
 
-    commandList->endMarker();
+    return source;
 }
 
-int FilterGradientsPass::GetOutputBufferIndex()
+bool FilterGradientsPass::ValidateAgainstReference()
 {
-    return c_NumFilterPasses & 1;
+    if (!m_gradientsTexture || m_lastViewportSize.x == 0)
+    {
+        donut::log::warning("Gradient filter validation skipped: the filter hasn't run yet.");
+        return false;
+    }
+
+    // Read back both layers of the gradients texture: the filter leaves its input intact.
+    const nvrhi::TextureDesc& desc = m_gradientsTexture->getDesc();
+    const int2 textureSize = int2(int(desc.width), int(desc.height));
+
+    nvrhi::StagingTextureHandle stagingTexture = m_device->createStagingTexture(desc, nvrhi::CpuAccessMode::Read);
+
+    nvrhi::CommandListHandle commandList = m_device->createCommandList();
+    commandList->open();
+    for (uint32_t layer = 0; layer < desc.arraySize; layer++)
+    {
+        const nvrhi::TextureSlice slice = nvrhi::TextureSlice().setArraySlice(layer);
+        commandList->copyTexture(stagingTexture, slice, m_gradientsTexture, slice);
+    }
+    commandList->close();
+    m_device->executeCommandList(commandList);
+    m_device->waitForIdle();
+
+    auto readLayer = [&](uint32_t layer, std::vector<float4>& pixels)
+    {
+        const nvrhi::TextureSlice slice = nvrhi::TextureSlice().setArraySlice(layer);
+
+        size_t rowPitch = 0;
+        const uint8_t* data = static_cast<const uint8_t*>(m_device->mapStagingTexture(stagingTexture, slice, nvrhi::CpuAccessMode::Read, &rowPitch));
+        if (!data)
+            return false;
+
+        pixels.resize(size_t(textureSize.x) * textureSize.y);
+        for (int y = 0; y < textureSize.y; y++)
+        {
+            const uint16_t* row = reinterpret_cast<const uint16_t*>(data + y * rowPitch);
+            for (int x = 0; x < textureSize.x; x++)
+            {
+                pixels[y * textureSize.x + x] = float4(
+                    Fp16ToFp32(row[x * 4 + 0]), Fp16ToFp32(row[x * 4 + 1]),
+                    Fp16ToFp32(row[x * 4 + 2]), Fp16ToFp32(row[x * 4 + 3]));
+            }
+        }
+
+        m_device->unmapStagingTexture(stagingTexture);
+        return true;
+    };
+
+    std::vector<float4> input;
+    std::vector<float4> output;
+    if (!readLayer(RTXDI_GRAD_INPUT_LAYER, input) || !readLayer(RTXDI_GRAD_OUTPUT_LAYER, output))
+    {
+        donut::log::error("Couldn't map the gradients readback texture.");
+        return false;
+    }
+
+    const std::vector<float4> reference = FilterGradientsReference(input, textureSize, int2(m_lastViewportSize), m_lastCheckerboard);
+
+    // The shader rounds to FP16 after every pass and the reference doesn't, so allow a few FP16 ULPs of difference per pass.
+    // The gradients are stored premultiplied by RTXDI_GRAD_STORAGE_SCALE, so errors below 1 are measured as absolute.
+    const float tolerance = 4e-3f;
+
+    const int2 outputSize = min(textureSize, int2(m_lastViewportSize));
+    float maxError = 0.f;
+    int2 maxErrorPos = int2::zero();
+    int failedPixels = 0;
+
+    for (int y = 0; y < outputSize.y; y++)
+    {
+        for (int x = 0; x < outputSize.x; x++)
+        {
+            const float4 expected = reference[y * textureSize.x + x];
+            const float4 actual = output[y * textureSize.x + x];
+
+            float pixelError = 0.f;
+            for (int channel = 0; channel < 4; channel++)
+            {
+                const float error = fabsf(actual[channel] - expected[channel]) / std::max(fabsf(expected[channel]), 1.f);
+                pixelError = std::max(pixelError, error);
+            }
+
+            if (pixelError > tolerance)
+                failedPixels++;
+
+            if (pixelError > maxError)
+            {
+                maxError = pixelError;
+                maxErrorPos = int2(x, y);
+            }
+        }
+    }
+
+    if (failedPixels > 0)
+    {
+        donut::log::warning("Gradient filter validation FAILED: %d of %d pixels differ from the CPU reference, "
+            "max relative error %f at (%d, %d).", failedPixels, outputSize.x * outputSize.y, maxError, maxErrorPos.x, maxErrorPos.y);
+        return false;
+    }
+
+    donut::log::info("Gradient filter validation passed: %dx%d pixels match the CPU reference, max relative error %f.",
+        outputSize.x, outputSize.y, maxError);
+    return true;
 }
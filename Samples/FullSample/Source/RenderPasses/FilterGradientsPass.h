@@ -13,6 +13,8 @@
 #include <nvrhi/nvrhi.h>
 #include <memory>
 
+#include <donut/core/math/math.h>
+
 namespace donut::engine
 {
     class ShaderFactory;
@@ -39,6 +41,11 @@ public:
 
     static int GetOutputBufferIndex();
 
+    // Reads back the gradients texture, runs the filter on its input layer on the CPU and compares
+    // the result with the filtered layer. Call after the frame that ran Render(...) has been submitted.
+    // Stalls the GPU, so it's only meant for debugging and testing.
+    bool ValidateAgainstReference();
+
 private:
     nvrhi::DeviceHandle m_device;
 
@@ -47,6 +54,8 @@ private:
     nvrhi::BindingLayoutHandle m_bindingLayout;
     nvrhi::BindingSetHandle m_bindingSet;
     nvrhi::TextureHandle m_gradientsTexture;
+    dm::uint2 m_lastViewportSize = dm::uint2::zero();
+    bool m_lastCheckerboard = false;
 
     std::shared_ptr<donut::engine::ShaderFactory> m_shaderFactory;
 };
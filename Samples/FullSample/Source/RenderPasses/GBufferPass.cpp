@@ -21,6 +21,8 @@
 #include <donut/core/log.h>
 #include <nvrhi/utils.h>
 
+#include <algorithm>
+#include <cassert>
 #include <utility>
 
 using namespace donut::math;
@@ -28,6 +30,36 @@ using namespace donut::math;
 
 using namespace donut::engine;
 
+// Size of one set of non-indexed indirect draw arguments: vertexCount, instanceCount, startVertexLocation, startInstanceLocation
+static constexpr uint32_t c_DrawArgumentsSize = sizeof(uint32_t) * 4;
+
+// Lists the geometries drawn by the rasterized G-buffer pass, in the same order as the CPU draw loop.
+static std::vector<GBufferDrawRecord> BuildDrawRecords(const SceneGraph& sceneGraph)
+{
+    std::vector<GBufferDrawRecord> records;
+
+    for (const auto& instance : sceneGraph.GetMeshInstances())
+    {
+        const auto& mesh = instance->GetMesh();
+
+        if (!instance->GetNode())
+            continue;
+
+        for (size_t geometryIndex = 0; geometryIndex < mesh->geometries.size(); geometryIndex++)
+        {
+            const auto& geometry = mesh->geometries[geometryIndex];
+
+            GBufferDrawRecord record{};
+            record.instanceIndex = uint32_t(instance->GetInstanceIndex());
+            record.geometryIndex = uint32_t(geometryIndex);
+            record.boundsMin = geometry->objectSpaceBounds.m_mins;
+            record.boundsMax = geometry->objectSpaceBounds.m_maxs;
+            records.push_back(record);
+        }
+    }
+
+    return records;
+}
 
 RaytracedGBufferPass::RaytracedGBufferPass(
     nvrhi::IDevice* device,
@@ -128,7 +160,7 @@ void RaytracedGBufferPass::Render(
     constants.normalMapScale = settings.normalMapScale;
     constants.enableAlphaTestedGeometry = settings.enableAlphaTestedGeometry;
     constants.enableTransparentGeometry = settings.enableTransparentGeometry;
-    constants.materialReadbackBufferIndex = ProfilerSection::MaterialReadback * 2;
+    constants.materialReadbackBufferIndex = RAY_COUNT_TRACED(ProfilerSection::MaterialReadback);
     constants.materialReadbackPosition = (settings.enableMaterialReadback) ? settings.materialReadbackPosition : int2(-1, -1);
     constants.textureLodBias = settings.textureLodBias;
     constants.textureGradientScale = powf(2.f, settings.textureLodBias);
@@ -185,10 +217,46 @@ RasterizedGBufferPass::RasterizedGBufferPass(
 
     m_bindingLayout = m_device->createBindingLayout(globalBindingLayoutDesc);
 
+    nvrhi::BindingLayoutDesc cullingBindingLayoutDesc;
+    cullingBindingLayoutDesc.visibility = nvrhi::ShaderType::Compute;
+    cullingBindingLayoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::PushConstants(0, sizeof(GBufferCullingConstants)),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(2),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(3),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(0)
+    };
+
+    m_cullingBindingLayout = m_device->createBindingLayout(cullingBindingLayoutDesc);
 }
 
 void RasterizedGBufferPass::CreateBindingSet()
 {
+    // The draw record buffers are sized for the scene structure at load time and re-created when it changes.
+    // Their contents are uploaded on the first frame that uses them, see UpdateDrawRecords(...)
+    m_drawCount = uint32_t(BuildDrawRecords(*m_scene->GetSceneGraph()).size());
+    m_drawRecordsValid = false;
+
+    // The visibility buffer packs the geometry and primitive indices into 32 bits, check that the scene fits
+    m_visibilityBufferSupported = true;
+    for (const auto& mesh : m_scene->GetSceneGraph()->GetMeshes())
+    {
+        if (mesh->geometries.size() > (1u << (32 - VISIBILITY_BUFFER_PRIMITIVE_BITS)))
+            m_visibilityBufferSupported = false;
+
+        for (const auto& geometry : mesh->geometries)
+        {
+            if (geometry->numIndices / 3 > (1u << VISIBILITY_BUFFER_PRIMITIVE_BITS))
+                m_visibilityBufferSupported = false;
+        }
+    }
+
+    if (!m_visibilityBufferSupported)
+        donut::log::warning("The scene has too many geometries per mesh or triangles per geometry for the visibility buffer, it will be disabled.");
+
+    CreateDrawBuffers();
+
     nvrhi::BindingSetDesc bindingSetDesc;
 
     bindingSetDesc.bindings = {
@@ -204,32 +272,148 @@ void RasterizedGBufferPass::CreateBindingSet()
     m_bindingSet = m_device->createBindingSet(bindingSetDesc, m_bindingLayout);
 }
 
+void RasterizedGBufferPass::CreateDrawBuffers()
+{
+    m_drawRecordBuffer = nullptr;
+    m_drawArgumentBuffer = nullptr;
+    m_cullingBindingSet = nullptr;
+
+    if (m_drawCount == 0)
+        return;
+
+    nvrhi::BufferDesc recordBufferDesc;
+    recordBufferDesc.byteSize = sizeof(GBufferDrawRecord) * m_drawCount;
+    recordBufferDesc.structStride = sizeof(GBufferDrawRecord);
+    recordBufferDesc.isVertexBuffer = true;
+    recordBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    recordBufferDesc.keepInitialState = true;
+    recordBufferDesc.debugName = "GBufferDrawRecords";
+    m_drawRecordBuffer = m_device->createBuffer(recordBufferDesc);
+
+    // Opaque arguments for all records, followed by the alpha tested arguments for all records
+    nvrhi::BufferDesc argumentBufferDesc;
+    argumentBufferDesc.byteSize = uint64_t(c_DrawArgumentsSize) * m_drawCount * 2;
+    argumentBufferDesc.format = nvrhi::Format::R32_UINT;
+    argumentBufferDesc.canHaveTypedViews = true;
+    argumentBufferDesc.canHaveUAVs = true;
+    argumentBufferDesc.isDrawIndirectArgs = true;
+    argumentBufferDesc.initialState = nvrhi::ResourceStates::IndirectArgument;
+    argumentBufferDesc.keepInitialState = true;
+    argumentBufferDesc.debugName = "GBufferDrawArguments";
+    m_drawArgumentBuffer = m_device->createBuffer(argumentBufferDesc);
+
+    nvrhi::BindingSetDesc cullingBindingSetDesc;
+    cullingBindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::PushConstants(0, sizeof(GBufferCullingConstants)),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(0, m_scene->GetInstanceBuffer()),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(1, m_scene->GetGeometryBuffer()),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(2, m_scene->GetMaterialBuffer()),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(3, m_drawRecordBuffer),
+        nvrhi::BindingSetItem::TypedBuffer_UAV(0, m_drawArgumentBuffer)
+    };
+
+    m_cullingBindingSet = m_device->createBindingSet(cullingBindingSetDesc, m_cullingBindingLayout);
+}
+
+void RasterizedGBufferPass::UpdateDrawRecords(nvrhi::ICommandList* commandList)
+{
+    const std::vector<GBufferDrawRecord> records = BuildDrawRecords(*m_scene->GetSceneGraph());
+
+    // Instances were added or removed since the buffers were created
+    if (records.size() != m_drawCount)
+    {
+        m_drawCount = uint32_t(records.size());
+        CreateDrawBuffers();
+    }
+
+    if (m_drawCount != 0)
+        commandList->writeBuffer(m_drawRecordBuffer, records.data(), records.size() * sizeof(GBufferDrawRecord));
+
+    m_drawRecordsValid = true;
+}
+
 void RasterizedGBufferPass::CreatePipeline(const RenderTargets& renderTargets)
 {
     donut::log::debug("Initializing RasterizedGBufferPass...");
 
-    std::vector<ShaderMacro> macros = { { "ALPHA_TESTED", "0"} };
+    for (int visibilityBuffer = 0; visibilityBuffer <= 1; visibilityBuffer++)
+    {
+        auto* framebuffer = (visibilityBuffer ? renderTargets.VisibilityFramebuffer : renderTargets.GBufferFramebuffer)->GetFramebuffer(nvrhi::AllSubresources);
+
+        for (int indirectDraw = 0; indirectDraw <= 1; indirectDraw++)
+        {
+            std::vector<ShaderMacro> macros = {
+                { "ALPHA_TESTED", "0" },
+                { "INDIRECT_DRAW", indirectDraw ? "1" : "0" },
+                { "VISIBILITY_BUFFER", visibilityBuffer ? "1" : "0" } };
+            const std::vector<ShaderMacro> vertexMacros = { macros[1] };
+
+            nvrhi::GraphicsPipelineDesc pipelineDesc;
+
+            pipelineDesc.bindingLayouts = { m_bindingLayout, m_bindlessLayout };
+            pipelineDesc.VS = m_shaderFactory->CreateShader("app/RasterizedGBuffer.hlsl", "vs_main", &vertexMacros, nvrhi::ShaderType::Vertex);
+            pipelineDesc.PS = m_shaderFactory->CreateShader("app/RasterizedGBuffer.hlsl", "ps_main", &macros, nvrhi::ShaderType::Pixel);
+            pipelineDesc.primType = nvrhi::PrimitiveType::TriangleList;
+            pipelineDesc.renderState.rasterState.frontCounterClockwise = true;
+            pipelineDesc.renderState.rasterState.cullMode = nvrhi::RasterCullMode::Back;
+            pipelineDesc.renderState.depthStencilState.depthTestEnable = true;
+            pipelineDesc.renderState.depthStencilState.depthFunc = nvrhi::ComparisonFunc::Greater;
+
+            if (indirectDraw)
+            {
+                // The indirect draws select their record with startInstanceLocation, which offsets the per-instance attributes in both APIs
+                const nvrhi::VertexAttributeDesc drawIdAttribute = nvrhi::VertexAttributeDesc()
+                    .setName("DRAW_ID")
+                    .setFormat(nvrhi::Format::RG32_UINT)
+                    .setBufferIndex(0)
+                    .setOffset(0)
+                    .setElementStride(sizeof(GBufferDrawRecord))
+                    .setIsInstanced(true);
+
+                m_indirectInputLayout = m_device->createInputLayout(&drawIdAttribute, 1, pipelineDesc.VS);
+                pipelineDesc.inputLayout = m_indirectInputLayout;
+            }
+
+            m_pipelines[visibilityBuffer][indirectDraw][0] = m_device->createGraphicsPipeline(pipelineDesc, framebuffer);
+
+            macros[0].definition = "1"; // ALPHA_TESTED
+            pipelineDesc.PS = m_shaderFactory->CreateShader("app/RasterizedGBuffer.hlsl", "ps_main", &macros, nvrhi::ShaderType::Pixel);
+            pipelineDesc.renderState.rasterState.cullMode = nvrhi::RasterCullMode::None;
+
+            m_pipelines[visibilityBuffer][indirectDraw][1] = m_device->createGraphicsPipeline(pipelineDesc, framebuffer);
+        }
+    }
 
-    nvrhi::GraphicsPipelineDesc pipelineDesc;
+    m_cullingShader = m_shaderFactory->CreateShader("app/GBufferCulling.hlsl", "main", nullptr, nvrhi::ShaderType::Compute);
 
-    pipelineDesc.bindingLayouts = { m_bindingLayout, m_bindlessLayout };
-    pipelineDesc.VS = m_shaderFactory->CreateShader("app/RasterizedGBuffer.hlsl", "vs_main", nullptr, nvrhi::ShaderType::Vertex);
-    pipelineDesc.PS = m_shaderFactory->CreateShader("app/RasterizedGBuffer.hlsl", "ps_main", &macros, nvrhi::ShaderType::Pixel);
-    pipelineDesc.primType = nvrhi::PrimitiveType::TriangleList;
-    pipelineDesc.renderState.rasterState.frontCounterClockwise = true;
-    pipelineDesc.renderState.rasterState.cullMode = nvrhi::RasterCullMode::Back;
-    pipelineDesc.renderState.depthStencilState.depthTestEnable = true;
-    pipelineDesc.renderState.depthStencilState.depthFunc = nvrhi::ComparisonFunc::Greater;
+    auto cullingPipelineDesc = nvrhi::ComputePipelineDesc()
+        .setComputeShader(m_cullingShader)
+        .addBindingLayout(m_cullingBindingLayout);
 
-    auto* framebuffer = renderTargets.GBufferFramebuffer->GetFramebuffer(nvrhi::AllSubresources);
+    m_cullingPipeline = m_device->createComputePipeline(cullingPipelineDesc);
+}
 
-    m_opaquePipeline = m_device->createGraphicsPipeline(pipelineDesc, framebuffer);
+void RasterizedGBufferPass::CullGeometry(nvrhi::ICommandList* commandList, const donut::engine::IView& view)
+{
+    commandList->beginMarker("GBufferCulling");
 
-    macros[0].definition = "1"; // ALPHA_TESTED
-    pipelineDesc.PS = m_shaderFactory->CreateShader("app/RasterizedGBuffer.hlsl", "ps_main", &macros, nvrhi::ShaderType::Pixel);
-    pipelineDesc.renderState.rasterState.cullMode = nvrhi::RasterCullMode::None;
+    // Same test as frustum::intersectsWith(box3) in the CPU draw loop
+    const frustum viewFrustum = view.GetViewFrustum();
+
+    GBufferCullingConstants constants{};
+    for (int i = 0; i < 6; i++)
+        constants.frustumPlanes[i] = float4(viewFrustum.planes[i].normal, viewFrustum.planes[i].distance);
+    constants.drawCount = m_drawCount;
+
+    auto state = nvrhi::ComputeState()
+        .setPipeline(m_cullingPipeline)
+        .addBindingSet(m_cullingBindingSet);
 
-    m_alphaTestedPipeline = m_device->createGraphicsPipeline(pipelineDesc, framebuffer);
+    commandList->setComputeState(state);
+    commandList->setPushConstants(&constants, sizeof(constants));
+    commandList->dispatch(dm::div_ceil(m_drawCount, GBUFFER_CULLING_GROUP_SIZE));
+
+    commandList->endMarker();
 }
 
 void RasterizedGBufferPass::Render(
@@ -237,13 +421,18 @@ void RasterizedGBufferPass::Render(
     const donut::engine::IView& view,
     const donut::engine::IView& viewPrev,
     const RenderTargets& renderTargets,
-    const GBufferSettings& settings)
+    const GBufferSettings& settings,
+    bool visibilityBuffer)
 {
-    commandList->beginMarker("GBufferFill");
+    commandList->beginMarker(visibilityBuffer ? "VisibilityBufferFill" : "GBufferFill");
 
     commandList->clearDepthStencilTexture(renderTargets.DeviceDepth, nvrhi::AllSubresources, true, 0.f, false, 0);
-    commandList->clearTextureFloat(renderTargets.Depth, nvrhi::AllSubresources, nvrhi::Color(BACKGROUND_DEPTH));
 
+    // The visibility buffer resolve pass writes all G-buffer pixels, including the background
+    if (visibilityBuffer)
+        commandList->clearTextureUInt(renderTargets.VisibilityBuffer, nvrhi::AllSubresources, VISIBILITY_BUFFER_EMPTY);
+    else
+        commandList->clearTextureFloat(renderTargets.Depth, nvrhi::AllSubresources, nvrhi::Color(BACKGROUND_DEPTH));
 
     GBufferConstants constants;
     view.FillPlanarViewConstants(constants.view);
@@ -253,14 +442,27 @@ void RasterizedGBufferPass::Render(
     constants.normalMapScale = settings.normalMapScale;
     constants.textureLodBias = settings.textureLodBias;
     constants.textureGradientScale = powf(2.f, settings.textureLodBias);
-    constants.materialReadbackBufferIndex = ProfilerSection::MaterialReadback * 2;
+    constants.materialReadbackBufferIndex = RAY_COUNT_TRACED(ProfilerSection::MaterialReadback);
     constants.materialReadbackPosition = (settings.enableMaterialReadback) ? settings.materialReadbackPosition : int2(-1, -1);
     commandList->writeBuffer(m_constantBuffer, &constants, sizeof(constants));
 
-    nvrhi::IFramebuffer* framebuffer = renderTargets.GBufferFramebuffer->GetFramebuffer(nvrhi::AllSubresources);
+    nvrhi::IFramebuffer* framebuffer = (visibilityBuffer ? renderTargets.VisibilityFramebuffer : renderTargets.GBufferFramebuffer)->GetFramebuffer(nvrhi::AllSubresources);
+
+    if (settings.enableGpuCulling && !m_drawRecordsValid)
+        UpdateDrawRecords(commandList);
+
+    const bool useIndirectDraws = settings.enableGpuCulling && m_drawCount != 0;
+
+    if (useIndirectDraws)
+        CullGeometry(commandList, view);
 
     commandList->setEnableAutomaticBarriers(false);
     commandList->setResourceStatesForFramebuffer(framebuffer);
+    if (useIndirectDraws)
+    {
+        commandList->setBufferState(m_drawRecordBuffer, nvrhi::ResourceStates::VertexBuffer);
+        commandList->setBufferState(m_drawArgumentBuffer, nvrhi::ResourceStates::IndirectArgument);
+    }
     commandList->commitBarriers();
 
     const auto& instances = m_scene->GetSceneGraph()->GetMeshInstances();
@@ -273,10 +475,22 @@ void RasterizedGBufferPass::Render(
             break;
 
         nvrhi::GraphicsState state;
-        state.pipeline = alphaTested ? m_alphaTestedPipeline : m_opaquePipeline;
+        state.pipeline = m_pipelines[visibilityBuffer][useIndirectDraws][alphaTested];
         state.bindings = { m_bindingSet, m_scene->GetDescriptorTable() };
         state.framebuffer = framebuffer;
         state.viewport = view.GetViewportState();
+
+        if (useIndirectDraws)
+        {
+            // One draw per record, the culled ones and the ones from the other material domain have no instances
+            state.vertexBuffers = { nvrhi::VertexBufferBinding().setBuffer(m_drawRecordBuffer).setSlot(0).setOffset(0) };
+            state.indirectParams = m_drawArgumentBuffer;
+            commandList->setGraphicsState(state);
+
+            commandList->drawIndirect(alphaTested * m_drawCount * c_DrawArgumentsSize, m_drawCount);
+            continue;
+        }
+
         commandList->setGraphicsState(state);
 
         nvrhi::DrawArguments args{};
@@ -316,6 +530,205 @@ void RasterizedGBufferPass::Render(
     commandList->endMarker();
 }
 
+VisibilityBufferResolvePass::VisibilityBufferResolvePass(
+    nvrhi::IDevice* device,
+    std::shared_ptr<donut::engine::ShaderFactory> shaderFactory,
+    std::shared_ptr<donut::engine::CommonRenderPasses> commonPasses,
+    std::shared_ptr<donut::engine::Scene> scene,
+    std::shared_ptr<Profiler> profiler,
+    nvrhi::IBindingLayout* bindlessLayout)
+    : m_device(device)
+    , m_bindlessLayout(bindlessLayout)
+    , m_shaderFactory(std::move(shaderFactory))
+    , m_commonPasses(std::move(commonPasses))
+    , m_scene(std::move(scene))
+    , m_profiler(std::move(profiler))
+{
+    m_constantBuffer = m_device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(sizeof(GBufferConstants), "VisibilityResolveConstants", 16));
+
+    nvrhi::BindingLayoutDesc globalBindingLayoutDesc;
+    globalBindingLayoutDesc.visibility = nvrhi::ShaderType::Compute;
+    globalBindingLayoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::Texture_UAV(0),
+        nvrhi::BindingLayoutItem::Texture_UAV(1),
+        nvrhi::BindingLayoutItem::Texture_UAV(2),
+        nvrhi::BindingLayoutItem::Texture_UAV(3),
+        nvrhi::BindingLayoutItem::Texture_UAV(4),
+        nvrhi::BindingLayoutItem::Texture_UAV(5),
+        nvrhi::BindingLayoutItem::Texture_UAV(6),
+        nvrhi::BindingLayoutItem::Texture_UAV(7),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(8),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(9),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(10),
+
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::PushConstants(1, sizeof(VisibilityResolveConstants)),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(2),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(3),
+        nvrhi::BindingLayoutItem::Sampler(0)
+    };
+
+    m_bindingLayout = m_device->createBindingLayout(globalBindingLayoutDesc);
+
+    // The shading pass reads the bins as a UAV, so its dispatch arguments are copied into a separate buffer
+    nvrhi::BufferDesc argumentBufferDesc;
+    argumentBufferDesc.byteSize = sizeof(uint32_t) * 3;
+    argumentBufferDesc.isDrawIndirectArgs = true;
+    argumentBufferDesc.initialState = nvrhi::ResourceStates::IndirectArgument;
+    argumentBufferDesc.keepInitialState = true;
+    argumentBufferDesc.debugName = "VisibilityResolveShadeArgs";
+    m_shadeArgumentBuffer = m_device->createBuffer(argumentBufferDesc);
+}
+
+void VisibilityBufferResolvePass::CreatePipeline()
+{
+    donut::log::debug("Initializing VisibilityBufferResolvePass...");
+
+    // The pass index is the value of VISIBILITY_RESOLVE_CLASSIFY...VISIBILITY_RESOLVE_SHADE
+    for (int pass = 0; pass < 4; pass++)
+    {
+        const std::vector<ShaderMacro> macros = { { "VISIBILITY_RESOLVE_PASS", std::to_string(pass) } };
+
+        m_shaders[pass] = m_shaderFactory->CreateShader("app/VisibilityBufferResolve.hlsl", "main", &macros, nvrhi::ShaderType::Compute);
+
+        auto pipelineDesc = nvrhi::ComputePipelineDesc()
+            .setComputeShader(m_shaders[pass])
+            .addBindingLayout(m_bindingLayout)
+            .addBindingLayout(m_bindlessLayout);
+
+        m_pipelines[pass] = m_device->createComputePipeline(pipelineDesc);
+    }
+}
+
+void VisibilityBufferResolvePass::CreateBindingSet(const RenderTargets& renderTargets)
+{
+    // One bin per material ID, the IDs are assigned by the scene loader and are dense
+    m_materialBinCount = 1;
+    for (const auto& material : m_scene->GetSceneGraph()->GetMaterials())
+        m_materialBinCount = std::max(m_materialBinCount, uint32_t(material->materialID) + 1);
+
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = sizeof(uint32_t) * (m_materialBinCount * 2 + VISIBILITY_RESOLVE_EXTRA_COUNTERS);
+    bufferDesc.format = nvrhi::Format::R32_UINT;
+    bufferDesc.canHaveTypedViews = true;
+    bufferDesc.canHaveUAVs = true;
+    bufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    bufferDesc.keepInitialState = true;
+    bufferDesc.debugName = "VisibilityResolveMaterialBins";
+    m_materialBinBuffer = m_device->createBuffer(bufferDesc);
+
+    bufferDesc.byteSize = sizeof(uint32_t) * uint64_t(renderTargets.Size.x) * uint64_t(renderTargets.Size.y);
+    bufferDesc.debugName = "VisibilityResolvePixelList";
+    m_pixelListBuffer = m_device->createBuffer(bufferDesc);
+
+    for (int currentFrame = 0; currentFrame <= 1; currentFrame++)
+    {
+        nvrhi::BindingSetDesc bindingSetDesc;
+        bindingSetDesc.bindings = {
+            nvrhi::BindingSetItem::Texture_UAV(0, currentFrame ? renderTargets.Depth : renderTargets.PrevDepth),
+            nvrhi::BindingSetItem::Texture_UAV(1, currentFrame ? renderTargets.GBufferDiffuseAlbedo : renderTargets.PrevGBufferDiffuseAlbedo),
+            nvrhi::BindingSetItem::Texture_UAV(2, currentFrame ? renderTargets.GBufferSpecularRough : renderTargets.PrevGBufferSpecularRough),
+            nvrhi::BindingSetItem::Texture_UAV(3, currentFrame ? renderTargets.GBufferNormals : renderTargets.PrevGBufferNormals),
+            nvrhi::BindingSetItem::Texture_UAV(4, currentFrame ? renderTargets.GBufferGeoNormals : renderTargets.PrevGBufferGeoNormals),
+            nvrhi::BindingSetItem::Texture_UAV(5, renderTargets.GBufferEmissive),
+            nvrhi::BindingSetItem::Texture_UAV(6, renderTargets.MotionVectors),
+            nvrhi::BindingSetItem::Texture_UAV(7, renderTargets.DeviceDepthUAV),
+            nvrhi::BindingSetItem::TypedBuffer_UAV(8, m_profiler->GetRayCountBuffer()),
+            nvrhi::BindingSetItem::TypedBuffer_UAV(9, m_materialBinBuffer),
+            nvrhi::BindingSetItem::TypedBuffer_UAV(10, m_pixelListBuffer),
+
+            nvrhi::BindingSetItem::ConstantBuffer(0, m_constantBuffer),
+            nvrhi::BindingSetItem::PushConstants(1, sizeof(VisibilityResolveConstants)),
+            nvrhi::BindingSetItem::Texture_SRV(0, renderTargets.VisibilityBuffer),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(1, m_scene->GetInstanceBuffer()),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(2, m_scene->GetGeometryBuffer()),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(3, m_scene->GetMaterialBuffer()),
+            nvrhi::BindingSetItem::Sampler(0, m_commonPasses->m_AnisotropicWrapSampler)
+        };
+
+        const nvrhi::BindingSetHandle bindingSet = m_device->createBindingSet(bindingSetDesc, m_bindingLayout);
+
+        if (currentFrame)
+            m_bindingSet = bindingSet;
+        else
+            m_prevBindingSet = bindingSet;
+    }
+}
+
+void VisibilityBufferResolvePass::Render(
+    nvrhi::ICommandList* commandList,
+    const donut::engine::IView& view,
+    const donut::engine::IView& viewPrev,
+    const GBufferSettings& settings)
+{
+    commandList->beginMarker("VisibilityBufferResolve");
+
+    GBufferConstants constants;
+    view.FillPlanarViewConstants(constants.view);
+    viewPrev.FillPlanarViewConstants(constants.viewPrev);
+    constants.roughnessOverride = (settings.enableRoughnessOverride) ? settings.roughnessOverride : -1.f;
+    constants.metalnessOverride = (settings.enableMetalnessOverride) ? settings.metalnessOverride : -1.f;
+    constants.normalMapScale = settings.normalMapScale;
+    constants.enableAlphaTestedGeometry = settings.enableAlphaTestedGeometry;
+    constants.enableTransparentGeometry = settings.enableTransparentGeometry;
+    constants.materialReadbackBufferIndex = RAY_COUNT_TRACED(ProfilerSection::MaterialReadback);
+    constants.materialReadbackPosition = (settings.enableMaterialReadback) ? settings.materialReadbackPosition : int2(-1, -1);
+    constants.textureLodBias = settings.textureLodBias;
+    constants.textureGradientScale = powf(2.f, settings.textureLodBias);
+    commandList->writeBuffer(m_constantBuffer, &constants, sizeof(constants));
+
+    commandList->clearBufferUInt(m_materialBinBuffer, 0);
+
+    VisibilityResolveConstants pushConstants{};
+    pushConstants.materialBinCount = m_materialBinCount;
+
+    const uint32_t width = view.GetViewExtent().width();
+    const uint32_t height = view.GetViewExtent().height();
+
+    auto state = nvrhi::ComputeState()
+        .addBindingSet(m_bindingSet)
+        .addBindingSet(m_scene->GetDescriptorTable());
+
+    state.setPipeline(m_pipelines[VISIBILITY_RESOLVE_CLASSIFY]);
+    commandList->setComputeState(state);
+    commandList->setPushConstants(&pushConstants, sizeof(pushConstants));
+    commandList->dispatch(dm::div_ceil(width, 16), dm::div_ceil(height, 16));
+
+    nvrhi::utils::BufferUavBarrier(commandList, m_materialBinBuffer);
+
+    state.setPipeline(m_pipelines[VISIBILITY_RESOLVE_OFFSETS]);
+    commandList->setComputeState(state);
+    commandList->setPushConstants(&pushConstants, sizeof(pushConstants));
+    commandList->dispatch(1);
+
+    nvrhi::utils::BufferUavBarrier(commandList, m_materialBinBuffer);
+
+    state.setPipeline(m_pipelines[VISIBILITY_RESOLVE_SCATTER]);
+    commandList->setComputeState(state);
+    commandList->setPushConstants(&pushConstants, sizeof(pushConstants));
+    commandList->dispatch(dm::div_ceil(width, 16), dm::div_ceil(height, 16));
+
+    commandList->copyBuffer(m_shadeArgumentBuffer, 0, m_materialBinBuffer, sizeof(uint32_t) * m_materialBinCount * 2, sizeof(uint32_t) * 3);
+
+    // The copy transitions the bin buffer out of the UAV state, which orders the cursor writes with the shading pass.
+    nvrhi::utils::BufferUavBarrier(commandList, m_pixelListBuffer);
+
+    state.setPipeline(m_pipelines[VISIBILITY_RESOLVE_SHADE]);
+    state.indirectParams = m_shadeArgumentBuffer;
+    commandList->setComputeState(state);
+    commandList->setPushConstants(&pushConstants, sizeof(pushConstants));
+    commandList->dispatchIndirect(0);
+
+    commandList->endMarker();
+}
+
+void VisibilityBufferResolvePass::NextFrame()
+{
+    std::swap(m_bindingSet, m_prevBindingSet);
+}
+
 PostprocessGBufferPass::PostprocessGBufferPass(nvrhi::IDevice* device, std::shared_ptr<donut::engine::ShaderFactory> shaderFactory)
     : m_device(device)
     , m_shaderFactory(std::move(shaderFactory))
@@ -325,9 +738,14 @@ PostprocessGBufferPass::PostprocessGBufferPass(nvrhi::IDevice* device, std::shar
     globalBindingLayoutDesc.bindings = {
         nvrhi::BindingLayoutItem::Texture_UAV(0),
         nvrhi::BindingLayoutItem::Texture_UAV(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(2),
 
         nvrhi::BindingLayoutItem::Texture_SRV(0),
-        nvrhi::BindingLayoutItem::Texture_SRV(1)
+        nvrhi::BindingLayoutItem::Texture_SRV(1),
+        nvrhi::BindingLayoutItem::Texture_SRV(2),
+        nvrhi::BindingLayoutItem::Texture_SRV(3),
+
+        nvrhi::BindingLayoutItem::PushConstants(0, sizeof(PostprocessGBufferConstants))
     };
 
     m_bindingLayout = m_device->createBindingLayout(globalBindingLayoutDesc);
@@ -352,9 +770,14 @@ void PostprocessGBufferPass::CreateBindingSet(const RenderTargets& renderTargets
         bindingSetDesc.bindings = {
             nvrhi::BindingSetItem::Texture_UAV(0, currentFrame ? renderTargets.GBufferSpecularRough : renderTargets.PrevGBufferSpecularRough),
             nvrhi::BindingSetItem::Texture_UAV(1, renderTargets.NormalRoughness),
+            nvrhi::BindingSetItem::StructuredBuffer_UAV(2, currentFrame ? renderTargets.GBufferSurfaces : renderTargets.PrevGBufferSurfaces),
 
             nvrhi::BindingSetItem::Texture_SRV(0, currentFrame ? renderTargets.GBufferNormals : renderTargets.PrevGBufferNormals),
-            nvrhi::BindingSetItem::Texture_SRV(1, currentFrame ? renderTargets.Depth : renderTargets.PrevDepth)
+            nvrhi::BindingSetItem::Texture_SRV(1, currentFrame ? renderTargets.Depth : renderTargets.PrevDepth),
+            nvrhi::BindingSetItem::Texture_SRV(2, currentFrame ? renderTargets.GBufferGeoNormals : renderTargets.PrevGBufferGeoNormals),
+            nvrhi::BindingSetItem::Texture_SRV(3, currentFrame ? renderTargets.GBufferDiffuseAlbedo : renderTargets.PrevGBufferDiffuseAlbedo),
+
+            nvrhi::BindingSetItem::PushConstants(0, sizeof(PostprocessGBufferConstants))
         };
 
         const nvrhi::BindingSetHandle bindingSet = m_device->createBindingSet(bindingSetDesc, m_bindingLayout);
@@ -364,15 +787,24 @@ void PostprocessGBufferPass::CreateBindingSet(const RenderTargets& renderTargets
         else
             m_prevBindingSet = bindingSet;
     }
+
+    m_compactSurfaceStride = renderTargets.CompactSurfaceStride;
 }
 
-void PostprocessGBufferPass::Render(nvrhi::ICommandList* commandList, const donut::engine::IView& view)
+void PostprocessGBufferPass::Render(nvrhi::ICommandList* commandList, const donut::engine::IView& view, bool writeCompactSurfaces)
 {
     auto state = nvrhi::ComputeState()
         .setPipeline(m_computePipeline)
         .addBindingSet(m_bindingSet);
 
     commandList->setComputeState(state);
+
+    PostprocessGBufferConstants constants{};
+    constants.viewportSize = dm::uint2(view.GetViewExtent().width(), view.GetViewExtent().height());
+    constants.compactSurfaceStride = m_compactSurfaceStride;
+    constants.writeCompactSurfaces = writeCompactSurfaces;
+    commandList->setPushConstants(&constants, sizeof(constants));
+
     commandList->dispatch(
         dm::div_ceil(view.GetViewExtent().width(), 16),
         dm::div_ceil(view.GetViewExtent().height(), 16));
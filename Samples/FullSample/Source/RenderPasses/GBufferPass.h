@@ -40,6 +40,7 @@ struct GBufferSettings
     ibool enableAlphaTestedGeometry = true;
     ibool enableTransparentGeometry = true;
     float textureLodBias = -1.f;
+    ibool enableGpuCulling = false; // Rasterized G-buffer only: frustum culling in a compute pass and one multi-draw-indirect per material domain
 
     bool enableMaterialReadback = false;
     dm::int2 materialReadbackPosition = 0;
@@ -101,6 +102,7 @@ public:
 
     void CreatePipeline(const RenderTargets& renderTargets);
 
+    // Also creates the draw records for the GPU culling path, so it must be called after the scene is loaded.
     void CreateBindingSet();
 
     void Render(
@@ -108,18 +110,88 @@ public:
         const donut::engine::IView& view,
         const donut::engine::IView& viewPrev,
         const RenderTargets& renderTargets,
+        const GBufferSettings& settings,
+        bool visibilityBuffer);
+
+    // The visibility buffer stores the geometry and primitive indices with limited precision, see ShaderParameters.h
+    [[nodiscard]] bool IsVisibilityBufferSupported() const { return m_visibilityBufferSupported; }
+
+    // Rebuilds and re-uploads the draw records before the next culled frame. Call it when mesh instances are added
+    // or removed, or when the instances or their meshes are animated.
+    void InvalidateDrawRecords() { m_drawRecordsValid = false; }
+
+private:
+    void CreateDrawBuffers();
+    void UpdateDrawRecords(nvrhi::ICommandList* commandList);
+    void CullGeometry(nvrhi::ICommandList* commandList, const donut::engine::IView& view);
+
+    nvrhi::DeviceHandle m_device;
+
+    nvrhi::GraphicsPipelineHandle m_pipelines[2][2][2]; // [visibilityBuffer][indirectDraw][alphaTested]
+    nvrhi::InputLayoutHandle m_indirectInputLayout;
+    nvrhi::BindingLayoutHandle m_bindingLayout;
+    nvrhi::BindingLayoutHandle m_bindlessLayout;
+    nvrhi::BindingSetHandle m_bindingSet;
+
+    nvrhi::ShaderHandle m_cullingShader;
+    nvrhi::ComputePipelineHandle m_cullingPipeline;
+    nvrhi::BindingLayoutHandle m_cullingBindingLayout;
+    nvrhi::BindingSetHandle m_cullingBindingSet;
+
+    nvrhi::BufferHandle m_constantBuffer;
+    nvrhi::BufferHandle m_drawRecordBuffer;
+    nvrhi::BufferHandle m_drawArgumentBuffer;
+    uint32_t m_drawCount = 0;
+    bool m_drawRecordsValid = false;
+    bool m_visibilityBufferSupported = true;
+
+    std::shared_ptr<donut::engine::ShaderFactory> m_shaderFactory;
+    std::shared_ptr<donut::engine::CommonRenderPasses> m_commonPasses;
+    std::shared_ptr<donut::engine::Scene> m_scene;
+    std::shared_ptr<Profiler> m_profiler;
+};
+
+// Fills the G-buffer from the visibility buffer written by RasterizedGBufferPass, evaluating the material once per visible pixel.
+// The pixels are sorted by material before shading, see VisibilityBufferResolve.hlsl
+class VisibilityBufferResolvePass
+{
+public:
+    VisibilityBufferResolvePass(
+        nvrhi::IDevice* device,
+        std::shared_ptr<donut::engine::ShaderFactory> shaderFactory,
+        std::shared_ptr<donut::engine::CommonRenderPasses> commonPasses,
+        std::shared_ptr<donut::engine::Scene> scene,
+        std::shared_ptr<Profiler> profiler,
+        nvrhi::IBindingLayout* bindlessLayout);
+
+    void CreatePipeline();
+
+    // Also sizes the material bins for the current scene, so it must be called after the scene is loaded.
+    void CreateBindingSet(const RenderTargets& renderTargets);
+
+    void Render(
+        nvrhi::ICommandList* commandList,
+        const donut::engine::IView& view,
+        const donut::engine::IView& viewPrev,
         const GBufferSettings& settings);
 
+    void NextFrame();
+
 private:
     nvrhi::DeviceHandle m_device;
 
-    nvrhi::GraphicsPipelineHandle m_opaquePipeline;
-    nvrhi::GraphicsPipelineHandle m_alphaTestedPipeline;
+    nvrhi::ShaderHandle m_shaders[4];
+    nvrhi::ComputePipelineHandle m_pipelines[4]; // Indexed by VISIBILITY_RESOLVE_PASS
     nvrhi::BindingLayoutHandle m_bindingLayout;
     nvrhi::BindingLayoutHandle m_bindlessLayout;
     nvrhi::BindingSetHandle m_bindingSet;
+    nvrhi::BindingSetHandle m_prevBindingSet;
 
     nvrhi::BufferHandle m_constantBuffer;
+    nvrhi::BufferHandle m_materialBinBuffer;
+    nvrhi::BufferHandle m_pixelListBuffer;
+    nvrhi::BufferHandle m_shadeArgumentBuffer;
+    uint32_t m_materialBinCount = 1;
 
     std::shared_ptr<donut::engine::ShaderFactory> m_shaderFactory;
     std::shared_ptr<donut::engine::CommonRenderPasses> m_commonPasses;
@@ -139,14 +211,17 @@ public:
     void CreateBindingSet(
         const RenderTargets& renderTargets);
 
+    // Also writes the compact G-buffer surfaces used by the lighting passes if 'writeCompactSurfaces' is set.
     void Render(
         nvrhi::ICommandList* commandList,
-        const donut::engine::IView& view);
+        const donut::engine::IView& view,
+        bool writeCompactSurfaces);
 
     void NextFrame();
 
 private:
     nvrhi::DeviceHandle m_device;
+    uint32_t m_compactSurfaceStride = 0;
 
     nvrhi::ShaderHandle m_computeShader;
     nvrhi::ComputePipelineHandle m_computePipeline;
@@ -54,12 +54,32 @@ GenerateMipsPass::GenerateMipsPass(
     nvrhi::utils::CreateBindingSetAndLayout(device, nvrhi::ShaderType::Compute, 0,
         bindingSetDesc, bindingLayout, m_bindingSet);
 
+    // The counter of finished thread groups lives in a separate register space
+    // because the mip UAVs are declared as an unbounded array starting at u0.
+    nvrhi::BufferDesc counterBufferDesc;
+    counterBufferDesc.byteSize = sizeof(uint32_t);
+    counterBufferDesc.structStride = sizeof(uint32_t);
+    counterBufferDesc.canHaveUAVs = true;
+    counterBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    counterBufferDesc.keepInitialState = true;
+    counterBufferDesc.debugName = "GenerateMipsAtomicCounter";
+    m_atomicCounterBuffer = device->createBuffer(counterBufferDesc);
+
+    nvrhi::BindingSetDesc counterBindingSetDesc;
+    counterBindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(0, m_atomicCounterBuffer)
+    };
+
+    nvrhi::BindingLayoutHandle counterBindingLayout;
+    nvrhi::utils::CreateBindingSetAndLayout(device, nvrhi::ShaderType::Compute, 1,
+        counterBindingSetDesc, counterBindingLayout, m_counterBindingSet);
+
     std::vector<donut::engine::ShaderMacro> macros = { { "INPUT_ENVIRONMENT_MAP", sourceEnvironmentMap ? "1" : "0" } };
 
     nvrhi::ShaderHandle shader = shaderFactory->CreateShader("app/PreprocessEnvironmentMap.hlsl", "main", &macros, nvrhi::ShaderType::Compute);
 
     nvrhi::ComputePipelineDesc pipelineDesc;
-    pipelineDesc.bindingLayouts = { bindingLayout };
+    pipelineDesc.bindingLayouts = { bindingLayout, counterBindingLayout };
     pipelineDesc.CS = shader;
     m_pipeline = device->createComputePipeline(pipelineDesc);
 }
@@ -67,33 +87,33 @@ GenerateMipsPass::GenerateMipsPass(
 void GenerateMipsPass::Process(nvrhi::ICommandList* commandList)
 {
     commandList->beginMarker("GenerateMips");
+
+    // The shader resets the counter after every dispatch, so it only needs to be cleared once
+    if (!m_atomicCounterInitialized)
+    {
+        commandList->clearBufferUInt(m_atomicCounterBuffer, 0);
+        m_atomicCounterInitialized = true;
+    }
     
     const auto& destDesc = m_destinationTexture->getDesc();
 
-    constexpr uint32_t mipLevelsPerPass = 5;
-    uint32_t width = destDesc.width;
-    uint32_t height = destDesc.height;
+    // The whole mip chain is built in one dispatch: every group reduces a 32x32 block through 5 mip levels,
+    // and the last group to finish reduces the rest of the chain.
+    const uint32_t groupsX = div_ceil(destDesc.width, 32);
+    const uint32_t groupsY = div_ceil(destDesc.height, 32);
 
-    for (uint32_t sourceMipLevel = 0; sourceMipLevel < destDesc.mipLevels; sourceMipLevel += mipLevelsPerPass)
-    {
-        nvrhi::ComputeState state;
-        state.pipeline = m_pipeline;
-        state.bindings = { m_bindingSet };
-        commandList->setComputeState(state);
-
-        PreprocessEnvironmentMapConstants constants{};
-        constants.sourceSize = { destDesc.width, destDesc.height };
-        constants.numDestMipLevels = destDesc.mipLevels;
-        constants.sourceMipLevel = sourceMipLevel;
-        commandList->setPushConstants(&constants, sizeof(constants));
-
-        commandList->dispatch(div_ceil(width, 32), div_ceil(height, 32), 1);
-
-        width = std::max(1u, width >> mipLevelsPerPass);
-        height = std::max(1u, height >> mipLevelsPerPass);
-        
-        commandList->clearState(); // make sure nvrhi inserts a barrier
-    }
+    nvrhi::ComputeState state;
+    state.pipeline = m_pipeline;
+    state.bindings = { m_bindingSet, m_counterBindingSet };
+    commandList->setComputeState(state);
+
+    PreprocessEnvironmentMapConstants constants{};
+    constants.sourceSize = { destDesc.width, destDesc.height };
+    constants.numDestMipLevels = destDesc.mipLevels;
+    constants.numWorkGroups = groupsX * groupsY;
+    commandList->setPushConstants(&constants, sizeof(constants));
+
+    commandList->dispatch(groupsX, groupsY, 1);
 
     commandList->endMarker();
 }
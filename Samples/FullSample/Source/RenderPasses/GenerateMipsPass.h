@@ -32,6 +32,9 @@ public:
 private:
     nvrhi::ComputePipelineHandle m_pipeline;
     nvrhi::BindingSetHandle m_bindingSet;
+    nvrhi::BindingSetHandle m_counterBindingSet;
+    nvrhi::BufferHandle m_atomicCounterBuffer;
     nvrhi::TextureHandle m_sourceTexture;
     nvrhi::TextureHandle m_destinationTexture;
+    bool m_atomicCounterInitialized = false;
 };
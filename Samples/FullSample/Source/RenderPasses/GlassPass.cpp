@@ -113,7 +113,7 @@ void GlassPass::Render(
     constants.environmentScale = environmentLight.radianceScale.x;
     constants.environmentRotation = environmentLight.rotation;
     constants.normalMapScale = normalMapScale;
-    constants.materialReadbackBufferIndex = ProfilerSection::MaterialReadback * 2;
+    constants.materialReadbackBufferIndex = RAY_COUNT_TRACED(ProfilerSection::MaterialReadback);
     constants.materialReadbackPosition = enableMaterialReadback ? materialReadbackPosition : int2(-1, -1);
     commandList->writeBuffer(m_constantBuffer, &constants, sizeof(constants));
 
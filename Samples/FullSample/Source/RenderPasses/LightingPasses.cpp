@@ -22,7 +22,10 @@
 #include <donut/core/log.h>
 #include <nvrhi/utils.h>
 #include <Rtxdi/ImportanceSamplingContext.h>
+#include <Rtxdi/RtxdiUtils.h>
 
+#include <algorithm>
+#include <cstring>
 #include <utility>
 
 #if WITH_NRD
@@ -108,6 +111,9 @@ LightingPasses::LightingPasses(
         nvrhi::BindingLayoutItem::Texture_SRV(10),
         nvrhi::BindingLayoutItem::Texture_SRV(11),
         nvrhi::BindingLayoutItem::Texture_SRV(12),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(13),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(14),
+        nvrhi::BindingLayoutItem::Texture_SRV(15),
 
         nvrhi::BindingLayoutItem::RayTracingAccelStruct(30),
         nvrhi::BindingLayoutItem::RayTracingAccelStruct(31),
@@ -121,6 +127,8 @@ LightingPasses::LightingPasses(
         nvrhi::BindingLayoutItem::Texture_SRV(23),
         nvrhi::BindingLayoutItem::Texture_SRV(24),
         nvrhi::BindingLayoutItem::StructuredBuffer_SRV(25),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(26),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(27),
 
         nvrhi::BindingLayoutItem::StructuredBuffer_UAV(0),
         nvrhi::BindingLayoutItem::Texture_UAV(1),
@@ -129,11 +137,18 @@ LightingPasses::LightingPasses(
         nvrhi::BindingLayoutItem::Texture_UAV(4),
         nvrhi::BindingLayoutItem::Texture_UAV(5),
         nvrhi::BindingLayoutItem::StructuredBuffer_UAV(6),
+        nvrhi::BindingLayoutItem::Texture_UAV(7),
+        nvrhi::BindingLayoutItem::Texture_UAV(8),
+        nvrhi::BindingLayoutItem::Texture_UAV(9),
 
         nvrhi::BindingLayoutItem::TypedBuffer_UAV(10),
         nvrhi::BindingLayoutItem::TypedBuffer_UAV(11),
         nvrhi::BindingLayoutItem::TypedBuffer_UAV(12),
         nvrhi::BindingLayoutItem::StructuredBuffer_UAV(13),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(14),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(15),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(16),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(17),
 
         nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
         nvrhi::BindingLayoutItem::PushConstants(1, sizeof(PerPassConstants)),
@@ -144,6 +159,52 @@ LightingPasses::LightingPasses(
     m_bindingLayout = m_device->createBindingLayout(globalBindingLayoutDesc);
 
     m_constantBuffer = m_device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(sizeof(ResamplingConstants), "ResamplingConstants", 16));
+
+    m_pipelineCache = std::make_unique<PipelineCache>(m_device, m_shaderFactory, m_bindingLayout, m_bindlessLayout, "LightingPasses");
+
+    m_lazyComputePasses = {
+        &m_presampleLightsPass,
+        &m_presampleEnvironmentMapPass,
+        &m_presampleReGIR,
+        &m_brdfRayBinningPass,
+        &m_wavefrontBrdfRayArgsPass,
+        &m_wavefrontBrdfRayShadingPass,
+        &m_GIUpsamplingPass
+    };
+
+    m_lazyRayTracingPasses = {
+        &m_generateInitialSamplesPass,
+        &m_temporalResamplingPass,
+        &m_spatialResamplingPass,
+        &m_shadeSamplesPass,
+        &m_brdfRayTracingPass,
+        &m_sortedBrdfRayTracingPass,
+        &m_wavefrontBrdfRayTracingPass,
+        &m_shadeSecondarySurfacesPass,
+        &m_fusedResamplingPass,
+        &m_gradientsPass,
+        &m_GITemporalResamplingPass,
+        &m_GISpatialResamplingPass,
+        &m_GIFusedResamplingPass,
+        &m_GIFinalShadingPass
+    };
+}
+
+LightingPasses::~LightingPasses() = default;
+
+void LightingPasses::ClearPipelineCache()
+{
+    m_pipelineCache->LogStatistics();
+    m_pipelineCache->Clear();
+
+    // The passes point into the cache
+    for (LazyComputePass* pass : m_lazyComputePasses)
+        *pass = LazyComputePass();
+    for (LazyRayTracingPass* pass : m_lazyRayTracingPasses)
+        *pass = LazyRayTracingPass();
+
+    m_pipelinesDeclared = false;
+    m_pipelineSwitchPending = false;
 }
 
 void LightingPasses::CreateBindingSet(
@@ -174,6 +235,9 @@ void LightingPasses::CreateBindingSet(
             nvrhi::BindingSetItem::Texture_SRV(10, currentFrame ? renderTargets.PrevRestirLuminance : renderTargets.RestirLuminance),
             nvrhi::BindingSetItem::Texture_SRV(11, renderTargets.MotionVectors),
             nvrhi::BindingSetItem::Texture_SRV(12, renderTargets.NormalRoughness),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(13, currentFrame ? renderTargets.GBufferSurfaces : renderTargets.PrevGBufferSurfaces),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(14, currentFrame ? renderTargets.PrevGBufferSurfaces : renderTargets.GBufferSurfaces),
+            nvrhi::BindingSetItem::Texture_SRV(15, renderTargets.ConfidenceTiles),
             
             nvrhi::BindingSetItem::RayTracingAccelStruct(30, currentFrame ? topLevelAS : prevTopLevelAS),
             nvrhi::BindingSetItem::RayTracingAccelStruct(31, currentFrame ? prevTopLevelAS : topLevelAS),
@@ -187,6 +251,8 @@ void LightingPasses::CreateBindingSet(
             nvrhi::BindingSetItem::Texture_SRV(23, resources.EnvironmentPdfTexture),
             nvrhi::BindingSetItem::Texture_SRV(24, resources.LocalLightPdfTexture),
             nvrhi::BindingSetItem::StructuredBuffer_SRV(25, resources.GeometryInstanceToLightBuffer),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(26, resources.InstancedLightBuffer),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(27, resources.InstancedLightRefBuffer),
 
             nvrhi::BindingSetItem::StructuredBuffer_UAV(0, resources.LightReservoirBuffer),
             nvrhi::BindingSetItem::Texture_UAV(1, renderTargets.DiffuseLighting),
@@ -195,11 +261,18 @@ void LightingPasses::CreateBindingSet(
             nvrhi::BindingSetItem::Texture_UAV(4, renderTargets.Gradients),
             nvrhi::BindingSetItem::Texture_UAV(5, currentFrame ? renderTargets.RestirLuminance : renderTargets.PrevRestirLuminance),
             nvrhi::BindingSetItem::StructuredBuffer_UAV(6, resources.GIReservoirBuffer),
+            nvrhi::BindingSetItem::Texture_UAV(7, renderTargets.GIDiffuseLighting),
+            nvrhi::BindingSetItem::Texture_UAV(8, renderTargets.GISpecularLighting),
+            nvrhi::BindingSetItem::Texture_UAV(9, renderTargets.VisibilityCache),
 
             nvrhi::BindingSetItem::TypedBuffer_UAV(10, resources.RisBuffer),
             nvrhi::BindingSetItem::TypedBuffer_UAV(11, resources.RisLightDataBuffer),
             nvrhi::BindingSetItem::TypedBuffer_UAV(12, m_profiler->GetRayCountBuffer()),
             nvrhi::BindingSetItem::StructuredBuffer_UAV(13, resources.SecondaryGBuffer),
+            nvrhi::BindingSetItem::StructuredBuffer_UAV(14, resources.BrdfRayBuffer),
+            nvrhi::BindingSetItem::TypedBuffer_UAV(15, resources.BrdfRayQueueBuffer),
+            nvrhi::BindingSetItem::TypedBuffer_UAV(16, resources.BrdfRayQueueCounterBuffer),
+            nvrhi::BindingSetItem::StructuredBuffer_UAV(17, resources.BrdfRayHitBuffer),
 
             nvrhi::BindingSetItem::ConstantBuffer(0, m_constantBuffer),
             nvrhi::BindingSetItem::PushConstants(1, sizeof(PerPassConstants)),
@@ -223,31 +296,96 @@ void LightingPasses::CreateBindingSet(
     m_localLightPdfTextureSize.x = localLightPdfDesc.width;
     m_localLightPdfTextureSize.y = localLightPdfDesc.height;
 
+    m_compactGBufferSurfaceStride = renderTargets.CompactSurfaceStride;
+
+    m_lightBufferCapacity = resources.GetLightBufferCapacity();
+    m_instancedLightCapacity = resources.GetMaxInstancedLights();
+
     m_lightReservoirBuffer = resources.LightReservoirBuffer;
     m_secondarySurfaceBuffer = resources.SecondaryGBuffer;
+    m_brdfRayBuffer = resources.BrdfRayBuffer;
+    m_brdfRayHitBuffer = resources.BrdfRayHitBuffer;
+    m_brdfRayQueueBuffer = resources.BrdfRayQueueBuffer;
+    m_brdfRayQueueCounterBuffer = resources.BrdfRayQueueCounterBuffer;
+    m_brdfRayShadingArgsBuffer = resources.BrdfRayShadingArgsBuffer;
     m_GIReservoirBuffer = resources.GIReservoirBuffer;
+    m_GIDiffuseLighting = renderTargets.GIDiffuseLighting;
+    m_GISpecularLighting = renderTargets.GISpecularLighting;
+    m_visibilityCache = renderTargets.VisibilityCache;
+    m_visibilityCacheValid = false;
+}
+
+static bool IsSameDeclaration(const char* shaderName, const std::vector<ShaderMacro>& macros, const char* newShaderName, const std::vector<ShaderMacro>& newMacros)
+{
+    if (!shaderName || strcmp(shaderName, newShaderName) != 0 || macros.size() != newMacros.size())
+        return false;
+
+    for (size_t i = 0; i < macros.size(); i++)
+    {
+        if (macros[i].name != newMacros[i].name || macros[i].definition != newMacros[i].definition)
+            return false;
+    }
+
+    return true;
 }
 
-void LightingPasses::CreateComputePass(ComputePass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros)
+void LightingPasses::DeclareComputePass(LazyComputePass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros)
 {
-    donut::log::debug("Initializing ComputePass %s...", shaderName);
+    if (IsSameDeclaration(pass.ShaderName, pass.Macros, shaderName, macros))
+        return;
 
-    pass.Shader = m_shaderFactory->CreateShader(shaderName, "main", &macros, nvrhi::ShaderType::Compute);
+    pass.ShaderName = shaderName;
+    pass.Macros = macros;
 
-    nvrhi::ComputePipelineDesc pipelineDesc;
-    pipelineDesc.bindingLayouts = { m_bindingLayout, m_bindlessLayout };
-    pipelineDesc.CS = pass.Shader;
-    pass.Pipeline = m_device->createComputePipeline(pipelineDesc);
+    // Keep the previous permutation until UpdatePipelines switches to the new one. Passes that were not used
+    // with the previous settings have nothing to fall back to, they are created on first use like before.
+    pass.Pending = m_pipelinesDeclared && pass.Pass;
+    if (!pass.Pending)
+        pass.Pass = nullptr;
 }
 
-void LightingPasses::ExecuteComputePass(nvrhi::ICommandList* commandList, ComputePass& pass, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection)
+void LightingPasses::DeclareRayTracingPass(LazyRayTracingPass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, bool useRayQuery)
 {
+    if (pass.UseRayQuery == useRayQuery && IsSameDeclaration(pass.ShaderName, pass.Macros, shaderName, macros))
+        return;
+
+    pass.ShaderName = shaderName;
+    pass.Macros = macros;
+    pass.UseRayQuery = useRayQuery;
+
+    pass.Pending = m_pipelinesDeclared && pass.Pass;
+    if (!pass.Pending)
+        pass.Pass = nullptr;
+}
+
+ComputePass* LightingPasses::ResolvePass(LazyComputePass& pass)
+{
+    if (!pass.Pass && pass.ShaderName)
+        pass.Pass = m_pipelineCache->GetComputePass(pass.ShaderName, pass.Macros);
+
+    return pass.Pass;
+}
+
+RayTracingPass* LightingPasses::ResolvePass(LazyRayTracingPass& pass)
+{
+    if (!pass.Pass && pass.ShaderName)
+        pass.Pass = m_pipelineCache->GetRayTracingPass(pass.ShaderName, pass.Macros, pass.UseRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE);
+
+    return pass.Pass;
+}
+
+void LightingPasses::ExecuteComputePass(nvrhi::ICommandList* commandList, LazyComputePass& lazyPass, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection)
+{
+    ComputePass* pass = ResolvePass(lazyPass);
+    if (!pass)
+        return;
+
     commandList->beginMarker(passName);
     m_profiler->BeginSection(commandList, profilerSection);
 
     nvrhi::ComputeState state;
     state.bindings = { m_bindingSet, m_scene->GetDescriptorTable() };
-    state.pipeline = pass.Pipeline;
+    state.pipeline = pass->Pipeline;
     commandList->setComputeState(state);
 
     PerPassConstants pushConstants{};
@@ -260,15 +398,44 @@ void LightingPasses::ExecuteComputePass(nvrhi::ICommandList* commandList, Comput
     commandList->endMarker();
 }
 
-void LightingPasses::ExecuteRayTracingPass(nvrhi::ICommandList* commandList, RayTracingPass& pass, bool enableRayCounts, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection, nvrhi::IBindingSet* extraBindingSet)
+void LightingPasses::ExecuteComputePassIndirect(nvrhi::ICommandList* commandList, LazyComputePass& lazyPass, const char* passName, nvrhi::IBuffer* argumentBuffer, ProfilerSection::Enum profilerSection)
 {
+    ComputePass* pass = ResolvePass(lazyPass);
+    if (!pass)
+        return;
+
+    commandList->beginMarker(passName);
+    m_profiler->BeginSection(commandList, profilerSection);
+
+    nvrhi::ComputeState state;
+    state.bindings = { m_bindingSet, m_scene->GetDescriptorTable() };
+    state.pipeline = pass->Pipeline;
+    state.indirectParams = argumentBuffer;
+    commandList->setComputeState(state);
+
+    PerPassConstants pushConstants{};
+    pushConstants.rayCountBufferIndex = -1;
+    commandList->setPushConstants(&pushConstants, sizeof(pushConstants));
+
+    commandList->dispatchIndirect(0);
+
+    m_profiler->EndSection(commandList, profilerSection);
+    commandList->endMarker();
+}
+
+void LightingPasses::ExecuteRayTracingPass(nvrhi::ICommandList* commandList, LazyRayTracingPass& lazyPass, bool enableRayCounts, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection, nvrhi::IBindingSet* extraBindingSet)
+{
+    RayTracingPass* pass = ResolvePass(lazyPass);
+    if (!pass)
+        return;
+
     commandList->beginMarker(passName);
     m_profiler->BeginSection(commandList, profilerSection);
 
     PerPassConstants pushConstants{};
     pushConstants.rayCountBufferIndex = enableRayCounts ? profilerSection : -1;
     
-    pass.Execute(commandList, dispatchSize.x, dispatchSize.y, m_bindingSet, extraBindingSet, m_scene->GetDescriptorTable(), &pushConstants, sizeof(pushConstants));
+    pass->Execute(commandList, dispatchSize.x, dispatchSize.y, m_bindingSet, extraBindingSet, m_scene->GetDescriptorTable(), &pushConstants, sizeof(pushConstants));
     
     m_profiler->EndSection(commandList, profilerSection);
     commandList->endMarker();
@@ -294,42 +461,85 @@ donut::engine::ShaderMacro LightingPasses::GetRegirMacro(const rtxdi::ReGIRStati
     return { "RTXDI_REGIR_MODE", regirMode };
 }
 
+uint32_t LightingPasses::GetGIDownscaleFactor(const RenderSettings& lightingSettings, const rtxdi::ReSTIRDIContext& context)
+{
+    if (context.GetStaticParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off)
+        return 1;
+
+    return std::max(lightingSettings.giDownscaleFactor, 1u);
+}
+
+RTXDI_ReservoirBufferParameters LightingPasses::GetGIReservoirBufferParameters(const rtxdi::ReSTIRDIContext& context, uint32_t giDownscaleFactor)
+{
+    if (giDownscaleFactor <= 1)
+        return context.GetReservoirBufferParameters();
+
+    const rtxdi::ReSTIRDIStaticParameters& staticParams = context.GetStaticParameters();
+
+    return rtxdi::CalculateReservoirBufferParameters(
+        (staticParams.RenderWidth + giDownscaleFactor - 1) / giDownscaleFactor,
+        (staticParams.RenderHeight + giDownscaleFactor - 1) / giDownscaleFactor,
+        rtxdi::CheckerboardMode::Off);
+}
+
 void LightingPasses::CreatePresamplingPipelines()
 {
-    CreateComputePass(m_presampleLightsPass, "app/LightingPasses/Presampling/PresampleLights.hlsl", {});
-    CreateComputePass(m_presampleEnvironmentMapPass, "app/LightingPasses/Presampling/PresampleEnvironmentMap.hlsl", {});
+    DeclareComputePass(m_presampleLightsPass, "app/LightingPasses/Presampling/PresampleLights.hlsl", {});
+    DeclareComputePass(m_presampleEnvironmentMapPass, "app/LightingPasses/Presampling/PresampleEnvironmentMap.hlsl", {});
 }
 
 void LightingPasses::CreateReGIRPipeline(const rtxdi::ReGIRStaticParameters& regirStaticParams, const std::vector<donut::engine::ShaderMacro>& regirMacros)
 {
     if (regirStaticParams.Mode != rtxdi::ReGIRMode::Disabled)
     {
-        CreateComputePass(m_presampleReGIR, "app/LightingPasses/Presampling/PresampleReGIR.hlsl", regirMacros);
+        DeclareComputePass(m_presampleReGIR, "app/LightingPasses/Presampling/PresampleReGIR.hlsl", regirMacros);
+    }
+    else
+    {
+        m_presampleReGIR = LazyComputePass();
     }
 }
 
 void LightingPasses::CreateReSTIRDIPipelines(const std::vector<donut::engine::ShaderMacro>& regirMacros, bool useRayQuery)
 {
-    m_generateInitialSamplesPass.Init(m_device, *m_shaderFactory, "app/LightingPasses/DI/GenerateInitialSamples.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_bindingLayout, nullptr, m_bindlessLayout);
-    m_temporalResamplingPass.Init(m_device, *m_shaderFactory, "app/LightingPasses/DI/TemporalResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_bindingLayout, nullptr, m_bindlessLayout);
-    m_spatialResamplingPass.Init(m_device, *m_shaderFactory, "app/LightingPasses/DI/SpatialResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_bindingLayout, nullptr, m_bindlessLayout);
-    m_shadeSamplesPass.Init(m_device, *m_shaderFactory, "app/LightingPasses/DI/ShadeSamples.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_bindingLayout, nullptr, m_bindlessLayout);
-    m_brdfRayTracingPass.Init(m_device, *m_shaderFactory, "app/LightingPasses/BrdfRayTracing.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_bindingLayout, nullptr, m_bindlessLayout);
-    m_shadeSecondarySurfacesPass.Init(m_device, *m_shaderFactory, "app/LightingPasses/ShadeSecondarySurfaces.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_bindingLayout, nullptr, m_bindlessLayout);
-    m_fusedResamplingPass.Init(m_device, *m_shaderFactory, "app/LightingPasses/DI/FusedResampling.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_bindingLayout, nullptr, m_bindlessLayout);
-    m_gradientsPass.Init(m_device, *m_shaderFactory, "app/DenoisingPasses/ComputeGradients.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_bindingLayout, nullptr, m_bindlessLayout);
+    DeclareRayTracingPass(m_generateInitialSamplesPass, "app/LightingPasses/DI/GenerateInitialSamples.hlsl", regirMacros, useRayQuery);
+    DeclareRayTracingPass(m_temporalResamplingPass, "app/LightingPasses/DI/TemporalResampling.hlsl", {}, useRayQuery);
+    DeclareRayTracingPass(m_spatialResamplingPass, "app/LightingPasses/DI/SpatialResampling.hlsl", {}, useRayQuery);
+    DeclareRayTracingPass(m_shadeSamplesPass, "app/LightingPasses/DI/ShadeSamples.hlsl", regirMacros, useRayQuery);
+    DeclareRayTracingPass(m_brdfRayTracingPass, "app/LightingPasses/BrdfRayTracing.hlsl", {}, useRayQuery);
+    // The binning and wavefront queue passes don't trace rays, but they use the bridge functions that need the USE_RAY_QUERY macro.
+    DeclareComputePass(m_brdfRayBinningPass, "app/LightingPasses/BrdfRayTracing.hlsl", { { "USE_RAY_QUERY", "1" }, { "BRDF_RAY_PASS", "BRDF_RAY_PASS_BINNING" } });
+    if (useRayQuery)
+    {
+        // The sorted BRDF ray pass relies on the compute thread layout, so it has no ray generation shader version.
+        DeclareRayTracingPass(m_sortedBrdfRayTracingPass, "app/LightingPasses/BrdfRayTracing.hlsl", { { "BRDF_RAY_PASS", "BRDF_RAY_PASS_SORTED" } }, true);
+    }
+    else
+    {
+        m_sortedBrdfRayTracingPass = LazyRayTracingPass();
+    }
+    DeclareRayTracingPass(m_wavefrontBrdfRayTracingPass, "app/LightingPasses/BrdfRayTracing.hlsl", { { "BRDF_RAY_PASS", "BRDF_RAY_PASS_WAVEFRONT_TRACE" } }, useRayQuery);
+    DeclareComputePass(m_wavefrontBrdfRayArgsPass, "app/LightingPasses/BrdfRayTracing.hlsl", { { "USE_RAY_QUERY", "1" }, { "BRDF_RAY_PASS", "BRDF_RAY_PASS_WAVEFRONT_ARGS" } });
+    DeclareComputePass(m_wavefrontBrdfRayShadingPass, "app/LightingPasses/BrdfRayTracing.hlsl", { { "USE_RAY_QUERY", "1" }, { "BRDF_RAY_PASS", "BRDF_RAY_PASS_WAVEFRONT_SHADE" } });
+    DeclareRayTracingPass(m_shadeSecondarySurfacesPass, "app/LightingPasses/ShadeSecondarySurfaces.hlsl", regirMacros, useRayQuery);
+    DeclareRayTracingPass(m_fusedResamplingPass, "app/LightingPasses/DI/FusedResampling.hlsl", regirMacros, useRayQuery);
+    DeclareRayTracingPass(m_gradientsPass, "app/DenoisingPasses/ComputeGradients.hlsl", {}, useRayQuery);
 }
 
 void LightingPasses::CreateReSTIRGIPipelines(bool useRayQuery)
 {
-    m_GITemporalResamplingPass.Init(m_device, *m_shaderFactory, "app/LightingPasses/GI/TemporalResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_bindingLayout, nullptr, m_bindlessLayout);
-    m_GISpatialResamplingPass.Init(m_device, *m_shaderFactory, "app/LightingPasses/GI/SpatialResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_bindingLayout, nullptr, m_bindlessLayout);
-    m_GIFusedResamplingPass.Init(m_device, *m_shaderFactory, "app/LightingPasses/GI/FusedResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_bindingLayout, nullptr, m_bindlessLayout);
-    m_GIFinalShadingPass.Init(m_device, *m_shaderFactory, "app/LightingPasses/GI/FinalShading.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_bindingLayout, nullptr, m_bindlessLayout);
+    DeclareRayTracingPass(m_GITemporalResamplingPass, "app/LightingPasses/GI/TemporalResampling.hlsl", {}, useRayQuery);
+    DeclareRayTracingPass(m_GISpatialResamplingPass, "app/LightingPasses/GI/SpatialResampling.hlsl", {}, useRayQuery);
+    DeclareRayTracingPass(m_GIFusedResamplingPass, "app/LightingPasses/GI/FusedResampling.hlsl", {}, useRayQuery);
+    DeclareRayTracingPass(m_GIFinalShadingPass, "app/LightingPasses/GI/FinalShading.hlsl", {}, useRayQuery);
+    // The upsampling pass doesn't trace rays, but it uses the bridge functions that need the USE_RAY_QUERY macro.
+    DeclareComputePass(m_GIUpsamplingPass, "app/LightingPasses/GI/UpsampleGI.hlsl", { { "USE_RAY_QUERY", "1" } });
 }
 
 void LightingPasses::CreatePipelines(const rtxdi::ReGIRStaticParameters& regirStaticParams, bool useRayQuery)
 {
+    // The pipelines are only created when a pass is first executed, so that the permutations that
+    // the current settings don't use cost nothing. Permutations that were used before are found in the cache.
     std::vector<donut::engine::ShaderMacro> regirMacros = {
         GetRegirMacro(regirStaticParams)
     };
@@ -338,6 +548,72 @@ void LightingPasses::CreatePipelines(const rtxdi::ReGIRStaticParameters& regirSt
     CreateReGIRPipeline(regirStaticParams, regirMacros);
     CreateReSTIRDIPipelines(regirMacros, useRayQuery);
     CreateReSTIRGIPipelines(useRayQuery);
+
+    const bool anyPending =
+        std::any_of(m_lazyComputePasses.begin(), m_lazyComputePasses.end(), [](const LazyComputePass* pass) { return pass->Pending; }) ||
+        std::any_of(m_lazyRayTracingPasses.begin(), m_lazyRayTracingPasses.end(), [](const LazyRayTracingPass* pass) { return pass->Pending; });
+
+    m_pipelinesDeclared = true;
+
+    if (!anyPending)
+        return;
+
+    // The new permutations are requested right away, so that they all compile in parallel
+    if (!m_pipelineSwitchPending)
+        m_pipelineSwitchStart = std::chrono::steady_clock::now();
+
+    m_pipelineSwitchPending = true;
+    UpdatePipelines();
+}
+
+void LightingPasses::UpdatePipelines()
+{
+    if (!m_pipelineSwitchPending)
+        return;
+
+    bool ready = true;
+    ComputePass* computePass = nullptr;
+    RayTracingPass* rayTracingPass = nullptr;
+
+    for (LazyComputePass* pass : m_lazyComputePasses)
+    {
+        if (pass->Pending && !m_pipelineCache->RequestComputePass(pass->ShaderName, pass->Macros, computePass))
+            ready = false;
+    }
+
+    for (LazyRayTracingPass* pass : m_lazyRayTracingPasses)
+    {
+        if (pass->Pending && !m_pipelineCache->RequestRayTracingPass(pass->ShaderName, pass->Macros, pass->UseRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, rayTracingPass))
+            ready = false;
+    }
+
+    if (!ready)
+        return;
+
+    // Everything is in the cache now, so these requests return the passes immediately.
+    // Switching all passes in the same frame avoids mixing permutations with different settings.
+    for (LazyComputePass* pass : m_lazyComputePasses)
+    {
+        if (pass->Pending)
+        {
+            m_pipelineCache->RequestComputePass(pass->ShaderName, pass->Macros, pass->Pass);
+            pass->Pending = false;
+        }
+    }
+
+    for (LazyRayTracingPass* pass : m_lazyRayTracingPasses)
+    {
+        if (pass->Pending)
+        {
+            m_pipelineCache->RequestRayTracingPass(pass->ShaderName, pass->Macros, pass->UseRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, pass->Pass);
+            pass->Pending = false;
+        }
+    }
+
+    m_pipelineSwitchPending = false;
+
+    const double switchTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_pipelineSwitchStart).count();
+    donut::log::info("LightingPasses: switched to the new pipelines after %.1f ms", switchTimeMs);
 }
 
 #if WITH_NRD
@@ -440,6 +716,14 @@ void LightingPasses::FillResamplingConstants(
     constants.sceneConstants.enableAlphaTestedGeometry = lightingSettings.enableAlphaTestedGeometry;
     constants.sceneConstants.enableTransparentGeometry = lightingSettings.enableTransparentGeometry;
     constants.visualizeRegirCells = lightingSettings.visualizeRegirCells;
+    constants.enableCompactGBufferSurfaces = lightingSettings.enableCompactGBufferSurfaces;
+    constants.compactGBufferSurfaceStride = m_compactGBufferSurfaceStride;
+    constants.enableAdaptiveSampleBudget = lightingSettings.enableAdaptiveSampleBudget;
+    constants.adaptiveBudgetMinScale = lightingSettings.adaptiveBudgetMinScale;
+    constants.adaptiveBudgetMaxScale = lightingSettings.adaptiveBudgetMaxScale;
+    constants.enableVisibilityCache = lightingSettings.enableVisibilityCache;
+    constants.visibilityCacheRefreshPeriod = lightingSettings.visibilityCacheRefreshPeriod;
+    constants.visibilityCacheMaxDistance = lightingSettings.visibilityCacheMaxDistance;
 #if WITH_NRD
     if (lightingSettings.denoiserMode != DENOISER_MODE_OFF)
     {
@@ -457,6 +741,9 @@ void LightingPasses::FillResamplingConstants(
     FillReSTIRGIConstants(constants.restirGI, isContext.GetReSTIRGIContext());
 
     constants.localLightPdfTextureSize = m_localLightPdfTextureSize;
+    constants.lightBufferCapacity = m_lightBufferCapacity;
+    constants.instancedLightCapacity = m_instancedLightCapacity;
+    constants.instancedLightCounts = m_instancedLightCounts;
 
     if (lightBufferParameters.environmentLightParams.lightPresent)
     {
@@ -466,7 +753,7 @@ void LightingPasses::FillResamplingConstants(
     m_currentFrameOutputReservoir = isContext.GetReSTIRDIContext().GetBufferIndices().shadingInputBufferIndex;
 }
 
-void LightingPasses::PrepareForLightSampling(
+void LightingPasses::UpdateSamplingConstants(
     nvrhi::ICommandList* commandList,
     rtxdi::ImportanceSamplingContext& isContext,
     const donut::engine::IView& view,
@@ -475,7 +762,6 @@ void LightingPasses::PrepareForLightSampling(
     bool enableAccumulation)
 {
     rtxdi::ReSTIRDIContext& restirDIContext = isContext.GetReSTIRDIContext();
-    rtxdi::ReGIRContext& regirContext = isContext.GetReGIRContext();
 
     ResamplingConstants constants = {};
     constants.frameIndex = restirDIContext.GetFrameIndex();
@@ -485,6 +771,26 @@ void LightingPasses::PrepareForLightSampling(
     constants.enableAccumulation = enableAccumulation;
 
     commandList->writeBuffer(m_constantBuffer, &constants, sizeof(constants));
+}
+
+void LightingPasses::ResolveLightSamplingPasses()
+{
+    ResolvePass(m_presampleLightsPass);
+    ResolvePass(m_presampleEnvironmentMapPass);
+    ResolvePass(m_presampleReGIR);
+}
+
+void LightingPasses::PrepareForLightSampling(
+    nvrhi::ICommandList* commandList,
+    rtxdi::ImportanceSamplingContext& isContext,
+    const donut::engine::IView& view,
+    const donut::engine::IView& previousView,
+    const RenderSettings& localSettings,
+    bool enableAccumulation)
+{
+    rtxdi::ReGIRContext& regirContext = isContext.GetReGIRContext();
+
+    UpdateSamplingConstants(commandList, isContext, view, previousView, localSettings, enableAccumulation);
 
     auto& lightBufferParams = isContext.GetLightBufferParameters();
 
@@ -535,6 +841,14 @@ void LightingPasses::RenderDirectLighting(
     if (context.GetStaticParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off)
         dispatchSize.x /= 2;
 
+    // The cache entries are not updated while the cache is disabled, so they are discarded when it's enabled again,
+    // as well as when the render targets are recreated.
+    if (localSettings.enableVisibilityCache && !m_visibilityCacheValid)
+    {
+        commandList->clearTextureUInt(m_visibilityCache, nvrhi::AllSubresources, ~0u);
+    }
+    m_visibilityCacheValid = localSettings.enableVisibilityCache;
+
     // Run the lighting passes in the necessary sequence: one fused kernel or multiple separate passes.
     //
     // Note: the below code places explicit UAV barriers between subsequent passes
@@ -614,6 +928,21 @@ void LightingPasses::RenderBrdfRays(
     constants.brdfPT.enableIndirectEmissiveSurfaces = enableEmissiveSurfaces;
     constants.brdfPT.enableReSTIRGI = enableReSTIRGI;
 
+    // Reduced resolution GI runs the whole BRDF ray and ReSTIR GI chain on a coarser pixel grid,
+    // accumulates its output in the GI lighting textures, and resolves that with UpsampleGI.hlsl.
+    const uint32_t giDownscaleFactor = (enableIndirect && enableReSTIRGI)
+        ? GetGIDownscaleFactor(localSettings, restirDIContext)
+        : 1;
+
+    if (giDownscaleFactor > 1)
+    {
+        constants.giDownscaleFactor = giDownscaleFactor;
+        constants.restirGI.reservoirBufferParams = GetGIReservoirBufferParameters(restirDIContext, giDownscaleFactor);
+
+        // Secondary resampling looks up the DI reservoirs at render resolution pixel positions
+        constants.brdfPT.enableSecondaryResampling = false;
+    }
+
     ReSTIRGI_BufferIndices restirGIBufferIndices = restirGIContext.GetBufferIndices();
     m_currentFrameGIOutputReservoir = restirGIBufferIndices.finalShadingInputBufferIndex;
 
@@ -627,7 +956,59 @@ void LightingPasses::RenderBrdfRays(
     if (restirDIContext.GetStaticParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off)
         dispatchSize.x /= 2;
 
-    ExecuteRayTracingPass(commandList, m_brdfRayTracingPass, localSettings.enableRayCounts, "BrdfRayTracingPass", dispatchSize, ProfilerSection::BrdfRays);
+    const dm::int2 renderDispatchSize = dispatchSize;
+
+    if (giDownscaleFactor > 1)
+    {
+        dispatchSize = (dispatchSize + int(giDownscaleFactor) - 1) / int(giDownscaleFactor);
+
+        commandList->clearTextureFloat(m_GIDiffuseLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
+        commandList->clearTextureFloat(m_GISpecularLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
+    }
+
+    if (localSettings.enableWavefrontBrdfRays)
+    {
+        const dm::int2 tileCount = (dispatchSize + BRDF_RAY_BIN_TILE_SIZE - 1) / BRDF_RAY_BIN_TILE_SIZE;
+
+        ExecuteComputePass(commandList, m_brdfRayBinningPass, "BrdfRayBinning", tileCount, ProfilerSection::BrdfRayBinning);
+
+        commandList->clearBufferUInt(m_brdfRayQueueCounterBuffer, 0);
+
+        // Place explicit UAV barriers between the passes. See the note on barriers in RenderDirectLighting(...)
+        nvrhi::utils::BufferUavBarrier(commandList, m_brdfRayBuffer);
+
+        // The wavefront passes only trace rays in the trace pass, which is the one to compare between RayQuery and TraceRay.
+        ExecuteRayTracingPass(commandList, m_wavefrontBrdfRayTracingPass, localSettings.enableRayCounts, "WavefrontBrdfRayTracing", tileCount * BRDF_RAY_BIN_TILE_SIZE, ProfilerSection::BrdfRays);
+
+        nvrhi::utils::BufferUavBarrier(commandList, m_brdfRayQueueCounterBuffer);
+
+        ExecuteComputePass(commandList, m_wavefrontBrdfRayArgsPass, "WavefrontBrdfRayArgs", dm::int2(1, 1), ProfilerSection::BrdfRayHitShading);
+
+        commandList->copyBuffer(m_brdfRayShadingArgsBuffer, 0, m_brdfRayQueueCounterBuffer, BRDF_RAY_QUEUE_DISPATCH_ARGS * sizeof(uint32_t), sizeof(uint32_t) * 3);
+
+        // The copy transitions the counter buffer out of the UAV state, which is enough to order it with the shading pass.
+        nvrhi::utils::BufferUavBarrier(commandList, m_brdfRayQueueBuffer);
+        nvrhi::utils::BufferUavBarrier(commandList, m_brdfRayHitBuffer);
+
+        ExecuteComputePassIndirect(commandList, m_wavefrontBrdfRayShadingPass, "WavefrontBrdfRayShading", m_brdfRayShadingArgsBuffer, ProfilerSection::BrdfRayHitShading);
+    }
+    // The sorted pass is only declared in RayQuery mode.
+    else if (localSettings.enableSortedBrdfRays && m_sortedBrdfRayTracingPass.ShaderName)
+    {
+        const dm::int2 tileCount = (dispatchSize + BRDF_RAY_BIN_TILE_SIZE - 1) / BRDF_RAY_BIN_TILE_SIZE;
+
+        ExecuteComputePass(commandList, m_brdfRayBinningPass, "BrdfRayBinning", tileCount, ProfilerSection::BrdfRayBinning);
+
+        // Place an explicit UAV barrier between the passes. See the note on barriers in RenderDirectLighting(...)
+        nvrhi::utils::BufferUavBarrier(commandList, m_brdfRayBuffer);
+
+        // The sorted pass reads whole tiles, so it must cover all of them even when the view size is not a multiple of the tile size.
+        ExecuteRayTracingPass(commandList, m_sortedBrdfRayTracingPass, localSettings.enableRayCounts, "SortedBrdfRayTracing", tileCount * BRDF_RAY_BIN_TILE_SIZE, ProfilerSection::BrdfRays);
+    }
+    else
+    {
+        ExecuteRayTracingPass(commandList, m_brdfRayTracingPass, localSettings.enableRayCounts, "BrdfRayTracingPass", dispatchSize, ProfilerSection::BrdfRays);
+    }
 
     if (enableIndirect)
     {
@@ -667,6 +1048,15 @@ void LightingPasses::RenderBrdfRays(
             nvrhi::utils::BufferUavBarrier(commandList, m_GIReservoirBuffer);
 
             ExecuteRayTracingPass(commandList, m_GIFinalShadingPass, localSettings.enableRayCounts, "GIFinalShading", dispatchSize, ProfilerSection::GIFinalShading, nullptr);
+
+            if (giDownscaleFactor > 1)
+            {
+                nvrhi::utils::TextureUavBarrier(commandList, m_GIDiffuseLighting);
+                nvrhi::utils::TextureUavBarrier(commandList, m_GISpecularLighting);
+
+                ExecuteComputePass(commandList, m_GIUpsamplingPass, "GIUpsampling",
+                    (renderDispatchSize + RTXDI_SCREEN_SPACE_GROUP_SIZE - 1) / RTXDI_SCREEN_SPACE_GROUP_SIZE, ProfilerSection::GIUpsampling);
+            }
         }
     }
 }
@@ -10,11 +10,12 @@
 
 #pragma once
 
-#include "RayTracingPass.h"
+#include "PipelineCache.h"
 #include "../ProfilerSections.h"
 
 #include <donut/core/math/math.h>
 #include <nvrhi/nvrhi.h>
+#include <chrono>
 #include <memory>
 
 #include <Rtxdi/DI/ReSTIRDIParameters.h>
@@ -68,12 +69,29 @@ public:
         ibool enableTransparentGeometry = true;
         ibool enableRayCounts = true;
         ibool visualizeRegirCells = false;
+        ibool enableCompactGBufferSurfaces = false; // Read the G-buffer through the compact surface buffer, see CompactGBuffer.hlsli
+        ibool enableSortedBrdfRays = false; // Bin the BRDF rays by direction octant before tracing them, RayQuery only
+        ibool enableWavefrontBrdfRays = false; // Trace the binned BRDF rays without shading, then shade the hits from per-material-domain queues
+        uint32_t giDownscaleFactor = 1; // Run the ReSTIR GI passes at 1/2 or 1/4 of the render resolution and upsample the result
         
         ibool enableGradients = true;
         float gradientLogDarknessBias = -12.f;
         float gradientSensitivity = 8.f;
         float confidenceHistoryLength = 0.75f;
 
+        // Scale the DI initial sample and spatial tap counts per tile by the previous frame's confidence:
+        // tiles with zero confidence use adaptiveBudgetMaxScale, tiles with full confidence use adaptiveBudgetMinScale.
+        ibool enableAdaptiveSampleBudget = false;
+        float adaptiveBudgetMinScale = 0.5f;
+        float adaptiveBudgetMaxScale = 2.f;
+
+        // Reuse the final visibility of the previous frame in the DI shading passes when the pixel keeps the same light sample
+        // and surface position, within visibilityCacheMaxDistance relative to their distances. 1/visibilityCacheRefreshPeriod
+        // of the pixels trace the visibility ray anyway on each frame to pick up changes in the occluders.
+        ibool enableVisibilityCache = false;
+        uint32_t visibilityCacheRefreshPeriod = 8;
+        float visibilityCacheMaxDistance = 0.005f;
+
         BRDFPathTracing_Parameters brdfptParams = GetDefaultBRDFPathTracingParams();
         
 #if WITH_NRD
@@ -90,14 +108,43 @@ public:
         std::shared_ptr<Profiler> profiler,
         nvrhi::IBindingLayout* bindlessLayout);
 
+    ~LightingPasses();
+
+    // Declares the pass permutations for the given settings. The pipelines are created on first use and cached, see PipelineCache.
+    // When the settings change later, the new permutations are created on worker threads and the passes keep using
+    // the previous ones until UpdatePipelines switches to the new set.
     void CreatePipelines(const rtxdi::ReGIRStaticParameters& regirStaticParams, bool useRayQuery);
 
+    // Must be called once per frame before the passes are recorded. Switches all passes at once when
+    // the permutations requested by CreatePipelines are ready.
+    void UpdatePipelines();
+
+    [[nodiscard]] bool IsSwitchingPipelines() const { return m_pipelineSwitchPending; }
+
+    // Must be called after the shaders are reloaded, before CreatePipelines.
+    void ClearPipelineCache();
+
     void CreateBindingSet(
         nvrhi::rt::IAccelStruct* topLevelAS,
         nvrhi::rt::IAccelStruct* prevTopLevelAS,
         const RenderTargets& renderTargets,
         const RtxdiResources& resources);
 
+    // Writes the constants used by the presampling and direct lighting passes. The constant buffer is volatile,
+    // so this must be called on every command list that records those passes - PrepareForLightSampling does it.
+    void UpdateSamplingConstants(
+        nvrhi::ICommandList* commandList,
+        rtxdi::ImportanceSamplingContext& context,
+        const donut::engine::IView& view,
+        const donut::engine::IView& previousView,
+        const RenderSettings& localSettings,
+        bool enableAccumulation);
+
+    // Creates the presampling pipelines that PrepareForLightSampling can use, if they are not created yet.
+    // Pipeline creation goes through the shader factory, which is not thread safe, so this must be called
+    // before PrepareForLightSampling is recorded on a worker thread.
+    void ResolveLightSamplingPasses();
+
     void PrepareForLightSampling(
         nvrhi::ICommandList* commandList,
         rtxdi::ImportanceSamplingContext& context,
@@ -129,6 +176,9 @@ public:
 
     void NextFrame();
 
+    // Number of instanced lights at the start of each half of the light buffer, from PrepareLightsPass
+    void SetInstancedLightCounts(const dm::uint2& counts) { m_instancedLightCounts = counts; }
+
     [[nodiscard]] nvrhi::IBindingLayout* GetBindingLayout() const;
     [[nodiscard]] nvrhi::IBindingSet* GetCurrentBindingSet() const;
     [[nodiscard]] uint32_t GetOutputReservoirBufferIndex() const;
@@ -136,6 +186,14 @@ public:
 
     static donut::engine::ShaderMacro GetRegirMacro(const rtxdi::ReGIRStaticParameters& regirStaticParams);
 
+    // Returns the downscale factor that the ReSTIR GI passes actually use: reduced resolution GI is not supported
+    // with checkerboard rendering, so that falls back to the render resolution.
+    static uint32_t GetGIDownscaleFactor(const RenderSettings& lightingSettings, const rtxdi::ReSTIRDIContext& context);
+
+    // Returns the reservoir layout of the ReSTIR GI passes for the given downscale factor,
+    // which also determines the size of RtxdiResources::GIReservoirBuffer.
+    static RTXDI_ReservoirBufferParameters GetGIReservoirBufferParameters(const rtxdi::ReSTIRDIContext& context, uint32_t giDownscaleFactor);
+
 private:
     void FillResamplingConstants(
         ResamplingConstants& constants,
@@ -147,33 +205,64 @@ private:
     void CreateReSTIRDIPipelines(const std::vector<donut::engine::ShaderMacro>& regirMacros, bool useRayQuery);
     void CreateReSTIRGIPipelines(bool useRayQuery);
 
-    struct ComputePass
+    // A pass permutation declared by CreatePipelines and looked up in the pipeline cache when it's first executed.
+    // Passes without a shader name are not used with the current settings.
+    // While a pass is pending, Pass is the previous permutation (or nullptr if there was none) and the declared one
+    // is being created in the background.
+    struct LazyComputePass
+    {
+        const char* ShaderName = nullptr;
+        std::vector<donut::engine::ShaderMacro> Macros;
+        ComputePass* Pass = nullptr;
+        bool Pending = false;
+    };
+
+    struct LazyRayTracingPass
     {
-        nvrhi::ShaderHandle Shader;
-        nvrhi::ComputePipelineHandle Pipeline;
+        const char* ShaderName = nullptr;
+        std::vector<donut::engine::ShaderMacro> Macros;
+        bool UseRayQuery = false;
+        RayTracingPass* Pass = nullptr;
+        bool Pending = false;
     };
 
-    void CreateComputePass(ComputePass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros);
-    void ExecuteComputePass(nvrhi::ICommandList* commandList, ComputePass& pass, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection);
-    void ExecuteRayTracingPass(nvrhi::ICommandList* commandList, RayTracingPass& pass, bool enableRayCounts, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection, nvrhi::IBindingSet* extraBindingSet = nullptr);
+    void DeclareComputePass(LazyComputePass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros);
+    void DeclareRayTracingPass(LazyRayTracingPass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, bool useRayQuery);
+    ComputePass* ResolvePass(LazyComputePass& pass);
+    RayTracingPass* ResolvePass(LazyRayTracingPass& pass);
+    void ExecuteComputePass(nvrhi::ICommandList* commandList, LazyComputePass& pass, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection);
+    void ExecuteComputePassIndirect(nvrhi::ICommandList* commandList, LazyComputePass& pass, const char* passName, nvrhi::IBuffer* argumentBuffer, ProfilerSection::Enum profilerSection);
+    void ExecuteRayTracingPass(nvrhi::ICommandList* commandList, LazyRayTracingPass& pass, bool enableRayCounts, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection, nvrhi::IBindingSet* extraBindingSet = nullptr);
 
     nvrhi::DeviceHandle m_device;
 
-    ComputePass m_presampleLightsPass;
-    ComputePass m_presampleEnvironmentMapPass;
-    ComputePass m_presampleReGIR;
-    RayTracingPass m_generateInitialSamplesPass;
-    RayTracingPass m_temporalResamplingPass;
-    RayTracingPass m_spatialResamplingPass;
-    RayTracingPass m_shadeSamplesPass;
-    RayTracingPass m_brdfRayTracingPass;
-    RayTracingPass m_shadeSecondarySurfacesPass;
-    RayTracingPass m_fusedResamplingPass;
-    RayTracingPass m_gradientsPass;
-    RayTracingPass m_GITemporalResamplingPass;
-    RayTracingPass m_GISpatialResamplingPass;
-    RayTracingPass m_GIFusedResamplingPass;
-    RayTracingPass m_GIFinalShadingPass;
+    std::unique_ptr<PipelineCache> m_pipelineCache;
+    LazyComputePass m_presampleLightsPass;
+    LazyComputePass m_presampleEnvironmentMapPass;
+    LazyComputePass m_presampleReGIR;
+    LazyRayTracingPass m_generateInitialSamplesPass;
+    LazyRayTracingPass m_temporalResamplingPass;
+    LazyRayTracingPass m_spatialResamplingPass;
+    LazyRayTracingPass m_shadeSamplesPass;
+    LazyRayTracingPass m_brdfRayTracingPass;
+    LazyComputePass m_brdfRayBinningPass;
+    LazyRayTracingPass m_sortedBrdfRayTracingPass;
+    LazyRayTracingPass m_wavefrontBrdfRayTracingPass;
+    LazyComputePass m_wavefrontBrdfRayArgsPass;
+    LazyComputePass m_wavefrontBrdfRayShadingPass;
+    LazyRayTracingPass m_shadeSecondarySurfacesPass;
+    LazyRayTracingPass m_fusedResamplingPass;
+    LazyRayTracingPass m_gradientsPass;
+    LazyRayTracingPass m_GITemporalResamplingPass;
+    LazyRayTracingPass m_GISpatialResamplingPass;
+    LazyRayTracingPass m_GIFusedResamplingPass;
+    LazyRayTracingPass m_GIFinalShadingPass;
+    LazyComputePass m_GIUpsamplingPass;
+    std::vector<LazyComputePass*> m_lazyComputePasses;
+    std::vector<LazyRayTracingPass*> m_lazyRayTracingPasses;
+    bool m_pipelinesDeclared = false;
+    bool m_pipelineSwitchPending = false;
+    std::chrono::steady_clock::time_point m_pipelineSwitchStart;
     nvrhi::BindingLayoutHandle m_bindingLayout;
     nvrhi::BindingLayoutHandle m_bindlessLayout;
     nvrhi::BindingSetHandle m_bindingSet;
@@ -181,10 +270,23 @@ private:
     nvrhi::BufferHandle m_constantBuffer;
     nvrhi::BufferHandle m_lightReservoirBuffer;
     nvrhi::BufferHandle m_secondarySurfaceBuffer;
+    nvrhi::BufferHandle m_brdfRayBuffer;
+    nvrhi::BufferHandle m_brdfRayHitBuffer;
+    nvrhi::BufferHandle m_brdfRayQueueBuffer;
+    nvrhi::BufferHandle m_brdfRayQueueCounterBuffer;
+    nvrhi::BufferHandle m_brdfRayShadingArgsBuffer;
     nvrhi::BufferHandle m_GIReservoirBuffer;
+    nvrhi::TextureHandle m_GIDiffuseLighting;
+    nvrhi::TextureHandle m_GISpecularLighting;
+    nvrhi::TextureHandle m_visibilityCache;
+    bool m_visibilityCacheValid = false;
 
     dm::uint2 m_environmentPdfTextureSize;
     dm::uint2 m_localLightPdfTextureSize;
+    uint32_t m_compactGBufferSurfaceStride = 0;
+    uint32_t m_lightBufferCapacity = 0;
+    uint32_t m_instancedLightCapacity = 0;
+    dm::uint2 m_instancedLightCounts = dm::uint2(0u);
 
     uint32_t m_lastFrameOutputReservoir = 0;
     uint32_t m_currentFrameOutputReservoir = 0;
@@ -0,0 +1,249 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "PipelineCache.h"
+
+#include <donut/engine/ShaderFactory.h>
+#include <donut/core/log.h>
+
+#include <chrono>
+#include <utility>
+
+using namespace donut::engine;
+
+PipelineCache::PipelineCache(
+    nvrhi::IDevice* device,
+    std::shared_ptr<donut::engine::ShaderFactory> shaderFactory,
+    nvrhi::IBindingLayout* bindingLayout,
+    nvrhi::IBindingLayout* bindlessLayout,
+    const char* name)
+    : m_device(device)
+    , m_shaderFactory(std::move(shaderFactory))
+    , m_bindingLayout(bindingLayout)
+    , m_bindlessLayout(bindlessLayout)
+    , m_name(name)
+{
+}
+
+PipelineCache::~PipelineCache()
+{
+    Clear();
+    LogStatistics();
+}
+
+std::string PipelineCache::MakeKey(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, const char* passType)
+{
+    std::string key = shaderName;
+    key += '|';
+    key += passType;
+
+    for (const auto& macro : macros)
+    {
+        key += '|';
+        key += macro.name;
+        key += '=';
+        key += macro.definition;
+    }
+
+    return key;
+}
+
+template<typename PassType>
+void PipelineCache::CollectCreation(Entry<PassType>& entry, const std::string& key, const CreationResult& result)
+{
+    m_statistics.creationTimeMs += result.timeMs;
+
+    if (result.success)
+    {
+        donut::log::debug("%s: created %s in %.1f ms", m_name.c_str(), key.c_str(), result.timeMs);
+    }
+    else
+    {
+        donut::log::warning("%s: failed to create the pipeline for %s", m_name.c_str(), key.c_str());
+        ++m_statistics.failures;
+        entry.Pass = nullptr; // Remember the failure, so that the creation is not attempted on every frame
+    }
+}
+
+template<typename PassType, typename LoadFunc, typename CreateFunc>
+bool PipelineCache::FindOrCreate(EntryMap<PassType>& entries, const std::string& key, bool async,
+    const LoadFunc& loadShaders, const CreateFunc& createPipeline, PassType*& pass)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto it = entries.find(key);
+    if (it == entries.end())
+    {
+        ++m_statistics.misses;
+
+        Entry<PassType>& entry = entries[key];
+        entry.Pass = std::make_unique<PassType>();
+
+        // The shader factory is not thread safe, so the shaders are loaded with the lock held.
+        // Only the pipeline creation, which calls into the device, runs on the worker thread.
+        const bool shadersLoaded = loadShaders(*entry.Pass);
+
+        auto task = [passPtr = entry.Pass.get(), shadersLoaded, createPipeline]()
+        {
+            const auto startTime = std::chrono::steady_clock::now();
+
+            CreationResult result;
+            result.success = shadersLoaded && createPipeline(*passPtr);
+            result.timeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+            return result;
+        };
+
+        if (async && shadersLoaded)
+        {
+            entry.Creation = std::async(std::launch::async, task).share();
+            pass = nullptr;
+            return false;
+        }
+
+        CollectCreation(entry, key, task());
+        pass = entry.Pass.get();
+        return true;
+    }
+
+    ++m_statistics.hits;
+
+    if (it->second.Creation.valid())
+    {
+        std::shared_future<CreationResult> creation = it->second.Creation;
+
+        if (creation.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            if (async)
+            {
+                pass = nullptr;
+                return false;
+            }
+
+            // Let the other threads use the cache while this one waits
+            lock.unlock();
+            creation.wait();
+            lock.lock();
+
+            // The entry may have been collected by another thread, or dropped by Clear(), in the meantime
+            it = entries.find(key);
+            if (it == entries.end())
+            {
+                pass = nullptr;
+                return true;
+            }
+        }
+
+        if (it->second.Creation.valid())
+        {
+            CollectCreation(it->second, key, it->second.Creation.get());
+            it->second.Creation = std::shared_future<CreationResult>();
+        }
+    }
+
+    pass = it->second.Pass.get();
+    return true;
+}
+
+bool PipelineCache::FindOrCreateRayTracingPass(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, bool useRayQuery, uint32_t computeGroupSize, bool async, RayTracingPass*& pass)
+{
+    const std::string key = MakeKey(shaderName, macros, useRayQuery ? "RayQuery" : "TraceRay");
+
+    return FindOrCreate(m_rayTracingPasses, key, async,
+        [&](RayTracingPass& newPass)
+        {
+            return newPass.LoadShaders(*m_shaderFactory, shaderName, macros, useRayQuery);
+        },
+        [this, computeGroupSize](RayTracingPass& newPass)
+        {
+            return newPass.CreatePipeline(m_device, computeGroupSize, m_bindingLayout, nullptr, m_bindlessLayout);
+        },
+        pass);
+}
+
+bool PipelineCache::FindOrCreateComputePass(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, bool async, ComputePass*& pass)
+{
+    const std::string key = MakeKey(shaderName, macros, "Compute");
+
+    return FindOrCreate(m_computePasses, key, async,
+        [&](ComputePass& newPass)
+        {
+            newPass.Shader = m_shaderFactory->CreateShader(shaderName, "main", &macros, nvrhi::ShaderType::Compute);
+            return newPass.Shader != nullptr;
+        },
+        [this](ComputePass& newPass)
+        {
+            nvrhi::ComputePipelineDesc pipelineDesc;
+            pipelineDesc.bindingLayouts = { m_bindingLayout, m_bindlessLayout };
+            pipelineDesc.CS = newPass.Shader;
+            newPass.Pipeline = m_device->createComputePipeline(pipelineDesc);
+            return newPass.Pipeline != nullptr;
+        },
+        pass);
+}
+
+RayTracingPass* PipelineCache::GetRayTracingPass(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, bool useRayQuery, uint32_t computeGroupSize)
+{
+    RayTracingPass* pass = nullptr;
+    FindOrCreateRayTracingPass(shaderName, macros, useRayQuery, computeGroupSize, false, pass);
+    return pass;
+}
+
+ComputePass* PipelineCache::GetComputePass(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros)
+{
+    ComputePass* pass = nullptr;
+    FindOrCreateComputePass(shaderName, macros, false, pass);
+    return pass;
+}
+
+bool PipelineCache::RequestRayTracingPass(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, bool useRayQuery, uint32_t computeGroupSize, RayTracingPass*& pass)
+{
+    return FindOrCreateRayTracingPass(shaderName, macros, useRayQuery, computeGroupSize, true, pass);
+}
+
+bool PipelineCache::RequestComputePass(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, ComputePass*& pass)
+{
+    return FindOrCreateComputePass(shaderName, macros, true, pass);
+}
+
+void PipelineCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // The worker threads don't take the lock, so they can finish while it's held
+    for (auto& [key, entry] : m_rayTracingPasses)
+    {
+        if (entry.Creation.valid())
+            entry.Creation.wait();
+    }
+
+    for (auto& [key, entry] : m_computePasses)
+    {
+        if (entry.Creation.valid())
+            entry.Creation.wait();
+    }
+
+    m_rayTracingPasses.clear();
+    m_computePasses.clear();
+}
+
+void PipelineCache::LogStatistics() const
+{
+    const Statistics statistics = GetStatistics();
+
+    donut::log::info("%s permutation cache: %u hits, %u misses (%u failed), %.1f ms spent creating pipelines",
+        m_name.c_str(), statistics.hits, statistics.misses, statistics.failures, statistics.creationTimeMs);
+}
+
+PipelineCache::Statistics PipelineCache::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_statistics;
+}
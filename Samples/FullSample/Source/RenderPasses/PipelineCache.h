@@ -0,0 +1,123 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "RayTracingPass.h"
+
+#include <nvrhi/nvrhi.h>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace donut::engine
+{
+    class ShaderFactory;
+    struct ShaderMacro;
+}
+
+struct ComputePass
+{
+    nvrhi::ShaderHandle Shader;
+    nvrhi::ComputePipelineHandle Pipeline;
+};
+
+// An in-memory map from pass permutations to pipelines, for a group of passes that share their binding layouts.
+// A permutation is created on first use and kept until Clear() is called. The key of a permutation is its shader name,
+// macros and pass type, so declaring the same passes again - for example after the RTXDI context is re-created - only
+// costs a lookup. The lookups are thread safe, so the passes can be resolved from parallel command recording.
+//
+// Nothing is written to disk: NVRHI creates the driver pipelines internally and doesn't accept an application-owned
+// VkPipelineCache or ID3D12PipelineLibrary, so reuse across runs is left to the driver's own shader cache.
+//
+// The Request functions create the pipelines on worker threads instead: the shaders are loaded on the calling thread,
+// and only the driver compilation runs in the background.
+class PipelineCache
+{
+public:
+    struct Statistics
+    {
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+        uint32_t failures = 0;
+        double creationTimeMs = 0.0;
+    };
+
+    PipelineCache(
+        nvrhi::IDevice* device,
+        std::shared_ptr<donut::engine::ShaderFactory> shaderFactory,
+        nvrhi::IBindingLayout* bindingLayout,
+        nvrhi::IBindingLayout* bindlessLayout,
+        const char* name);
+
+    ~PipelineCache();
+
+    // Both functions return nullptr if the pipeline cannot be created. The returned passes stay valid until Clear().
+    // If the permutation is being created on a worker thread, they wait for it.
+    RayTracingPass* GetRayTracingPass(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, bool useRayQuery, uint32_t computeGroupSize);
+    ComputePass* GetComputePass(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros);
+
+    // Non-blocking versions: start creating the permutation on a worker thread if it's not in the cache yet.
+    // Return false while the pipeline is being created. Once they return true, 'pass' is set like in the Get functions.
+    bool RequestRayTracingPass(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, bool useRayQuery, uint32_t computeGroupSize, RayTracingPass*& pass);
+    bool RequestComputePass(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, ComputePass*& pass);
+
+    // Waits for the background work and drops all pipelines, must be called when the shaders are reloaded.
+    void Clear();
+
+    void LogStatistics() const;
+    [[nodiscard]] Statistics GetStatistics() const;
+
+private:
+    struct CreationResult
+    {
+        bool success = false;
+        double timeMs = 0.0;
+    };
+
+    template<typename PassType>
+    struct Entry
+    {
+        std::unique_ptr<PassType> Pass;
+        std::shared_future<CreationResult> Creation; // Valid until the result of a background creation is collected
+    };
+
+    template<typename PassType>
+    using EntryMap = std::unordered_map<std::string, Entry<PassType>>;
+
+    static std::string MakeKey(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, const char* passType);
+
+    // Finds or creates the entry of a permutation, and sets 'pass' when the entry is ready.
+    // In async mode, returns false while the pipeline is being created instead of waiting for it.
+    template<typename PassType, typename LoadFunc, typename CreateFunc>
+    bool FindOrCreate(EntryMap<PassType>& entries, const std::string& key, bool async,
+        const LoadFunc& loadShaders, const CreateFunc& createPipeline, PassType*& pass);
+
+    bool FindOrCreateRayTracingPass(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, bool useRayQuery, uint32_t computeGroupSize, bool async, RayTracingPass*& pass);
+    bool FindOrCreateComputePass(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, bool async, ComputePass*& pass);
+
+    // Updates the statistics with the result of a creation, and drops the pass if it failed. Called with m_mutex locked.
+    template<typename PassType>
+    void CollectCreation(Entry<PassType>& entry, const std::string& key, const CreationResult& result);
+
+    nvrhi::DeviceHandle m_device;
+    std::shared_ptr<donut::engine::ShaderFactory> m_shaderFactory;
+    nvrhi::BindingLayoutHandle m_bindingLayout;
+    nvrhi::BindingLayoutHandle m_bindlessLayout;
+    std::string m_name;
+
+    mutable std::mutex m_mutex;
+    EntryMap<RayTracingPass> m_rayTracingPasses;
+    EntryMap<ComputePass> m_computePasses;
+    Statistics m_statistics;
+};
@@ -46,6 +46,8 @@ PrepareLightsPass::PrepareLightsPass(
         nvrhi::BindingLayoutItem::StructuredBuffer_UAV(0),
         nvrhi::BindingLayoutItem::TypedBuffer_UAV(1),
         nvrhi::BindingLayoutItem::Texture_UAV(2),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(3),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(4),
         nvrhi::BindingLayoutItem::StructuredBuffer_SRV(0),
         nvrhi::BindingLayoutItem::StructuredBuffer_SRV(1),
         nvrhi::BindingLayoutItem::StructuredBuffer_SRV(2),
@@ -77,6 +79,8 @@ void PrepareLightsPass::CreateBindingSet(RtxdiResources& resources)
         nvrhi::BindingSetItem::StructuredBuffer_UAV(0, resources.LightDataBuffer),
         nvrhi::BindingSetItem::TypedBuffer_UAV(1, resources.LightIndexMappingBuffer),
         nvrhi::BindingSetItem::Texture_UAV(2, resources.LocalLightPdfTexture),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(3, resources.InstancedLightBuffer),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(4, resources.InstancedLightRefBuffer),
         nvrhi::BindingSetItem::StructuredBuffer_SRV(0, resources.TaskBuffer),
         nvrhi::BindingSetItem::StructuredBuffer_SRV(1, resources.PrimitiveLightBuffer),
         nvrhi::BindingSetItem::StructuredBuffer_SRV(2, m_scene->GetInstanceBuffer()),
@@ -91,26 +95,74 @@ void PrepareLightsPass::CreateBindingSet(RtxdiResources& resources)
     m_lightIndexMappingBuffer = resources.LightIndexMappingBuffer;
     m_geometryInstanceToLightBuffer = resources.GeometryInstanceToLightBuffer;
     m_localLightPdfTexture = resources.LocalLightPdfTexture;
-    m_maxLightsInBuffer = uint32_t(resources.LightDataBuffer->getDesc().byteSize / (sizeof(PolymorphicLightInfo) * 2));
+    m_instancedLightBuffer = resources.InstancedLightBuffer;
+    m_maxLightsInBuffer = resources.GetLightBufferCapacity();
+    m_maxInstancedLights = resources.GetMaxInstancedLights();
+    m_maxPrimitiveLights = resources.GetMaxPrimitiveLights();
+    m_maxInstancedMeshTriangles = resources.GetMaxInstancedMeshTriangles();
+    m_maxMeshTasks = resources.GetMaxEmissiveMeshes() + resources.GetMaxInstancedMeshes();
+    m_instancedLightCounts = dm::uint2(0u);
+    m_reportedSkippedLights = false;
 }
 
-void PrepareLightsPass::CountLightsInScene(uint32_t& numEmissiveMeshes, uint32_t& numEmissiveTriangles)
+static bool IsEmissive(const donut::engine::Material& material)
 {
-    numEmissiveMeshes = 0;
-    numEmissiveTriangles = 0;
+    return any(material.emissiveColor != 0.f) && material.emissiveIntensity > 0.f;
+}
+
+std::unordered_map<const MeshGeometry*, uint32_t> PrepareLightsPass::CountEmissiveGeometryInstances(bool enableInstancedMeshLights) const
+{
+    std::unordered_map<const MeshGeometry*, uint32_t> instanceCounts;
+
+    if (!enableInstancedMeshLights)
+        return instanceCounts;
+
+    for (const auto& instance : m_scene->GetSceneGraph()->GetMeshInstances())
+    {
+        for (const auto& geometry : instance->GetMesh()->geometries)
+        {
+            if (IsEmissive(*geometry->material))
+                ++instanceCounts[geometry.get()];
+        }
+    }
+
+    return instanceCounts;
+}
+
+PrepareLightsPass::EmissiveLightCounts PrepareLightsPass::CountLightsInScene(bool enableInstancedMeshLights)
+{
+    EmissiveLightCounts counts;
+
+    const auto instanceCounts = CountEmissiveGeometryInstances(enableInstancedMeshLights);
+
+    for (const auto& [geometry, instanceCount] : instanceCounts)
+    {
+        if (instanceCount > 1)
+        {
+            counts.instancedMeshes += 1;
+            counts.instancedMeshTriangles += geometry->numIndices / 3;
+        }
+    }
 
     const auto& instances = m_scene->GetSceneGraph()->GetMeshInstances();
     for (const auto& instance : instances)
     {
         for (const auto& geometry : instance->GetMesh()->geometries)
         {
-            if (any(geometry->material->emissiveColor != 0.f))
-            {
-                numEmissiveMeshes += 1;
-                numEmissiveTriangles += geometry->numIndices / 3;
-            }
+            if (!IsEmissive(*geometry->material))
+                continue;
+
+            counts.meshes += 1;
+
+            auto instanceCount = instanceCounts.find(geometry.get());
+            if (instanceCount != instanceCounts.end() && instanceCount->second > 1)
+                counts.instancedLights += geometry->numIndices / 3;
+            else
+                counts.triangles += geometry->numIndices / 3;
         }
     }
+
+    return counts;
 }
 
 static inline uint floatToUInt(float _V, float _Scale)
@@ -343,7 +395,8 @@ RTXDI_LightBufferParameters PrepareLightsPass::Process(
     nvrhi::ICommandList* commandList, 
     const rtxdi::ReSTIRDIContext& context,
     const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
-    bool enableImportanceSampledEnvironmentLight)
+    bool enableImportanceSampledEnvironmentLight,
+    bool enableInstancedMeshLights)
 {
     RTXDI_LightBufferParameters outLightBufferParams = {};
     const rtxdi::ReSTIRDIStaticParameters& contextParameters = context.GetStaticParameters();
@@ -351,55 +404,120 @@ RTXDI_LightBufferParameters PrepareLightsPass::Process(
     commandList->beginMarker("PrepareLights");
 
     std::vector<PrepareLightsTask> tasks;
+    std::vector<PrepareLightsTask> bakeTasks;
     std::vector<PolymorphicLightInfo> primitiveLightInfos;
     uint32_t lightBufferOffset = 0;
+    uint32_t numInstancedLights = 0;
+    uint32_t instancedLightBufferSize = 0;
+    uint32_t numSkippedLights = 0;
     std::vector<uint32_t> geometryInstanceToLight(m_scene->GetSceneGraph()->GetGeometryInstancesCount(), RTXDI_INVALID_LIGHT_INDEX);
+    std::unordered_map<const MeshGeometry*, uint32_t> instancedLightOffsets;
 
+    const auto instanceCounts = CountEmissiveGeometryInstances(enableInstancedMeshLights);
     const auto& instances = m_scene->GetSceneGraph()->GetMeshInstances();
-    for (const auto& instance : instances)
-    {
-        const auto& mesh = instance->GetMesh();
 
-        assert(instance->GetGeometryInstanceIndex() < geometryInstanceToLight.size());
-        uint32_t firstGeometryInstanceIndex = instance->GetGeometryInstanceIndex();
+    // Each half of the LightDataBuffer only has entries for the lights after the instanced ones, see RAB_LoadLightInfo
+    const uint32_t maxLightDataEntries = m_maxLightsInBuffer - m_maxInstancedLights;
 
-        for (size_t geometryIndex = 0; geometryIndex < mesh->geometries.size(); ++geometryIndex)
+    // The instanced geometries go first, so that the lighting passes can tell them apart with a single comparison
+    for (bool instancedPass : { true, false })
+    {
+        for (const auto& instance : instances)
         {
-            const auto& geometry = mesh->geometries[geometryIndex];
+            const auto& mesh = instance->GetMesh();
 
-            size_t instanceHash = 0;
-            nvrhi::hash_combine(instanceHash, instance.get());
-            nvrhi::hash_combine(instanceHash, geometryIndex);
+            assert(instance->GetGeometryInstanceIndex() < geometryInstanceToLight.size());
+            uint32_t firstGeometryInstanceIndex = instance->GetGeometryInstanceIndex();
 
-            if (!any(geometry->material->emissiveColor != 0.f) || geometry->material->emissiveIntensity <= 0.f)
+            for (size_t geometryIndex = 0; geometryIndex < mesh->geometries.size(); ++geometryIndex)
             {
-                // remove the info about this instance, just in case it was emissive and now it's not
-                m_instanceLightBufferOffsets.erase(instanceHash);
-                continue;
+                const auto& geometry = mesh->geometries[geometryIndex];
+
+                size_t instanceHash = 0;
+                nvrhi::hash_combine(instanceHash, instance.get());
+                nvrhi::hash_combine(instanceHash, geometryIndex);
+
+                if (!IsEmissive(*geometry->material))
+                {
+                    // remove the info about this instance, just in case it was emissive and now it's not
+                    m_instanceLightBufferOffsets.erase(instanceHash);
+                    continue;
+                }
+
+                auto instanceCount = instanceCounts.find(geometry.get());
+                bool isInstanced = instanceCount != instanceCounts.end() && instanceCount->second > 1;
+                if (isInstanced != instancedPass)
+                    continue;
+
+                const uint32_t triangleCount = geometry->numIndices / 3;
+
+                // These limits are checked in release builds too, going over them would write outside of the buffers.
+                // The instanced lights only use the InstancedLightRefBuffer, the other lights use the LightDataBuffer
+                // starting after this frame's instanced lights, which are all known at this point.
+                const uint64_t lightBufferEnd = uint64_t(lightBufferOffset) + triangleCount;
+                const bool fitsIntoLightBuffers = isInstanced
+                    ? lightBufferEnd <= m_maxInstancedLights
+                    : lightBufferEnd - numInstancedLights <= maxLightDataEntries;
+                // The first instance of an instanced geometry also bakes its triangles into the InstancedLightBuffer
+                const bool needsBake = isInstanced && instancedLightOffsets.find(geometry.get()) == instancedLightOffsets.end();
+                const bool fitsIntoInstancedLightBuffer = !needsBake ||
+                    uint64_t(instancedLightBufferSize) + triangleCount <= m_maxInstancedMeshTriangles;
+                const size_t numMeshTasks = tasks.size() + bakeTasks.size() + (needsBake ? 2 : 1);
+                if (uint32_t(instance->GetInstanceIndex()) >= TASK_PRIMITIVE_LIGHT_BIT ||
+                    !fitsIntoLightBuffers ||
+                    !fitsIntoInstancedLightBuffer ||
+                    numMeshTasks > m_maxMeshTasks)
+                {
+                    numSkippedLights += triangleCount;
+                    m_instanceLightBufferOffsets.erase(instanceHash);
+                    continue;
+                }
+
+                geometryInstanceToLight[firstGeometryInstanceIndex + geometryIndex] = lightBufferOffset;
+
+                // find the previous offset of this instance in the light buffer
+                auto pOffset = m_instanceLightBufferOffsets.find(instanceHash);
+
+                PrepareLightsTask task;
+                task.instanceIndex = uint32_t(instance->GetInstanceIndex());
+                task.geometryIndex = uint32_t(geometryIndex);
+                task.lightBufferOffset = lightBufferOffset;
+                task.previousLightBufferOffset = (pOffset != m_instanceLightBufferOffsets.end()) ? int(pOffset->second) : -1;
+                task.instancedLightOffset = ~0u;
+
+                if (isInstanced)
+                {
+                    auto [instancedLightOffset, inserted] = instancedLightOffsets.try_emplace(geometry.get(), instancedLightBufferSize);
+                    if (inserted)
+                    {
+                        // The first instance of the geometry is used to find its vertex data for baking
+                        PrepareLightsTask bakeTask = task;
+                        bakeTask.lightBufferOffset = instancedLightBufferSize;
+                        bakeTask.previousLightBufferOffset = -1;
+                        bakeTask.instancedLightOffset = instancedLightBufferSize;
+                        bakeTasks.push_back(bakeTask);
+
+                        instancedLightBufferSize += triangleCount;
+                    }
+
+                    task.instancedLightOffset = instancedLightOffset->second;
+                }
+
+                // record the current offset of this instance for use on the next frame
+                m_instanceLightBufferOffsets[instanceHash] = lightBufferOffset;
+
+                lightBufferOffset += triangleCount;
+
+                tasks.push_back(task);
             }
-
-            geometryInstanceToLight[firstGeometryInstanceIndex + geometryIndex] = lightBufferOffset;
-
-            // find the previous offset of this instance in the light buffer
-            auto pOffset = m_instanceLightBufferOffsets.find(instanceHash);
-
-            assert(geometryIndex < 0xfff);
-
-            PrepareLightsTask task;
-            task.instanceAndGeometryIndex = (instance->GetInstanceIndex() << 12) | uint32_t(geometryIndex & 0xfff);
-            task.lightBufferOffset = lightBufferOffset;
-            task.triangleCount = geometry->numIndices / 3;
-            task.previousLightBufferOffset = (pOffset != m_instanceLightBufferOffsets.end()) ? int(pOffset->second) : -1;
-
-            // record the current offset of this instance for use on the next frame
-            m_instanceLightBufferOffsets[instanceHash] = lightBufferOffset;
-
-            lightBufferOffset += task.triangleCount;
-
-            tasks.push_back(task);
         }
+
+        if (instancedPass)
+            numInstancedLights = lightBufferOffset;
     }
 
+    assert(numInstancedLights <= m_maxInstancedLights);
+
     commandList->writeBuffer(m_geometryInstanceToLightBuffer, geometryInstanceToLight.data(), geometryInstanceToLight.size() * sizeof(uint32_t));
 
     outLightBufferParams.localLightBufferRegion.firstLightIndex = 0;
@@ -420,19 +538,27 @@ RTXDI_LightBufferParameters PrepareLightsPass::Process(
         if (!ConvertLight(*pLight, polymorphicLight, enableImportanceSampledEnvironmentLight))
             continue;
 
+        if (lightBufferOffset - numInstancedLights >= maxLightDataEntries || primitiveLightInfos.size() >= m_maxPrimitiveLights)
+        {
+            numSkippedLights += 1;
+            m_primitiveLightBufferOffsets.erase(pLight.get());
+            continue;
+        }
+
         // find the previous offset of this instance in the light buffer
         auto pOffset = m_primitiveLightBufferOffsets.find(pLight.get());
 
         PrepareLightsTask task;
-        task.instanceAndGeometryIndex = TASK_PRIMITIVE_LIGHT_BIT | uint32_t(primitiveLightInfos.size());
+        task.instanceIndex = TASK_PRIMITIVE_LIGHT_BIT | uint32_t(primitiveLightInfos.size());
+        task.geometryIndex = 0;
         task.lightBufferOffset = lightBufferOffset;
-        task.triangleCount = 1; // technically zero, but we need to allocate 1 thread in the grid to process this light
         task.previousLightBufferOffset = (pOffset != m_primitiveLightBufferOffsets.end()) ? pOffset->second : -1;
+        task.instancedLightOffset = ~0u;
 
         // record the current offset of this instance for use on the next frame
         m_primitiveLightBufferOffsets[pLight.get()] = lightBufferOffset;
 
-        lightBufferOffset += task.triangleCount;
+        lightBufferOffset += 1; // technically zero, but we need to allocate 1 thread in the grid to process this light
 
         tasks.push_back(task);
         primitiveLightInfos.push_back(polymorphicLight);
@@ -446,6 +572,13 @@ RTXDI_LightBufferParameters PrepareLightsPass::Process(
     }
 
     assert(numImportanceSampledEnvironmentLights <= 1);
+
+    if (numSkippedLights != 0 && !m_reportedSkippedLights)
+    {
+        donut::log::error("PrepareLights: %u lights don't fit into the RTXDI resources and are skipped, "
+            "the light buffer has a capacity of %u lights per frame", numSkippedLights, m_maxLightsInBuffer);
+        m_reportedSkippedLights = true;
+    }
     
     outLightBufferParams.localLightBufferRegion.numLights += numFinitePrimLights;
     outLightBufferParams.infiniteLightBufferRegion.firstLightIndex = outLightBufferParams.localLightBufferRegion.numLights;
@@ -453,6 +586,10 @@ RTXDI_LightBufferParameters PrepareLightsPass::Process(
     outLightBufferParams.environmentLightParams.lightIndex = outLightBufferParams.infiniteLightBufferRegion.firstLightIndex + outLightBufferParams.infiniteLightBufferRegion.numLights;
     outLightBufferParams.environmentLightParams.lightPresent = numImportanceSampledEnvironmentLights;
     
+    // The bake tasks are stored after the light tasks and processed by a separate dispatch
+    const uint32_t numLightTasks = uint32_t(tasks.size());
+    tasks.insert(tasks.end(), bakeTasks.begin(), bakeTasks.end());
+
     commandList->writeBuffer(m_taskBuffer, tasks.data(), tasks.size() * sizeof(PrepareLightsTask));
 
     if (!primitiveLightInfos.empty())
@@ -471,16 +608,42 @@ RTXDI_LightBufferParameters PrepareLightsPass::Process(
     nvrhi::ComputeState state;
     state.pipeline = m_computePipeline;
     state.bindings = { m_bindingSet, m_scene->GetDescriptorTable() };
-    commandList->setComputeState(state);
 
-    PrepareLightsConstants constants;
-    constants.numTasks = uint32_t(tasks.size());
+    PrepareLightsConstants constants = {};
     constants.currentFrameLightOffset = m_maxLightsInBuffer * m_oddFrame;
     constants.previousFrameLightOffset = m_maxLightsInBuffer * !m_oddFrame;
+    constants.currentFrameDataOffset = (m_maxLightsInBuffer - m_maxInstancedLights) * m_oddFrame;
+    constants.currentFrameInstancedLightOffset = m_maxInstancedLights * m_oddFrame;
+    constants.numInstancedLights = numInstancedLights;
+
+    // Bake the local space triangles of the instanced geometries first, the light tasks transform them.
+    // They are baked on every frame like the other emissive triangles to pick up changes in the materials.
+    if (!bakeTasks.empty())
+    {
+        commandList->setComputeState(state);
+
+        constants.firstTask = numLightTasks;
+        constants.numTasks = uint32_t(bakeTasks.size());
+        constants.bakeInstancedLights = 1;
+        constants.tasksEndOffset = instancedLightBufferSize;
+        commandList->setPushConstants(&constants, sizeof(constants));
+
+        commandList->dispatch(dm::div_ceil(instancedLightBufferSize, 256));
+    }
+
+    // Set the state again to get a UAV barrier between the dispatches
+    commandList->setComputeState(state);
+
+    constants.firstTask = 0;
+    constants.numTasks = numLightTasks;
+    constants.bakeInstancedLights = 0;
+    constants.tasksEndOffset = lightBufferOffset;
     commandList->setPushConstants(&constants, sizeof(constants));
 
     commandList->dispatch(dm::div_ceil(lightBufferOffset, 256));
 
+    m_instancedLightCounts[m_oddFrame ? 1 : 0] = numInstancedLights;
+
     commandList->endMarker();
 
     outLightBufferParams.localLightBufferRegion.firstLightIndex += constants.currentFrameLightOffset;
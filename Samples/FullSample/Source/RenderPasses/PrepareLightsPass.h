@@ -30,6 +30,17 @@ class RtxdiResources;
 class PrepareLightsPass
 {
 public:
+    // Emissive geometries that are used by more than one mesh instance are stored once in local space,
+    // and each instance refers to them with its transform instead of having its own copy of the triangles.
+    struct EmissiveLightCounts
+    {
+        uint32_t meshes = 0;                // emissive geometry instances, including the instanced ones
+        uint32_t triangles = 0;             // triangles of the non-instanced emissive geometry instances
+        uint32_t instancedMeshes = 0;       // distinct instanced emissive geometries
+        uint32_t instancedMeshTriangles = 0;
+        uint32_t instancedLights = 0;       // triangles of all instances of the instanced geometries
+    };
+
     PrepareLightsPass(
         nvrhi::IDevice* device,
         std::shared_ptr<donut::engine::ShaderFactory> shaderFactory,
@@ -39,15 +50,22 @@ public:
 
     void CreatePipeline();
     void CreateBindingSet(RtxdiResources& resources);
-    void CountLightsInScene(uint32_t& numEmissiveMeshes, uint32_t& numEmissiveTriangles);
+    EmissiveLightCounts CountLightsInScene(bool enableInstancedMeshLights);
     
     RTXDI_LightBufferParameters Process(
         nvrhi::ICommandList* commandList, 
         const rtxdi::ReSTIRDIContext& context, 
         const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
-        bool enableImportanceSampledEnvironmentLight);
+        bool enableImportanceSampledEnvironmentLight,
+        bool enableInstancedMeshLights);
+
+    // Number of instanced lights at the start of each half of the light buffer, see RAB_LoadLightInfo
+    [[nodiscard]] dm::uint2 GetInstancedLightCounts() const { return m_instancedLightCounts; }
 
 private:
+    // Returns the number of instances of each emissive geometry, or an empty map if instancing is disabled.
+    std::unordered_map<const donut::engine::MeshGeometry*, uint32_t> CountEmissiveGeometryInstances(bool enableInstancedMeshLights) const;
+
     nvrhi::DeviceHandle m_device;
 
     nvrhi::ShaderHandle m_computeShader;
@@ -60,10 +78,17 @@ private:
     nvrhi::BufferHandle m_primitiveLightBuffer;
     nvrhi::BufferHandle m_lightIndexMappingBuffer;
     nvrhi::BufferHandle m_geometryInstanceToLightBuffer;
+    nvrhi::BufferHandle m_instancedLightBuffer;
     nvrhi::TextureHandle m_localLightPdfTexture;
 
     uint32_t m_maxLightsInBuffer;
+    uint32_t m_maxInstancedLights;
+    uint32_t m_maxPrimitiveLights;
+    uint32_t m_maxInstancedMeshTriangles;
+    uint32_t m_maxMeshTasks; // emissive geometry instances and bake tasks, the primitive lights have their own part of the TaskBuffer
     bool m_oddFrame = false;
+    bool m_reportedSkippedLights = false;
+    dm::uint2 m_instancedLightCounts = dm::uint2(0u);
 
     std::shared_ptr<donut::engine::ShaderFactory> m_shaderFactory;
     std::shared_ptr<donut::engine::CommonRenderPasses> m_commonPasses;
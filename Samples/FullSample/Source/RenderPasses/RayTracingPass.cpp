@@ -28,10 +28,23 @@ bool RayTracingPass::Init(
     nvrhi::IBindingLayout* bindingLayout,
     nvrhi::IBindingLayout* extraBindingLayout,
     nvrhi::IBindingLayout* bindlessLayout)
+{
+    if (!LoadShaders(shaderFactory, shaderName, extraMacros, useRayQuery))
+        return false;
+
+    return CreatePipeline(device, computeGroupSize, bindingLayout, extraBindingLayout, bindlessLayout);
+}
+
+bool RayTracingPass::LoadShaders(
+    donut::engine::ShaderFactory& shaderFactory,
+    const char* shaderName,
+    const std::vector<donut::engine::ShaderMacro>& extraMacros,
+    bool useRayQuery)
 {
     donut::log::debug("Initializing RayTracingPass %s...", shaderName);
 
-    ComputeGroupSize = computeGroupSize;
+    // Drop the pipeline of the other type if the pass is re-initialized after toggling RayQuery
+    *this = RayTracingPass();
 
     std::vector<donut::engine::ShaderMacro> macros = { { "USE_RAY_QUERY", "1" } };
 
@@ -40,9 +53,25 @@ bool RayTracingPass::Init(
     if (useRayQuery)
     {
         ComputeShader = shaderFactory.CreateShader(shaderName, "main", &macros, nvrhi::ShaderType::Compute);
-        if (!ComputeShader)
-            return false;
+        return ComputeShader != nullptr;
+    }
+
+    macros[0].definition = "0"; // USE_RAY_QUERY
+    ShaderLibrary = shaderFactory.CreateShaderLibrary(shaderName, &macros);
+    return ShaderLibrary != nullptr;
+}
 
+bool RayTracingPass::CreatePipeline(
+    nvrhi::IDevice* device,
+    uint32_t computeGroupSize,
+    nvrhi::IBindingLayout* bindingLayout,
+    nvrhi::IBindingLayout* extraBindingLayout,
+    nvrhi::IBindingLayout* bindlessLayout)
+{
+    ComputeGroupSize = computeGroupSize;
+
+    if (ComputeShader)
+    {
         nvrhi::ComputePipelineDesc pipelineDesc;
         pipelineDesc.bindingLayouts = { bindingLayout };
         if (bindlessLayout)
@@ -58,8 +87,6 @@ bool RayTracingPass::Init(
         return true;
     }
 
-    macros[0].definition = "0"; // USE_RAY_QUERY
-    ShaderLibrary = shaderFactory.CreateShaderLibrary(shaderName, &macros);
     if (!ShaderLibrary)
         return false;
 
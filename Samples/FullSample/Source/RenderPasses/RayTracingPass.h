@@ -30,6 +30,7 @@ struct RayTracingPass
 
     uint32_t ComputeGroupSize = 0;
 
+    // Equivalent to LoadShaders followed by CreatePipeline.
     bool Init(
         nvrhi::IDevice* device,
         donut::engine::ShaderFactory& shaderFactory,
@@ -41,6 +42,21 @@ struct RayTracingPass
         nvrhi::IBindingLayout* extraBindingLayout,
         nvrhi::IBindingLayout* bindlessLayout);
 
+    // Init in two steps: the pipeline creation is the expensive part, and it doesn't use the shader factory,
+    // so it can run on a worker thread.
+    bool LoadShaders(
+        donut::engine::ShaderFactory& shaderFactory,
+        const char* shaderName,
+        const std::vector<donut::engine::ShaderMacro>& extraMacros,
+        bool useRayQuery);
+
+    bool CreatePipeline(
+        nvrhi::IDevice* device,
+        uint32_t computeGroupSize,
+        nvrhi::IBindingLayout* bindingLayout,
+        nvrhi::IBindingLayout* extraBindingLayout,
+        nvrhi::IBindingLayout* bindlessLayout);
+
     void Execute(
         nvrhi::ICommandList* commandList,
         int width,
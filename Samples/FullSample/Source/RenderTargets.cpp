@@ -104,9 +104,9 @@ RenderTargets::RenderTargets(nvrhi::IDevice* device, int2 size)
     desc.debugName = "ResolvedColor";
     ResolvedColor = device->createTexture(desc);
 
-    desc.format = nvrhi::Format::RGBA16_FLOAT;
-    desc.debugName = "ReferenceColor";
-    ReferenceColor = device->createTexture(desc);
+    desc.format = nvrhi::Format::RG32_UINT;
+    desc.debugName = "VisibilityBuffer";
+    VisibilityBuffer = device->createTexture(desc);
 
     GBufferFramebuffer = std::make_shared<engine::FramebufferFactory>(device);
     GBufferFramebuffer->DepthTarget = DeviceDepth;
@@ -132,9 +132,29 @@ RenderTargets::RenderTargets(nvrhi::IDevice* device, int2 size)
         MotionVectors
     };
 
+    VisibilityFramebuffer = std::make_shared<engine::FramebufferFactory>(device);
+    VisibilityFramebuffer->DepthTarget = DeviceDepth;
+    VisibilityFramebuffer->RenderTargets = { VisibilityBuffer };
+
     ResolvedFramebuffer = std::make_shared<engine::FramebufferFactory>(device);
     ResolvedFramebuffer->RenderTargets = { ResolvedColor };
 
+    // Compact G-buffer surfaces, stored in 8x8 pixel tiles
+
+    CompactSurfaceStride = (uint32_t(size.x) + 7) & ~7u;
+    const uint32_t compactSurfaceRows = (uint32_t(size.y) + 7) & ~7u;
+
+    nvrhi::BufferDesc surfaceBufferDesc;
+    surfaceBufferDesc.byteSize = uint64_t(CompactSurfaceStride) * compactSurfaceRows * sizeof(dm::uint4);
+    surfaceBufferDesc.structStride = sizeof(dm::uint4);
+    surfaceBufferDesc.canHaveUAVs = true;
+    surfaceBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    surfaceBufferDesc.keepInitialState = true;
+    surfaceBufferDesc.debugName = "GBufferSurfaces";
+    GBufferSurfaces = device->createBuffer(surfaceBufferDesc);
+    surfaceBufferDesc.debugName = "PrevGBufferSurfaces";
+    PrevGBufferSurfaces = device->createBuffer(surfaceBufferDesc);
+
     // UAV-only textures
 
     desc.isRenderTarget = false;
@@ -155,6 +175,17 @@ RenderTargets::RenderTargets(nvrhi::IDevice* device, int2 size)
     desc.debugName = "DenoisedSpecularLighting";
     DenoisedSpecularLighting = device->createTexture(desc);
 
+    // Reduced resolution ReSTIR GI output, sized for the largest supported downscale mode (half resolution)
+    desc.width = (size.x + 1) / 2;
+    desc.height = (size.y + 1) / 2;
+    desc.format = nvrhi::Format::RGBA16_FLOAT;
+    desc.debugName = "GIDiffuseLighting";
+    GIDiffuseLighting = device->createTexture(desc);
+    desc.debugName = "GISpecularLighting";
+    GISpecularLighting = device->createTexture(desc);
+    desc.width = size.x;
+    desc.height = size.y;
+
     desc.format = nvrhi::Format::RGBA16_SNORM;
     desc.debugName = "TaaFeedback1";
     TaaFeedback1 = device->createTexture(desc);
@@ -185,6 +216,13 @@ RenderTargets::RenderTargets(nvrhi::IDevice* device, int2 size)
     desc.debugName = "PrevSpecularConfidence";
     PrevSpecularConfidence = device->createTexture(desc);
 
+    desc.width = (size.x + CONFIDENCE_TILE_SIZE - 1) / CONFIDENCE_TILE_SIZE;
+    desc.height = (size.y + CONFIDENCE_TILE_SIZE - 1) / CONFIDENCE_TILE_SIZE;
+    desc.debugName = "ConfidenceTiles";
+    ConfidenceTiles = device->createTexture(desc);
+    desc.width = size.x;
+    desc.height = size.y;
+
     desc.format = nvrhi::Format::RG16_SINT;
     desc.debugName = "TemporalSamplePositions";
     TemporalSamplePositions = device->createTexture(desc);
@@ -197,16 +235,34 @@ RenderTargets::RenderTargets(nvrhi::IDevice* device, int2 size)
     desc.debugName = "Gradients";
     Gradients = device->createTexture(desc);
 
-    nvrhi::TextureDesc debugDesc;
-    debugDesc.width = size.x;
-    debugDesc.height = size.y;
-    debugDesc.keepInitialState = false;
-    debugDesc.isUAV = true;
-    debugDesc.isRenderTarget = false;
-    debugDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
-    debugDesc.format = nvrhi::Format::RGBA16_FLOAT;
-    debugDesc.debugName = "DebugColor";
-    DebugColor = device->createTexture(debugDesc);
+    desc.width = size.x;
+    desc.height = size.y;
+    desc.format = nvrhi::Format::RGBA32_UINT;
+    desc.debugName = "VisibilityCache";
+    VisibilityCache = device->createTexture(desc);
+}
+
+nvrhi::TextureDesc RenderTargets::GetDebugColorDesc() const
+{
+    // DebugColor is a transient frame graph texture, so it only occupies memory in the frames that display it.
+    nvrhi::TextureDesc desc;
+    desc.width = Size.x;
+    desc.height = Size.y;
+    desc.isUAV = true;
+    desc.format = nvrhi::Format::RGBA16_FLOAT;
+    desc.debugName = "DebugColor";
+    return desc;
+}
+
+void RenderTargets::CreateReferenceColor(nvrhi::IDevice* device)
+{
+    if (ReferenceColor)
+        return;
+
+    // The reference image is only needed after the user stores one, so allocate it on first use.
+    nvrhi::TextureDesc desc = ResolvedColor->getDesc();
+    desc.debugName = "ReferenceColor";
+    ReferenceColor = device->createTexture(desc);
 }
 
 bool RenderTargets::IsUpdateRequired(int2 size)
@@ -224,6 +280,7 @@ void RenderTargets::NextFrame()
     std::swap(GBufferSpecularRough, PrevGBufferSpecularRough);
     std::swap(GBufferNormals, PrevGBufferNormals);
     std::swap(GBufferGeoNormals, PrevGBufferGeoNormals);
+    std::swap(GBufferSurfaces, PrevGBufferSurfaces);
     std::swap(GBufferFramebuffer, PrevGBufferFramebuffer);
     std::swap(DiffuseConfidence, PrevDiffuseConfidence);
     std::swap(SpecularConfidence, PrevSpecularConfidence);
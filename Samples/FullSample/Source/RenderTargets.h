@@ -37,6 +37,12 @@ public:
     nvrhi::TextureHandle PrevGBufferGeoNormals;
     nvrhi::TextureHandle MotionVectors;
     nvrhi::TextureHandle NormalRoughness; // for NRD
+    nvrhi::TextureHandle VisibilityBuffer; // instance, geometry and primitive per pixel, see VisibilityBufferResolve.hlsl
+
+    // Compact per-pixel surface records for the resampling passes, see CompactGBuffer.hlsli
+    nvrhi::BufferHandle GBufferSurfaces;
+    nvrhi::BufferHandle PrevGBufferSurfaces;
+    uint32_t CompactSurfaceStride = 0;
 
     nvrhi::TextureHandle HdrColor;
     nvrhi::TextureHandle LdrColor;
@@ -44,6 +50,8 @@ public:
     nvrhi::TextureHandle SpecularLighting;
     nvrhi::TextureHandle DenoisedDiffuseLighting;
     nvrhi::TextureHandle DenoisedSpecularLighting;
+    nvrhi::TextureHandle GIDiffuseLighting; // reduced resolution ReSTIR GI output, see LightingPasses::RenderBrdfRays
+    nvrhi::TextureHandle GISpecularLighting;
     nvrhi::TextureHandle TaaFeedback1;
     nvrhi::TextureHandle TaaFeedback2;
     nvrhi::TextureHandle ResolvedColor;
@@ -57,19 +65,23 @@ public:
     nvrhi::TextureHandle SpecularConfidence;
     nvrhi::TextureHandle PrevDiffuseConfidence;
     nvrhi::TextureHandle PrevSpecularConfidence;
+    nvrhi::TextureHandle ConfidenceTiles; // lowest confidence in each CONFIDENCE_TILE_SIZE^2 tile, drives the adaptive sample budgets
+    nvrhi::TextureHandle VisibilityCache; // last final visibility per pixel, see LoadCachedFinalVisibility in ShadingHelpers.hlsli
 
-    nvrhi::TextureHandle DebugColor;
-    nvrhi::TextureHandle ReferenceColor;
+    nvrhi::TextureHandle ReferenceColor; // created on demand, see CreateReferenceColor
 
     std::shared_ptr<donut::engine::FramebufferFactory> LdrFramebuffer;
     std::shared_ptr<donut::engine::FramebufferFactory> ResolvedFramebuffer;
     std::shared_ptr<donut::engine::FramebufferFactory> GBufferFramebuffer;
     std::shared_ptr<donut::engine::FramebufferFactory> PrevGBufferFramebuffer;
+    std::shared_ptr<donut::engine::FramebufferFactory> VisibilityFramebuffer;
 
     dm::int2 Size;
 
     RenderTargets(nvrhi::IDevice* device, dm::int2 size);
 
     bool IsUpdateRequired(dm::int2 size);
+    void CreateReferenceColor(nvrhi::IDevice* device);
+    [[nodiscard]] nvrhi::TextureDesc GetDebugColorDesc() const;
     void NextFrame();
 };
@@ -18,6 +18,53 @@
 using namespace dm;
 #include "../shaders/ShaderParameters.h"
 
+static uint32_t AlignUp(uint32_t value, uint32_t quantum)
+{
+    return (value + quantum - 1) & ~(quantum - 1);
+}
+
+RtxdiResources::LightCapacities RtxdiResources::GetLightCapacities(
+    const PrepareLightsPass::EmissiveLightCounts& emissiveLightCounts,
+    uint32_t numPrimitiveLights,
+    uint32_t numGeometryInstances)
+{
+    const uint32_t meshAllocationQuantum = 128;
+    const uint32_t triangleAllocationQuantum = 1024;
+    const uint32_t primitiveAllocationQuantum = 128;
+
+    LightCapacities capacities;
+    capacities.maxEmissiveMeshes = AlignUp(emissiveLightCounts.meshes, meshAllocationQuantum);
+    capacities.maxEmissiveTriangles = AlignUp(emissiveLightCounts.triangles, triangleAllocationQuantum);
+    capacities.maxPrimitiveLights = AlignUp(numPrimitiveLights, primitiveAllocationQuantum);
+    capacities.maxInstancedMeshes = emissiveLightCounts.instancedMeshes;
+    capacities.maxInstancedMeshTriangles = AlignUp(emissiveLightCounts.instancedMeshTriangles, triangleAllocationQuantum);
+    capacities.maxInstancedLights = AlignUp(emissiveLightCounts.instancedLights, triangleAllocationQuantum);
+    capacities.maxGeometryInstances = numGeometryInstances;
+    return capacities;
+}
+
+RtxdiResources::RtxdiResources(
+    nvrhi::IDevice* device, 
+    const rtxdi::ReSTIRDIContext& context,
+    const rtxdi::RISBufferSegmentAllocator& risBufferSegmentAllocator,
+    const LightCapacities& lightCapacities,
+    uint32_t environmentMapWidth,
+    uint32_t environmentMapHeight,
+    uint32_t giReservoirArrayPitch)
+    : RtxdiResources(device, context, risBufferSegmentAllocator,
+        lightCapacities.maxEmissiveMeshes,
+        lightCapacities.maxEmissiveTriangles,
+        lightCapacities.maxPrimitiveLights,
+        lightCapacities.maxInstancedMeshes,
+        lightCapacities.maxInstancedMeshTriangles,
+        lightCapacities.maxInstancedLights,
+        lightCapacities.maxGeometryInstances,
+        environmentMapWidth,
+        environmentMapHeight,
+        giReservoirArrayPitch)
+{
+}
+
 RtxdiResources::RtxdiResources(
     nvrhi::IDevice* device, 
     const rtxdi::ReSTIRDIContext& context,
@@ -25,16 +72,25 @@ RtxdiResources::RtxdiResources(
     uint32_t maxEmissiveMeshes,
     uint32_t maxEmissiveTriangles,
     uint32_t maxPrimitiveLights,
+    uint32_t maxInstancedMeshes,
+    uint32_t maxInstancedMeshTriangles,
+    uint32_t maxInstancedLights,
     uint32_t maxGeometryInstances,
     uint32_t environmentMapWidth,
-    uint32_t environmentMapHeight)
+    uint32_t environmentMapHeight,
+    uint32_t giReservoirArrayPitch)
     : m_maxEmissiveMeshes(maxEmissiveMeshes)
     , m_maxEmissiveTriangles(maxEmissiveTriangles)
     , m_maxPrimitiveLights(maxPrimitiveLights)
+    , m_maxInstancedMeshes(maxInstancedMeshes)
+    , m_maxInstancedMeshTriangles(maxInstancedMeshTriangles)
+    , m_maxInstancedLights(maxInstancedLights)
     , m_maxGeometryInstances(maxGeometryInstances)
+    , m_giReservoirArrayPitch(giReservoirArrayPitch)
 {
     nvrhi::BufferDesc taskBufferDesc;
-    taskBufferDesc.byteSize = sizeof(PrepareLightsTask) * (maxEmissiveMeshes + maxPrimitiveLights);
+    // The instanced meshes have an extra task each, for baking their local space triangles
+    taskBufferDesc.byteSize = sizeof(PrepareLightsTask) * (maxEmissiveMeshes + maxPrimitiveLights + maxInstancedMeshes);
     taskBufferDesc.structStride = sizeof(PrepareLightsTask);
     taskBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
     taskBufferDesc.keepInitialState = true;
@@ -69,11 +125,13 @@ RtxdiResources::RtxdiResources(
     RisLightDataBuffer = device->createBuffer(risBufferDesc);
 
 
-    uint32_t maxLocalLights = maxEmissiveTriangles + maxPrimitiveLights;
+    // The light indices of the instanced meshes have no light buffer entries, see RAB_LoadLightInfo
+    uint32_t maxLocalLights = maxEmissiveTriangles + maxPrimitiveLights + maxInstancedLights;
     uint32_t lightBufferElements = maxLocalLights * 2;
+    uint32_t lightDataElements = (maxEmissiveTriangles + maxPrimitiveLights) * 2;
 
     nvrhi::BufferDesc lightBufferDesc;
-    lightBufferDesc.byteSize = sizeof(PolymorphicLightInfo) * lightBufferElements;
+    lightBufferDesc.byteSize = sizeof(PolymorphicLightInfo) * lightDataElements;
     lightBufferDesc.structStride = sizeof(PolymorphicLightInfo);
     lightBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
     lightBufferDesc.keepInitialState = true;
@@ -91,6 +149,26 @@ RtxdiResources::RtxdiResources(
     GeometryInstanceToLightBuffer = device->createBuffer(geometryInstanceToLightBufferDesc);
 
 
+    nvrhi::BufferDesc instancedLightBufferDesc;
+    instancedLightBufferDesc.byteSize = sizeof(PolymorphicLightInfo) * std::max(maxInstancedMeshTriangles, 1u);
+    instancedLightBufferDesc.structStride = sizeof(PolymorphicLightInfo);
+    instancedLightBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    instancedLightBufferDesc.keepInitialState = true;
+    instancedLightBufferDesc.debugName = "InstancedLightBuffer";
+    instancedLightBufferDesc.canHaveUAVs = true;
+    InstancedLightBuffer = device->createBuffer(instancedLightBufferDesc);
+
+
+    nvrhi::BufferDesc instancedLightRefBufferDesc;
+    instancedLightRefBufferDesc.byteSize = sizeof(uint32_t) * 2 * std::max(maxInstancedLights * 2, 1u); // (instance, local triangle) per light
+    instancedLightRefBufferDesc.structStride = sizeof(uint32_t) * 2;
+    instancedLightRefBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    instancedLightRefBufferDesc.keepInitialState = true;
+    instancedLightRefBufferDesc.debugName = "InstancedLightRefBuffer";
+    instancedLightRefBufferDesc.canHaveUAVs = true;
+    InstancedLightRefBuffer = device->createBuffer(instancedLightRefBufferDesc);
+
+
     nvrhi::BufferDesc lightIndexMappingBufferDesc;
     lightIndexMappingBufferDesc.byteSize = sizeof(uint32_t) * lightBufferElements;
     lightIndexMappingBufferDesc.format = nvrhi::Format::R32_UINT;
@@ -132,6 +210,52 @@ RtxdiResources::RtxdiResources(
     SecondaryGBuffer = device->createBuffer(secondaryGBufferDesc);
 
 
+    // The binned BRDF rays are stored in tiles that match the reservoir blocks, see BrdfRayTracing.hlsl
+    static_assert(BRDF_RAY_BIN_TILE_SIZE == RTXDI_RESERVOIR_BLOCK_SIZE);
+    nvrhi::BufferDesc brdfRayBufferDesc;
+    brdfRayBufferDesc.byteSize = sizeof(BrdfRayData) * context.GetReservoirBufferParameters().reservoirArrayPitch;
+    brdfRayBufferDesc.structStride = sizeof(BrdfRayData);
+    brdfRayBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    brdfRayBufferDesc.keepInitialState = true;
+    brdfRayBufferDesc.debugName = "BrdfRayBuffer";
+    brdfRayBufferDesc.canHaveUAVs = true;
+    BrdfRayBuffer = device->createBuffer(brdfRayBufferDesc);
+
+    // The wavefront BRDF ray path stores one hit per binned ray, and has one queue per material domain
+    // that can hold all the rays. The counter buffer also holds the dispatch arguments of the shading pass.
+    nvrhi::BufferDesc brdfRayHitBufferDesc;
+    brdfRayHitBufferDesc.byteSize = sizeof(BrdfRayHitData) * context.GetReservoirBufferParameters().reservoirArrayPitch;
+    brdfRayHitBufferDesc.structStride = sizeof(BrdfRayHitData);
+    brdfRayHitBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    brdfRayHitBufferDesc.keepInitialState = true;
+    brdfRayHitBufferDesc.debugName = "BrdfRayHitBuffer";
+    brdfRayHitBufferDesc.canHaveUAVs = true;
+    BrdfRayHitBuffer = device->createBuffer(brdfRayHitBufferDesc);
+
+    nvrhi::BufferDesc brdfRayQueueBufferDesc;
+    brdfRayQueueBufferDesc.byteSize = sizeof(uint32_t) * context.GetReservoirBufferParameters().reservoirArrayPitch * BRDF_RAY_DOMAIN_COUNT;
+    brdfRayQueueBufferDesc.format = nvrhi::Format::R32_UINT;
+    brdfRayQueueBufferDesc.canHaveTypedViews = true;
+    brdfRayQueueBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    brdfRayQueueBufferDesc.keepInitialState = true;
+    brdfRayQueueBufferDesc.debugName = "BrdfRayQueueBuffer";
+    brdfRayQueueBufferDesc.canHaveUAVs = true;
+    BrdfRayQueueBuffer = device->createBuffer(brdfRayQueueBufferDesc);
+
+    brdfRayQueueBufferDesc.byteSize = sizeof(uint32_t) * BRDF_RAY_QUEUE_COUNTER_COUNT;
+    brdfRayQueueBufferDesc.debugName = "BrdfRayQueueCounterBuffer";
+    BrdfRayQueueCounterBuffer = device->createBuffer(brdfRayQueueBufferDesc);
+
+    // The shading pass reads the counters as a UAV, so its dispatch arguments are copied into a separate buffer
+    nvrhi::BufferDesc brdfRayShadingArgsBufferDesc;
+    brdfRayShadingArgsBufferDesc.byteSize = sizeof(uint32_t) * 3;
+    brdfRayShadingArgsBufferDesc.isDrawIndirectArgs = true;
+    brdfRayShadingArgsBufferDesc.initialState = nvrhi::ResourceStates::IndirectArgument;
+    brdfRayShadingArgsBufferDesc.keepInitialState = true;
+    brdfRayShadingArgsBufferDesc.debugName = "BrdfRayShadingArgsBuffer";
+    BrdfRayShadingArgsBuffer = device->createBuffer(brdfRayShadingArgsBufferDesc);
+
+
     nvrhi::TextureDesc environmentPdfDesc;
     environmentPdfDesc.width = environmentMapWidth;
     environmentPdfDesc.height = environmentMapHeight;
@@ -153,8 +277,9 @@ RtxdiResources::RtxdiResources(
     localLightPdfDesc.format = nvrhi::Format::R32_FLOAT; // Use FP32 here to allow a wide range of flux values, esp. when downsampled.
     LocalLightPdfTexture = device->createTexture(localLightPdfDesc);
     
+    // The GI reservoirs follow the GI resolution, which can be lower than the render resolution, see LightingPasses::GetGIReservoirBufferParameters
     nvrhi::BufferDesc giReservoirBufferDesc;
-    giReservoirBufferDesc.byteSize = sizeof(RTXDI_PackedGIReservoir) * context.GetReservoirBufferParameters().reservoirArrayPitch * rtxdi::c_NumReSTIRGIReservoirBuffers;
+    giReservoirBufferDesc.byteSize = sizeof(RTXDI_PackedGIReservoir) * giReservoirArrayPitch * rtxdi::c_NumReSTIRGIReservoirBuffers;
     giReservoirBufferDesc.structStride = sizeof(RTXDI_PackedGIReservoir);
     giReservoirBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
     giReservoirBufferDesc.keepInitialState = true;
@@ -193,7 +318,32 @@ uint32_t RtxdiResources::GetMaxPrimitiveLights() const
     return m_maxPrimitiveLights;
 }
 
+uint32_t RtxdiResources::GetMaxInstancedMeshes() const
+{
+    return m_maxInstancedMeshes;
+}
+
+uint32_t RtxdiResources::GetMaxInstancedMeshTriangles() const
+{
+    return m_maxInstancedMeshTriangles;
+}
+
+uint32_t RtxdiResources::GetMaxInstancedLights() const
+{
+    return m_maxInstancedLights;
+}
+
+uint32_t RtxdiResources::GetLightBufferCapacity() const
+{
+    return m_maxEmissiveTriangles + m_maxPrimitiveLights + m_maxInstancedLights;
+}
+
 uint32_t RtxdiResources::GetMaxGeometryInstances() const
 {
     return m_maxGeometryInstances;
 }
+
+uint32_t RtxdiResources::GetGIReservoirArrayPitch() const
+{
+    return m_giReservoirArrayPitch;
+}
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include "RenderPasses/PrepareLightsPass.h"
+
 #include <nvrhi/nvrhi.h>
 
 namespace rtxdi
@@ -26,16 +28,51 @@ public:
     nvrhi::BufferHandle PrimitiveLightBuffer;
     nvrhi::BufferHandle LightDataBuffer;
     nvrhi::BufferHandle GeometryInstanceToLightBuffer;
+    nvrhi::BufferHandle InstancedLightBuffer;
+    nvrhi::BufferHandle InstancedLightRefBuffer;
     nvrhi::BufferHandle LightIndexMappingBuffer;
     nvrhi::BufferHandle RisBuffer;
     nvrhi::BufferHandle RisLightDataBuffer;
     nvrhi::BufferHandle NeighborOffsetsBuffer;
     nvrhi::BufferHandle LightReservoirBuffer;
     nvrhi::BufferHandle SecondaryGBuffer;
+    nvrhi::BufferHandle BrdfRayBuffer;
+    nvrhi::BufferHandle BrdfRayHitBuffer;
+    nvrhi::BufferHandle BrdfRayQueueBuffer;
+    nvrhi::BufferHandle BrdfRayQueueCounterBuffer;
+    nvrhi::BufferHandle BrdfRayShadingArgsBuffer;
     nvrhi::TextureHandle EnvironmentPdfTexture;
     nvrhi::TextureHandle LocalLightPdfTexture;
     nvrhi::BufferHandle GIReservoirBuffer;
 
+    // Sizes of the light buffers, see GetLightCapacities
+    struct LightCapacities
+    {
+        uint32_t maxEmissiveMeshes = 0;
+        uint32_t maxEmissiveTriangles = 0;
+        uint32_t maxPrimitiveLights = 0;
+        uint32_t maxInstancedMeshes = 0;
+        uint32_t maxInstancedMeshTriangles = 0;
+        uint32_t maxInstancedLights = 0;
+        uint32_t maxGeometryInstances = 0;
+    };
+
+    // Rounds the light counts of a scene up to the allocation quanta, so that small changes
+    // to the scene don't force the resources to be recreated.
+    static LightCapacities GetLightCapacities(
+        const PrepareLightsPass::EmissiveLightCounts& emissiveLightCounts,
+        uint32_t numPrimitiveLights,
+        uint32_t numGeometryInstances);
+
+    RtxdiResources(
+        nvrhi::IDevice* device, 
+        const rtxdi::ReSTIRDIContext& context,
+        const rtxdi::RISBufferSegmentAllocator& risBufferSegmentAllocator,
+        const LightCapacities& lightCapacities,
+        uint32_t environmentMapWidth,
+        uint32_t environmentMapHeight,
+        uint32_t giReservoirArrayPitch);
+
     RtxdiResources(
         nvrhi::IDevice* device, 
         const rtxdi::ReSTIRDIContext& context,
@@ -43,21 +80,34 @@ public:
         uint32_t maxEmissiveMeshes,
         uint32_t maxEmissiveTriangles,
         uint32_t maxPrimitiveLights,
+        uint32_t maxInstancedMeshes,
+        uint32_t maxInstancedMeshTriangles,
+        uint32_t maxInstancedLights,
         uint32_t maxGeometryInstances,
         uint32_t environmentMapWidth,
-        uint32_t environmentMapHeight);
+        uint32_t environmentMapHeight,
+        uint32_t giReservoirArrayPitch);
 
     void InitializeNeighborOffsets(nvrhi::ICommandList* commandList, uint32_t neighborOffsetCount);
 
     uint32_t GetMaxEmissiveMeshes() const;
     uint32_t GetMaxEmissiveTriangles() const;
     uint32_t GetMaxPrimitiveLights() const;
+    uint32_t GetMaxInstancedMeshes() const;
+    uint32_t GetMaxInstancedMeshTriangles() const;
+    uint32_t GetMaxInstancedLights() const;
+    uint32_t GetLightBufferCapacity() const; // light indices per frame, including the instanced lights
     uint32_t GetMaxGeometryInstances() const;
+    uint32_t GetGIReservoirArrayPitch() const;
 
 private:
     bool m_neighborOffsetsInitialized = false;
     uint32_t m_maxEmissiveMeshes = 0;
     uint32_t m_maxEmissiveTriangles = 0;
     uint32_t m_maxPrimitiveLights = 0;
+    uint32_t m_maxInstancedMeshes = 0;
+    uint32_t m_maxInstancedMeshTriangles = 0;
+    uint32_t m_maxInstancedLights = 0;
     uint32_t m_maxGeometryInstances = 0;
+    uint32_t m_giReservoirArrayPitch = 0;
 };
@@ -218,7 +218,11 @@ bool SampleScene::LoadWithExecutor(const std::filesystem::path& jsonFileName, tf
         }
     }
 
-    // Enumerate the available environment maps
+    return true;
+}
+
+void SampleScene::EnumerateEnvironmentMaps()
+{
     std::vector<std::string> environmentMapNames;
     const std::string texturePath = "/media/environment/";
     m_fs->enumerateFiles(texturePath, { ".exr" }, donut::vfs::enumerate_to_vector(environmentMapNames));
@@ -230,8 +234,6 @@ bool SampleScene::LoadWithExecutor(const std::filesystem::path& jsonFileName, tf
     {
         m_environmentMaps.push_back(texturePath + mapName);
     }
-
-    return true;
 }
 
 const donut::engine::SceneGraphAnimation* SampleScene::GetBenchmarkAnimation() const
@@ -397,8 +399,8 @@ void SampleScene::BuildMeshBLASes(nvrhi::IDevice* device)
     commandList->close();
     device->executeCommandList(commandList);
 
-    device->waitForIdle();
-    device->runGarbageCollection();
+    // No need to wait for the builds: the first frame is submitted to the same queue after them,
+    // and the scratch memory is released by the regular garbage collection once they complete.
 }
 
 void SampleScene::UpdateSkinnedMeshBLASes(nvrhi::ICommandList* commandList, uint32_t frameIndex)
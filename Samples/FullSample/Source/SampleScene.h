@@ -104,6 +104,9 @@ public:
     const donut::engine::SceneGraphAnimation* GetBenchmarkAnimation() const;
     const donut::engine::PerspectiveCamera* GetBenchmarkCamera() const;
     
+    // Independent of the scene contents, so it can run concurrently with the loading.
+    void EnumerateEnvironmentMaps();
+
     void BuildMeshBLASes(nvrhi::IDevice* device);
     void UpdateSkinnedMeshBLASes(nvrhi::ICommandList* commandList, uint32_t frameIndex);
     void BuildTopLevelAccelStruct(nvrhi::ICommandList* commandList);
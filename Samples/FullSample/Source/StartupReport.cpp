@@ -0,0 +1,110 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "StartupReport.h"
+
+#include <donut/core/log.h>
+#include <json/writer.h>
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+
+StartupReport::Scope::Scope(StartupReport& report, const char* name)
+    : m_report(report)
+    , m_name(name)
+    , m_start(Clock::now())
+{
+}
+
+StartupReport::Scope::~Scope()
+{
+    m_report.AddPhase(m_name, m_start, Clock::now());
+}
+
+StartupReport::StartupReport()
+    : m_origin(Clock::now())
+{
+}
+
+double StartupReport::ToMilliseconds(Clock::time_point time) const
+{
+    return std::chrono::duration<double, std::milli>(time - m_origin).count();
+}
+
+void StartupReport::AddPhase(const char* name, Clock::time_point start, Clock::time_point end)
+{
+    Phase phase;
+    phase.name = name;
+    phase.start = ToMilliseconds(start);
+    phase.duration = std::chrono::duration<double, std::milli>(end - start).count();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_phases.push_back(std::move(phase));
+}
+
+bool StartupReport::MarkFirstFrame()
+{
+    if (m_timeToFirstFrame > 0.0)
+        return false;
+
+    m_timeToFirstFrame = ToMilliseconds(Clock::now());
+    return true;
+}
+
+std::vector<StartupReport::Phase> StartupReport::GetSortedPhases() const
+{
+    std::vector<Phase> phases;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        phases = m_phases;
+    }
+
+    std::stable_sort(phases.begin(), phases.end(), [](const Phase& a, const Phase& b) { return a.start < b.start; });
+    return phases;
+}
+
+void StartupReport::Log() const
+{
+    donut::log::info("Startup: first frame after %.0f ms", m_timeToFirstFrame);
+
+    for (const Phase& phase : GetSortedPhases())
+        donut::log::info("    %-32s at %8.1f ms, took %8.1f ms", phase.name.c_str(), phase.start, phase.duration);
+}
+
+bool StartupReport::WriteJson(const std::filesystem::path& fileName) const
+{
+    Json::Value root(Json::objectValue);
+    root["timeToFirstFrameMs"] = m_timeToFirstFrame;
+
+    Json::Value& phases = root["phases"] = Json::Value(Json::arrayValue);
+    for (const Phase& phase : GetSortedPhases())
+    {
+        Json::Value& node = phases.append(Json::Value(Json::objectValue));
+        node["name"] = phase.name;
+        node["startMs"] = phase.start;
+        node["durationMs"] = phase.duration;
+    }
+
+    std::ofstream file(fileName);
+    if (!file.is_open())
+    {
+        donut::log::error("Couldn't write the startup report to '%s'", fileName.generic_string().c_str());
+        return false;
+    }
+
+    Json::StreamWriterBuilder builder;
+    builder.settings_["precision"] = 4;
+    std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
+    writer->write(root, &file);
+    file << std::endl;
+
+    return true;
+}
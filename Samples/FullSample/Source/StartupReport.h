@@ -0,0 +1,72 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Records the startup phases of the application, from the creation of the report to the first frame.
+// The phases may overlap because some of them run concurrently on worker threads or on the scene loading thread,
+// so the report stores the start of each phase as well as its duration, both relative to the creation of the report.
+class StartupReport
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Measures the phase from its construction to its destruction.
+    class Scope
+    {
+    public:
+        Scope(StartupReport& report, const char* name);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        StartupReport& m_report;
+        const char* m_name;
+        Clock::time_point m_start;
+    };
+
+    StartupReport();
+
+    // Thread safe.
+    void AddPhase(const char* name, Clock::time_point start, Clock::time_point end);
+
+    // Marks the end of the startup, returns false if it was already marked.
+    bool MarkFirstFrame();
+
+    [[nodiscard]] double GetTimeToFirstFrame() const { return m_timeToFirstFrame; }
+
+    void Log() const;
+    bool WriteJson(const std::filesystem::path& fileName) const;
+
+private:
+    struct Phase
+    {
+        std::string name;
+        double start = 0.0;    // milliseconds
+        double duration = 0.0; // milliseconds
+    };
+
+    [[nodiscard]] double ToMilliseconds(Clock::time_point time) const;
+    [[nodiscard]] std::vector<Phase> GetSortedPhases() const;
+
+    Clock::time_point m_origin;
+    double m_timeToFirstFrame = 0.0; // milliseconds, zero until MarkFirstFrame
+
+    mutable std::mutex m_mutex;
+    std::vector<Phase> m_phases;
+};
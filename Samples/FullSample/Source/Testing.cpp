@@ -176,19 +176,28 @@ void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParamet
 
     options.add_options()
         ("aa-mode", "Anti-aliasing mode: OFF, ACC, TAA, DLSS (if supported)", value(ui.aaMode))
+        ("adaptive-budget", "Scale the ReSTIR DI sample counts per tile by the previous frame's confidence", value(ui.lightingSettings.enableAdaptiveSampleBudget))
         ("alpha-tested", "Alpha-tested materials toggle", value(ui.gbufferSettings.enableAlphaTestedGeometry))
         ("animation", "Animations toggle", value(ui.enableAnimations))
+        ("async-light-prep", "Run the light preparation passes on the async compute queue (Vulkan only)", value(ui.asyncLightPreparation))
         ("benchmark", "Run the benchmark", value(args.benchmark))
+        ("benchmark-report", "Write the benchmark timings and light counts to a JSON file", value(args.benchmarkReportFileName))
         ("bloom", "Bloom effect toggle", value(ui.enableBloom))
         ("checkerboard", "Use checkerboard rendering", value(checkerboard))
+        ("compact-gbuffer", "Read the G-buffer surfaces from the compact surface buffer in the lighting passes", value(ui.lightingSettings.enableCompactGBufferSurfaces))
         ("d,debug", "Enable the DX12 or Vulkan validation layers", value(deviceParams.enableDebugRuntime))
+        ("dynamic-resolution", "Adjust the resolution scale to reach the target GPU frame time", value(ui.enableDynamicResolution))
+        ("dynamic-resolution-target", "Target GPU frame time for dynamic resolution, in milliseconds", value(ui.dynamicResolutionTarget))
         ("disable-bg-opt", "Disable DX12 driver background optimization", value(args.disableBackgroundOptimization))
         ("direct-resampling", "Direct lighting resampling mode: NONE, TEMPORAL, SPATIAL, TEMPORAL_SPATIAL, FUSED", value(ui.restirDI.resamplingMode))
         ("fullscreen", "Run in full screen", value(deviceParams.startFullscreen))
+        ("gi-downscale", "ReSTIR GI resolution divider: 1 (full), 2 (half) or 4 (quarter)", value(ui.lightingSettings.giDownscaleFactor))
+        ("gpu-culling", "Cull the rasterized G-buffer geometry on the GPU and draw it with multi-draw-indirect", value(ui.gbufferSettings.enableGpuCulling))
         ("h,help", "Display this help message", value(help))
         ("height", "Window height", value(deviceParams.backBufferHeight))
         ("indirect-resampling", "ReSTIR GI resampling mode: NONE, TEMPORAL, SPATIAL, TEMPORAL_SPATIAL, FUSED", value(ui.restirGI.resamplingMode))
         ("noise-mix", "Amount of noise to mix in after denoising", value(ui.noiseMix))
+        ("parallel-recording", "Record independent passes into separate command lists on worker threads", value(ui.parallelCommandRecording))
         ("pixel-jitter", "Pixel jitter toggle", value(ui.enablePixelJitter))
         ("preset", "Rendering settings preset: FAST, MEDIUM, UNBIASED, ULTRA, REFERENCE", value(ui))
         ("rasterize-gbuffer", "G-buffer rasterization toggle", value(ui.rasterizeGBuffer))
@@ -197,12 +206,20 @@ void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParamet
         ("indirect-mode", "Indirect lighting mode: NONE, BRDF, RESTIRGI", value(ui.indirectLightingMode))
         ("render-width", "Internal render target width, overrides window size", value(args.renderWidth))
         ("render-height", "Internal render target height, overrides window size", value(args.renderHeight))
+        ("recording-threads", "Number of worker threads for command list recording, default is one per hardware thread", value(args.recordingThreads))
         ("save-file", "Save frame to file and exit", value(args.saveFrameFileName))
         ("save-frame", "Index of the frame to save, default is 0", value(args.saveFrameIndex))
+        ("scene", "Scene file to load instead of the Bistro, for example one made by RtxdiSceneGenerator", value(args.sceneFileName))
+        ("sorted-brdf-rays", "Bin the BRDF rays by direction before tracing them (RayQuery only)", value(ui.lightingSettings.enableSortedBrdfRays))
+        ("startup-report", "Write the startup phase timings to a JSON file after the first frame", value(args.startupReportFileName))
         ("tone-mapping", "Tone mapping toggle", value(ui.enableToneMapping))
         ("transparent", "Transparent materials toggle", value(ui.gbufferSettings.enableTransparentGeometry))
+        ("validate-gradient-filter", "Compare the filtered gradients with a CPU reference after the first frame that computes them", value(ui.validateGradientFilter))
         ("verbose", "Enable debug log messages", value(args.verbose))
+        ("visibility-buffer", "Rasterize a visibility buffer and evaluate the materials in a separate pass", value(ui.useVisibilityBuffer))
+        ("visibility-cache", "Reuse the previous frame's final visibility in ReSTIR DI shading when the sample and surface have not moved", value(ui.lightingSettings.enableVisibilityCache))
         ("vk", "Run the application using Vulkan (otherwise D3D12 if supported)", value(useVk))
+        ("wavefront-brdf-rays", "Trace the BRDF rays first and shade the hits from per-material queues", value(ui.lightingSettings.enableWavefrontBrdfRays))
         ("width", "Window width", value(deviceParams.backBufferWidth))
     ;
 
@@ -34,6 +34,10 @@ struct CommandLineArguments
     bool disableBackgroundOptimization = false;
     int renderWidth = 0;
     int renderHeight = 0;
+    int recordingThreads = 0; // 0 means one per hardware thread
+    std::string startupReportFileName;
+    std::string sceneFileName;           // native path, loads the Bistro scene if empty
+    std::string benchmarkReportFileName;
 };
 
 void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParameters& deviceParams, UIData& ui, CommandLineArguments& args);
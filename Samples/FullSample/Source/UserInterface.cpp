@@ -33,10 +33,10 @@
  */
 
 #include "UserInterface.h"
+#include "IesProfileAtlas.h"
 #include "Profiler.h"
 #include "SampleScene.h"
 
-#include <donut/engine/IesProfile.h>
 #include <donut/app/Camera.h>
 #include <donut/app/UserInterfaceUtils.h>
 #include <donut/core/json.h>
@@ -264,6 +264,15 @@ void UserInterface::PerformanceWindow()
 
         m_ui.resources->profiler->BuildUI(m_ui.lightingSettings.enableRayCounts);
     }
+
+    const FrameGraph::Statistics& graphStats = m_ui.frameGraphStats;
+    ImGui::Text("Frame graph: %u/%u passes, %u barriers, %u aliasing barriers, %u/%u clears skipped",
+        graphStats.numPasses - graphStats.numCulledPasses, graphStats.numPasses,
+        graphStats.numBarriers, graphStats.numAliasingBarriers,
+        graphStats.numSkippedClears, graphStats.numClears + graphStats.numSkippedClears);
+    ImGui::Text("Transient memory: %.2f MB (%.2f MB without aliasing)",
+        double(graphStats.transientHeapSize) / (1024.0 * 1024.0),
+        double(graphStats.unaliasedTransientSize) / (1024.0 * 1024.0));
 }
 
 constexpr uint32_t c_ColorRegularHeader   = 0xffff8080;
@@ -291,7 +300,12 @@ void UserInterface::GeneralRenderingSettings()
         {
             if (GetDevice()->queryFeatureSupport(nvrhi::Feature::RayTracingPipeline))
             {
-                m_ui.reloadShaders |= ImGui::Checkbox("Use RayQuery", (bool*)&m_ui.useRayQuery);
+                m_ui.rayQueryChanged |= ImGui::Checkbox("Use RayQuery", (bool*)&m_ui.useRayQuery);
+                if (m_ui.pipelineSwitchPending)
+                {
+                    ImGui::SameLine();
+                    ImGui::TextDisabled("(compiling...)");
+                }
             }
             else
             {
@@ -306,11 +320,55 @@ void UserInterface::GeneralRenderingSettings()
         }
 
         ImGui::Checkbox("Rasterize G-Buffer", (bool*)&m_ui.rasterizeGBuffer);
+        if (m_ui.rasterizeGBuffer)
+        {
+            ImGui::Checkbox("GPU Culling (Multi-Draw Indirect)", (bool*)&m_ui.gbufferSettings.enableGpuCulling);
+            ShowHelpMarker("Frustum cull the G-buffer geometries in a compute pass that writes draw arguments, "
+                "and draw them with one indirect multi-draw per material domain instead of one draw call each. "
+                "Compare the 'G-Buffer Recording (CPU)' profiler line with the CPU draw loop.");
+            ImGui::Checkbox("Visibility Buffer", (bool*)&m_ui.useVisibilityBuffer);
+            ShowHelpMarker("Rasterize only the instance, geometry and primitive indices of each pixel, "
+                "then evaluate the materials in compute passes that process the pixels sorted by material. "
+                "Every visible pixel is shaded once regardless of overdraw. Compare the 'G-Buffer Fill' profiler line with the regular rasterizer.");
+        }
+        m_ui.resetAccumulation |= ImGui::Checkbox("Compact G-Buffer Surfaces", (bool*)&m_ui.lightingSettings.enableCompactGBufferSurfaces);
+        ShowHelpMarker("Pack the G-buffer into one 16-byte record per pixel after it's rendered, "
+            "so that the lighting passes read a surface with one load instead of five texture fetches.");
+        if (m_ui.useRayQuery)
+        {
+            ImGui::Checkbox("Sorted BRDF Rays", (bool*)&m_ui.lightingSettings.enableSortedBrdfRays);
+            ShowHelpMarker("Generate the BRDF rays in a separate pass that bins them by direction octant within 16x16 pixel tiles, "
+                "then trace them in the binned order and write the results back to their pixels. "
+                "Compare the 'BRDF Ray Binning' and 'BRDF or MIS Rays' profiler rows with the in-place path.");
+        }
+        ImGui::Checkbox("Wavefront BRDF Rays", (bool*)&m_ui.lightingSettings.enableWavefrontBrdfRays);
+        ShowHelpMarker("Trace the binned BRDF rays in a pass that only records the hits and appends them to per-material-domain queues "
+            "(opaque, alpha tested, transmissive, miss), then shade each queue in a separate indirect dispatch. "
+            "Compare the 'BRDF or MIS Rays' and 'BRDF Ray Hit Shading' profiler rows with Ray Query on and off.");
+        ImGui::Checkbox("Parallel Command Recording", (bool*)&m_ui.parallelCommandRecording);
+
+        if (GetDevice()->queryFeatureSupport(nvrhi::Feature::ComputeQueue) && GetDevice()->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D12)
+        {
+            ImGui::Checkbox("Async Light Preparation", (bool*)&m_ui.asyncLightPreparation);
+            ShowHelpMarker("Run light preparation, light PDF mipmap generation and presampling on the compute queue, overlapping with the G-buffer fill. "
+                "Vulkan only: on D3D12, the light resources are kept in states that compute command lists cannot use.");
+        }
 
-        int resolutionScalePercents = int(m_ui.resolutionScale * 100.f);
-        ImGui::SliderInt("Resolution Scale (%)", &resolutionScalePercents, 50, 100);
-        m_ui.resolutionScale = float(resolutionScalePercents) * 0.01f;
-        m_ui.resolutionScale = dm::clamp(m_ui.resolutionScale, 0.5f, 1.0f);
+        ImGui::Checkbox("Dynamic Resolution", (bool*)&m_ui.enableDynamicResolution);
+        ShowHelpMarker("Adjust the resolution scale every frame to keep the GPU frame time close to the target. "
+            "Requires the profiler, and is suspended in the Accumulation anti-aliasing mode.");
+        if (m_ui.enableDynamicResolution)
+        {
+            ImGui::SliderFloat("Target Frame Time (ms)", &m_ui.dynamicResolutionTarget, 4.f, 50.f, "%.1f");
+            ImGui::Text("Resolution Scale: %d%%", int(roundf(m_ui.resolutionScale * 100.f)));
+        }
+        else
+        {
+            int resolutionScalePercents = int(roundf(m_ui.resolutionScale * 100.f));
+            ImGui::SliderInt("Resolution Scale (%)", &resolutionScalePercents, 50, 100);
+            m_ui.resolutionScale = float(resolutionScalePercents) * 0.01f;
+            m_ui.resolutionScale = dm::clamp(m_ui.resolutionScale, 0.5f, 1.0f);
+        }
 
         ImGui::Checkbox("##enableFpsLimit", &m_ui.enableFpsLimit);
         ImGui::SameLine();
@@ -438,6 +496,16 @@ void UserInterface::SamplingSettings()
                 "Spatial\0"
                 "Temporal + Spatial\0"
                 "Fused Spatiotemporal\0");
+
+            int giResolution = (m_ui.lightingSettings.giDownscaleFactor >= 4) ? 2 : (m_ui.lightingSettings.giDownscaleFactor == 2) ? 1 : 0;
+            if (ImGui::Combo("Resolution", &giResolution, "Full\0Half\0Quarter\0"))
+            {
+                m_ui.lightingSettings.giDownscaleFactor = 1u << giResolution;
+                m_ui.resetAccumulation = true;
+            }
+            ShowHelpMarker("Trace the BRDF rays and run ReSTIR GI at a reduced resolution, then upsample the result "
+                "guided by the G-buffer depth and normals. Not available with checkerboard rendering, "
+                "and disables the reuse of RTXDI samples for secondary surfaces.");
             ImGui::PopItemWidth();
             ImGui::Separator();
 
@@ -652,6 +720,18 @@ void UserInterface::SamplingSettings()
                     samplingSettingsChanged |= ImGui::SliderInt("Final Visibility - Max Age", (int*)&m_ui.restirDI.shadingParams.finalVisibilityMaxAge, 0, 16);
                 }
 
+                m_ui.resetAccumulation |= ImGui::Checkbox("Visibility Cache", (bool*)&m_ui.lightingSettings.enableVisibilityCache);
+                ShowHelpMarker(
+                    "Keep the last final visibility of each pixel and reuse it while the pixel shades the same light sample "
+                    "from the same surface position, instead of tracing the visibility ray again. A rotating fraction of the pixels "
+                    "traces the ray anyway on every frame to pick up moving occluders. The rays saved this way are reported by the profiler.");
+
+                if (m_ui.lightingSettings.enableVisibilityCache && m_showAdvancedSamplingSettings)
+                {
+                    m_ui.resetAccumulation |= ImGui::SliderInt("Visibility Cache - Refresh Period", (int*)&m_ui.lightingSettings.visibilityCacheRefreshPeriod, 1, 32);
+                    m_ui.resetAccumulation |= ImGui::SliderFloat("Visibility Cache - Max Distance", &m_ui.lightingSettings.visibilityCacheMaxDistance, 0.f, 0.05f, "%.4f");
+                }
+
                 ImGui::TreePop();
             }
         }
@@ -996,6 +1076,22 @@ void UserInterface::DenoiserSettings()
                 ImGui::SliderFloat("Gradient Sensitivity", &m_ui.lightingSettings.gradientSensitivity, 1.f, 20.f);
                 ImGui::SliderFloat("Darkness Bias (EV)", &m_ui.lightingSettings.gradientLogDarknessBias, -16.f, -4.f);
                 ImGui::SliderFloat("Confidence History Length", &m_ui.lightingSettings.confidenceHistoryLength, 0.f, 3.f);
+                if (ImGui::Button("Validate Gradient Filter"))
+                    m_ui.validateGradientFilter = true;
+                ShowHelpMarker("Run the gradient filter on the CPU and compare the result with the GPU output of the next frame. "
+                    "The result is printed to the log.");
+            }
+            if (m_ui.lightingSettings.enableGradients)
+            {
+                ImGui::Checkbox("Adaptive Sample Budget", (bool*)&m_ui.lightingSettings.enableAdaptiveSampleBudget);
+                ShowHelpMarker("Scale the ReSTIR DI initial light samples and spatial resampling taps in each 8x8 tile "
+                    "by the lowest confidence the tile had in the previous frame. Tiles where the lighting changed get more samples, "
+                    "stable tiles get fewer. Compare the ray counts and image quality with fixed budgets using the benchmark.");
+                if (m_ui.lightingSettings.enableAdaptiveSampleBudget)
+                {
+                    ImGui::SliderFloat("Budget at High Confidence", &m_ui.lightingSettings.adaptiveBudgetMinScale, 0.f, 1.f);
+                    ImGui::SliderFloat("Budget at Low Confidence", &m_ui.lightingSettings.adaptiveBudgetMaxScale, 1.f, 4.f);
+                }
             }
 
             if (m_showAdvancedDenoisingSettings)
@@ -1134,6 +1230,9 @@ void UserInterface::SceneSettings()
 
         m_ui.resetAccumulation |= ImGui::Checkbox("Alpha-Tested Geometry", (bool*)&m_ui.gbufferSettings.enableAlphaTestedGeometry);
         m_ui.resetAccumulation |= ImGui::Checkbox("Transparent Geometry", (bool*)&m_ui.gbufferSettings.enableTransparentGeometry);
+        m_ui.resetAccumulation |= ImGui::Checkbox("Instanced Emissive Meshes", &m_ui.enableInstancedMeshLights);
+        ShowHelpMarker("Store the emissive triangles of meshes with multiple instances once in local space, "
+            "and transform them per instance when the lights are sampled.");
 
         const auto& environmentMaps = m_ui.resources->scene->GetEnvironmentMaps();
 
@@ -22,6 +22,7 @@
 #include <donut/app/imgui_renderer.h>
 #include "RenderPasses/GBufferPass.h"
 #include "RenderPasses/LightingPasses.h"
+#include "FrameGraph.h"
 
 #if WITH_NRD
 #include <NRD.h>
@@ -33,9 +34,7 @@
 
 class SampleScene;
 
-namespace donut::engine {
-    struct IesProfile;
-}
+struct IesProfile;
 
 namespace donut::app {
     class FirstPersonCamera;
@@ -82,7 +81,7 @@ struct UIResources
     std::shared_ptr<SampleScene> scene;
     donut::app::FirstPersonCamera* camera = nullptr;
 
-    std::vector<std::shared_ptr<donut::engine::IesProfile>> iesProfiles;
+    std::vector<std::shared_ptr<IesProfile>> iesProfiles;
 
     std::shared_ptr<donut::engine::Material> selectedMaterial;
 };
@@ -110,6 +109,8 @@ enum DebugRenderOutput
 struct UIData
 {
     bool reloadShaders = false;
+    bool rayQueryChanged = false;
+    bool pipelineSwitchPending = false;
     bool resetAccumulation = false;
     bool showUI = true;
     bool isLoading = true;
@@ -121,8 +122,11 @@ struct UIData
     ibool enableToneMapping = true;
     ibool enablePixelJitter = true;
     ibool rasterizeGBuffer = true;
+    ibool useVisibilityBuffer = false;
     ibool useRayQuery = true;
     ibool enableBloom = true;
+    ibool parallelCommandRecording = true;
+    ibool asyncLightPreparation = false;
     float exposureBias = -1.0f;
     float verticalFov = 60.f;
 
@@ -143,6 +147,7 @@ struct UIData
     int environmentMapDirty = 0; // 1 -> needs to be rendered; 2 -> passes/textures need to be created
     int environmentMapIndex = -1;
     bool environmentMapImportanceSampling = true;
+    bool enableInstancedMeshLights = true; // Store emissive geometries with multiple instances once, see PrepareLightsPass
     float environmentIntensityBias = 0.f;
     float environmentRotation = 0.f;
     
@@ -165,6 +170,8 @@ struct UIData
 #endif
 
     float resolutionScale = 1.f;
+    ibool enableDynamicResolution = false;
+    float dynamicResolutionTarget = 16.6f; // milliseconds
 
     bool enableFpsLimit = false;
     uint32_t fpsLimit = 60;
@@ -178,10 +185,12 @@ struct UIData
     bool freezeRegirPosition = false;
     std::optional<int> animationFrame;
     std::string benchmarkResults;
+    FrameGraph::Statistics frameGraphStats;
 
     uint32_t visualizationMode = 0; // See the VIS_MODE_XXX constants in ShaderParameters.h
     uint32_t debugRenderOutputBuffer = 0; // See DebugRenderOutput enum above
 
+    bool validateGradientFilter = false; // compare the filtered gradients with a CPU reference after the next frame
     bool storeReferenceImage = false;
     bool referenceImageCaptured = false;
     float referenceImageSplit = 0.f;
@@ -24,7 +24,6 @@
 #include <donut/engine/FramebufferFactory.h>
 #include <donut/engine/DescriptorTableManager.h>
 #include <donut/engine/View.h>
-#include <donut/engine/IesProfile.h>
 #include <donut/app/DeviceManager.h>
 #include <donut/core/log.h>
 #include <donut/core/vfs/VFS.h>
@@ -32,9 +31,18 @@
 #include <nvrhi/utils.h>
 #ifdef DONUT_WITH_TASKFLOW
 #include <taskflow/taskflow.hpp>
+#include <json/writer.h>
 #endif
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
 #include "DebugViz/DebugVizPasses.h"
+#include "CommandRecorder.h"
+#include "DynamicResolution.h"
+#include "FrameGraph.h"
+#include "IesProfileAtlas.h"
 #include "RenderPasses/AccumulationPass.h"
 #include "RenderPasses/CompositingPass.h"
 #include "RenderPasses/ConfidencePass.h"
@@ -50,6 +58,7 @@
 #include "RenderTargets.h"
 #include "RtxdiResources.h"
 #include "SampleScene.h"
+#include "StartupReport.h"
 #include "Testing.h"
 #include "UserInterface.h"
 
@@ -80,11 +89,12 @@ static int g_ExitCode = 0;
 class SceneRenderer : public app::ApplicationBase
 {
 public:
-    SceneRenderer(app::DeviceManager* deviceManager, UIData& ui, CommandLineArguments& args)
+    SceneRenderer(app::DeviceManager* deviceManager, UIData& ui, CommandLineArguments& args, StartupReport& startupReport)
         : ApplicationBase(deviceManager)
         , m_bindingCache(deviceManager->GetDevice())
         , m_ui(ui)
         , m_args(args)
+        , m_startupReport(startupReport)
     { 
         m_ui.resources->camera = &m_camera;
     }
@@ -101,6 +111,9 @@ public:
 
     bool Init()
     {
+        std::optional<StartupReport::Scope> phase;
+        phase.emplace(m_startupReport, "File systems");
+
         std::filesystem::path mediaPath = app::GetDirectoryWithExecutable().parent_path() / "Assets/Media";
         if (!std::filesystem::exists(mediaPath))
         {
@@ -124,6 +137,24 @@ public:
         m_rootFs->mount("/shaders/donut", frameworkShaderPath);
         m_rootFs->mount("/shaders/app", appShaderPath);
 
+        std::filesystem::path scenePath = "/Assets/Media/bistro-rtxdi.scene.json";
+        if (!m_args.sceneFileName.empty())
+        {
+            // Scenes from elsewhere, such as the generated ones, are loaded through a mount of their folder
+            const std::filesystem::path sceneFile = std::filesystem::absolute(m_args.sceneFileName);
+            if (!std::filesystem::exists(sceneFile))
+            {
+                log::error("Couldn't find the scene file '%s'.", sceneFile.generic_string().c_str());
+                return false;
+            }
+
+            log::debug("Mounting %s to %s", sceneFile.parent_path().string().c_str(), "/Scene");
+            m_rootFs->mount("/Scene", sceneFile.parent_path());
+            scenePath = std::filesystem::path("/Scene") / sceneFile.filename();
+        }
+
+        phase.emplace(m_startupReport, "Render pass creation");
+
         m_shaderFactory = std::make_shared<engine::ShaderFactory>(GetDevice(), m_rootFs, "/shaders");
         m_CommonPasses = std::make_shared<engine::CommonRenderPasses>(GetDevice(), m_shaderFactory);
 
@@ -140,19 +171,20 @@ public:
             m_bindlessLayout = GetDevice()->createBindlessLayout(bindlessLayoutDesc);
         }
 
-        std::filesystem::path scenePath = "/Assets/Media/bistro-rtxdi.scene.json";
-
         m_descriptorTableManager = std::make_shared<engine::DescriptorTableManager>(GetDevice(), m_bindlessLayout);
 
         m_TextureCache = std::make_shared<donut::engine::TextureCache>(GetDevice(), m_rootFs, m_descriptorTableManager);
         m_TextureCache->SetInfoLogSeverity(donut::log::Severity::Debug);
         
-        m_iesProfileLoader = std::make_unique<engine::IesProfileLoader>(GetDevice(), m_shaderFactory, m_descriptorTableManager);
+        m_iesProfileAtlas = std::make_unique<IesProfileAtlas>(GetDevice(), m_descriptorTableManager);
 
         auto sceneTypeFactory = std::make_shared<SampleSceneTypeFactory>();
         m_scene = std::make_shared<SampleScene>(GetDevice(), *m_shaderFactory, m_rootFs, m_TextureCache, m_descriptorTableManager, sceneTypeFactory);
         m_ui.resources->scene = m_scene;
 
+        // The scene loading thread also uses the executor to load the meshes and textures in parallel
+        m_executor = std::make_unique<tf::Executor>(m_args.recordingThreads > 0 ? size_t(m_args.recordingThreads) : std::thread::hardware_concurrency());
+
         SetAsynchronousLoadingEnabled(true);
         BeginLoadingScene(m_rootFs, scenePath);
         GetDeviceManager()->SetVsyncEnabled(true);
@@ -169,6 +201,7 @@ public:
         m_accumulationPass = std::make_unique<AccumulationPass>(GetDevice(), m_shaderFactory);
         m_gBufferPass = std::make_unique<RaytracedGBufferPass>(GetDevice(), m_shaderFactory, m_CommonPasses, m_scene, m_profiler, m_bindlessLayout);
         m_rasterizedGBufferPass = std::make_unique<RasterizedGBufferPass>(GetDevice(), m_shaderFactory, m_CommonPasses, m_scene, m_profiler, m_bindlessLayout);
+        m_visibilityResolvePass = std::make_unique<VisibilityBufferResolvePass>(GetDevice(), m_shaderFactory, m_CommonPasses, m_scene, m_profiler, m_bindlessLayout);
         m_postprocessGBufferPass = std::make_unique<PostprocessGBufferPass>(GetDevice(), m_shaderFactory);
         m_glassPass = std::make_unique<GlassPass>(GetDevice(), m_shaderFactory, m_CommonPasses, m_scene, m_profiler, m_bindlessLayout);
         m_prepareLightsPass = std::make_unique<PrepareLightsPass>(GetDevice(), m_shaderFactory, m_CommonPasses, m_scene, m_bindlessLayout);
@@ -188,28 +221,58 @@ public:
         }
 #endif
 
-        LoadShaders();
+        phase.reset();
 
+        // These phases are independent of each other and of the scene loading that runs on its own thread.
+        // The shader factory is not thread safe, so all shaders are created by one task.
         std::vector<std::string> profileNames;
         m_rootFs->enumerateFiles("/Assets/Media/ies-profiles", { ".ies" }, vfs::enumerate_to_vector(profileNames));
+        std::vector<std::shared_ptr<IesProfile>> profiles(profileNames.size());
+
+        tf::Taskflow taskflow;
+
+        taskflow.emplace([this]()
+        {
+            StartupReport::Scope scope(m_startupReport, "Shader and pipeline creation");
+            LoadShaders();
+        }).name("Shaders");
 
-        for (const std::string& profileName : profileNames)
+        taskflow.emplace([this, &profileNames, &profiles](tf::Subflow& subflow)
         {
-            auto profile = m_iesProfileLoader->LoadIesProfile(*m_rootFs, "/Assets/Media/ies-profiles/" + profileName);
+            StartupReport::Scope scope(m_startupReport, "IES profile parsing and baking");
 
-            if (profile)
+            for (size_t index = 0; index < profileNames.size(); index++)
             {
-                m_iesProfiles.push_back(profile);
+                subflow.emplace([this, &profileNames, &profiles, index]()
+                {
+                    profiles[index] = IesProfileAtlas::LoadProfile(*m_rootFs, "/Assets/Media/ies-profiles/" + profileNames[index]);
+                });
             }
-        }
-        m_ui.resources->iesProfiles = m_iesProfiles;
+
+            subflow.join();
+        }).name("IES profiles");
+
+        taskflow.emplace([this]()
+        {
+            StartupReport::Scope scope(m_startupReport, "Environment map enumeration");
+            m_scene->EnumerateEnvironmentMaps();
+        }).name("Environment maps");
+
+        m_executor->run(taskflow).wait();
+
+        profiles.erase(std::remove(profiles.begin(), profiles.end(), nullptr), profiles.end());
+        m_iesProfileAtlas->SetProfiles(std::move(profiles));
+        m_ui.resources->iesProfiles = m_iesProfileAtlas->GetProfiles();
 
         m_commandList = GetDevice()->createCommandList();
+        m_frameGraphPool = std::make_unique<FrameGraphResourcePool>(GetDevice());
+
+        m_commandRecorder = std::make_unique<CommandRecorder>(GetDevice(), m_executor.get());
 
         return true;
     }
 
-    void AssignIesProfiles(nvrhi::ICommandList* commandList)
+    void AssignIesProfiles()
     {
         for (const auto& light : m_scene->GetSceneGraph()->GetLights())
         {
@@ -223,14 +286,10 @@ public:
                 if (spotLight.profileTextureIndex >= 0)
                     continue;
 
-                auto foundProfile = std::find_if(m_iesProfiles.begin(), m_iesProfiles.end(),
-                    [&spotLight](auto it) { return it->name == spotLight.profileName; });
-
-                if (foundProfile != m_iesProfiles.end())
+                // All profiles are uploaded in SceneLoaded, so this is only a lookup
+                if (const IesProfile* profile = m_iesProfileAtlas->FindProfile(spotLight.profileName))
                 {
-                    m_iesProfileLoader->BakeIesProfile(**foundProfile, commandList);
-
-                    spotLight.profileTextureIndex = (*foundProfile)->textureIndex;
+                    spotLight.profileTextureIndex = profile->shaderIndex;
                 }
             }
         }
@@ -238,6 +297,8 @@ public:
 
     virtual void SceneLoaded() override
     {
+        StartupReport::Scope phase(m_startupReport, "Scene setup");
+
         ApplicationBase::SceneLoaded();
 
         m_scene->FinishedLoading(GetFrameIndex());
@@ -264,9 +325,33 @@ public:
             m_sunLight->angularSize = 1.f;
         }
 
-        m_commandList->open();
-        AssignIesProfiles(m_commandList);
-        m_commandList->close();
+        // The BLAS creation is the longest part, overlap it with the rest. It submits its own command list,
+        // so the IES profiles are only recorded here and submitted after it.
+        tf::Taskflow taskflow;
+
+        taskflow.emplace([this]()
+        {
+            StartupReport::Scope scope(m_startupReport, "BLAS creation");
+            m_scene->BuildMeshBLASes(GetDevice());
+        }).name("BLAS");
+
+        taskflow.emplace([this]()
+        {
+            StartupReport::Scope scope(m_startupReport, "IES profile upload");
+            m_commandList->open();
+            m_iesProfileAtlas->Upload(m_commandList);
+            m_commandList->close();
+            AssignIesProfiles();
+        }).name("IES profiles");
+
+        taskflow.emplace([this]()
+        {
+            StartupReport::Scope scope(m_startupReport, "G-buffer draw records");
+            m_rasterizedGBufferPass->CreateBindingSet();
+        }).name("Draw records");
+
+        m_executor->run(taskflow).wait();
+
         GetDevice()->executeCommandList(m_commandList);
 
         // Create an environment light
@@ -275,10 +360,6 @@ public:
         m_environmentLight->SetName("Environment");
         m_ui.environmentMapDirty = 2;
         m_ui.environmentMapIndex = 0;
-        
-        m_rasterizedGBufferPass->CreateBindingSet();
-
-        m_scene->BuildMeshBLASes(GetDevice());
 
         GetDeviceManager()->SetVsyncEnabled(false);
 
@@ -292,6 +373,7 @@ public:
         m_compositingPass->CreatePipeline();
         m_accumulationPass->CreatePipeline();
         m_gBufferPass->CreatePipeline(m_ui.useRayQuery);
+        m_visibilityResolvePass->CreatePipeline();
         m_postprocessGBufferPass->CreatePipeline();
         m_glassPass->CreatePipeline(m_ui.useRayQuery);
         m_prepareLightsPass->CreatePipeline();
@@ -299,7 +381,9 @@ public:
 
     virtual bool LoadScene(std::shared_ptr<vfs::IFileSystem> fs, const std::filesystem::path& sceneFileName) override 
     {
-        if (m_scene->Load(sceneFileName))
+        StartupReport::Scope phase(m_startupReport, "Scene loading");
+
+        if (m_scene->LoadWithExecutor(sceneFileName, m_executor.get()))
         {
             return true;
         }
@@ -455,6 +539,32 @@ public:
         }
     }
 
+    void UpdateDynamicResolution()
+    {
+        // The controller needs the GPU frame time, and changing the resolution would restart the accumulation
+        const bool enableDynamicResolution = m_ui.enableDynamicResolution && m_profiler->IsEnabled() &&
+            m_ui.aaMode != AntiAliasingMode::Accumulation;
+
+        if (enableDynamicResolution)
+        {
+            DynamicResolutionController::Parameters params = m_dynamicResolution.GetParameters();
+            params.targetFrameTime = m_ui.dynamicResolutionTarget;
+            m_dynamicResolution.SetParameters(params);
+
+            if (!m_dynamicResolutionActive)
+                m_dynamicResolution.Reset(m_ui.resolutionScale);
+
+            m_ui.resolutionScale = m_dynamicResolution.Update(m_profiler->GetTimer(ProfilerSection::Frame));
+        }
+        m_dynamicResolutionActive = enableDynamicResolution;
+
+        // Accumulated frames are only valid for the resolution they were rendered at.
+        // Other AA modes handle the viewport changes through the previous view.
+        if (m_ui.resolutionScale != m_previousResolutionScale && m_ui.aaMode == AntiAliasingMode::Accumulation)
+            m_ui.resetAccumulation = true;
+        m_previousResolutionScale = m_ui.resolutionScale;
+    }
+
     void SetupView(uint32_t renderWidth, uint32_t renderHeight, const engine::PerspectiveCamera* activeCamera)
     {
         nvrhi::Viewport windowViewport((float)renderWidth, (float)renderHeight);
@@ -505,6 +615,7 @@ public:
             GetDevice()->waitForIdle();
 
             m_shaderFactory->ClearCache();
+            m_lightingPasses->ClearPipelineCache();
             m_temporalAntiAliasingPass = nullptr;
             m_renderEnvironmentMapPass = nullptr;
             m_environmentMapPdfMipmapPass = nullptr;
@@ -515,6 +626,13 @@ public:
 
             LoadShaders();
         }
+        else if (m_ui.rayQueryChanged)
+        {
+            // The G-buffer and glass pipelines are small enough to recreate here. The lighting passes
+            // keep the previous permutations until the new ones are compiled, see LightingPasses::UpdatePipelines.
+            m_gBufferPass->CreatePipeline(m_ui.useRayQuery);
+            m_glassPass->CreatePipeline(m_ui.useRayQuery);
+        }
 
         bool renderTargetsCreated = false;
         bool rtxdiResourcesCreated = false;
@@ -528,8 +646,7 @@ public:
             ? m_environmentMap->texture.Get()
             : m_renderEnvironmentMapPass->GetTexture();
 
-        uint32_t numEmissiveMeshes, numEmissiveTriangles;
-        m_prepareLightsPass->CountLightsInScene(numEmissiveMeshes, numEmissiveTriangles);
+        const PrepareLightsPass::EmissiveLightCounts emissiveLightCounts = m_prepareLightsPass->CountLightsInScene(m_ui.enableInstancedMeshLights);
         uint32_t numPrimitiveLights = uint32_t(m_scene->GetSceneGraph()->GetLights().size());
         uint32_t numGeometryInstances = uint32_t(m_scene->GetSceneGraph()->GetGeometryInstancesCount());
         
@@ -538,8 +655,11 @@ public:
         if (m_rtxdiResources && (
             environmentMapSize.x != m_rtxdiResources->EnvironmentPdfTexture->getDesc().width ||
             environmentMapSize.y != m_rtxdiResources->EnvironmentPdfTexture->getDesc().height ||
-            numEmissiveMeshes > m_rtxdiResources->GetMaxEmissiveMeshes() ||
-            numEmissiveTriangles > m_rtxdiResources->GetMaxEmissiveTriangles() || 
+            emissiveLightCounts.meshes > m_rtxdiResources->GetMaxEmissiveMeshes() ||
+            emissiveLightCounts.triangles > m_rtxdiResources->GetMaxEmissiveTriangles() || 
+            emissiveLightCounts.instancedMeshes > m_rtxdiResources->GetMaxInstancedMeshes() ||
+            emissiveLightCounts.instancedMeshTriangles > m_rtxdiResources->GetMaxInstancedMeshTriangles() ||
+            emissiveLightCounts.instancedLights > m_rtxdiResources->GetMaxInstancedLights() ||
             numPrimitiveLights > m_rtxdiResources->GetMaxPrimitiveLights() ||
             numGeometryInstances > m_rtxdiResources->GetMaxGeometryInstances()))
         {
@@ -559,6 +679,16 @@ public:
             m_ui.regirLightSlotCount = m_isContext->GetReGIRContext().GetReGIRLightSlotCount();
         }
 
+        // The GI reservoir buffer is sized for the ReSTIR GI resolution, so it's recreated when that changes
+        const rtxdi::ReSTIRDIContext& restirDIContext = m_isContext->GetReSTIRDIContext();
+        const uint32_t giReservoirArrayPitch = LightingPasses::GetGIReservoirBufferParameters(restirDIContext,
+            LightingPasses::GetGIDownscaleFactor(m_ui.lightingSettings, restirDIContext)).reservoirArrayPitch;
+
+        if (m_rtxdiResources && giReservoirArrayPitch != m_rtxdiResources->GetGIReservoirArrayPitch())
+        {
+            m_rtxdiResources = nullptr;
+        }
+
         if (!m_renderTargets)
         {
             m_renderTargets = std::make_shared<RenderTargets>(GetDevice(), int2((int)renderWidth, (int)renderHeight));
@@ -567,6 +697,8 @@ public:
 
             m_gBufferPass->CreateBindingSet(m_scene->GetTopLevelAS(), m_scene->GetPrevTopLevelAS(), *m_renderTargets);
 
+            m_visibilityResolvePass->CreateBindingSet(*m_renderTargets);
+
             m_postprocessGBufferPass->CreateBindingSet(*m_renderTargets);
 
             m_glassPass->CreateBindingSet(m_scene->GetTopLevelAS(), m_scene->GetPrevTopLevelAS(), *m_renderTargets);
@@ -574,6 +706,7 @@ public:
             m_filterGradientsPass->CreateBindingSet(*m_renderTargets);
 
             m_confidencePass->CreateBindingSet(*m_renderTargets);
+            m_confidenceTilesValid = false;
             
             m_accumulationPass->CreateBindingSet(*m_renderTargets);
 
@@ -589,20 +722,14 @@ public:
 
         if (!m_rtxdiResources)
         {
-            uint32_t meshAllocationQuantum = 128;
-            uint32_t triangleAllocationQuantum = 1024;
-            uint32_t primitiveAllocationQuantum = 128;
-
             m_rtxdiResources = std::make_unique<RtxdiResources>(
                 GetDevice(), 
                 m_isContext->GetReSTIRDIContext(),
                 m_isContext->GetRISBufferSegmentAllocator(),
-                (numEmissiveMeshes + meshAllocationQuantum - 1) & ~(meshAllocationQuantum - 1),
-                (numEmissiveTriangles + triangleAllocationQuantum - 1) & ~(triangleAllocationQuantum - 1),
-                (numPrimitiveLights + primitiveAllocationQuantum - 1) & ~(primitiveAllocationQuantum - 1),
-                numGeometryInstances,
+                RtxdiResources::GetLightCapacities(emissiveLightCounts, numPrimitiveLights, numGeometryInstances),
                 environmentMapSize.x,
-                environmentMapSize.y);
+                environmentMapSize.y,
+                giReservoirArrayPitch);
 
             m_prepareLightsPass->CreateBindingSet(*m_rtxdiResources);
             
@@ -639,13 +766,17 @@ public:
                 *m_rtxdiResources);
         }
 
-        if (rtxdiResourcesCreated || m_ui.reloadShaders)
+        if (rtxdiResourcesCreated || m_ui.reloadShaders || m_ui.rayQueryChanged)
         {
             // Some RTXDI context settings affect the shader permutations
             m_lightingPasses->CreatePipelines(m_ui.regirStaticParams, m_ui.useRayQuery);
         }
 
+        m_lightingPasses->UpdatePipelines();
+        m_ui.pipelineSwitchPending = m_lightingPasses->IsSwitchingPipelines();
+
         m_ui.reloadShaders = false;
+        m_ui.rayQueryChanged = false;
 
         if (!m_temporalAntiAliasingPass)
         {
@@ -682,8 +813,10 @@ public:
         if (!m_debugVizPasses || renderTargetsCreated)
         {
             m_debugVizPasses = std::make_unique<DebugVizPasses>(GetDevice(), m_shaderFactory, m_scene, m_bindlessLayout);
-            m_debugVizPasses->CreateBindingSets(*m_renderTargets, m_renderTargets->DebugColor);
             m_debugVizPasses->CreatePipelines();
+
+            // The binding sets are created when DebugColor is placed by the frame graph
+            m_debugVizGeneration = ~0u;
         }
 
 #if WITH_NRD
@@ -815,6 +948,37 @@ public:
         return m_isContext->IsLocalLightPowerRISEnabled();
     }
 
+    // Writes the benchmark timings together with the light counts of the scene,
+    // so that the runs on generated scenes can be plotted against the number of lights.
+    bool WriteBenchmarkReport(const std::filesystem::path& fileName)
+    {
+        Json::Value root = m_profiler->GetAsJson();
+        root["scene"] = m_args.sceneFileName.empty() ? std::string("bistro-rtxdi.scene.json") : m_args.sceneFileName;
+
+        const PrepareLightsPass::EmissiveLightCounts counts = m_prepareLightsPass->CountLightsInScene(m_ui.enableInstancedMeshLights);
+        Json::Value& lights = root["lights"];
+        lights["emissiveMeshes"] = counts.meshes;
+        lights["emissiveTriangles"] = counts.triangles + counts.instancedLights;
+        lights["instancedMeshes"] = counts.instancedMeshes;
+        lights["instancedLights"] = counts.instancedLights;
+        lights["primitiveLights"] = uint32_t(m_scene->GetSceneGraph()->GetLights().size());
+
+        std::ofstream file(fileName);
+        if (!file.is_open())
+        {
+            log::error("Couldn't write the benchmark report to '%s'", fileName.generic_string().c_str());
+            return false;
+        }
+
+        Json::StreamWriterBuilder builder;
+        builder.settings_["precision"] = 4;
+        std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
+        writer->write(root, &file);
+        file << std::endl;
+
+        return true;
+    }
+
     void RenderScene(nvrhi::IFramebuffer* framebuffer) override
     {
         if (m_frameStepMode == FrameStepMode::Wait)
@@ -863,6 +1027,9 @@ public:
                 {
                     glfwSetWindowShouldClose(GetDeviceManager()->GetWindow(), GLFW_TRUE);
                     log::info("BENCHMARK RESULTS >>>\n\n%s<<<", m_ui.benchmarkResults.c_str());
+
+                    if (!m_args.benchmarkReportFileName.empty() && !WriteBenchmarkReport(m_args.benchmarkReportFileName))
+                        g_ExitCode = 1;
                 }
             }
         }
@@ -908,6 +1075,11 @@ public:
             LoadEnvironmentMap();
         }
 
+        // The G-buffer draw records list the mesh instances and their bounds, rebuild them when those change.
+        // Animated frames are the same ones that rebuild the TLAS.
+        if (m_scene->GetSceneGraph()->HasPendingStructureChanges() || m_framesSinceAnimation < 2)
+            m_rasterizedGBufferPass->InvalidateDrawRecords();
+
         m_scene->RefreshSceneGraph(GetFrameIndex());
 
         const auto& fbinfo = framebuffer->getFramebufferInfo();
@@ -918,6 +1090,7 @@ public:
             renderWidth = m_args.renderWidth;
             renderHeight = m_args.renderHeight;
         }
+        UpdateDynamicResolution();
         SetupView(renderWidth, renderHeight, activeCamera);
         SetupRenderPasses(renderWidth, renderHeight, exposureResetRequired);
         if (!m_ui.freezeRegirPosition)
@@ -931,6 +1104,7 @@ public:
 #endif
 
         m_gBufferPass->NextFrame();
+        m_visibilityResolvePass->NextFrame();
         m_postprocessGBufferPass->NextFrame();
         m_lightingPasses->NextFrame();
         m_confidencePass->NextFrame();
@@ -1018,84 +1192,11 @@ public:
         uint32_t denoiserMode = DENOISER_MODE_OFF;
 #endif
 
-        m_commandList->open();
-
-        m_profiler->BeginFrame(m_commandList);
-
-        AssignIesProfiles(m_commandList);
-        m_scene->RefreshBuffers(m_commandList, GetFrameIndex());
-        m_rtxdiResources->InitializeNeighborOffsets(m_commandList, m_isContext->GetNeighborOffsetCount());
-
-        if (m_framesSinceAnimation < 2)
-        {
-            ProfilerScope scope(*m_profiler, m_commandList, ProfilerSection::TlasUpdate);
-
-            m_scene->UpdateSkinnedMeshBLASes(m_commandList, GetFrameIndex());
-            m_scene->BuildTopLevelAccelStruct(m_commandList);
-        }
-        m_commandList->compactBottomLevelAccelStructs();
-
-        if (m_ui.environmentMapDirty)
-        {
-            ProfilerScope scope(*m_profiler, m_commandList, ProfilerSection::EnvironmentMap);
-
-            if (m_ui.environmentMapIndex == 0)
-            {
-                donut::render::SkyParameters params;
-                m_renderEnvironmentMapPass->Render(m_commandList, *m_sunLight, params);
-            }
-            
-            m_environmentMapPdfMipmapPass->Process(m_commandList);
-
-            m_ui.environmentMapDirty = 0;
-        }
-
-        nvrhi::utils::ClearColorAttachment(m_commandList, framebuffer, 0, nvrhi::Color(0.f));
-
-        {
-            ProfilerScope scope(*m_profiler, m_commandList, ProfilerSection::GBufferFill);
-
-            GBufferSettings gbufferSettings = m_ui.gbufferSettings;
-            float upscalingLodBias = ::log2f(m_view.GetViewport().width() / m_upscaledView.GetViewport().width());
-            gbufferSettings.textureLodBias += upscalingLodBias;
-
-            if (m_ui.rasterizeGBuffer)
-                m_rasterizedGBufferPass->Render(m_commandList, m_view, m_viewPrevious, *m_renderTargets, m_ui.gbufferSettings);
-            else
-                m_gBufferPass->Render(m_commandList, m_view, m_viewPrevious, m_ui.gbufferSettings);
-
-            m_postprocessGBufferPass->Render(m_commandList, m_view);
-        }
-
         // The light indexing members of frameParameters are written by PrepareLightsPass below
         rtxdi::ReSTIRDIContext& restirDIContext = m_isContext->GetReSTIRDIContext();
         restirDIContext.SetFrameIndex(effectiveFrameIndex);
         m_isContext->GetReSTIRGIContext().SetFrameIndex(effectiveFrameIndex);
 
-        {
-            ProfilerScope scope(*m_profiler, m_commandList, ProfilerSection::MeshProcessing);
-            
-            RTXDI_LightBufferParameters lightBufferParams = m_prepareLightsPass->Process(
-                m_commandList,
-                restirDIContext,
-                m_scene->GetSceneGraph()->GetLights(),
-                m_environmentMapPdfMipmapPass != nullptr && m_ui.environmentMapImportanceSampling);
-            m_isContext->SetLightBufferParams(lightBufferParams);
-
-            auto initialSamplingParams = restirDIContext.GetInitialSamplingParameters();
-            initialSamplingParams.environmentMapImportanceSampling = lightBufferParams.environmentLightParams.lightPresent;
-            m_ui.restirDI.initialSamplingParams.environmentMapImportanceSampling = initialSamplingParams.environmentMapImportanceSampling;
-            restirDIContext.SetInitialSamplingParameters(initialSamplingParams);
-        }
-
-        if (IsLocalLightPowerRISEnabled())
-        {
-            ProfilerScope scope(*m_profiler, m_commandList, ProfilerSection::LocalLightPdfMap);
-            
-            m_localLightPdfMipmapPass->Process(m_commandList);
-        }
-
-
 #if WITH_NRD
         if (restirDIContext.GetStaticParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off)
         {
@@ -1108,7 +1209,7 @@ public:
             m_ui.relaxSettings.checkerboardMode = nrd::CheckerboardMode::OFF;
         }
 #endif
-        
+
         LightingPasses::RenderSettings lightingSettings = m_ui.lightingSettings;
         lightingSettings.enablePreviousTLAS &= m_ui.enableAnimations;
         lightingSettings.enableAlphaTestedGeometry = m_ui.gbufferSettings.enableAlphaTestedGeometry;
@@ -1144,270 +1245,572 @@ public:
             lightingSettings.enableGradients = false;
         }
 
+        // The sample budgets come from the confidence tiles written in the previous frame,
+        // so they can only be used if that frame has computed the confidence.
+        lightingSettings.enableAdaptiveSampleBudget &= m_confidenceTilesValid;
+        m_confidenceTilesValid = lightingSettings.enableGradients;
+
+        // The frame is recorded in segments that go into separate command lists. The G-buffer and light preparation
+        // segments only depend on the frame setup, so they are recorded concurrently on the worker threads.
+        // Neither of them writes state that the other one reads: the light preparation writes the RTXDI context
+        // and the ReSTIR DI sampling parameters in m_ui, and the G-buffer segment only reads the views, the
+        // G-buffer settings in m_ui and the render targets. The presampling pipelines are created here, before
+        // the recording starts, because the shader factory is not thread safe, and the profiler locks its
+        // timer state because both segments open sections on it.
+        // Lighting needs the light buffer parameters computed by PrepareLightsPass on the CPU. It also waits for
+        // the G-buffer recording, because it lazily creates framebuffers, textures and blit pipelines in objects
+        // that are not thread safe (m_renderTargets, m_CommonPasses, m_bindingCache) and that the G-buffer passes
+        // may use as well.
+        // The command lists are submitted in the order of the segments.
+        //
+        // The light preparation chain (PrepareLights, light PDF mips and presampling) doesn't depend on the G-buffer,
+        // so it can run on the async compute queue and overlap with the G-buffer fill. It's added before the G-buffer
+        // segment so that it's submitted first, and lighting waits for it on the graphics queue.
+        m_commandRecorder->SetParallelRecordingEnabled(m_ui.parallelCommandRecording);
+
         if (enableDirectReStirPass || enableIndirect)
-        {
-            m_lightingPasses->PrepareForLightSampling(m_commandList,
-                *m_isContext,
-                m_view, m_viewPrevious,
-                lightingSettings,
-                /* enableAccumulation = */ m_ui.aaMode == AntiAliasingMode::Accumulation);
-        }
+            m_lightingPasses->ResolveLightSamplingPasses();
+
+        // Not on D3D12: the light buffers and PDF textures keep the ShaderResource state, which includes
+        // PIXEL_SHADER_RESOURCE and is not allowed on compute command lists, and the PDF texture is cleared.
+        const bool asyncLightPreparation = m_ui.asyncLightPreparation
+            && GetDevice()->queryFeatureSupport(nvrhi::Feature::ComputeQueue)
+            && GetDevice()->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D12;
+
+        const nvrhi::CommandQueue lightPreparationQueue = asyncLightPreparation
+            ? nvrhi::CommandQueue::Compute
+            : nvrhi::CommandQueue::Graphics;
 
-        if (enableDirectReStirPass)
+        const uint32_t setupSegment = m_commandRecorder->AddSegment("Setup", [&](nvrhi::ICommandList* commandList)
         {
-            m_commandList->clearTextureFloat(m_renderTargets->Gradients, nvrhi::AllSubresources, nvrhi::Color(0.f));
+            m_profiler->BeginFrame(commandList);
 
-            m_lightingPasses->RenderDirectLighting(m_commandList,
-                restirDIContext,
-                m_view,
-                lightingSettings);
+            AssignIesProfiles();
+            m_scene->RefreshBuffers(commandList, GetFrameIndex());
+            m_rtxdiResources->InitializeNeighborOffsets(commandList, m_isContext->GetNeighborOffsetCount());
 
-            // Post-process the gradients into a confidence buffer usable by NRD
-            if (lightingSettings.enableGradients)
+            if (m_framesSinceAnimation < 2)
             {
-                m_filterGradientsPass->Render(m_commandList, m_view, checkerboard);
-                m_confidencePass->Render(m_commandList, m_view, lightingSettings.gradientLogDarknessBias, lightingSettings.gradientSensitivity, lightingSettings.confidenceHistoryLength, checkerboard);
+                ProfilerScope scope(*m_profiler, commandList, ProfilerSection::TlasUpdate);
+
+                m_scene->UpdateSkinnedMeshBLASes(commandList, GetFrameIndex());
+                m_scene->BuildTopLevelAccelStruct(commandList);
             }
-        }
+            commandList->compactBottomLevelAccelStructs();
 
-        if (enableBrdfAndIndirectPass)
-        {
-            restirDIShadingParams = m_isContext->GetReSTIRDIContext().GetShadingParameters();
-            restirDIShadingParams.enableDenoiserInputPacking = true;
-            m_isContext->GetReSTIRDIContext().SetShadingParameters(restirDIShadingParams);
+            if (m_ui.environmentMapDirty)
+            {
+                ProfilerScope scope(*m_profiler, commandList, ProfilerSection::EnvironmentMap);
 
-            bool enableReSTIRGI = m_ui.indirectLightingMode == IndirectLightingMode::ReStirGI;
+                if (m_ui.environmentMapIndex == 0)
+                {
+                    donut::render::SkyParameters params;
+                    m_renderEnvironmentMapPass->Render(commandList, *m_sunLight, params);
+                }
 
-            m_lightingPasses->RenderBrdfRays(
-                m_commandList,
-                *m_isContext,
-                m_view, m_viewPrevious,
-                lightingSettings,
-                m_ui.gbufferSettings,
-                *m_environmentLight,
-                /* enableIndirect = */ enableIndirect,
-                /* enableAdditiveBlend = */ enableDirectReStirPass,
-                /* enableEmissiveSurfaces = */ m_ui.directLightingMode == DirectLightingMode::Brdf,
-                /* enableAccumulation = */ m_ui.aaMode == AntiAliasingMode::Accumulation,
-                enableReSTIRGI
-                );
-        }
+                m_environmentMapPdfMipmapPass->Process(commandList);
 
-        // If none of the passes above were executed, clear the textures to avoid stale data there.
-        // It's a weird mode but it can be selected from the UI.
-        if (!enableDirectReStirPass && !enableBrdfAndIndirectPass)
-        {
-            m_commandList->clearTextureFloat(m_renderTargets->DiffuseLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
-            m_commandList->clearTextureFloat(m_renderTargets->SpecularLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
-        }
-        
-#if WITH_NRD
-        if (m_ui.enableDenoiser)
+                m_ui.environmentMapDirty = 0;
+            }
+
+            nvrhi::utils::ClearColorAttachment(commandList, framebuffer, 0, nvrhi::Color(0.f));
+
+            // Measures the graphics queue time between the end of the setup and the start of lighting,
+            // which is the G-buffer fill plus any time spent waiting for the light preparation chain
+            m_profiler->BeginSection(commandList, ProfilerSection::GBufferAndLightPreparation);
+        });
+
+        const uint32_t lightPreparationSegment = m_commandRecorder->AddSegment("Light Preparation", [&](nvrhi::ICommandList* commandList)
         {
-            ProfilerScope scope(*m_profiler, m_commandList, ProfilerSection::Denoising);
-            m_commandList->beginMarker("Denoising");
+            ProfilerScope totalScope(*m_profiler, commandList, ProfilerSection::LightPreparation);
 
-            const void* methodSettings = (m_ui.denoisingMethod == nrd::Denoiser::RELAX_DIFFUSE_SPECULAR)
-                ? (void*)&m_ui.relaxSettings
-                : (void*)&m_ui.reblurSettings;
+            {
+                ProfilerScope scope(*m_profiler, commandList, ProfilerSection::MeshProcessing);
+
+                RTXDI_LightBufferParameters lightBufferParams = m_prepareLightsPass->Process(
+                    commandList,
+                    restirDIContext,
+                    m_scene->GetSceneGraph()->GetLights(),
+                    m_environmentMapPdfMipmapPass != nullptr && m_ui.environmentMapImportanceSampling,
+                    m_ui.enableInstancedMeshLights);
+                m_isContext->SetLightBufferParams(lightBufferParams);
+                m_lightingPasses->SetInstancedLightCounts(m_prepareLightsPass->GetInstancedLightCounts());
+
+                auto initialSamplingParams = restirDIContext.GetInitialSamplingParameters();
+                initialSamplingParams.environmentMapImportanceSampling = lightBufferParams.environmentLightParams.lightPresent;
+                m_ui.restirDI.initialSamplingParams.environmentMapImportanceSampling = initialSamplingParams.environmentMapImportanceSampling;
+                restirDIContext.SetInitialSamplingParameters(initialSamplingParams);
+            }
 
-            m_nrd->RunDenoiserPasses(m_commandList, *m_renderTargets, m_view, m_viewPrevious, GetFrameIndex(), lightingSettings.enableGradients, methodSettings, m_ui.debug);
-            
-            m_commandList->endMarker();
-        }
-#endif
+            if (IsLocalLightPowerRISEnabled())
+            {
+                ProfilerScope scope(*m_profiler, commandList, ProfilerSection::LocalLightPdfMap);
 
-        m_compositingPass->Render(
-            m_commandList,
-            m_view,
-            m_viewPrevious,
-            denoiserMode,
-            checkerboard,
-            m_ui,
-            *m_environmentLight);
+                m_localLightPdfMipmapPass->Process(commandList);
+            }
+
+            if (enableDirectReStirPass || enableIndirect)
+            {
+                m_lightingPasses->PrepareForLightSampling(commandList,
+                    *m_isContext,
+                    m_view, m_viewPrevious,
+                    lightingSettings,
+                    /* enableAccumulation = */ m_ui.aaMode == AntiAliasingMode::Accumulation);
+            }
+        }, { setupSegment }, lightPreparationQueue);
 
-        if (m_ui.gbufferSettings.enableTransparentGeometry)
+        const uint32_t gbufferSegment = m_commandRecorder->AddSegment("G-Buffer", [&](nvrhi::ICommandList* commandList)
         {
-            ProfilerScope scope(*m_profiler, m_commandList, ProfilerSection::Glass);
+            {
+                ProfilerScope scope(*m_profiler, commandList, ProfilerSection::GBufferFill);
 
-            m_glassPass->Render(m_commandList, m_view,
-                *m_environmentLight,
-                m_ui.gbufferSettings.normalMapScale,
-                m_ui.gbufferSettings.enableMaterialReadback,
-                m_ui.gbufferSettings.materialReadbackPosition);
-        }
+                GBufferSettings gbufferSettings = m_ui.gbufferSettings;
+                float upscalingLodBias = ::log2f(m_view.GetViewport().width() / m_upscaledView.GetViewport().width());
+                gbufferSettings.textureLodBias += upscalingLodBias;
 
-        Resolve(m_commandList, accumulationWeight);
+                // Host time of the G-buffer draw submission, to compare the CPU draw loop with the GPU culling path
+                const auto recordingStartTime = std::chrono::steady_clock::now();
 
-        if (m_ui.enableBloom)
-        {
-#if WITH_DLSS
-            // Use the unresolved image for bloom when DLSS is active because DLSS can modify HDR values significantly and add bloom flicker.
-            nvrhi::ITexture* bloomSource = (m_ui.aaMode == AntiAliasingMode::DLSS && m_ui.resolutionScale == 1.f)
-                ? m_renderTargets->HdrColor
-                : m_renderTargets->ResolvedColor;
-#else
-            nvrhi::ITexture* bloomSource = m_RenderTargets->ResolvedColor;
-#endif
+                const bool useVisibilityBuffer = m_ui.useVisibilityBuffer && m_rasterizedGBufferPass->IsVisibilityBufferSupported();
 
-            m_bloomPass->Render(m_commandList, m_renderTargets->ResolvedFramebuffer, m_upscaledView, bloomSource, 32.f, 0.005f);
-        }
+                if (m_ui.rasterizeGBuffer)
+                    m_rasterizedGBufferPass->Render(commandList, m_view, m_viewPrevious, *m_renderTargets, m_ui.gbufferSettings, useVisibilityBuffer);
+                else
+                    m_gBufferPass->Render(commandList, m_view, m_viewPrevious, m_ui.gbufferSettings);
+
+                const auto recordingEndTime = std::chrono::steady_clock::now();
+                m_profiler->SetGBufferRecordingTime(std::chrono::duration<double, std::milli>(recordingEndTime - recordingStartTime).count());
+
+                // The material evaluation is part of the G-buffer fill time, so that both modes can be compared on that line
+                if (m_ui.rasterizeGBuffer && useVisibilityBuffer)
+                    m_visibilityResolvePass->Render(commandList, m_view, m_viewPrevious, m_ui.gbufferSettings);
 
-        // Reference image functionality:
+                m_postprocessGBufferPass->Render(commandList, m_view, m_ui.lightingSettings.enableCompactGBufferSurfaces);
+            }
+        }, { setupSegment });
+
+        m_commandRecorder->AddSegment("Lighting and Post-Processing", [&](nvrhi::ICommandList* commandList)
         {
-            // When the camera is moved, discard the previously stored image, if any, and disable its display.
-            if (!cameraIsStatic)
+            m_profiler->EndSection(commandList, ProfilerSection::GBufferAndLightPreparation);
+
+            // The resampling constants are volatile and were written on the light preparation command list
+            if (enableDirectReStirPass || enableIndirect)
             {
-                m_ui.referenceImageCaptured = false;
-                m_ui.referenceImageSplit = 0.f;
+                m_lightingPasses->UpdateSamplingConstants(commandList,
+                    *m_isContext,
+                    m_view, m_viewPrevious,
+                    lightingSettings,
+                    /* enableAccumulation = */ m_ui.aaMode == AntiAliasingMode::Accumulation);
             }
 
-            // When the user clicks the "Store" button, copy the ResolvedColor texture into ReferenceColor.
-            if (m_ui.storeReferenceImage)
+            if (enableDirectReStirPass)
             {
-                m_commandList->copyTexture(m_renderTargets->ReferenceColor, nvrhi::TextureSlice(), m_renderTargets->ResolvedColor, nvrhi::TextureSlice());
-                m_ui.storeReferenceImage = false;
-                m_ui.referenceImageCaptured = true;
+                commandList->clearTextureFloat(m_renderTargets->Gradients, nvrhi::AllSubresources, nvrhi::Color(0.f));
+
+                m_lightingPasses->RenderDirectLighting(commandList,
+                    restirDIContext,
+                    m_view,
+                    lightingSettings);
+
+                // Post-process the gradients into a confidence buffer usable by NRD
+                if (lightingSettings.enableGradients)
+                {
+                    m_filterGradientsPass->Render(commandList, m_view, checkerboard);
+                    m_confidencePass->Render(commandList, m_view, m_viewPrevious, lightingSettings.gradientLogDarknessBias, lightingSettings.gradientSensitivity, lightingSettings.confidenceHistoryLength, checkerboard);
+                }
             }
 
-            // When the "Split Display" parameter is nonzero, show a portion of the previously stored
-            // ReferenceColor texture on the left side of the screen by copying it into the ResolvedColor texture.
-            if (m_ui.referenceImageSplit > 0.f)
+            if (enableBrdfAndIndirectPass)
             {
-                engine::BlitParameters blitParams;
-                blitParams.sourceTexture = m_renderTargets->ReferenceColor;
-                blitParams.sourceBox.m_maxs = float2(m_ui.referenceImageSplit, 1.f);
-                blitParams.targetFramebuffer = m_renderTargets->ResolvedFramebuffer->GetFramebuffer(nvrhi::AllSubresources);
-                blitParams.targetBox = blitParams.sourceBox;
-                blitParams.sampler = engine::BlitSampler::Point;
-                m_CommonPasses->BlitTexture(m_commandList, blitParams, &m_bindingCache);
+                restirDIShadingParams = m_isContext->GetReSTIRDIContext().GetShadingParameters();
+                restirDIShadingParams.enableDenoiserInputPacking = true;
+                m_isContext->GetReSTIRDIContext().SetShadingParameters(restirDIShadingParams);
+
+                bool enableReSTIRGI = m_ui.indirectLightingMode == IndirectLightingMode::ReStirGI;
+
+                m_lightingPasses->RenderBrdfRays(
+                    commandList,
+                    *m_isContext,
+                    m_view, m_viewPrevious,
+                    lightingSettings,
+                    m_ui.gbufferSettings,
+                    *m_environmentLight,
+                    /* enableIndirect = */ enableIndirect,
+                    /* enableAdditiveBlend = */ enableDirectReStirPass,
+                    /* enableEmissiveSurfaces = */ m_ui.directLightingMode == DirectLightingMode::Brdf,
+                    /* enableAccumulation = */ m_ui.aaMode == AntiAliasingMode::Accumulation,
+                    enableReSTIRGI
+                    );
             }
-        }
 
-        if(m_ui.enableToneMapping)
-        { // Tone mapping
-            render::ToneMappingParameters ToneMappingParams;
-            ToneMappingParams.minAdaptedLuminance = 0.002f;
-            ToneMappingParams.maxAdaptedLuminance = 0.2f;
-            ToneMappingParams.exposureBias = m_ui.exposureBias;
-            ToneMappingParams.eyeAdaptationSpeedUp = 2.0f;
-            ToneMappingParams.eyeAdaptationSpeedDown = 1.0f;
+            // If none of the passes above were executed, clear the textures to avoid stale data there.
+            // It's a weird mode but it can be selected from the UI.
+            if (!enableDirectReStirPass && !enableBrdfAndIndirectPass)
+            {
+                commandList->clearTextureFloat(m_renderTargets->DiffuseLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
+                commandList->clearTextureFloat(m_renderTargets->SpecularLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
+            }
 
-            if (exposureResetRequired)
+#if WITH_NRD
+            if (m_ui.enableDenoiser)
             {
-                ToneMappingParams.eyeAdaptationSpeedUp = 0.f;
-                ToneMappingParams.eyeAdaptationSpeedDown = 0.f;
+                ProfilerScope scope(*m_profiler, commandList, ProfilerSection::Denoising);
+                commandList->beginMarker("Denoising");
+
+                const void* methodSettings = (m_ui.denoisingMethod == nrd::Denoiser::RELAX_DIFFUSE_SPECULAR)
+                    ? (void*)&m_ui.relaxSettings
+                    : (void*)&m_ui.reblurSettings;
+
+                m_nrd->RunDenoiserPasses(commandList, *m_renderTargets, m_view, m_viewPrevious, GetFrameIndex(), lightingSettings.enableGradients, methodSettings, m_ui.debug);
+
+                commandList->endMarker();
             }
+#endif
 
-            m_toneMappingPass->SimpleRender(m_commandList, ToneMappingParams, m_upscaledView, m_renderTargets->ResolvedColor);
-        }
-        else
-        {
-            m_CommonPasses->BlitTexture(m_commandList, m_renderTargets->LdrFramebuffer->GetFramebuffer(m_upscaledView), m_renderTargets->ResolvedColor, &m_bindingCache);
-        }
+            // The rest of the frame is expressed as a frame graph. The passes declare what they read and write,
+            // and the graph culls the passes whose results are not displayed, e.g. tone mapping and visualization
+            // when a debug buffer is shown, and places the transient textures like DebugColor into a shared heap.
+            // The Prev* G-buffer and confidence textures carry history into the next frame through
+            // RenderTargets::NextFrame, so they stay persistent and are not part of the graph.
+            FrameGraph frameGraph;
 
-        if (m_ui.visualizationMode != VIS_MODE_NONE)
-        {
-            bool haveSignal = true;
-            uint32_t inputBufferIndex = 0;
-            switch(m_ui.visualizationMode)
+            FrameGraphTexture hdrColor = frameGraph.ImportTexture(m_renderTargets->HdrColor);
+            FrameGraphTexture resolvedColor = frameGraph.ImportTexture(m_renderTargets->ResolvedColor);
+            FrameGraphTexture ldrColor = frameGraph.ImportTexture(m_renderTargets->LdrColor);
+            FrameGraphTexture backBuffer = frameGraph.ImportTexture(framebuffer->getDesc().colorAttachments[0].texture);
+            FrameGraphTexture debugColor = frameGraph.CreateTexture(m_renderTargets->GetDebugColorDesc());
+
+            frameGraph.MarkOutput(backBuffer);
+
+            // Saving the frame and the frame step mode read LdrColor after the graph is executed
+            if (!m_args.saveFrameFileName.empty() || m_frameStepMode != FrameStepMode::Disabled)
+                frameGraph.MarkOutput(ldrColor);
+
+            frameGraph.AddPass("Compositing",
+                [&](FrameGraphBuilder& builder)
+                {
+                    builder.Write(hdrColor);
+                },
+                [&](nvrhi::ICommandList* commandList, const FrameGraphResources&)
+                {
+                    m_compositingPass->Render(
+                        commandList,
+                        m_view,
+                        m_viewPrevious,
+                        denoiserMode,
+                        checkerboard,
+                        m_ui,
+                        *m_environmentLight);
+                });
+
+            if (m_ui.gbufferSettings.enableTransparentGeometry)
             {
-            case VIS_MODE_DENOISED_DIFFUSE:
-            case VIS_MODE_DENOISED_SPECULAR:
-                haveSignal = m_ui.enableDenoiser;
-                break;
+                frameGraph.AddPass("Glass",
+                    [&](FrameGraphBuilder& builder)
+                    {
+                        builder.ReadWrite(hdrColor);
+
+                        // Material readback results are consumed by the UI
+                        if (m_ui.gbufferSettings.enableMaterialReadback)
+                            builder.SetSideEffects();
+                    },
+                    [&](nvrhi::ICommandList* commandList, const FrameGraphResources&)
+                    {
+                        ProfilerScope scope(*m_profiler, commandList, ProfilerSection::Glass);
+
+                        m_glassPass->Render(commandList, m_view,
+                            *m_environmentLight,
+                            m_ui.gbufferSettings.normalMapScale,
+                            m_ui.gbufferSettings.enableMaterialReadback,
+                            m_ui.gbufferSettings.materialReadbackPosition);
+                    });
+            }
 
-            case VIS_MODE_DIFFUSE_CONFIDENCE:
-            case VIS_MODE_SPECULAR_CONFIDENCE:
-                haveSignal = m_ui.lightingSettings.enableGradients && m_ui.enableDenoiser;
-                break;
+            frameGraph.AddPass("Resolve",
+                [&](FrameGraphBuilder& builder)
+                {
+                    builder.Read(hdrColor);
+                    builder.Write(resolvedColor, nvrhi::ResourceStates::RenderTarget);
 
-            case VIS_MODE_RESERVOIR_WEIGHT:
-            case VIS_MODE_RESERVOIR_M:
-                inputBufferIndex = m_lightingPasses->GetOutputReservoirBufferIndex();
-                haveSignal = m_ui.directLightingMode == DirectLightingMode::ReStir;
-                break;
-                
-            case VIS_MODE_GI_WEIGHT:
-            case VIS_MODE_GI_M:
-                inputBufferIndex = m_lightingPasses->GetGIOutputReservoirBufferIndex();
-                haveSignal = m_ui.indirectLightingMode == IndirectLightingMode::ReStirGI;
-                break;
+                    // TAA and accumulation keep their history across frames
+                    builder.SetSideEffects();
+                },
+                [&](nvrhi::ICommandList* commandList, const FrameGraphResources&)
+                {
+                    Resolve(commandList, accumulationWeight);
+                });
+
+            if (m_ui.enableBloom)
+            {
+                frameGraph.AddPass("Bloom",
+                    [&](FrameGraphBuilder& builder)
+                    {
+                        builder.Read(hdrColor);
+                        builder.ReadWrite(resolvedColor, nvrhi::ResourceStates::RenderTarget);
+                    },
+                    [&](nvrhi::ICommandList* commandList, const FrameGraphResources& resources)
+                    {
+#if WITH_DLSS
+                        // Use the unresolved image for bloom when DLSS is active because DLSS can modify HDR values significantly and add bloom flicker.
+                        nvrhi::ITexture* bloomSource = (m_ui.aaMode == AntiAliasingMode::DLSS && m_ui.resolutionScale == 1.f)
+                            ? resources.GetTexture(hdrColor)
+                            : resources.GetTexture(resolvedColor);
+#else
+                        nvrhi::ITexture* bloomSource = resources.GetTexture(resolvedColor);
+#endif
+
+                        m_bloomPass->Render(commandList, m_renderTargets->ResolvedFramebuffer, m_upscaledView, bloomSource, 32.f, 0.005f);
+                    });
             }
 
-            if (haveSignal)
+            // Reference image functionality:
             {
-                m_visualizationPass->Render(
-                    m_commandList,
-                    m_renderTargets->LdrFramebuffer->GetFramebuffer(m_upscaledView),
-                    m_view,
-                    m_upscaledView,
-                    *m_isContext,
-                    inputBufferIndex,
-                    m_ui.visualizationMode,
-                    m_ui.aaMode == AntiAliasingMode::Accumulation);
+                // When the camera is moved, discard the previously stored image, if any, and disable its display.
+                if (!cameraIsStatic)
+                {
+                    m_ui.referenceImageCaptured = false;
+                    m_ui.referenceImageSplit = 0.f;
+                }
+
+                // When the user clicks the "Store" button, copy the ResolvedColor texture into ReferenceColor.
+                if (m_ui.storeReferenceImage)
+                {
+                    frameGraph.AddPass("StoreReference",
+                        [&](FrameGraphBuilder& builder)
+                        {
+                            builder.Read(resolvedColor, nvrhi::ResourceStates::CopySource);
+                            builder.SetSideEffects();
+                        },
+                        [&](nvrhi::ICommandList* commandList, const FrameGraphResources& resources)
+                        {
+                            m_renderTargets->CreateReferenceColor(GetDevice());
+                            commandList->copyTexture(m_renderTargets->ReferenceColor, nvrhi::TextureSlice(), resources.GetTexture(resolvedColor), nvrhi::TextureSlice());
+                        });
+
+                    m_ui.storeReferenceImage = false;
+                    m_ui.referenceImageCaptured = true;
+                }
+
+                // When the "Split Display" parameter is nonzero, show a portion of the previously stored
+                // ReferenceColor texture on the left side of the screen by copying it into the ResolvedColor texture.
+                if (m_ui.referenceImageSplit > 0.f && m_ui.referenceImageCaptured)
+                {
+                    frameGraph.AddPass("ReferenceSplit",
+                        [&](FrameGraphBuilder& builder)
+                        {
+                            builder.ReadWrite(resolvedColor, nvrhi::ResourceStates::RenderTarget);
+                        },
+                        [&](nvrhi::ICommandList* commandList, const FrameGraphResources&)
+                        {
+                            if (!m_renderTargets->ReferenceColor)
+                                return;
+
+                            engine::BlitParameters blitParams;
+                            blitParams.sourceTexture = m_renderTargets->ReferenceColor;
+                            blitParams.sourceBox.m_maxs = float2(m_ui.referenceImageSplit, 1.f);
+                            blitParams.targetFramebuffer = m_renderTargets->ResolvedFramebuffer->GetFramebuffer(nvrhi::AllSubresources);
+                            blitParams.targetBox = blitParams.sourceBox;
+                            blitParams.sampler = engine::BlitSampler::Point;
+                            m_CommonPasses->BlitTexture(commandList, blitParams, &m_bindingCache);
+                        });
+                }
             }
-        }
 
-        switch (m_ui.debugRenderOutputBuffer)
+            frameGraph.AddPass("ToneMapping",
+                [&](FrameGraphBuilder& builder)
+                {
+                    builder.Read(resolvedColor);
+                    builder.Write(ldrColor, nvrhi::ResourceStates::RenderTarget);
+                },
+                [&](nvrhi::ICommandList* commandList, const FrameGraphResources& resources)
+                {
+                    if (m_ui.enableToneMapping)
+                    {
+                        render::ToneMappingParameters ToneMappingParams;
+                        ToneMappingParams.minAdaptedLuminance = 0.002f;
+                        ToneMappingParams.maxAdaptedLuminance = 0.2f;
+                        ToneMappingParams.exposureBias = m_ui.exposureBias;
+                        ToneMappingParams.eyeAdaptationSpeedUp = 2.0f;
+                        ToneMappingParams.eyeAdaptationSpeedDown = 1.0f;
+
+                        if (exposureResetRequired)
+                        {
+                            ToneMappingParams.eyeAdaptationSpeedUp = 0.f;
+                            ToneMappingParams.eyeAdaptationSpeedDown = 0.f;
+                        }
+
+                        m_toneMappingPass->SimpleRender(commandList, ToneMappingParams, m_upscaledView, resources.GetTexture(resolvedColor));
+                    }
+                    else
+                    {
+                        m_CommonPasses->BlitTexture(commandList, m_renderTargets->LdrFramebuffer->GetFramebuffer(m_upscaledView), resources.GetTexture(resolvedColor), &m_bindingCache);
+                    }
+                });
+
+            if (m_ui.visualizationMode != VIS_MODE_NONE)
+            {
+                bool haveSignal = true;
+                uint32_t inputBufferIndex = 0;
+                switch(m_ui.visualizationMode)
+                {
+                case VIS_MODE_DENOISED_DIFFUSE:
+                case VIS_MODE_DENOISED_SPECULAR:
+                    haveSignal = m_ui.enableDenoiser;
+                    break;
+
+                case VIS_MODE_DIFFUSE_CONFIDENCE:
+                case VIS_MODE_SPECULAR_CONFIDENCE:
+                    haveSignal = m_ui.lightingSettings.enableGradients && m_ui.enableDenoiser;
+                    break;
+
+                case VIS_MODE_RESERVOIR_WEIGHT:
+                case VIS_MODE_RESERVOIR_M:
+                    inputBufferIndex = m_lightingPasses->GetOutputReservoirBufferIndex();
+                    haveSignal = m_ui.directLightingMode == DirectLightingMode::ReStir;
+                    break;
+
+                case VIS_MODE_GI_WEIGHT:
+                case VIS_MODE_GI_M:
+                    inputBufferIndex = m_lightingPasses->GetGIOutputReservoirBufferIndex();
+                    haveSignal = m_ui.indirectLightingMode == IndirectLightingMode::ReStirGI;
+                    break;
+                }
+
+                if (haveSignal)
+                {
+                    frameGraph.AddPass("Visualization",
+                        [&](FrameGraphBuilder& builder)
+                        {
+                            builder.ReadWrite(ldrColor, nvrhi::ResourceStates::RenderTarget);
+                        },
+                        [&, inputBufferIndex](nvrhi::ICommandList* commandList, const FrameGraphResources&)
+                        {
+                            m_visualizationPass->Render(
+                                commandList,
+                                m_renderTargets->LdrFramebuffer->GetFramebuffer(m_upscaledView),
+                                m_view,
+                                m_upscaledView,
+                                *m_isContext,
+                                inputBufferIndex,
+                                m_ui.visualizationMode,
+                                m_ui.aaMode == AntiAliasingMode::Accumulation);
+                        });
+                }
+            }
+
+            // Select the texture that is displayed, unpacking the G-buffer channels into DebugColor if necessary
+            FrameGraphTexture displayedTexture;
+            switch (m_ui.debugRenderOutputBuffer)
+            {
+                case DebugRenderOutput::LDRColor:
+                    displayedTexture = ldrColor;
+                    break;
+                case GBufferDiffuseAlbedo:
+                case GBufferSpecularRough:
+                case GBufferNormals:
+                case GBufferGeoNormals:
+                    displayedTexture = debugColor;
+                    break;
+                case DebugRenderOutput::Depth:
+                    displayedTexture = frameGraph.ImportTexture(m_renderTargets->Depth);
+                    break;
+                case GBufferEmissive:
+                    displayedTexture = frameGraph.ImportTexture(m_renderTargets->GBufferEmissive);
+                    break;
+                case DiffuseLighting:
+                    displayedTexture = frameGraph.ImportTexture(m_renderTargets->DiffuseLighting);
+                    break;
+                case SpecularLighting:
+                    displayedTexture = frameGraph.ImportTexture(m_renderTargets->SpecularLighting);
+                    break;
+                case DenoisedDiffuseLighting:
+                    displayedTexture = frameGraph.ImportTexture(m_renderTargets->DenoisedDiffuseLighting);
+                    break;
+                case DenoisedSpecularLighting:
+                    displayedTexture = frameGraph.ImportTexture(m_renderTargets->DenoisedSpecularLighting);
+                    break;
+                case RestirLuminance:
+                    displayedTexture = frameGraph.ImportTexture(m_renderTargets->RestirLuminance);
+                    break;
+                case PrevRestirLuminance:
+                    displayedTexture = frameGraph.ImportTexture(m_renderTargets->PrevRestirLuminance);
+                    break;
+                case DiffuseConfidence:
+                    displayedTexture = frameGraph.ImportTexture(m_renderTargets->DiffuseConfidence);
+                    break;
+                case SpecularConfidence:
+                    displayedTexture = frameGraph.ImportTexture(m_renderTargets->SpecularConfidence);
+                    break;
+                case MotionVectors:
+                    displayedTexture = frameGraph.ImportTexture(m_renderTargets->MotionVectors);
+                    break;
+            }
+
+            frameGraph.AddPass("UnpackGBuffer",
+                [&](FrameGraphBuilder& builder)
+                {
+                    builder.Write(debugColor);
+                },
+                [&](nvrhi::ICommandList* commandList, const FrameGraphResources& resources)
+                {
+                    // The binding sets refer to the placed DebugColor texture, which changes when the transient heap layout does
+                    if (m_debugVizGeneration != m_frameGraphPool->GetGeneration())
+                    {
+                        m_debugVizPasses->CreateBindingSets(*m_renderTargets, resources.GetTexture(debugColor));
+                        m_debugVizGeneration = m_frameGraphPool->GetGeneration();
+                    }
+
+                    switch (m_ui.debugRenderOutputBuffer)
+                    {
+                        case GBufferDiffuseAlbedo:
+                            m_debugVizPasses->RenderUnpackedDiffuseAlbeo(commandList, m_upscaledView);
+                            break;
+                        case GBufferSpecularRough:
+                            m_debugVizPasses->RenderUnpackedSpecularRoughness(commandList, m_upscaledView);
+                            break;
+                        case GBufferNormals:
+                            m_debugVizPasses->RenderUnpackedNormals(commandList, m_upscaledView);
+                            break;
+                        case GBufferGeoNormals:
+                            m_debugVizPasses->RenderUnpackedGeoNormals(commandList, m_upscaledView);
+                            break;
+                        default:
+                            break;
+                    }
+                });
+
+            if (displayedTexture.IsValid())
+            {
+                frameGraph.AddPass("DisplayOutput",
+                    [&](FrameGraphBuilder& builder)
+                    {
+                        builder.Read(displayedTexture);
+                        builder.Write(backBuffer, nvrhi::ResourceStates::RenderTarget);
+                    },
+                    [&](nvrhi::ICommandList* commandList, const FrameGraphResources& resources)
+                    {
+                        m_CommonPasses->BlitTexture(commandList, framebuffer, resources.GetTexture(displayedTexture), &m_bindingCache);
+                    });
+            }
+
+            frameGraph.Compile([this](const nvrhi::TextureDesc& desc) { return m_frameGraphPool->GetMemoryRequirements(desc); });
+            frameGraph.Execute(commandList, *m_frameGraphPool);
+            m_ui.frameGraphStats = frameGraph.GetStatistics();
+
+            m_profiler->EndFrame(commandList);
+        }, { lightPreparationSegment, gbufferSegment });
+
+        m_commandRecorder->Execute();
+        m_profiler->SetRecordingTime(m_commandRecorder->GetLastRecordingTime());
+
+        // The validation reads back the gradients, so it can only run in a frame that has filtered them
+        if (m_ui.validateGradientFilter && lightingSettings.enableGradients)
         {
-            case DebugRenderOutput::LDRColor:
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->LdrColor, &m_bindingCache);
-                break;
-            case DebugRenderOutput::Depth:
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->Depth, &m_bindingCache);
-                break;
-            case GBufferDiffuseAlbedo:
-                m_debugVizPasses->RenderUnpackedDiffuseAlbeo(m_commandList, m_upscaledView);
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->DebugColor, &m_bindingCache);
-                break;
-            case GBufferSpecularRough:
-                m_debugVizPasses->RenderUnpackedSpecularRoughness(m_commandList, m_upscaledView);
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->DebugColor, &m_bindingCache);
-                break;
-            case GBufferNormals:
-                m_debugVizPasses->RenderUnpackedNormals(m_commandList, m_upscaledView);
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->DebugColor, &m_bindingCache);
-                break;
-            case GBufferGeoNormals:
-                m_debugVizPasses->RenderUnpackedGeoNormals(m_commandList, m_upscaledView);
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->DebugColor, &m_bindingCache);
-                break;
-            case GBufferEmissive:
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->GBufferEmissive, &m_bindingCache);
-                break;
-            case DiffuseLighting:
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->DiffuseLighting, &m_bindingCache);
-                break;
-            case SpecularLighting:
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->SpecularLighting, &m_bindingCache);
-                break;
-            case DenoisedDiffuseLighting:
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->DenoisedDiffuseLighting, &m_bindingCache);
-                break;
-            case DenoisedSpecularLighting:
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->DenoisedSpecularLighting, &m_bindingCache);
-                break;
-            case RestirLuminance:
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->RestirLuminance, &m_bindingCache);
-                break;
-            case PrevRestirLuminance:
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->PrevRestirLuminance, &m_bindingCache);
-                break;
-            case DiffuseConfidence:
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->DiffuseConfidence, &m_bindingCache);
-                break;
-            case SpecularConfidence:
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->SpecularConfidence, &m_bindingCache);
-                break;
-            case MotionVectors:
-                m_CommonPasses->BlitTexture(m_commandList, framebuffer, m_renderTargets->MotionVectors, &m_bindingCache);
+            m_filterGradientsPass->ValidateAgainstReference();
+            m_ui.validateGradientFilter = false;
         }
-        
-        m_profiler->EndFrame(m_commandList);
 
-        m_commandList->close();
-        GetDevice()->executeCommandList(m_commandList);
+        m_profiler->SetCompactGBufferSurfaces(m_ui.lightingSettings.enableCompactGBufferSurfaces);
 
         if (!m_args.saveFrameFileName.empty() && m_renderFrameIndex == m_args.saveFrameIndex)
         {
@@ -1417,6 +1820,14 @@ public:
             
             glfwSetWindowShouldClose(GetDeviceManager()->GetWindow(), 1);
         }
+
+        if (m_startupReport.MarkFirstFrame())
+        {
+            m_startupReport.Log();
+
+            if (!m_args.startupReportFileName.empty())
+                m_startupReport.WriteJson(m_args.startupReportFileName);
+        }
         
         m_ui.gbufferSettings.enableMaterialReadback = false;
         
@@ -1433,6 +1844,8 @@ public:
 
 private:
     nvrhi::CommandListHandle m_commandList;
+    std::unique_ptr<tf::Executor> m_executor;
+    std::unique_ptr<CommandRecorder> m_commandRecorder;
 
     nvrhi::BindingLayoutHandle m_bindlessLayout;
 
@@ -1456,6 +1869,7 @@ private:
     std::unique_ptr<rtxdi::ImportanceSamplingContext> m_isContext;
     std::unique_ptr<RaytracedGBufferPass> m_gBufferPass;
     std::unique_ptr<RasterizedGBufferPass> m_rasterizedGBufferPass;
+    std::unique_ptr<VisibilityBufferResolvePass> m_visibilityResolvePass;
     std::unique_ptr<PostprocessGBufferPass> m_postprocessGBufferPass;
     std::unique_ptr<GlassPass> m_glassPass;
     std::unique_ptr<FilterGradientsPass> m_filterGradientsPass;
@@ -1469,9 +1883,11 @@ private:
     std::unique_ptr<LightingPasses> m_lightingPasses;
     std::unique_ptr<VisualizationPass> m_visualizationPass;
     std::unique_ptr<RtxdiResources> m_rtxdiResources;
-    std::unique_ptr<engine::IesProfileLoader> m_iesProfileLoader;
+    std::unique_ptr<IesProfileAtlas> m_iesProfileAtlas;
     std::shared_ptr<Profiler> m_profiler;
     std::unique_ptr<DebugVizPasses> m_debugVizPasses;
+    std::unique_ptr<FrameGraphResourcePool> m_frameGraphPool;
+    uint32_t m_debugVizGeneration = ~0u;
 
     uint32_t m_renderFrameIndex = 0;
 
@@ -1485,12 +1901,15 @@ private:
 
     UIData& m_ui;
     CommandLineArguments& m_args;
+    StartupReport& m_startupReport;
     uint m_framesSinceAnimation = 0;
     bool m_previousViewValid = false;
+    bool m_confidenceTilesValid = false;
+    DynamicResolutionController m_dynamicResolution;
+    bool m_dynamicResolutionActive = false;
+    float m_previousResolutionScale = 1.f;
     time_point<steady_clock> m_previousFrameTimeStamp;
 
-    std::vector<std::shared_ptr<engine::IesProfile>> m_iesProfiles;
-
     dm::float3 m_regirCenter;
 
     enum class FrameStepMode
@@ -1514,11 +1933,15 @@ int main(int argc, char** argv)
     app::DeviceCreationParameters deviceParams;
     deviceParams.swapChainBufferCount = 3;
     deviceParams.enableRayTracingExtensions = true;
+    deviceParams.enableComputeQueue = true;
     deviceParams.backBufferWidth = 1920;
     deviceParams.backBufferHeight = 1080;
     deviceParams.vsyncEnabled = true;
     deviceParams.infoLogSeverity = log::Severity::Debug;
 
+    // Created first, so that the startup phases are measured from the start of the process
+    StartupReport startupReport;
+
     UIData ui;
     CommandLineArguments args;
 
@@ -1576,10 +1999,16 @@ int main(int argc, char** argv)
     SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
 #endif
 
-    if (!deviceManager->CreateWindowDeviceAndSwapChain(deviceParams, windowTitle.c_str()))
     {
-        log::error("Cannot initialize a %s graphics device.", apiString);
-        return 1;
+        StartupReport::Scope phase(startupReport, "Device creation");
+
+        // The benchmark mode needs a window too: the frames are driven by RunMessageLoop, which advances the frame index
+        // and presents through the swap chain, and the final passes and the UI render into the back buffer.
+        if (!deviceManager->CreateWindowDeviceAndSwapChain(deviceParams, windowTitle.c_str()))
+        {
+            log::error("Cannot initialize a %s graphics device.", apiString);
+            return 1;
+        }
     }
 
     bool rayPipelineSupported = deviceManager->GetDevice()->queryFeatureSupport(nvrhi::Feature::RayTracingPipeline);
@@ -1615,7 +2044,7 @@ int main(int argc, char** argv)
 #endif
 
     {
-        SceneRenderer sceneRenderer(deviceManager, ui, args);
+        SceneRenderer sceneRenderer(deviceManager, ui, args, startupReport);
         if (sceneRenderer.Init())
         {
             UserInterface userInterface(deviceManager, *sceneRenderer.GetRootFs(), ui);
@@ -128,8 +128,6 @@ RTXDI_LightBufferParameters PrepareLightsPass::Process(nvrhi::ICommandList* comm
 
             geometryInstanceToLight[firstGeometryInstanceIndex + geometryIndex] = lightBufferOffset;
 
-            assert(geometryIndex < 0xfff);
-
             PrepareLightsTask task{};
             task.instanceIndex = instance->GetInstanceIndex();
             task.geometryIndex = (uint32_t)geometryIndex;
@@ -0,0 +1,284 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "ApplicationBridge.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace donut::math;
+
+namespace cpuref
+{
+    static float square(float x) { return x * x; }
+
+    uint32_t RTXDI_JenkinsHash(uint32_t a)
+    {
+        a = (a + 0x7ed55d16) + (a << 12);
+        a = (a ^ 0xc761c23c) ^ (a >> 19);
+        a = (a + 0x165667b1) + (a << 5);
+        a = (a + 0xd3a2646c) ^ (a << 9);
+        a = (a + 0xfd7046c5) + (a << 3);
+        a = (a ^ 0xb55a4f09) ^ (a >> 16);
+        return a;
+    }
+
+    uint32_t RTXDI_ZCurveToLinearIndex(uint2 xy)
+    {
+        uint32_t b = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            b |= ((xy.x & 1) | ((xy.y & 1) << 1)) << (2 * i);
+            xy.x >>= 1;
+            xy.y >>= 1;
+        }
+        return b;
+    }
+
+    float RTXDI_Luminance(float3 color)
+    {
+        return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+    }
+
+    bool RTXDI_CompareRelativeDifference(float reference, float candidate, float threshold)
+    {
+        return (threshold <= 0) || std::abs(reference - candidate) <= threshold * std::max(reference, candidate);
+    }
+
+    float calcLuminance(float3 color)
+    {
+        return dot(color, float3(0.299f, 0.587f, 0.114f));
+    }
+
+    float3 sampleTriangle(float2 rndSample)
+    {
+        const float sqrtx = std::sqrt(rndSample.x);
+
+        return float3(
+            1 - sqrtx,
+            sqrtx * (1 - rndSample.y),
+            sqrtx * rndSample.y);
+    }
+
+    RAB_RandomSamplerState RAB_InitRandomSampler(uint2 index, uint32_t frameIndex, uint32_t pass)
+    {
+        RAB_RandomSamplerState state;
+        state.index = 1;
+        state.seed = RTXDI_JenkinsHash(RTXDI_ZCurveToLinearIndex(index)) + frameIndex + pass * 13;
+        return state;
+    }
+
+    static uint32_t murmur3(RAB_RandomSamplerState& r)
+    {
+        auto rot32 = [](uint32_t x, uint32_t y) { return (x << y) | (x >> (32 - y)); };
+
+        const uint32_t c1 = 0xcc9e2d51;
+        const uint32_t c2 = 0x1b873593;
+        const uint32_t r1 = 15;
+        const uint32_t r2 = 13;
+        const uint32_t m = 5;
+        const uint32_t n = 0xe6546b64;
+
+        uint32_t hash = r.seed;
+        uint32_t k = r.index++;
+        k *= c1;
+        k = rot32(k, r1);
+        k *= c2;
+
+        hash ^= k;
+        hash = rot32(hash, r2) * m + n;
+
+        hash ^= 4;
+        hash ^= (hash >> 16);
+        hash *= 0x85ebca6b;
+        hash ^= (hash >> 13);
+        hash *= 0xc2b2ae35;
+        hash ^= (hash >> 16);
+
+        return hash;
+    }
+
+    float RAB_GetNextRandom(RAB_RandomSamplerState& rng)
+    {
+        const uint32_t v = murmur3(rng);
+        const uint32_t one = 0x3f800000; // asuint(1.f)
+        const uint32_t mask = (1 << 23) - 1;
+        const uint32_t bits = (mask & v) | one;
+        float result;
+        std::memcpy(&result, &bits, sizeof(result));
+        return result - 1.f;
+    }
+
+    static float3 Schlick_Fresnel(float3 F0, float VdotH)
+    {
+        return F0 + (float3(1.f) - F0) * std::pow(std::max(1.f - VdotH, 0.f), 5.f);
+    }
+
+    static float Lambert(float3 normal, float3 lightIncident)
+    {
+        return std::max(0.f, -dot(normal, lightIncident)) / PI_f;
+    }
+
+    static float G_Smith_over_NdotV(float roughness, float NdotV, float NdotL)
+    {
+        const float alpha = square(roughness);
+        const float g1 = NdotV * std::sqrt(square(alpha) + (1.f - square(alpha)) * square(NdotL));
+        const float g2 = NdotL * std::sqrt(square(alpha) + (1.f - square(alpha)) * square(NdotV));
+        return 2.f * NdotL / (g1 + g2);
+    }
+
+    static float3 GGX_times_NdotL(float3 V, float3 L, float3 N, float roughness, float3 F0)
+    {
+        const float3 H = normalize(L + V);
+
+        const float NoL = saturate(dot(N, L));
+        const float VoH = saturate(dot(V, H));
+        const float NoV = saturate(dot(N, V));
+        const float NoH = saturate(dot(N, H));
+
+        if (NoL <= 0)
+            return float3(0.f);
+
+        const float G = G_Smith_over_NdotV(roughness, NoV, NoL);
+        const float alpha = square(roughness);
+        const float D = square(alpha) / (PI_f * square(square(NoH) * square(alpha) + (1 - square(NoH))));
+        const float3 F = Schlick_Fresnel(F0, VoH);
+
+        return F * (D * G * NoL / 4);
+    }
+
+    float getSurfaceDiffuseProbability(const RAB_Surface& surface)
+    {
+        const float diffuseWeight = calcLuminance(surface.material.diffuseAlbedo);
+        const float specularWeight = calcLuminance(Schlick_Fresnel(surface.material.specularF0, dot(surface.viewDir, surface.normal)));
+        const float sumWeights = diffuseWeight + specularWeight;
+        return sumWeights < 1e-7f ? 1.f : (diffuseWeight / sumWeights);
+    }
+
+    bool RAB_AreMaterialsSimilar(const RAB_Material& a, const RAB_Material& b)
+    {
+        const float roughnessThreshold = 0.5f;
+        const float reflectivityThreshold = 0.25f;
+        const float albedoThreshold = 0.25f;
+
+        if (!RTXDI_CompareRelativeDifference(a.roughness, b.roughness, roughnessThreshold))
+            return false;
+
+        if (std::abs(calcLuminance(a.specularF0) - calcLuminance(b.specularF0)) > reflectivityThreshold)
+            return false;
+
+        if (std::abs(calcLuminance(a.diffuseAlbedo) - calcLuminance(b.diffuseAlbedo)) > albedoThreshold)
+            return false;
+
+        return true;
+    }
+
+    RAB_LightInfo CreateTriangleLight(float3 a, float3 b, float3 c, float3 radiance)
+    {
+        RAB_LightInfo light;
+        light.base = a;
+        light.edge1 = b - a;
+        light.edge2 = c - a;
+        light.radiance = radiance;
+
+        const float3 lightNormal = cross(light.edge1, light.edge2);
+        const float lightNormalLength = length(lightNormal);
+
+        if (lightNormalLength > 0.f)
+        {
+            light.surfaceArea = 0.5f * lightNormalLength;
+            light.normal = lightNormal / lightNormalLength;
+        }
+
+        return light;
+    }
+
+    float GetLightPower(const RAB_LightInfo& lightInfo)
+    {
+        return lightInfo.surfaceArea * PI_f * calcLuminance(lightInfo.radiance);
+    }
+
+    RAB_LightSample RAB_SamplePolymorphicLight(const RAB_LightInfo& lightInfo, const RAB_Surface& surface, float2 uv)
+    {
+        RAB_LightSample result;
+
+        const float3 bary = sampleTriangle(uv);
+        result.position = lightInfo.base + lightInfo.edge1 * bary.y + lightInfo.edge2 * bary.z;
+        result.normal = lightInfo.normal;
+        result.radiance = lightInfo.radiance;
+
+        if (lightInfo.surfaceArea <= 0.f)
+            return result;
+
+        float3 L = result.position - surface.worldPos;
+        const float Ldist = length(L);
+        L /= Ldist;
+
+        // pdfAtoW
+        const float areaPdf = 1.f / lightInfo.surfaceArea;
+        const float sampleCosTheta = saturate(dot(L, -result.normal));
+        result.solidAnglePdf = sampleCosTheta > 0.f ? areaPdf * square(Ldist) / sampleCosTheta : 0.f;
+
+        return result;
+    }
+
+    float3 RAB_GetReflectedRadianceForSurface(float3 incomingRadianceLocation, float3 incomingRadiance, const RAB_Surface& surface)
+    {
+        const float3 L = normalize(incomingRadianceLocation - surface.worldPos);
+        const float3 N = surface.normal;
+        const float3 V = surface.viewDir;
+
+        if (dot(L, surface.geoNormal) <= 0)
+            return float3(0.f);
+
+        const float d = Lambert(N, -L);
+        float3 s = float3(0.f);
+        if (surface.material.roughness != 0)
+            s = GGX_times_NdotL(V, L, N, std::max(surface.material.roughness, c_MinRoughness), surface.material.specularF0);
+
+        return incomingRadiance * (d * surface.material.diffuseAlbedo + s);
+    }
+
+    float RAB_GetLightSampleTargetPdfForSurface(const RAB_LightSample& lightSample, const RAB_Surface& surface)
+    {
+        if (lightSample.solidAnglePdf <= 0)
+            return 0;
+
+        return RTXDI_Luminance(RAB_GetReflectedRadianceForSurface(lightSample.position, lightSample.radiance, surface)) / lightSample.solidAnglePdf;
+    }
+
+    SplitBrdf EvaluateBrdf(const RAB_Surface& surface, float3 samplePosition)
+    {
+        const float3 L = normalize(samplePosition - surface.worldPos);
+
+        SplitBrdf brdf;
+        brdf.demodulatedDiffuse = Lambert(surface.normal, -L);
+        if (surface.material.roughness != 0)
+            brdf.specular = GGX_times_NdotL(surface.viewDir, L, surface.normal, std::max(surface.material.roughness, c_MinRoughness), surface.material.specularF0);
+        return brdf;
+    }
+
+    bool RAB_GetConservativeVisibility(const Bvh& bvh, const RAB_Surface& surface, float3 samplePosition)
+    {
+        // setupVisibilityRay
+        const float offset = 0.001f;
+        const float3 L = samplePosition - surface.worldPos;
+        const float distance = length(L);
+
+        Ray ray;
+        ray.origin = surface.worldPos;
+        ray.direction = L / distance;
+        ray.tMin = offset;
+        ray.tMax = std::max(offset, distance - offset * 2);
+
+        return !bvh.IsOccluded(ray);
+    }
+}
@@ -0,0 +1,106 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+// C++ implementation of the RTXDI application bridge used by the full sample,
+// see Samples/FullSample/Shaders/LightingPasses/RtxdiApplicationBridge.
+// The structures and functions keep the RAB_ names of their HLSL counterparts so that the two
+// can be compared side by side, and the math follows the shader code as closely as possible.
+//
+// Only triangle lights are supported, which is what emissive meshes are converted into
+// by the PrepareLights pass. The random number generator is bit-exact with the shaders.
+
+#include "Bvh.h"
+
+namespace cpuref
+{
+    constexpr float c_BackgroundDepth = 65504.f; // BACKGROUND_DEPTH
+    constexpr float c_MinRoughness = 0.05f;      // kMinRoughness
+    constexpr uint32_t c_InvalidLightIndex = ~0u; // RTXDI_InvalidLightIndex
+
+    struct RAB_Material
+    {
+        donut::math::float3 diffuseAlbedo = donut::math::float3(0.f);
+        donut::math::float3 specularF0 = donut::math::float3(0.f);
+        float roughness = 0.f;
+    };
+
+    struct RAB_Surface
+    {
+        donut::math::float3 worldPos = donut::math::float3(0.f);
+        donut::math::float3 viewDir = donut::math::float3(0.f);
+        donut::math::float3 normal = donut::math::float3(0.f);
+        donut::math::float3 geoNormal = donut::math::float3(0.f);
+        float viewDepth = c_BackgroundDepth;
+        float diffuseProbability = 0.f;
+        RAB_Material material;
+    };
+
+    // Same data as TriangleLight in PolymorphicLight.hlsli, after unpacking.
+    struct RAB_LightInfo
+    {
+        donut::math::float3 base = donut::math::float3(0.f);
+        donut::math::float3 edge1 = donut::math::float3(0.f);
+        donut::math::float3 edge2 = donut::math::float3(0.f);
+        donut::math::float3 radiance = donut::math::float3(0.f);
+        donut::math::float3 normal = donut::math::float3(0.f);
+        float surfaceArea = 0.f;
+    };
+
+    struct RAB_LightSample
+    {
+        donut::math::float3 position = donut::math::float3(0.f);
+        donut::math::float3 normal = donut::math::float3(0.f);
+        donut::math::float3 radiance = donut::math::float3(0.f);
+        float solidAnglePdf = 0.f;
+    };
+
+    struct RAB_RandomSamplerState
+    {
+        uint32_t seed = 0;
+        uint32_t index = 0;
+    };
+
+    struct SplitBrdf
+    {
+        float demodulatedDiffuse = 0.f;
+        donut::math::float3 specular = donut::math::float3(0.f);
+    };
+
+    // RTXDI helper functions
+    uint32_t RTXDI_JenkinsHash(uint32_t a);
+    uint32_t RTXDI_ZCurveToLinearIndex(donut::math::uint2 xy);
+    float RTXDI_Luminance(donut::math::float3 color);
+    bool RTXDI_CompareRelativeDifference(float reference, float candidate, float threshold);
+
+    // Sample helper functions
+    float calcLuminance(donut::math::float3 color);
+    donut::math::float3 sampleTriangle(donut::math::float2 rndSample);
+
+    // The frame index is a parameter here instead of a global constant
+    RAB_RandomSamplerState RAB_InitRandomSampler(donut::math::uint2 index, uint32_t frameIndex, uint32_t pass);
+    float RAB_GetNextRandom(RAB_RandomSamplerState& rng);
+
+    inline bool RAB_IsSurfaceValid(const RAB_Surface& surface) { return surface.viewDepth != c_BackgroundDepth; }
+    float getSurfaceDiffuseProbability(const RAB_Surface& surface);
+    bool RAB_AreMaterialsSimilar(const RAB_Material& a, const RAB_Material& b);
+
+    RAB_LightInfo CreateTriangleLight(donut::math::float3 a, donut::math::float3 b, donut::math::float3 c, donut::math::float3 radiance);
+    float GetLightPower(const RAB_LightInfo& lightInfo);
+    RAB_LightSample RAB_SamplePolymorphicLight(const RAB_LightInfo& lightInfo, const RAB_Surface& surface, donut::math::float2 uv);
+
+    donut::math::float3 RAB_GetReflectedRadianceForSurface(donut::math::float3 incomingRadianceLocation, donut::math::float3 incomingRadiance, const RAB_Surface& surface);
+    float RAB_GetLightSampleTargetPdfForSurface(const RAB_LightSample& lightSample, const RAB_Surface& surface);
+    SplitBrdf EvaluateBrdf(const RAB_Surface& surface, donut::math::float3 samplePosition);
+
+    // Visibility is tested against the CPU BVH instead of the TLAS
+    bool RAB_GetConservativeVisibility(const Bvh& bvh, const RAB_Surface& surface, donut::math::float3 samplePosition);
+}
@@ -0,0 +1,336 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+using namespace donut::math;
+
+namespace cpuref
+{
+    static constexpr uint32_t c_NumBins = 16;
+    static constexpr uint32_t c_MaxStackDepth = 64;
+
+    static float SurfaceArea(const float3& boundsMin, const float3& boundsMax)
+    {
+        const float3 extent = max(boundsMax - boundsMin, float3(0.f));
+        return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+
+    void Bvh::Build(const std::vector<float3>& positions)
+    {
+        m_nodes.clear();
+        m_packets.clear();
+        m_triangleCount = uint32_t(positions.size() / 3);
+
+        if (m_triangleCount == 0)
+            return;
+
+        std::vector<BuildTriangle> triangles(m_triangleCount);
+        for (uint32_t index = 0; index < m_triangleCount; index++)
+        {
+            const float3& a = positions[index * 3 + 0];
+            const float3& b = positions[index * 3 + 1];
+            const float3& c = positions[index * 3 + 2];
+
+            BuildTriangle& triangle = triangles[index];
+            triangle.boundsMin = min(a, min(b, c));
+            triangle.boundsMax = max(a, max(b, c));
+            triangle.centroid = (a + b + c) / 3.f;
+            triangle.index = index;
+        }
+
+        m_nodes.reserve(size_t(m_triangleCount) * 2 / PacketWidth + 1);
+        m_nodes.emplace_back();
+        BuildNode(0, triangles, 0, triangles.size(), positions);
+    }
+
+    void Bvh::BuildNode(uint32_t nodeIndex, std::vector<BuildTriangle>& triangles, size_t begin, size_t end,
+        const std::vector<float3>& positions)
+    {
+        float3 boundsMin = float3(FLT_MAX);
+        float3 boundsMax = float3(-FLT_MAX);
+        float3 centroidMin = float3(FLT_MAX);
+        float3 centroidMax = float3(-FLT_MAX);
+        for (size_t index = begin; index < end; index++)
+        {
+            boundsMin = min(boundsMin, triangles[index].boundsMin);
+            boundsMax = max(boundsMax, triangles[index].boundsMax);
+            centroidMin = min(centroidMin, triangles[index].centroid);
+            centroidMax = max(centroidMax, triangles[index].centroid);
+        }
+
+        m_nodes[nodeIndex].boundsMin = boundsMin;
+        m_nodes[nodeIndex].boundsMax = boundsMax;
+
+        const size_t count = end - begin;
+        if (count <= PacketWidth)
+        {
+            // Pad the packet with degenerate triangles that never produce a hit
+            TrianglePacket packet = {};
+            for (uint32_t lane = 0; lane < PacketWidth; lane++)
+            {
+                packet.triangleIndex[lane] = ~0u;
+                if (lane >= count)
+                    continue;
+
+                const uint32_t triangleIndex = triangles[begin + lane].index;
+                const float3 v0 = positions[triangleIndex * 3 + 0];
+                const float3 e1 = positions[triangleIndex * 3 + 1] - v0;
+                const float3 e2 = positions[triangleIndex * 3 + 2] - v0;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    packet.v0[axis][lane] = v0[axis];
+                    packet.e1[axis][lane] = e1[axis];
+                    packet.e2[axis][lane] = e2[axis];
+                }
+                packet.triangleIndex[lane] = triangleIndex;
+            }
+
+            m_nodes[nodeIndex].isLeaf = 1;
+            m_nodes[nodeIndex].childOrPacket = uint32_t(m_packets.size());
+            m_packets.push_back(packet);
+            return;
+        }
+
+        // Find the best split among the bin boundaries on all axes using the surface area heuristic
+        int bestAxis = -1;
+        uint32_t bestSplit = 0;
+        float bestCost = FLT_MAX;
+        const float3 centroidExtent = centroidMax - centroidMin;
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (centroidExtent[axis] <= 0.f)
+                continue;
+
+            struct Bin
+            {
+                float3 boundsMin = float3(FLT_MAX);
+                float3 boundsMax = float3(-FLT_MAX);
+                uint32_t count = 0;
+            };
+            Bin bins[c_NumBins];
+
+            const float scale = float(c_NumBins) / centroidExtent[axis];
+            for (size_t index = begin; index < end; index++)
+            {
+                const BuildTriangle& triangle = triangles[index];
+                const uint32_t bin = std::min(c_NumBins - 1, uint32_t((triangle.centroid[axis] - centroidMin[axis]) * scale));
+                bins[bin].boundsMin = min(bins[bin].boundsMin, triangle.boundsMin);
+                bins[bin].boundsMax = max(bins[bin].boundsMax, triangle.boundsMax);
+                bins[bin].count++;
+            }
+
+            // Sweep from the right to get the cost of all right-hand partitions
+            float rightArea[c_NumBins];
+            uint32_t rightCount[c_NumBins];
+            Bin accumulated;
+            for (uint32_t bin = c_NumBins - 1; bin > 0; bin--)
+            {
+                accumulated.boundsMin = min(accumulated.boundsMin, bins[bin].boundsMin);
+                accumulated.boundsMax = max(accumulated.boundsMax, bins[bin].boundsMax);
+                accumulated.count += bins[bin].count;
+                rightArea[bin] = SurfaceArea(accumulated.boundsMin, accumulated.boundsMax);
+                rightCount[bin] = accumulated.count;
+            }
+
+            accumulated = Bin();
+            for (uint32_t split = 1; split < c_NumBins; split++)
+            {
+                accumulated.boundsMin = min(accumulated.boundsMin, bins[split - 1].boundsMin);
+                accumulated.boundsMax = max(accumulated.boundsMax, bins[split - 1].boundsMax);
+                accumulated.count += bins[split - 1].count;
+
+                if (accumulated.count == 0 || rightCount[split] == 0)
+                    continue;
+
+                const float cost = SurfaceArea(accumulated.boundsMin, accumulated.boundsMax) * float(accumulated.count)
+                    + rightArea[split] * float(rightCount[split]);
+
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+
+        size_t middle;
+        if (bestAxis >= 0)
+        {
+            const float scale = float(c_NumBins) / centroidExtent[bestAxis];
+            const auto partition = std::partition(triangles.begin() + begin, triangles.begin() + end,
+                [&](const BuildTriangle& triangle)
+                {
+                    const uint32_t bin = std::min(c_NumBins - 1, uint32_t((triangle.centroid[bestAxis] - centroidMin[bestAxis]) * scale));
+                    return bin < bestSplit;
+                });
+            middle = size_t(partition - triangles.begin());
+        }
+        else
+        {
+            // All centroids are in the same place, split in the middle of the list
+            middle = begin + count / 2;
+        }
+
+        const uint32_t firstChild = uint32_t(m_nodes.size());
+        m_nodes[nodeIndex].childOrPacket = firstChild;
+        m_nodes.emplace_back();
+        m_nodes.emplace_back();
+
+        BuildNode(firstChild + 0, triangles, begin, middle, positions);
+        BuildNode(firstChild + 1, triangles, middle, end, positions);
+    }
+
+    // Returns the entry distance of the ray into the box, or FLT_MAX if the box is missed.
+    static float IntersectBox(const float3& boundsMin, const float3& boundsMax, const float3& origin, const float3& invDirection,
+        float tMin, float tMax)
+    {
+        const float3 t0 = (boundsMin - origin) * invDirection;
+        const float3 t1 = (boundsMax - origin) * invDirection;
+        const float3 tNear = min(t0, t1);
+        const float3 tFar = max(t0, t1);
+
+        const float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, tMin));
+        const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+
+        return entry <= exit ? entry : FLT_MAX;
+    }
+
+    template<bool AnyHit>
+    bool Bvh::Traverse(const Ray& ray, RayHit& hit) const
+    {
+        if (m_nodes.empty())
+            return false;
+
+        const float3 invDirection = 1.f / ray.direction;
+        float tMax = ray.tMax;
+        bool found = false;
+
+        uint32_t stack[c_MaxStackDepth];
+        uint32_t stackSize = 0;
+        uint32_t nodeIndex = 0;
+
+        if (IntersectBox(m_nodes[0].boundsMin, m_nodes[0].boundsMax, ray.origin, invDirection, ray.tMin, tMax) == FLT_MAX)
+            return false;
+
+        while (true)
+        {
+            const Node& node = m_nodes[nodeIndex];
+
+            if (node.isLeaf)
+            {
+                const TrianglePacket& packet = m_packets[node.childOrPacket];
+
+                // Moeller-Trumbore, 4 triangles at a time
+                float laneT[PacketWidth];
+                float laneU[PacketWidth];
+                float laneV[PacketWidth];
+                bool laneHit[PacketWidth];
+                for (uint32_t lane = 0; lane < PacketWidth; lane++)
+                {
+                    const float e1x = packet.e1[0][lane], e1y = packet.e1[1][lane], e1z = packet.e1[2][lane];
+                    const float e2x = packet.e2[0][lane], e2y = packet.e2[1][lane], e2z = packet.e2[2][lane];
+
+                    const float px = ray.direction.y * e2z - ray.direction.z * e2y;
+                    const float py = ray.direction.z * e2x - ray.direction.x * e2z;
+                    const float pz = ray.direction.x * e2y - ray.direction.y * e2x;
+                    const float det = e1x * px + e1y * py + e1z * pz;
+                    const float invDet = det != 0.f ? 1.f / det : 0.f;
+
+                    const float sx = ray.origin.x - packet.v0[0][lane];
+                    const float sy = ray.origin.y - packet.v0[1][lane];
+                    const float sz = ray.origin.z - packet.v0[2][lane];
+                    const float u = (sx * px + sy * py + sz * pz) * invDet;
+
+                    const float qx = sy * e1z - sz * e1y;
+                    const float qy = sz * e1x - sx * e1z;
+                    const float qz = sx * e1y - sy * e1x;
+                    const float v = (ray.direction.x * qx + ray.direction.y * qy + ray.direction.z * qz) * invDet;
+                    const float t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+                    laneT[lane] = t;
+                    laneU[lane] = u;
+                    laneV[lane] = v;
+                    laneHit[lane] = (det != 0.f) & (u >= 0.f) & (v >= 0.f) & (u + v <= 1.f) & (t >= ray.tMin) & (t <= tMax);
+                }
+
+                for (uint32_t lane = 0; lane < PacketWidth; lane++)
+                {
+                    if (!laneHit[lane] || laneT[lane] > tMax)
+                        continue;
+
+                    found = true;
+                    tMax = laneT[lane];
+                    hit.t = laneT[lane];
+                    hit.triangleIndex = packet.triangleIndex[lane];
+                    hit.barycentrics = float2(laneU[lane], laneV[lane]);
+
+                    if (AnyHit)
+                        return true;
+                }
+            }
+            else
+            {
+                const uint32_t left = node.childOrPacket;
+                const uint32_t right = left + 1;
+                const float leftEntry = IntersectBox(m_nodes[left].boundsMin, m_nodes[left].boundsMax, ray.origin, invDirection, ray.tMin, tMax);
+                const float rightEntry = IntersectBox(m_nodes[right].boundsMin, m_nodes[right].boundsMax, ray.origin, invDirection, ray.tMin, tMax);
+
+                if (leftEntry != FLT_MAX && rightEntry != FLT_MAX)
+                {
+                    // Visit the nearer child first, push the other one
+                    const bool leftFirst = leftEntry <= rightEntry;
+                    assert(stackSize < c_MaxStackDepth);
+                    stack[stackSize++] = leftFirst ? right : left;
+                    nodeIndex = leftFirst ? left : right;
+                    continue;
+                }
+
+                if (leftEntry != FLT_MAX)
+                {
+                    nodeIndex = left;
+                    continue;
+                }
+
+                if (rightEntry != FLT_MAX)
+                {
+                    nodeIndex = right;
+                    continue;
+                }
+            }
+
+            if (stackSize == 0)
+                break;
+
+            nodeIndex = stack[--stackSize];
+        }
+
+        return found;
+    }
+
+    RayHit Bvh::Intersect(const Ray& ray) const
+    {
+        RayHit hit;
+        Traverse<false>(ray, hit);
+        return hit;
+    }
+
+    bool Bvh::IsOccluded(const Ray& ray) const
+    {
+        RayHit hit;
+        return Traverse<true>(ray, hit);
+    }
+}
@@ -0,0 +1,92 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <cstdint>
+#include <vector>
+
+namespace cpuref
+{
+    struct Ray
+    {
+        donut::math::float3 origin;
+        float tMin = 0.f;
+        donut::math::float3 direction;
+        float tMax = 0.f;
+    };
+
+    struct RayHit
+    {
+        float t = 0.f;
+        uint32_t triangleIndex = ~0u;
+        donut::math::float2 barycentrics = donut::math::float2(0.f, 0.f); // same convention as the DXR hit attributes
+
+        [[nodiscard]] bool IsValid() const { return triangleIndex != ~0u; }
+    };
+
+    // A binary BVH over a triangle soup, built with binned SAH.
+    // Leaves hold up to 4 triangles in a structure-of-arrays packet, so that the ray-triangle tests
+    // in a leaf are written as 4-wide loops that the compiler can vectorize.
+    // The BVH is immutable after Build() and can be traversed from multiple threads.
+    class Bvh
+    {
+    public:
+        static constexpr uint32_t PacketWidth = 4;
+
+        // 'positions' contains 3 vertices per triangle. Triangle indices in RayHit refer to this array.
+        void Build(const std::vector<donut::math::float3>& positions);
+
+        // Returns the closest hit within [tMin, tMax], or an invalid hit.
+        [[nodiscard]] RayHit Intersect(const Ray& ray) const;
+
+        // Returns true if anything is hit within [tMin, tMax]; stops at the first hit.
+        [[nodiscard]] bool IsOccluded(const Ray& ray) const;
+
+        [[nodiscard]] uint32_t GetTriangleCount() const { return m_triangleCount; }
+        [[nodiscard]] size_t GetNodeCount() const { return m_nodes.size(); }
+
+    private:
+        struct Node
+        {
+            donut::math::float3 boundsMin;
+            uint32_t childOrPacket = 0; // first child for inner nodes, packet index for leaves
+            donut::math::float3 boundsMax;
+            uint32_t isLeaf = 0;
+        };
+
+        struct TrianglePacket
+        {
+            float v0[3][PacketWidth];
+            float e1[3][PacketWidth];
+            float e2[3][PacketWidth];
+            uint32_t triangleIndex[PacketWidth];
+        };
+
+        struct BuildTriangle
+        {
+            donut::math::float3 boundsMin;
+            donut::math::float3 boundsMax;
+            donut::math::float3 centroid;
+            uint32_t index;
+        };
+
+        void BuildNode(uint32_t nodeIndex, std::vector<BuildTriangle>& triangles, size_t begin, size_t end,
+            const std::vector<donut::math::float3>& positions);
+
+        template<bool AnyHit>
+        bool Traverse(const Ray& ray, RayHit& hit) const;
+
+        std::vector<Node> m_nodes;
+        std::vector<TrianglePacket> m_packets;
+        uint32_t m_triangleCount = 0;
+    };
+}
@@ -0,0 +1,481 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "ReSTIRDIPipeline.h"
+
+#include <taskflow/taskflow.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace donut::math;
+
+namespace cpuref
+{
+    static constexpr uint32_t c_NeighborOffsetCount = 8192;
+    static constexpr uint32_t c_MaxSpatialSamples = 32;
+
+    // Same sequence as rtxdi::FillNeighborOffsetBuffer, decoded from RG8_SNORM
+    static const std::vector<float2>& GetNeighborOffsets()
+    {
+        static const std::vector<float2> offsets = []()
+        {
+            std::vector<float2> result;
+            result.reserve(c_NeighborOffsetCount);
+
+            const int R = 250;
+            const float phi2 = 1.0f / 1.3247179572447f;
+            float u = 0.5f;
+            float v = 0.5f;
+            while (result.size() < c_NeighborOffsetCount)
+            {
+                u += phi2;
+                v += phi2 * phi2;
+                if (u >= 1.0f) u -= 1.0f;
+                if (v >= 1.0f) v -= 1.0f;
+
+                const float rSq = (u - 0.5f) * (u - 0.5f) + (v - 0.5f) * (v - 0.5f);
+                if (rSq > 0.25f)
+                    continue;
+
+                const int8_t x = int8_t((u - 0.5f) * R);
+                const int8_t y = int8_t((v - 0.5f) * R);
+                result.push_back(float2(std::max(float(x) / 127.f, -1.f), std::max(float(y) / 127.f, -1.f)));
+            }
+
+            return result;
+        }();
+
+        return offsets;
+    }
+
+    static bool RTXDI_IsValidNeighbor(float3 ourNorm, float3 theirNorm, float ourDepth, float theirDepth, float normalThreshold, float depthThreshold)
+    {
+        return (dot(theirNorm, ourNorm) >= normalThreshold)
+            && (std::abs(ourDepth - theirDepth) <= depthThreshold * std::max(ourDepth, theirDepth));
+    }
+
+    // RAB_ClampSamplePositionIntoView: reflect the position across the screen edges
+    static int2 ClampSamplePositionIntoView(int2 pixelPosition, uint2 viewportSize)
+    {
+        const int width = int(viewportSize.x);
+        const int height = int(viewportSize.y);
+
+        if (pixelPosition.x < 0) pixelPosition.x = -pixelPosition.x;
+        if (pixelPosition.y < 0) pixelPosition.y = -pixelPosition.y;
+        if (pixelPosition.x >= width) pixelPosition.x = 2 * width - pixelPosition.x - 1;
+        if (pixelPosition.y >= height) pixelPosition.y = 2 * height - pixelPosition.y - 1;
+
+        return pixelPosition;
+    }
+
+    static DIReservoir CombineCenterSample(const DIReservoir& centerSample)
+    {
+        DIReservoir state;
+        RTXDI_CombineDIReservoirs(state, centerSample, 0.5f, centerSample.targetPdf);
+        return state;
+    }
+
+    ReSTIRDIPipeline::ReSTIRDIPipeline(uint2 viewportSize, tf::Executor* executor)
+        : m_viewportSize(viewportSize)
+        , m_executor(executor)
+        , m_reservoirs(viewportSize.x, viewportSize.y, NumReservoirArrays)
+    {
+        m_diffuse.resize(size_t(viewportSize.x) * viewportSize.y, float3(0.f));
+        m_specular.resize(m_diffuse.size(), float3(0.f));
+    }
+
+    double ReSTIRDIPipeline::ForEachPixel(const PixelCallback& callback)
+    {
+        const uint32_t tilesX = (m_viewportSize.x + TileSize - 1) / TileSize;
+        const uint32_t tilesY = (m_viewportSize.y + TileSize - 1) / TileSize;
+
+        auto processTile = [this, tilesX, &callback](uint32_t tileIndex)
+        {
+            const uint32_t beginX = (tileIndex % tilesX) * TileSize;
+            const uint32_t beginY = (tileIndex / tilesX) * TileSize;
+            const uint32_t endX = std::min(beginX + TileSize, m_viewportSize.x);
+            const uint32_t endY = std::min(beginY + TileSize, m_viewportSize.y);
+
+            for (uint32_t y = beginY; y < endY; y++)
+                for (uint32_t x = beginX; x < endX; x++)
+                    callback(uint2(x, y));
+        };
+
+        const auto startTime = std::chrono::steady_clock::now();
+
+        if (m_executor)
+        {
+            tf::Taskflow taskflow;
+            taskflow.for_each_index(0u, tilesX * tilesY, 1u, processTile);
+            m_executor->run(taskflow).wait();
+        }
+        else
+        {
+            for (uint32_t tileIndex = 0; tileIndex < tilesX * tilesY; tileIndex++)
+                processTile(tileIndex);
+        }
+
+        const auto endTime = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    }
+
+    bool ReSTIRDIPipeline::GetVisibility(const Scene& scene, const RAB_Surface& surface, float3 samplePosition)
+    {
+        m_visibilityRays.fetch_add(1, std::memory_order_relaxed);
+        return RAB_GetConservativeVisibility(scene.GetBvh(), surface, samplePosition);
+    }
+
+    void ReSTIRDIPipeline::Render(const Scene& scene, const GBuffer& current, const GBuffer* previous, uint32_t frameIndex)
+    {
+        m_statistics = ReSTIRDIStatistics();
+        m_visibilityRays = 0;
+
+        // Pick the arrays so that the previous frame's final reservoirs stay intact until the temporal pass
+        const uint32_t historyArray = m_historyArrayIndex;
+        const uint32_t freeArray0 = (historyArray + 1) % NumReservoirArrays;
+        const uint32_t freeArray1 = (historyArray + 2) % NumReservoirArrays;
+
+        uint32_t currentArray = freeArray0;
+        GenerateInitialSamples(scene, current, frameIndex, currentArray);
+
+        if (m_settings.enableTemporalResampling && previous && m_historyValid)
+        {
+            TemporalResampling(scene, current, *previous, frameIndex, currentArray, historyArray, freeArray1);
+            currentArray = freeArray1;
+        }
+
+        if (m_settings.enableSpatialResampling)
+        {
+            const uint32_t outputArray = (currentArray == freeArray0) ? freeArray1 : freeArray0;
+            SpatialResampling(scene, current, frameIndex, currentArray, outputArray);
+            currentArray = outputArray;
+        }
+
+        ShadeSamples(scene, current, currentArray);
+
+        m_historyArrayIndex = currentArray;
+        m_historyValid = true;
+        m_statistics.visibilityRays = m_visibilityRays.load();
+    }
+
+    void ReSTIRDIPipeline::GenerateInitialSamples(const Scene& scene, const GBuffer& current, uint32_t frameIndex, uint32_t outputArray)
+    {
+        const uint32_t numSamples = m_settings.numLocalLightSamples;
+
+        m_statistics.initialSamplingTime = ForEachPixel([&](uint2 pixelPosition)
+        {
+            RAB_RandomSamplerState rng = RAB_InitRandomSampler(pixelPosition, frameIndex, 1);
+            const RAB_Surface surface = current.GetSurface(int2(pixelPosition));
+
+            DIReservoir state;
+            RAB_LightSample selectedSample;
+
+            if (RAB_IsSurfaceValid(surface) && numSamples > 0)
+            {
+                for (uint32_t i = 0; i < numSamples; i++)
+                {
+                    float sourcePdf;
+                    const uint32_t lightIndex = scene.SampleLocalLight(RAB_GetNextRandom(rng), sourcePdf);
+                    const float2 uv = float2(RAB_GetNextRandom(rng), RAB_GetNextRandom(rng));
+
+                    if (lightIndex == c_InvalidLightIndex || sourcePdf <= 0.f)
+                        continue;
+
+                    const RAB_LightSample candidateSample = RAB_SamplePolymorphicLight(scene.GetLights()[lightIndex], surface, uv);
+                    const float targetPdf = RAB_GetLightSampleTargetPdfForSurface(candidateSample, surface);
+
+                    if (RTXDI_StreamSample(state, lightIndex, uv, RAB_GetNextRandom(rng), targetPdf, 1.f / sourcePdf))
+                        selectedSample = candidateSample;
+                }
+
+                RTXDI_FinalizeResampling(state, 1.f, float(numSamples));
+                state.M = 1;
+
+                if (m_settings.enableInitialVisibility && RTXDI_IsValidDIReservoir(state))
+                {
+                    if (!GetVisibility(scene, surface, selectedSample.position))
+                        RTXDI_StoreVisibilityInDIReservoir(state, float3(0.f), true);
+                }
+            }
+
+            m_reservoirs.Store(state, pixelPosition, outputArray);
+        });
+    }
+
+    void ReSTIRDIPipeline::TemporalResampling(const Scene& scene, const GBuffer& current, const GBuffer& previous, uint32_t frameIndex,
+        uint32_t inputArray, uint32_t historyArray, uint32_t outputArray)
+    {
+        m_statistics.temporalResamplingTime = ForEachPixel([&](uint2 pixelPosition)
+        {
+            RAB_RandomSamplerState rng = RAB_InitRandomSampler(pixelPosition, frameIndex, 2);
+            const RAB_Surface surface = current.GetSurface(int2(pixelPosition));
+
+            DIReservoir state;
+
+            if (RAB_IsSurfaceValid(surface))
+            {
+                const DIReservoir curSample = m_reservoirs.Load(pixelPosition, inputArray);
+                const float historyLimit = std::min(float(c_PackedDIReservoirMaxM), float(m_settings.maxHistoryLength) * curSample.M);
+
+                state = CombineCenterSample(curSample);
+
+                // Backproject this pixel to last frame, with a random sub-pixel offset
+                float3 motion = current.motionVectors[size_t(pixelPosition.y) * m_viewportSize.x + pixelPosition.x];
+                motion.x += RAB_GetNextRandom(rng) - 0.5f;
+                motion.y += RAB_GetNextRandom(rng) - 0.5f;
+
+                int2 prevPos = int2(
+                    int(std::round(float(pixelPosition.x) + motion.x)),
+                    int(std::round(float(pixelPosition.y) + motion.y)));
+                const float expectedPrevLinearDepth = surface.viewDepth + motion.z;
+
+                // Try to find a matching surface in the neighborhood of the reprojected pixel
+                RAB_Surface temporalSurface;
+                bool foundNeighbor = false;
+                const float radius = 4.f;
+                int2 spatialOffset = int2(0, 0);
+
+                for (int i = 0; i < 9; i++)
+                {
+                    int2 offset = int2(0, 0);
+                    if (i > 0)
+                    {
+                        offset.x = int((RAB_GetNextRandom(rng) - 0.5f) * radius);
+                        offset.y = int((RAB_GetNextRandom(rng) - 0.5f) * radius);
+                    }
+
+                    const int2 idx = prevPos + offset;
+
+                    temporalSurface = previous.GetSurface(idx);
+                    if (!RAB_IsSurfaceValid(temporalSurface))
+                        continue;
+
+                    if (!RTXDI_IsValidNeighbor(surface.normal, temporalSurface.normal, expectedPrevLinearDepth, temporalSurface.viewDepth,
+                        m_settings.temporalNormalThreshold, m_settings.temporalDepthThreshold))
+                        continue;
+
+                    spatialOffset = idx - prevPos;
+                    prevPos = idx;
+                    foundNeighbor = true;
+                    break;
+                }
+
+                bool selectedPreviousSample = false;
+                float previousM = 0.f;
+
+                if (foundNeighbor)
+                {
+                    DIReservoir prevSample = m_reservoirs.Load(uint2(prevPos), historyArray);
+                    prevSample.M = std::min(prevSample.M, historyLimit);
+                    prevSample.spatialDistance += spatialOffset;
+                    prevSample.age += 1;
+
+                    // The scene is static, so light indices don't need to be translated between frames
+                    previousM = prevSample.M;
+
+                    float weightAtCurrent = 0.f;
+                    if (RTXDI_IsValidDIReservoir(prevSample))
+                    {
+                        const RAB_LightInfo& candidateLight = scene.GetLights()[RTXDI_GetDIReservoirLightIndex(prevSample)];
+                        const RAB_LightSample candidateSample = RAB_SamplePolymorphicLight(candidateLight, surface, RTXDI_GetDIReservoirSampleUV(prevSample));
+                        weightAtCurrent = RAB_GetLightSampleTargetPdfForSurface(candidateSample, surface);
+                    }
+
+                    selectedPreviousSample = RTXDI_CombineDIReservoirs(state, prevSample, RAB_GetNextRandom(rng), weightAtCurrent);
+                }
+
+                if (m_settings.temporalBiasCorrection != BiasCorrection::Off && foundNeighbor)
+                {
+                    // Compute the unbiased normalization term (instead of using 1/M)
+                    float pi = state.targetPdf;
+                    float piSum = state.targetPdf * curSample.M;
+
+                    if (RTXDI_IsValidDIReservoir(state))
+                    {
+                        const RAB_LightInfo& selectedLight = scene.GetLights()[RTXDI_GetDIReservoirLightIndex(state)];
+                        const RAB_LightSample selectedSample = RAB_SamplePolymorphicLight(selectedLight, temporalSurface, RTXDI_GetDIReservoirSampleUV(state));
+                        float temporalP = RAB_GetLightSampleTargetPdfForSurface(selectedSample, temporalSurface);
+
+                        if (m_settings.temporalBiasCorrection == BiasCorrection::RayTraced && temporalP > 0)
+                        {
+                            if (!GetVisibility(scene, temporalSurface, selectedSample.position))
+                                temporalP = 0;
+                        }
+
+                        pi = selectedPreviousSample ? temporalP : pi;
+                        piSum += temporalP * previousM;
+                    }
+
+                    RTXDI_FinalizeResampling(state, pi, piSum);
+                }
+                else
+                {
+                    RTXDI_FinalizeResampling(state, 1.f, state.M);
+                }
+            }
+
+            m_reservoirs.Store(state, pixelPosition, outputArray);
+        });
+    }
+
+    void ReSTIRDIPipeline::SpatialResampling(const Scene& scene, const GBuffer& current, uint32_t frameIndex, uint32_t inputArray, uint32_t outputArray)
+    {
+        const std::vector<float2>& neighborOffsets = GetNeighborOffsets();
+        const uint32_t neighborOffsetMask = c_NeighborOffsetCount - 1;
+
+        m_statistics.spatialResamplingTime = ForEachPixel([&](uint2 pixelPosition)
+        {
+            RAB_RandomSamplerState rng = RAB_InitRandomSampler(pixelPosition, frameIndex, 3);
+            const RAB_Surface surface = current.GetSurface(int2(pixelPosition));
+
+            DIReservoir state;
+
+            if (RAB_IsSurfaceValid(surface))
+            {
+                const DIReservoir centerSample = m_reservoirs.Load(pixelPosition, inputArray);
+
+                uint32_t numSamples = m_settings.numSpatialSamples;
+                if (centerSample.M < float(m_settings.maxHistoryLength))
+                    numSamples = std::max(numSamples, m_settings.numDisocclusionBoostSamples);
+                numSamples = std::min(numSamples, c_MaxSpatialSamples);
+
+                state = CombineCenterSample(centerSample);
+
+                const uint32_t startIdx = uint32_t(RAB_GetNextRandom(rng) * float(neighborOffsetMask));
+                uint32_t cachedResult = 0;
+                int selected = -1;
+
+                for (uint32_t i = 0; i < numSamples; i++)
+                {
+                    const float2 offset = neighborOffsets[(startIdx + i) & neighborOffsetMask] * m_settings.spatialSamplingRadius;
+                    const int2 spatialOffset = int2(int(offset.x), int(offset.y));
+                    const int2 idx = ClampSamplePositionIntoView(int2(pixelPosition) + spatialOffset, m_viewportSize);
+
+                    const RAB_Surface neighborSurface = current.GetSurface(idx);
+                    if (!RAB_IsSurfaceValid(neighborSurface))
+                        continue;
+
+                    if (!RTXDI_IsValidNeighbor(surface.normal, neighborSurface.normal, surface.viewDepth, neighborSurface.viewDepth,
+                        m_settings.spatialNormalThreshold, m_settings.spatialDepthThreshold))
+                        continue;
+
+                    if (!RAB_AreMaterialsSimilar(surface.material, neighborSurface.material))
+                        continue;
+
+                    cachedResult |= (1u << i);
+
+                    DIReservoir neighborSample = m_reservoirs.Load(uint2(idx), inputArray);
+                    neighborSample.spatialDistance += spatialOffset;
+
+                    float targetPdf = 0.f;
+                    if (RTXDI_IsValidDIReservoir(neighborSample))
+                    {
+                        const RAB_LightInfo& candidateLight = scene.GetLights()[RTXDI_GetDIReservoirLightIndex(neighborSample)];
+                        const RAB_LightSample candidateSample = RAB_SamplePolymorphicLight(candidateLight, surface, RTXDI_GetDIReservoirSampleUV(neighborSample));
+                        targetPdf = RAB_GetLightSampleTargetPdfForSurface(candidateSample, surface);
+                    }
+
+                    if (RTXDI_CombineDIReservoirs(state, neighborSample, RAB_GetNextRandom(rng), targetPdf))
+                        selected = int(i);
+                }
+
+                if (m_settings.spatialBiasCorrection != BiasCorrection::Off)
+                {
+                    // Compute the unbiased normalization term (instead of using 1/M)
+                    float pi = state.targetPdf;
+                    float piSum = state.targetPdf * centerSample.M;
+
+                    if (RTXDI_IsValidDIReservoir(state))
+                    {
+                        const RAB_LightInfo& selectedLight = scene.GetLights()[RTXDI_GetDIReservoirLightIndex(state)];
+
+                        for (uint32_t i = 0; i < numSamples; i++)
+                        {
+                            if ((cachedResult & (1u << i)) == 0)
+                                continue;
+
+                            const float2 offset = neighborOffsets[(startIdx + i) & neighborOffsetMask] * m_settings.spatialSamplingRadius;
+                            const int2 idx = ClampSamplePositionIntoView(int2(pixelPosition) + int2(int(offset.x), int(offset.y)), m_viewportSize);
+                            const RAB_Surface neighborSurface = current.GetSurface(idx);
+
+                            const RAB_LightSample selectedSample = RAB_SamplePolymorphicLight(selectedLight, neighborSurface, RTXDI_GetDIReservoirSampleUV(state));
+                            float ps = RAB_GetLightSampleTargetPdfForSurface(selectedSample, neighborSurface);
+
+                            if (m_settings.spatialBiasCorrection == BiasCorrection::RayTraced && ps > 0 && selected != int(i))
+                            {
+                                if (!GetVisibility(scene, neighborSurface, selectedSample.position))
+                                    ps = 0;
+                            }
+
+                            const DIReservoir neighborSample = m_reservoirs.Load(uint2(idx), inputArray);
+
+                            pi = (selected == int(i)) ? ps : pi;
+                            piSum += ps * neighborSample.M;
+                        }
+                    }
+
+                    RTXDI_FinalizeResampling(state, pi, piSum);
+                }
+                else
+                {
+                    RTXDI_FinalizeResampling(state, 1.f, state.M);
+                }
+            }
+
+            m_reservoirs.Store(state, pixelPosition, outputArray);
+        });
+    }
+
+    void ReSTIRDIPipeline::ShadeSamples(const Scene& scene, const GBuffer& current, uint32_t inputArray)
+    {
+        m_statistics.shadingTime = ForEachPixel([&](uint2 pixelPosition)
+        {
+            const size_t pixelIndex = size_t(pixelPosition.y) * m_viewportSize.x + pixelPosition.x;
+            const RAB_Surface surface = current.GetSurface(int2(pixelPosition));
+            DIReservoir reservoir = m_reservoirs.Load(pixelPosition, inputArray);
+
+            float3 diffuse = float3(0.f);
+            float3 specular = float3(0.f);
+
+            if (RAB_IsSurfaceValid(surface) && RTXDI_IsValidDIReservoir(reservoir))
+            {
+                const RAB_LightInfo& lightInfo = scene.GetLights()[RTXDI_GetDIReservoirLightIndex(reservoir)];
+                RAB_LightSample lightSample = RAB_SamplePolymorphicLight(lightInfo, surface, RTXDI_GetDIReservoirSampleUV(reservoir));
+
+                if (lightSample.solidAnglePdf > 0)
+                {
+                    if (m_settings.enableFinalVisibility)
+                    {
+                        const float3 visibility = float3(GetVisibility(scene, surface, lightSample.position) ? 1.f : 0.f);
+                        RTXDI_StoreVisibilityInDIReservoir(reservoir, visibility, m_settings.discardInvisibleSamples);
+                        m_reservoirs.Store(reservoir, pixelPosition, inputArray);
+
+                        lightSample.radiance *= visibility;
+                    }
+
+                    lightSample.radiance *= RTXDI_GetDIReservoirInvPdf(reservoir) / lightSample.solidAnglePdf;
+
+                    if (lightSample.radiance.x > 0 || lightSample.radiance.y > 0 || lightSample.radiance.z > 0)
+                    {
+                        const SplitBrdf brdf = EvaluateBrdf(surface, lightSample.position);
+
+                        diffuse = brdf.demodulatedDiffuse * lightSample.radiance;
+                        specular = brdf.specular * lightSample.radiance;
+                    }
+                }
+            }
+
+            m_diffuse[pixelIndex] = diffuse;
+            m_specular[pixelIndex] = specular;
+        });
+    }
+}
@@ -0,0 +1,131 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "Reservoir.h"
+#include "Scene.h"
+
+#include <atomic>
+#include <functional>
+
+namespace tf
+{
+    class Executor;
+}
+
+namespace cpuref
+{
+    // Same values as RTXDI_BIAS_CORRECTION_*. Pairwise MIS is not implemented and behaves like Basic.
+    enum class BiasCorrection : uint32_t
+    {
+        Off = 0,
+        Basic = 1,
+        Pairwise = 2,
+        RayTraced = 3
+    };
+
+    struct ReSTIRDISettings
+    {
+        // Initial sampling, local lights only
+        uint32_t numLocalLightSamples = 8;
+        bool enableInitialVisibility = true;
+
+        // Temporal resampling
+        bool enableTemporalResampling = true;
+        uint32_t maxHistoryLength = 20;
+        BiasCorrection temporalBiasCorrection = BiasCorrection::Basic;
+        float temporalDepthThreshold = 0.1f;
+        float temporalNormalThreshold = 0.5f;
+        bool discardInvisibleSamples = false;
+
+        // Spatial resampling
+        bool enableSpatialResampling = true;
+        uint32_t numSpatialSamples = 1;
+        uint32_t numDisocclusionBoostSamples = 8;
+        BiasCorrection spatialBiasCorrection = BiasCorrection::Basic;
+        float spatialSamplingRadius = 32.f;
+        float spatialDepthThreshold = 0.1f;
+        float spatialNormalThreshold = 0.5f;
+
+        // Shading
+        bool enableFinalVisibility = true;
+    };
+
+    struct ReSTIRDIStatistics
+    {
+        // Wall-clock times of the passes, in milliseconds
+        double initialSamplingTime = 0.0;
+        double temporalResamplingTime = 0.0;
+        double spatialResamplingTime = 0.0;
+        double shadingTime = 0.0;
+
+        uint64_t visibilityRays = 0;
+    };
+
+    // CPU implementation of the ReSTIR DI passes of the full sample: GenerateInitialSamples,
+    // TemporalResampling, SpatialResampling and ShadeSamples, following the RTXDI resampling functions.
+    // The screen is processed in 16x16 tiles that are distributed across the executor's threads.
+    // Reservoirs are stored with the same packing and block layout as on the GPU, in 3 arrays
+    // that are rotated between the passes and frames.
+    class ReSTIRDIPipeline
+    {
+    public:
+        static constexpr uint32_t NumReservoirArrays = 3;
+        static constexpr uint32_t TileSize = 16;
+
+        // The executor may be null, in which case all tiles are processed on the calling thread.
+        ReSTIRDIPipeline(donut::math::uint2 viewportSize, tf::Executor* executor);
+
+        void SetSettings(const ReSTIRDISettings& settings) { m_settings = settings; }
+        [[nodiscard]] const ReSTIRDISettings& GetSettings() const { return m_settings; }
+
+        // Renders one frame. 'previous' is the G-buffer of the previous frame, or null on the first frame.
+        void Render(const Scene& scene, const GBuffer& current, const GBuffer* previous, uint32_t frameIndex);
+
+        [[nodiscard]] const ReservoirBuffer& GetReservoirs() const { return m_reservoirs; }
+
+        // Index of the reservoir array that was used for shading in the last frame.
+        [[nodiscard]] uint32_t GetShadingArrayIndex() const { return m_historyArrayIndex; }
+
+        // Demodulated diffuse and full specular lighting, like the ShadeSamples outputs without denoiser packing.
+        [[nodiscard]] const std::vector<donut::math::float3>& GetDiffuseOutput() const { return m_diffuse; }
+        [[nodiscard]] const std::vector<donut::math::float3>& GetSpecularOutput() const { return m_specular; }
+
+        [[nodiscard]] const ReSTIRDIStatistics& GetStatistics() const { return m_statistics; }
+
+    private:
+        typedef std::function<void(donut::math::uint2 pixelPosition)> PixelCallback;
+
+        // Runs the callback for every pixel, tile by tile, and returns the elapsed time in milliseconds.
+        double ForEachPixel(const PixelCallback& callback);
+
+        void GenerateInitialSamples(const Scene& scene, const GBuffer& current, uint32_t frameIndex, uint32_t outputArray);
+        void TemporalResampling(const Scene& scene, const GBuffer& current, const GBuffer& previous, uint32_t frameIndex,
+            uint32_t inputArray, uint32_t historyArray, uint32_t outputArray);
+        void SpatialResampling(const Scene& scene, const GBuffer& current, uint32_t frameIndex, uint32_t inputArray, uint32_t outputArray);
+        void ShadeSamples(const Scene& scene, const GBuffer& current, uint32_t inputArray);
+
+        bool GetVisibility(const Scene& scene, const RAB_Surface& surface, donut::math::float3 samplePosition);
+
+        donut::math::uint2 m_viewportSize;
+        tf::Executor* m_executor;
+        ReSTIRDISettings m_settings;
+        ReSTIRDIStatistics m_statistics;
+        std::atomic<uint64_t> m_visibilityRays = 0;
+
+        ReservoirBuffer m_reservoirs;
+        uint32_t m_historyArrayIndex = 0;
+        bool m_historyValid = false;
+
+        std::vector<donut::math::float3> m_diffuse;
+        std::vector<donut::math::float3> m_specular;
+    };
+}
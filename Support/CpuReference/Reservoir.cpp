@@ -0,0 +1,174 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Reservoir.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace donut::math;
+
+namespace cpuref
+{
+    float2 RTXDI_GetDIReservoirSampleUV(const DIReservoir& reservoir)
+    {
+        return float2(float(reservoir.uvData & 0xffff), float(reservoir.uvData >> 16)) / float(0xffff);
+    }
+
+    float RTXDI_GetDIReservoirInvPdf(const DIReservoir& reservoir)
+    {
+        return reservoir.weightSum;
+    }
+
+    static uint32_t PackUV(float2 uv)
+    {
+        return uint32_t(saturate(uv.x) * 0xffff) | (uint32_t(saturate(uv.y) * 0xffff) << 16);
+    }
+
+    bool RTXDI_StreamSample(DIReservoir& reservoir, uint32_t lightIndex, float2 uv, float random, float targetPdf, float invSourcePdf)
+    {
+        // What's the current weight
+        const float risWeight = targetPdf * invSourcePdf;
+
+        reservoir.M += 1;
+        reservoir.weightSum += risWeight;
+
+        const bool selectSample = (random * reservoir.weightSum < risWeight);
+        if (selectSample)
+        {
+            reservoir.lightData = lightIndex | c_DIReservoirLightValidBit;
+            reservoir.uvData = PackUV(uv);
+            reservoir.targetPdf = targetPdf;
+        }
+
+        return selectSample;
+    }
+
+    bool RTXDI_CombineDIReservoirs(DIReservoir& reservoir, const DIReservoir& newReservoir, float random, float targetPdf)
+    {
+        // What's the current weight (times any prior-step RIS normalization factor)
+        const float risWeight = targetPdf * newReservoir.weightSum * newReservoir.M;
+
+        reservoir.M += newReservoir.M;
+        reservoir.weightSum += risWeight;
+
+        const bool selectSample = (random * reservoir.weightSum < risWeight);
+        if (selectSample)
+        {
+            reservoir.lightData = newReservoir.lightData;
+            reservoir.uvData = newReservoir.uvData;
+            reservoir.targetPdf = targetPdf;
+            reservoir.packedVisibility = newReservoir.packedVisibility;
+            reservoir.spatialDistance = newReservoir.spatialDistance;
+            reservoir.age = newReservoir.age;
+        }
+
+        return selectSample;
+    }
+
+    void RTXDI_FinalizeResampling(DIReservoir& reservoir, float normalizationNumerator, float normalizationDenominator)
+    {
+        const float denominator = reservoir.targetPdf * normalizationDenominator;
+
+        reservoir.weightSum = (denominator == 0.f) ? 0.f : (reservoir.weightSum * normalizationNumerator) / denominator;
+    }
+
+    void RTXDI_StoreVisibilityInDIReservoir(DIReservoir& reservoir, float3 visibility, bool discardIfInvisible)
+    {
+        reservoir.packedVisibility = uint32_t(saturate(visibility.x) * c_PackedDIReservoirVisibilityChannelMax)
+            | (uint32_t(saturate(visibility.y) * c_PackedDIReservoirVisibilityChannelMax) << c_PackedDIReservoirVisibilityChannelShift)
+            | (uint32_t(saturate(visibility.z) * c_PackedDIReservoirVisibilityChannelMax) << (c_PackedDIReservoirVisibilityChannelShift * 2));
+
+        reservoir.spatialDistance = int2(0, 0);
+        reservoir.age = 0;
+
+        if (discardIfInvisible && visibility.x == 0 && visibility.y == 0 && visibility.z == 0)
+        {
+            reservoir.weightSum = 0;
+        }
+    }
+
+    PackedDIReservoir RTXDI_PackDIReservoir(const DIReservoir& reservoir)
+    {
+        const int2 clampedSpatialDistance = clamp(reservoir.spatialDistance, int2(-c_PackedDIReservoirMaxDistance), int2(c_PackedDIReservoirMaxDistance));
+        const uint32_t clampedAge = std::min(reservoir.age, c_PackedDIReservoirMaxAge);
+
+        PackedDIReservoir data;
+        data.lightData = reservoir.lightData;
+        data.uvData = reservoir.uvData;
+
+        data.mVisibility = (reservoir.packedVisibility & c_PackedDIReservoirVisibilityMask)
+            | (std::min(uint32_t(reservoir.M), c_PackedDIReservoirMaxM) << c_PackedDIReservoirMShift);
+
+        data.distanceAge =
+            ((uint32_t(clampedSpatialDistance.x) & c_PackedDIReservoirDistanceMask) << c_PackedDIReservoirDistanceXShift)
+            | ((uint32_t(clampedSpatialDistance.y) & c_PackedDIReservoirDistanceMask) << c_PackedDIReservoirDistanceYShift)
+            | (clampedAge << c_PackedDIReservoirAgeShift);
+
+        data.targetPdf = reservoir.targetPdf;
+        data.weight = reservoir.weightSum;
+
+        return data;
+    }
+
+    DIReservoir RTXDI_UnpackDIReservoir(const PackedDIReservoir& data)
+    {
+        DIReservoir reservoir;
+        reservoir.lightData = data.lightData;
+        reservoir.uvData = data.uvData;
+        reservoir.targetPdf = data.targetPdf;
+        reservoir.weightSum = data.weight;
+        reservoir.M = float(data.mVisibility >> c_PackedDIReservoirMShift);
+        reservoir.packedVisibility = data.mVisibility & c_PackedDIReservoirVisibilityMask;
+
+        // Sign extend the shift values
+        reservoir.spatialDistance.x = int(int8_t((data.distanceAge >> c_PackedDIReservoirDistanceXShift) & c_PackedDIReservoirDistanceMask));
+        reservoir.spatialDistance.y = int(int8_t((data.distanceAge >> c_PackedDIReservoirDistanceYShift) & c_PackedDIReservoirDistanceMask));
+        reservoir.age = (data.distanceAge >> c_PackedDIReservoirAgeShift) & c_PackedDIReservoirMaxAge;
+
+        // Discard reservoirs that have Inf/NaN
+        if (!std::isfinite(reservoir.weightSum))
+            reservoir = DIReservoir();
+
+        return reservoir;
+    }
+
+    ReservoirBuffer::ReservoirBuffer(uint32_t width, uint32_t height, uint32_t numArrays)
+    {
+        const uint32_t blocksX = (width + c_ReservoirBlockSize - 1) / c_ReservoirBlockSize;
+        const uint32_t blocksY = (height + c_ReservoirBlockSize - 1) / c_ReservoirBlockSize;
+
+        m_blockRowPitch = blocksX * c_ReservoirBlockSize * c_ReservoirBlockSize;
+        m_arrayPitch = m_blockRowPitch * blocksY;
+        m_data.resize(size_t(m_arrayPitch) * numArrays, RTXDI_PackDIReservoir(DIReservoir()));
+    }
+
+    uint32_t ReservoirBuffer::PositionToPointer(uint2 reservoirPosition, uint32_t arrayIndex) const
+    {
+        const uint2 blockIdx = uint2(reservoirPosition.x / c_ReservoirBlockSize, reservoirPosition.y / c_ReservoirBlockSize);
+        const uint2 positionInBlock = uint2(reservoirPosition.x % c_ReservoirBlockSize, reservoirPosition.y % c_ReservoirBlockSize);
+
+        return arrayIndex * m_arrayPitch
+            + blockIdx.y * m_blockRowPitch
+            + blockIdx.x * (c_ReservoirBlockSize * c_ReservoirBlockSize)
+            + positionInBlock.y * c_ReservoirBlockSize
+            + positionInBlock.x;
+    }
+
+    DIReservoir ReservoirBuffer::Load(uint2 reservoirPosition, uint32_t arrayIndex) const
+    {
+        return RTXDI_UnpackDIReservoir(m_data[PositionToPointer(reservoirPosition, arrayIndex)]);
+    }
+
+    void ReservoirBuffer::Store(const DIReservoir& reservoir, uint2 reservoirPosition, uint32_t arrayIndex)
+    {
+        m_data[PositionToPointer(reservoirPosition, arrayIndex)] = RTXDI_PackDIReservoir(reservoir);
+    }
+}
@@ -0,0 +1,101 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <cstdint>
+#include <vector>
+
+namespace cpuref
+{
+    // Unpacked reservoir, same fields as RTXDI_DIReservoir.
+    struct DIReservoir
+    {
+        uint32_t lightData = 0;
+        uint32_t uvData = 0;
+        float weightSum = 0.f;
+        float targetPdf = 0.f;
+        float M = 0.f;
+        uint32_t packedVisibility = 0;
+        donut::math::int2 spatialDistance = donut::math::int2(0, 0);
+        uint32_t age = 0;
+        float canonicalWeight = 0.f;
+    };
+
+    // Packed reservoir with the same 24-byte layout as RTXDI_PackedDIReservoir,
+    // so that the buffers can be compared with GPU captures of RtxdiResources::LightReservoirBuffer.
+    struct PackedDIReservoir
+    {
+        uint32_t lightData;
+        uint32_t uvData;
+        uint32_t mVisibility;
+        uint32_t distanceAge;
+        float targetPdf;
+        float weight;
+    };
+    static_assert(sizeof(PackedDIReservoir) == 24);
+
+    constexpr uint32_t c_DIReservoirLightValidBit = 0x80000000;
+    constexpr uint32_t c_DIReservoirLightIndexMask = 0x7FFFFFFF;
+    constexpr uint32_t c_ReservoirBlockSize = 16; // RTXDI_RESERVOIR_BLOCK_SIZE
+
+    // Bit layout of PackedDIReservoir, same as the RTXDI_PackedDIReservoir_* constants.
+    // mVisibility holds 3x6 bits of visibility in the low bits and M above them.
+    constexpr uint32_t c_PackedDIReservoirVisibilityMask = 0x3ffff;
+    constexpr uint32_t c_PackedDIReservoirVisibilityChannelMax = 0x3f;
+    constexpr uint32_t c_PackedDIReservoirVisibilityChannelShift = 6;
+    constexpr uint32_t c_PackedDIReservoirMShift = 18;
+    constexpr uint32_t c_PackedDIReservoirMaxM = 0x3fff;
+
+    // distanceAge holds the signed spatial distance in the low 16 bits and the age above them.
+    constexpr uint32_t c_PackedDIReservoirDistanceChannelBits = 8;
+    constexpr uint32_t c_PackedDIReservoirDistanceXShift = 0;
+    constexpr uint32_t c_PackedDIReservoirDistanceYShift = 8;
+    constexpr uint32_t c_PackedDIReservoirAgeShift = 16;
+    constexpr uint32_t c_PackedDIReservoirMaxAge = 0xff;
+    constexpr uint32_t c_PackedDIReservoirDistanceMask = (1u << c_PackedDIReservoirDistanceChannelBits) - 1;
+    constexpr int c_PackedDIReservoirMaxDistance = int((1u << (c_PackedDIReservoirDistanceChannelBits - 1)) - 1);
+
+    inline bool RTXDI_IsValidDIReservoir(const DIReservoir& reservoir) { return reservoir.lightData != 0; }
+    inline uint32_t RTXDI_GetDIReservoirLightIndex(const DIReservoir& reservoir) { return reservoir.lightData & c_DIReservoirLightIndexMask; }
+    donut::math::float2 RTXDI_GetDIReservoirSampleUV(const DIReservoir& reservoir);
+    float RTXDI_GetDIReservoirInvPdf(const DIReservoir& reservoir);
+
+    bool RTXDI_StreamSample(DIReservoir& reservoir, uint32_t lightIndex, donut::math::float2 uv, float random, float targetPdf, float invSourcePdf);
+    bool RTXDI_CombineDIReservoirs(DIReservoir& reservoir, const DIReservoir& newReservoir, float random, float targetPdf);
+    void RTXDI_FinalizeResampling(DIReservoir& reservoir, float normalizationNumerator, float normalizationDenominator);
+    void RTXDI_StoreVisibilityInDIReservoir(DIReservoir& reservoir, donut::math::float3 visibility, bool discardIfInvisible);
+
+    PackedDIReservoir RTXDI_PackDIReservoir(const DIReservoir& reservoir);
+    DIReservoir RTXDI_UnpackDIReservoir(const PackedDIReservoir& data);
+
+    // Storage for one or more reservoir arrays, addressed in 16x16 blocks like RTXDI_DIReservoirBufferParameters.
+    class ReservoirBuffer
+    {
+    public:
+        ReservoirBuffer(uint32_t width, uint32_t height, uint32_t numArrays);
+
+        [[nodiscard]] uint32_t PositionToPointer(donut::math::uint2 reservoirPosition, uint32_t arrayIndex) const;
+
+        [[nodiscard]] DIReservoir Load(donut::math::uint2 reservoirPosition, uint32_t arrayIndex) const;
+        void Store(const DIReservoir& reservoir, donut::math::uint2 reservoirPosition, uint32_t arrayIndex);
+
+        [[nodiscard]] uint32_t GetBlockRowPitch() const { return m_blockRowPitch; }
+        [[nodiscard]] uint32_t GetArrayPitch() const { return m_arrayPitch; }
+        [[nodiscard]] const std::vector<PackedDIReservoir>& GetData() const { return m_data; }
+        [[nodiscard]] std::vector<PackedDIReservoir>& GetData() { return m_data; }
+
+    private:
+        uint32_t m_blockRowPitch;
+        uint32_t m_arrayPitch;
+        std::vector<PackedDIReservoir> m_data;
+    };
+}
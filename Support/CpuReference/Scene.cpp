@@ -0,0 +1,181 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Scene.h"
+
+#include <taskflow/taskflow.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace donut::math;
+
+namespace cpuref
+{
+    Ray Camera::GeneratePrimaryRay(float2 pixelPosition, uint2 viewportSize) const
+    {
+        const float3 right = normalize(cross(up, forward));
+        const float3 trueUp = cross(forward, right);
+        const float tanHalfFov = std::tan(verticalFov * 0.5f);
+        const float aspectRatio = float(viewportSize.x) / float(viewportSize.y);
+
+        const float2 ndc = float2(
+            (pixelPosition.x / float(viewportSize.x)) * 2.f - 1.f,
+            1.f - (pixelPosition.y / float(viewportSize.y)) * 2.f);
+
+        Ray ray;
+        ray.origin = position;
+        ray.direction = normalize(forward + right * (ndc.x * tanHalfFov * aspectRatio) + trueUp * (ndc.y * tanHalfFov));
+        ray.tMin = 0.f;
+        ray.tMax = c_BackgroundDepth;
+        return ray;
+    }
+
+    float2 Camera::ProjectToPixel(float3 worldPos, uint2 viewportSize, float& viewDepth) const
+    {
+        const float3 right = normalize(cross(up, forward));
+        const float3 trueUp = cross(forward, right);
+        const float tanHalfFov = std::tan(verticalFov * 0.5f);
+        const float aspectRatio = float(viewportSize.x) / float(viewportSize.y);
+
+        const float3 toPoint = worldPos - position;
+        viewDepth = dot(toPoint, forward);
+        if (viewDepth <= 0.f)
+            return float2(-1.f);
+
+        const float2 ndc = float2(
+            dot(toPoint, right) / (viewDepth * tanHalfFov * aspectRatio),
+            dot(toPoint, trueUp) / (viewDepth * tanHalfFov));
+
+        return float2(
+            (ndc.x * 0.5f + 0.5f) * float(viewportSize.x),
+            (0.5f - ndc.y * 0.5f) * float(viewportSize.y));
+    }
+
+    RAB_Surface GBuffer::GetSurface(int2 pixelPosition) const
+    {
+        if (pixelPosition.x < 0 || pixelPosition.y < 0 || pixelPosition.x >= int(viewportSize.x) || pixelPosition.y >= int(viewportSize.y))
+            return RAB_Surface();
+
+        return surfaces[size_t(pixelPosition.y) * viewportSize.x + pixelPosition.x];
+    }
+
+    void Scene::AddTriangle(float3 a, float3 b, float3 c, const RAB_Material& material, float3 emission)
+    {
+        m_positions.push_back(a);
+        m_positions.push_back(b);
+        m_positions.push_back(c);
+        m_materials.push_back(material);
+        m_emissions.push_back(emission);
+    }
+
+    void Scene::AddQuad(float3 origin, float3 edge1, float3 edge2, const RAB_Material& material, float3 emission)
+    {
+        AddTriangle(origin, origin + edge1, origin + edge1 + edge2, material, emission);
+        AddTriangle(origin, origin + edge1 + edge2, origin + edge2, material, emission);
+    }
+
+    void Scene::Finalize()
+    {
+        m_bvh.Build(m_positions);
+
+        m_lights.clear();
+        m_lightCdf.clear();
+        m_totalLightPower = 0.f;
+
+        for (size_t triangle = 0; triangle < m_emissions.size(); triangle++)
+        {
+            const float3 emission = m_emissions[triangle];
+            if (emission.x <= 0.f && emission.y <= 0.f && emission.z <= 0.f)
+                continue;
+
+            const RAB_LightInfo light = CreateTriangleLight(m_positions[triangle * 3 + 0], m_positions[triangle * 3 + 1],
+                m_positions[triangle * 3 + 2], emission);
+
+            m_totalLightPower += GetLightPower(light);
+            m_lights.push_back(light);
+            m_lightCdf.push_back(m_totalLightPower);
+        }
+    }
+
+    uint32_t Scene::SampleLocalLight(float random, float& sourcePdf) const
+    {
+        sourcePdf = 0.f;
+        if (m_lights.empty() || m_totalLightPower <= 0.f)
+            return c_InvalidLightIndex;
+
+        const float target = random * m_totalLightPower;
+        const auto found = std::upper_bound(m_lightCdf.begin(), m_lightCdf.end(), target);
+        const uint32_t lightIndex = std::min(uint32_t(found - m_lightCdf.begin()), uint32_t(m_lights.size() - 1));
+
+        sourcePdf = GetLightPower(m_lights[lightIndex]) / m_totalLightPower;
+        return lightIndex;
+    }
+
+    GBuffer Scene::RenderGBuffer(const Camera& camera, const Camera* previousCamera, uint2 viewportSize, tf::Executor* executor) const
+    {
+        GBuffer gbuffer;
+        gbuffer.viewportSize = viewportSize;
+        gbuffer.surfaces.resize(size_t(viewportSize.x) * viewportSize.y);
+        gbuffer.motionVectors.resize(gbuffer.surfaces.size(), float3(0.f));
+
+        auto renderRow = [this, &camera, previousCamera, viewportSize, &gbuffer](uint32_t y)
+        {
+            for (uint32_t x = 0; x < viewportSize.x; x++)
+            {
+                const size_t pixelIndex = size_t(y) * viewportSize.x + x;
+                const Ray ray = camera.GeneratePrimaryRay(float2(float(x) + 0.5f, float(y) + 0.5f), viewportSize);
+                const RayHit hit = m_bvh.Intersect(ray);
+
+                if (!hit.IsValid())
+                    continue;
+
+                const float3 a = m_positions[hit.triangleIndex * 3 + 0];
+                const float3 b = m_positions[hit.triangleIndex * 3 + 1];
+                const float3 c = m_positions[hit.triangleIndex * 3 + 2];
+
+                RAB_Surface& surface = gbuffer.surfaces[pixelIndex];
+                surface.worldPos = ray.origin + ray.direction * hit.t;
+                surface.viewDepth = dot(surface.worldPos - camera.position, camera.forward);
+                surface.viewDir = -ray.direction;
+                surface.geoNormal = normalize(cross(b - a, c - a));
+                if (dot(surface.geoNormal, surface.viewDir) < 0.f)
+                    surface.geoNormal = -surface.geoNormal;
+                surface.normal = surface.geoNormal;
+                surface.material = m_materials[hit.triangleIndex];
+                surface.diffuseProbability = getSurfaceDiffuseProbability(surface);
+
+                if (previousCamera)
+                {
+                    float previousViewDepth;
+                    const float2 previousPixel = previousCamera->ProjectToPixel(surface.worldPos, viewportSize, previousViewDepth);
+                    gbuffer.motionVectors[pixelIndex] = float3(
+                        previousPixel.x - (float(x) + 0.5f),
+                        previousPixel.y - (float(y) + 0.5f),
+                        previousViewDepth - surface.viewDepth);
+                }
+            }
+        };
+
+        if (executor)
+        {
+            tf::Taskflow taskflow;
+            taskflow.for_each_index(0u, viewportSize.y, 1u, renderRow);
+            executor->run(taskflow).wait();
+        }
+        else
+        {
+            for (uint32_t y = 0; y < viewportSize.y; y++)
+                renderRow(y);
+        }
+
+        return gbuffer;
+    }
+}
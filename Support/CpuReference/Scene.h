@@ -0,0 +1,85 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "ApplicationBridge.h"
+
+namespace tf
+{
+    class Executor;
+}
+
+namespace cpuref
+{
+    struct Camera
+    {
+        donut::math::float3 position = donut::math::float3(0.f);
+        donut::math::float3 forward = donut::math::float3(0.f, 0.f, 1.f);
+        donut::math::float3 up = donut::math::float3(0.f, 1.f, 0.f);
+        float verticalFov = 1.f; // radians
+
+        [[nodiscard]] Ray GeneratePrimaryRay(donut::math::float2 pixelPosition, donut::math::uint2 viewportSize) const;
+
+        // Returns the pixel position of a world position, and its view depth in 'viewDepth'.
+        [[nodiscard]] donut::math::float2 ProjectToPixel(donut::math::float3 worldPos, donut::math::uint2 viewportSize, float& viewDepth) const;
+    };
+
+    // Equivalent of the G-buffer textures, already decoded into surfaces like RAB_GetGBufferSurface does.
+    struct GBuffer
+    {
+        donut::math::uint2 viewportSize = donut::math::uint2(0, 0);
+        std::vector<RAB_Surface> surfaces;
+
+        // Pixel space motion into the previous frame in .xy, view depth difference in .z,
+        // i.e. the output of convertMotionVectorToPixelSpace.
+        std::vector<donut::math::float3> motionVectors;
+
+        // Returns an invalid surface for positions outside of the viewport.
+        [[nodiscard]] RAB_Surface GetSurface(donut::math::int2 pixelPosition) const;
+    };
+
+    // A static triangle soup with per-triangle materials. Emissive triangles become triangle lights.
+    class Scene
+    {
+    public:
+        void AddTriangle(donut::math::float3 a, donut::math::float3 b, donut::math::float3 c,
+            const RAB_Material& material, donut::math::float3 emission = donut::math::float3(0.f));
+
+        void AddQuad(donut::math::float3 origin, donut::math::float3 edge1, donut::math::float3 edge2,
+            const RAB_Material& material, donut::math::float3 emission = donut::math::float3(0.f));
+
+        // Builds the BVH, the light list and the power-based light sampling distribution.
+        void Finalize();
+
+        [[nodiscard]] const Bvh& GetBvh() const { return m_bvh; }
+        [[nodiscard]] const std::vector<RAB_LightInfo>& GetLights() const { return m_lights; }
+        [[nodiscard]] uint32_t GetTriangleCount() const { return uint32_t(m_materials.size()); }
+
+        // Samples a light proportionally to its power, like the local light PDF texture does on the GPU.
+        // Returns c_InvalidLightIndex if there are no lights.
+        [[nodiscard]] uint32_t SampleLocalLight(float random, float& sourcePdf) const;
+
+        // Casts primary rays for every pixel and fills the G-buffer.
+        // When 'previousCamera' is provided, motion vectors are computed from it, otherwise they are zero.
+        [[nodiscard]] GBuffer RenderGBuffer(const Camera& camera, const Camera* previousCamera, donut::math::uint2 viewportSize,
+            tf::Executor* executor) const;
+
+    private:
+        std::vector<donut::math::float3> m_positions;
+        std::vector<RAB_Material> m_materials;
+        std::vector<donut::math::float3> m_emissions;
+
+        Bvh m_bvh;
+        std::vector<RAB_LightInfo> m_lights;
+        std::vector<float> m_lightCdf;
+        float m_totalLightPower = 0.f;
+    };
+}
@@ -0,0 +1,274 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Runs the CPU reference ReSTIR DI pipeline on a procedural scene: a closed box with two blocks inside
+// and a grid of emissive quads on the ceiling, viewed by a slowly moving camera.
+// Prints the per-pass timings and writes the final reservoir buffer and the shaded image.
+
+#include "ReSTIRDIPipeline.h"
+
+#include <donut/core/log.h>
+#include <cxxopts.hpp>
+#include <taskflow/taskflow.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+using namespace donut::math;
+using namespace cpuref;
+
+struct Arguments
+{
+    uint32_t width = 640;
+    uint32_t height = 360;
+    uint32_t frames = 16;
+    uint32_t lightsPerSide = 8;
+    int threads = 0;
+    std::string outputPrefix;
+};
+
+static void BuildScene(Scene& scene, uint32_t lightsPerSide)
+{
+    RAB_Material white;
+    white.diffuseAlbedo = float3(0.7f);
+    white.specularF0 = float3(0.04f);
+    white.roughness = 0.5f;
+
+    RAB_Material red = white;
+    red.diffuseAlbedo = float3(0.7f, 0.1f, 0.1f);
+
+    RAB_Material green = white;
+    green.diffuseAlbedo = float3(0.1f, 0.7f, 0.1f);
+
+    RAB_Material glossy = white;
+    glossy.diffuseAlbedo = float3(0.2f);
+    glossy.specularF0 = float3(0.8f);
+    glossy.roughness = 0.15f;
+
+    const float size = 10.f;
+
+    // Walls of the box, all facing inwards
+    scene.AddQuad(float3(0.f, 0.f, 0.f), float3(size, 0.f, 0.f), float3(0.f, 0.f, size), white);   // floor
+    scene.AddQuad(float3(0.f, size, 0.f), float3(0.f, 0.f, size), float3(size, 0.f, 0.f), white);  // ceiling
+    scene.AddQuad(float3(0.f, 0.f, size), float3(size, 0.f, 0.f), float3(0.f, size, 0.f), white);  // back
+    scene.AddQuad(float3(0.f, 0.f, 0.f), float3(0.f, size, 0.f), float3(size, 0.f, 0.f), white);   // front
+    scene.AddQuad(float3(0.f, 0.f, 0.f), float3(0.f, 0.f, size), float3(0.f, size, 0.f), red);     // left
+    scene.AddQuad(float3(size, 0.f, 0.f), float3(0.f, size, 0.f), float3(0.f, 0.f, size), green);  // right
+
+    // Two blocks
+    auto addBlock = [&scene](float3 minCorner, float3 extent, const RAB_Material& material)
+    {
+        const float3 ex = float3(extent.x, 0.f, 0.f);
+        const float3 ey = float3(0.f, extent.y, 0.f);
+        const float3 ez = float3(0.f, 0.f, extent.z);
+        scene.AddQuad(minCorner + ey, ez, ex, material);
+        scene.AddQuad(minCorner, ex, ey, material);
+        scene.AddQuad(minCorner + ez, ey, ex, material);
+        scene.AddQuad(minCorner, ey, ez, material);
+        scene.AddQuad(minCorner + ex, ez, ey, material);
+    };
+    addBlock(float3(2.f, 0.f, 5.f), float3(2.5f, 5.f, 2.5f), white);
+    addBlock(float3(6.f, 0.f, 3.f), float3(2.5f, 2.5f, 2.5f), glossy);
+
+    // Grid of small emissive quads just below the ceiling, facing down, with varying colors
+    const float cellSize = size / float(lightsPerSide);
+    const float lightSize = cellSize * 0.3f;
+    for (uint32_t z = 0; z < lightsPerSide; z++)
+    {
+        for (uint32_t x = 0; x < lightsPerSide; x++)
+        {
+            const float3 origin = float3(
+                (float(x) + 0.5f) * cellSize - lightSize * 0.5f,
+                size - 0.01f,
+                (float(z) + 0.5f) * cellSize - lightSize * 0.5f);
+
+            const float hue = float(x + z * lightsPerSide) / float(lightsPerSide * lightsPerSide);
+            const float3 color = float3(
+                0.5f + 0.5f * std::cos(hue * 6.2831f),
+                0.5f + 0.5f * std::cos(hue * 6.2831f + 2.094f),
+                0.5f + 0.5f * std::cos(hue * 6.2831f + 4.188f));
+
+            scene.AddQuad(origin, float3(lightSize, 0.f, 0.f), float3(0.f, 0.f, lightSize), white, color * 20.f);
+        }
+    }
+
+    scene.Finalize();
+}
+
+static Camera GetCamera(uint32_t frameIndex)
+{
+    Camera camera;
+    const float angle = float(frameIndex) * 0.002f;
+    camera.position = float3(5.f + std::sin(angle), 5.f, 0.5f);
+    camera.forward = normalize(float3(0.f, -0.1f, 1.f));
+    camera.verticalFov = radians(60.f);
+    return camera;
+}
+
+static bool WritePfm(const std::string& fileName, const std::vector<float3>& pixels, uint2 size)
+{
+    FILE* file = fopen(fileName.c_str(), "wb");
+    if (!file)
+        return false;
+
+    // PFM stores the rows bottom to top
+    fprintf(file, "PF\n%u %u\n-1.0\n", size.x, size.y);
+    for (uint32_t y = size.y; y-- > 0; )
+        fwrite(&pixels[size_t(y) * size.x], sizeof(float3), size.x, file);
+
+    fclose(file);
+    return true;
+}
+
+static bool WriteBinary(const std::string& fileName, const void* data, size_t size)
+{
+    FILE* file = fopen(fileName.c_str(), "wb");
+    if (!file)
+        return false;
+
+    fwrite(data, 1, size, file);
+    fclose(file);
+    return true;
+}
+
+static bool ProcessCommandLine(int argc, char** argv, Arguments& args, ReSTIRDISettings& settings)
+{
+    try
+    {
+        using cxxopts::value;
+
+        cxxopts::Options options("RtxdiCpuReference", "CPU reference implementation of the ReSTIR DI pipeline");
+        bool help = false;
+        uint32_t temporalBiasCorrection = uint32_t(settings.temporalBiasCorrection);
+        uint32_t spatialBiasCorrection = uint32_t(settings.spatialBiasCorrection);
+
+        options.add_options()
+            ("frames", "Number of frames to render", value(args.frames))
+            ("h,help", "Display this help message", value(help))
+            ("height", "Render height", value(args.height))
+            ("initial-samples", "Number of local light samples per pixel", value(settings.numLocalLightSamples))
+            ("lights", "Number of emissive quads along each side of the ceiling grid", value(args.lightsPerSide))
+            ("output", "Prefix for the output files, nothing is written if empty", value(args.outputPrefix))
+            ("spatial", "Spatial resampling toggle", value(settings.enableSpatialResampling))
+            ("spatial-bias-correction", "Spatial bias correction: 0 = off, 1 = basic, 3 = ray traced", value(spatialBiasCorrection))
+            ("spatial-samples", "Number of spatial samples", value(settings.numSpatialSamples))
+            ("temporal", "Temporal resampling toggle", value(settings.enableTemporalResampling))
+            ("temporal-bias-correction", "Temporal bias correction: 0 = off, 1 = basic, 3 = ray traced", value(temporalBiasCorrection))
+            ("threads", "Number of worker threads, 0 means one per hardware thread, 1 disables the thread pool", value(args.threads))
+            ("width", "Render width", value(args.width));
+
+        options.parse(argc, argv);
+
+        if (help)
+        {
+            printf("%s", options.help().c_str());
+            return false;
+        }
+
+        settings.temporalBiasCorrection = BiasCorrection(temporalBiasCorrection);
+        settings.spatialBiasCorrection = BiasCorrection(spatialBiasCorrection);
+    }
+    catch (const cxxopts::exceptions::exception& e)
+    {
+        donut::log::error("%s", e.what());
+        return false;
+    }
+
+    if (args.width == 0 || args.height == 0 || args.lightsPerSide == 0)
+    {
+        donut::log::error("The render size and the number of lights must not be zero.");
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    Arguments args;
+    ReSTIRDISettings settings;
+    if (!ProcessCommandLine(argc, argv, args, settings))
+        return 1;
+
+    std::unique_ptr<tf::Executor> executor;
+    if (args.threads != 1)
+        executor = std::make_unique<tf::Executor>(args.threads > 0 ? size_t(args.threads) : size_t(std::thread::hardware_concurrency()));
+
+    Scene scene;
+    BuildScene(scene, args.lightsPerSide);
+    donut::log::info("Scene: %u triangles, %zu lights, %zu BVH nodes",
+        scene.GetTriangleCount(), scene.GetLights().size(), scene.GetBvh().GetNodeCount());
+
+    const uint2 viewportSize = uint2(args.width, args.height);
+    ReSTIRDIPipeline pipeline(viewportSize, executor.get());
+    pipeline.SetSettings(settings);
+
+    GBuffer previousGBuffer;
+    ReSTIRDIStatistics totals;
+    for (uint32_t frameIndex = 0; frameIndex < args.frames; frameIndex++)
+    {
+        const Camera camera = GetCamera(frameIndex);
+        const Camera previousCamera = GetCamera(frameIndex > 0 ? frameIndex - 1 : 0);
+
+        GBuffer gbuffer = scene.RenderGBuffer(camera, &previousCamera, viewportSize, executor.get());
+        pipeline.Render(scene, gbuffer, frameIndex > 0 ? &previousGBuffer : nullptr, frameIndex);
+
+        const ReSTIRDIStatistics& stats = pipeline.GetStatistics();
+        totals.initialSamplingTime += stats.initialSamplingTime;
+        totals.temporalResamplingTime += stats.temporalResamplingTime;
+        totals.spatialResamplingTime += stats.spatialResamplingTime;
+        totals.shadingTime += stats.shadingTime;
+        totals.visibilityRays += stats.visibilityRays;
+
+        previousGBuffer = std::move(gbuffer);
+    }
+
+    if (args.frames > 0)
+    {
+        const double frames = double(args.frames);
+        printf("Average over %u frames at %ux%u:\n", args.frames, args.width, args.height);
+        printf("  Initial sampling    %8.2f ms\n", totals.initialSamplingTime / frames);
+        printf("  Temporal resampling %8.2f ms\n", totals.temporalResamplingTime / frames);
+        printf("  Spatial resampling  %8.2f ms\n", totals.spatialResamplingTime / frames);
+        printf("  Shading             %8.2f ms\n", totals.shadingTime / frames);
+        printf("  Visibility rays     %8.0f\n", double(totals.visibilityRays) / frames);
+    }
+
+    if (!args.outputPrefix.empty() && args.frames > 0)
+    {
+        // Composite the demodulated diffuse with the albedo, like the compositing pass
+        std::vector<float3> color(pipeline.GetDiffuseOutput().size());
+        for (size_t index = 0; index < color.size(); index++)
+        {
+            color[index] = pipeline.GetDiffuseOutput()[index] * previousGBuffer.surfaces[index].material.diffuseAlbedo
+                + pipeline.GetSpecularOutput()[index];
+        }
+
+        // Only the array used for shading is written, in the GPU block layout
+        const ReservoirBuffer& reservoirs = pipeline.GetReservoirs();
+        const PackedDIReservoir* reservoirData = reservoirs.GetData().data() + size_t(pipeline.GetShadingArrayIndex()) * reservoirs.GetArrayPitch();
+
+        const std::string imageFile = args.outputPrefix + "_color.pfm";
+        const std::string reservoirFile = args.outputPrefix + "_reservoirs.bin";
+
+        if (!WritePfm(imageFile, color, viewportSize) ||
+            !WriteBinary(reservoirFile, reservoirData, reservoirs.GetArrayPitch() * sizeof(PackedDIReservoir)))
+        {
+            donut::log::error("Failed to write the output files.");
+            return 1;
+        }
+
+        donut::log::info("Saved '%s' and '%s'", imageFile.c_str(), reservoirFile.c_str());
+    }
+
+    return 0;
+}
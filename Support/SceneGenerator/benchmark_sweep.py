@@ -0,0 +1,160 @@
+# Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+#
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+"""Sweeps one option of the generated stress scene or of the FullSample and benchmarks the FullSample for each value.
+
+With --sweep-target generator (the default), the script runs RtxdiSceneGenerator with each value of
+the option and benchmarks the FullSample on each scene. With --sweep-target sample, the scene is
+generated once and the option is passed to the FullSample, for example to measure how the command
+list recording scales with --recording-threads, or how the resampling passes perform with
+--compact-gbuffer off (0) and on (1). Every run uses --benchmark --scene <generated scene>
+--benchmark-report <json>, and the time of every profiler section and the CPU recording times are
+collected into a CSV file. With matplotlib installed, the script also plots them against N.
+The generator is only built when the project is configured with -DRTXDI_BUILD_TOOLS=ON.
+Each FullSample run opens a window: the sample has no headless mode, because it renders into the swap
+chain back buffer and its frames are driven by the donut message loop, which needs a window.
+
+Examples:
+    python benchmark_sweep.py --bin-dir ../../bin --sweep point-lights --values 1000 10000 100000 \\
+        --generator-args="--emissive-meshes 0" --sample-args="--vk"
+
+    python benchmark_sweep.py --bin-dir ../../bin --sweep-target sample --sweep recording-threads \\
+        --values 1 2 4 8 16 --generator-args="--emissive-meshes 64 --instances 16"
+
+    python benchmark_sweep.py --bin-dir ../../bin --sweep-target sample --sweep compact-gbuffer --values 0 1
+"""
+
+import argparse
+import csv
+import json
+import os
+import shlex
+import subprocess
+import sys
+
+
+def run(command):
+    print(" ".join(shlex.quote(part) for part in command), flush=True)
+    return subprocess.run(command).returncode
+
+
+def find_executable(bin_dir, name, hint=None):
+    for candidate in (name, name + ".exe"):
+        path = os.path.join(bin_dir, candidate)
+        if os.path.isfile(path):
+            return path
+    sys.exit("Couldn't find %s in %s%s" % (name, bin_dir, ", " + hint if hint else ""))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--bin-dir", required=True, help="Folder with the FullSample and RtxdiSceneGenerator executables")
+    parser.add_argument("--sweep", required=True,
+                        help="Option to sweep, for example emissive-meshes, triangles-per-mesh, instances, spot-lights "
+                             "for the generator or recording-threads for the sample")
+    parser.add_argument("--sweep-target", choices=("generator", "sample"), default="generator",
+                        help="Pass the swept option to the generator, or generate one scene and pass it to the sample")
+    parser.add_argument("--values", required=True, type=int, nargs="+", help="Values of the swept option")
+    parser.add_argument("--output", default="sweep", help="Folder for the scenes, reports, CSV and plot")
+    parser.add_argument("--generator-args", default="", help="Additional generator options, the same for every scene")
+    parser.add_argument("--sample-args", default="", help="Additional FullSample options, the same for every run")
+    parser.add_argument("--no-plot", action="store_true", help="Only write the CSV file")
+    args = parser.parse_args()
+
+    generator = find_executable(args.bin_dir, "RtxdiSceneGenerator", "configure the project with -DRTXDI_BUILD_TOOLS=ON")
+    sample = find_executable(args.bin_dir, "FullSample")
+    output = os.path.abspath(args.output)
+    os.makedirs(output, exist_ok=True)
+
+    sweep_generator = args.sweep_target == "generator"
+    if not sweep_generator:
+        scene_name = "sweep-" + args.sweep
+        if run([generator, "--output", output, "--name", scene_name] + shlex.split(args.generator_args)) != 0:
+            sys.exit("The generator failed for %s" % scene_name)
+
+    rows = []
+    for value in args.values:
+        name = "%s-%d" % (args.sweep, value)
+        sample_args = shlex.split(args.sample_args)
+        if sweep_generator:
+            scene_name = name
+            if run([generator, "--output", output, "--name", name, "--" + args.sweep, str(value)]
+                   + shlex.split(args.generator_args)) != 0:
+                sys.exit("The generator failed for %s" % name)
+        else:
+            # Attached with '=' so that boolean options take the value too
+            sample_args += ["--%s=%d" % (args.sweep, value)]
+
+        report = os.path.join(output, name + ".report.json")
+        if os.path.exists(report):
+            os.remove(report)
+
+        run([sample, "--benchmark", "--scene", os.path.join(output, scene_name + ".scene.json"), "--benchmark-report", report]
+            + sample_args)
+
+        if not os.path.exists(report):
+            print("No report for %s, skipping it" % name)
+            continue
+
+        with open(report) as file:
+            data = json.load(file)
+
+        row = {"N": value}
+        row.update({"lights." + key: count for key, count in data.get("lights", {}).items()})
+        row.update({section: timings["timeMs"] for section, timings in data.get("sections", {}).items()})
+        row.update({key: data[key] for key in ("commandRecordingMs", "gbufferRecordingMs") if key in data})
+        rows.append(row)
+
+    if not rows:
+        sys.exit("None of the benchmark runs produced a report")
+
+    columns = []
+    for row in rows:
+        columns += [column for column in row if column not in columns]
+
+    csv_path = os.path.join(output, args.sweep + ".csv")
+    with open(csv_path, "w", newline="") as file:
+        writer = csv.DictWriter(file, fieldnames=columns)
+        writer.writeheader()
+        writer.writerows(rows)
+    print("Wrote " + csv_path)
+
+    if args.no_plot:
+        return
+
+    try:
+        import matplotlib
+        matplotlib.use("Agg")
+        import matplotlib.pyplot as plt
+    except ImportError:
+        print("matplotlib is not installed, skipping the plot")
+        return
+
+    figure, axes = plt.subplots(figsize=(10, 6))
+    for section in columns:
+        if section == "N" or section.startswith("lights."):
+            continue
+        points = [(row["N"], row[section]) for row in rows if section in row and row[section] > 0]
+        if points:
+            axes.plot(*zip(*points), marker="o", label=section)
+
+    axes.set_xscale("log")
+    axes.set_yscale("log")
+    axes.set_xlabel(args.sweep)
+    axes.set_ylabel("Time (ms)")
+    axes.grid(True, which="both", alpha=0.3)
+    axes.legend(fontsize="small", ncol=2)
+    figure.tight_layout()
+
+    plot_path = os.path.join(output, args.sweep + ".png")
+    figure.savefig(plot_path, dpi=120)
+    print("Wrote " + plot_path)
+
+
+if __name__ == "__main__":
+    main()
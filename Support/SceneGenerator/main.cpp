@@ -0,0 +1,665 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Generates procedural many-light scenes for measuring how the light preparation and sampling passes scale.
+// Writes <name>.scene.json, <name>.gltf and <name>.bin into the output directory. The scene is a ground plane
+// with emissive panels floating above it, where every panel mesh is instanced several times, and primitive lights
+// of every type scattered over the same area. A fraction of the panels and primitive lights move in circles,
+// and the "Benchmark" animation moves the camera across the scene, so the FullSample can run it with
+// --benchmark --scene <name>.scene.json. See benchmark_sweep.py for sweeping the counts.
+
+#include <donut/core/log.h>
+#include <donut/core/math/math.h>
+#include <cxxopts.hpp>
+#include <json/writer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace donut::math;
+
+struct Arguments
+{
+    std::string outputDirectory = ".";
+    std::string name = "stress";
+    uint32_t emissiveMeshes = 16;
+    uint32_t trianglesPerMesh = 32;
+    uint32_t instancesPerMesh = 4;
+    uint32_t pointLights = 0;
+    uint32_t sphereLights = 0;
+    uint32_t spotLights = 0;
+    uint32_t cylinderLights = 0;
+    uint32_t diskLights = 0;
+    uint32_t rectLights = 0;
+    uint32_t directionalLights = 1;
+    float animatedFraction = 0.f;
+    float size = 100.f;
+    float benchmarkSeconds = 4.f;
+    uint32_t seed = 1;
+};
+
+// Builds a glTF document with a single binary buffer, only the parts that the scene needs.
+class GltfBuilder
+{
+public:
+    GltfBuilder()
+        : m_root(Json::objectValue)
+    {
+        m_root["asset"]["version"] = "2.0";
+        m_root["asset"]["generator"] = "RtxdiSceneGenerator";
+        m_root["extensionsUsed"].append("KHR_materials_emissive_strength");
+    }
+
+    struct Geometry
+    {
+        uint32_t positions = 0;
+        uint32_t normals = 0;
+        uint32_t indices = 0;
+    };
+
+    // Writes the vertex and index data once, so that several meshes can share it with different materials.
+    Geometry AddGeometry(const std::vector<float3>& positions, const std::vector<float3>& normals, const std::vector<uint32_t>& indices)
+    {
+        float3 minPosition = positions[0];
+        float3 maxPosition = positions[0];
+        for (const float3& position : positions)
+        {
+            minPosition = min(minPosition, position);
+            maxPosition = max(maxPosition, position);
+        }
+
+        Geometry geometry;
+        geometry.positions = AddAccessor(positions.data(), positions.size(), sizeof(float3), c_Float, "VEC3", c_ArrayBuffer);
+        geometry.normals = AddAccessor(normals.data(), normals.size(), sizeof(float3), c_Float, "VEC3", c_ArrayBuffer);
+        geometry.indices = AddAccessor(indices.data(), indices.size(), sizeof(uint32_t), c_UnsignedInt, "SCALAR", c_ElementArrayBuffer);
+
+        Json::Value& positionAccessor = m_root["accessors"][geometry.positions];
+        positionAccessor["min"] = ToJson(minPosition);
+        positionAccessor["max"] = ToJson(maxPosition);
+
+        return geometry;
+    }
+
+    uint32_t AddMesh(const std::string& name, const Geometry& geometry, uint32_t material)
+    {
+        Json::Value primitive(Json::objectValue);
+        primitive["attributes"]["POSITION"] = geometry.positions;
+        primitive["attributes"]["NORMAL"] = geometry.normals;
+        primitive["indices"] = geometry.indices;
+        primitive["material"] = material;
+
+        Json::Value mesh(Json::objectValue);
+        mesh["name"] = name;
+        mesh["primitives"].append(primitive);
+        return Append("meshes", mesh);
+    }
+
+    uint32_t AddMaterial(const std::string& name, float3 baseColor, float3 emissiveColor, float emissiveStrength)
+    {
+        Json::Value material(Json::objectValue);
+        material["name"] = name;
+        material["pbrMetallicRoughness"]["baseColorFactor"] = ToJson(float4(baseColor, 1.f));
+        material["pbrMetallicRoughness"]["metallicFactor"] = 0.f;
+        material["pbrMetallicRoughness"]["roughnessFactor"] = 0.6f;
+
+        if (emissiveStrength > 0.f)
+        {
+            material["emissiveFactor"] = ToJson(emissiveColor);
+            material["extensions"]["KHR_materials_emissive_strength"]["emissiveStrength"] = emissiveStrength;
+            material["doubleSided"] = true;
+        }
+
+        return Append("materials", material);
+    }
+
+    uint32_t AddNode(const std::string& name, uint32_t mesh, float3 translation, float4 rotation, float3 scale)
+    {
+        Json::Value node(Json::objectValue);
+        node["name"] = name;
+        node["mesh"] = mesh;
+        node["translation"] = ToJson(translation);
+        node["rotation"] = ToJson(rotation);
+        node["scale"] = ToJson(scale);
+
+        const uint32_t index = Append("nodes", node);
+        m_sceneNodes.append(index);
+        return index;
+    }
+
+    // Adds a looping linear translation track to the shared "Lights" animation.
+    void AddTranslationAnimation(uint32_t node, const std::vector<float>& times, const std::vector<float3>& translations)
+    {
+        Json::Value sampler(Json::objectValue);
+        sampler["input"] = AddAccessor(times.data(), times.size(), sizeof(float), c_Float, "SCALAR", 0);
+        sampler["output"] = AddAccessor(translations.data(), translations.size(), sizeof(float3), c_Float, "VEC3", 0);
+        sampler["interpolation"] = "LINEAR";
+
+        Json::Value& inputAccessor = m_root["accessors"][sampler["input"].asUInt()];
+        inputAccessor["min"].append(times.front());
+        inputAccessor["max"].append(times.back());
+
+        Json::Value& animation = m_animation;
+        animation["name"] = "Lights";
+
+        Json::Value channel(Json::objectValue);
+        channel["sampler"] = animation["samplers"].size();
+        channel["target"]["node"] = node;
+        channel["target"]["path"] = "translation";
+
+        animation["samplers"].append(sampler);
+        animation["channels"].append(channel);
+    }
+
+    bool Write(const std::filesystem::path& gltfPath) const
+    {
+        const std::filesystem::path binPath = std::filesystem::path(gltfPath).replace_extension(".bin");
+
+        Json::Value root = m_root;
+        root["scene"] = 0;
+        root["scenes"][0]["nodes"] = m_sceneNodes;
+        if (m_animation.isObject())
+            root["animations"].append(m_animation);
+
+        Json::Value& buffer = root["buffers"][0];
+        buffer["uri"] = binPath.filename().generic_string();
+        buffer["byteLength"] = Json::UInt64(m_data.size());
+
+        std::ofstream binFile(binPath, std::ios::binary);
+        if (!binFile.is_open())
+        {
+            donut::log::error("Couldn't write '%s'", binPath.generic_string().c_str());
+            return false;
+        }
+        binFile.write(reinterpret_cast<const char*>(m_data.data()), std::streamsize(m_data.size()));
+
+        return WriteJson(root, gltfPath);
+    }
+
+    static bool WriteJson(const Json::Value& root, const std::filesystem::path& fileName)
+    {
+        std::ofstream file(fileName);
+        if (!file.is_open())
+        {
+            donut::log::error("Couldn't write '%s'", fileName.generic_string().c_str());
+            return false;
+        }
+
+        Json::StreamWriterBuilder builder;
+        builder.settings_["precision"] = 6;
+        builder.settings_["indentation"] = " ";
+        std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
+        writer->write(root, &file);
+        file << std::endl;
+
+        return true;
+    }
+
+    template<typename T>
+    static Json::Value ToJson(const T& vector)
+    {
+        Json::Value value(Json::arrayValue);
+        for (int i = 0; i < int(sizeof(T) / sizeof(float)); i++)
+            value.append((&vector.x)[i]);
+        return value;
+    }
+
+private:
+    static constexpr uint32_t c_Float = 5126;
+    static constexpr uint32_t c_UnsignedInt = 5125;
+    static constexpr uint32_t c_ArrayBuffer = 34962;
+    static constexpr uint32_t c_ElementArrayBuffer = 34963;
+
+    uint32_t Append(const char* arrayName, const Json::Value& value)
+    {
+        Json::Value& array = m_root[arrayName];
+        const uint32_t index = array.isArray() ? array.size() : 0;
+        array.append(value);
+        return index;
+    }
+
+    uint32_t AddAccessor(const void* data, size_t count, size_t elementSize, uint32_t componentType, const char* type, uint32_t target)
+    {
+        // Keep every view 4-byte aligned
+        const size_t byteLength = count * elementSize;
+        const size_t offset = (m_data.size() + 3) & ~size_t(3);
+        m_data.resize(offset + byteLength);
+        std::memcpy(m_data.data() + offset, data, byteLength);
+
+        Json::Value view(Json::objectValue);
+        view["buffer"] = 0;
+        view["byteOffset"] = Json::UInt64(offset);
+        view["byteLength"] = Json::UInt64(byteLength);
+        if (target)
+            view["target"] = target;
+
+        Json::Value accessor(Json::objectValue);
+        accessor["bufferView"] = Append("bufferViews", view);
+        accessor["componentType"] = componentType;
+        accessor["count"] = Json::UInt64(count);
+        accessor["type"] = type;
+        return Append("accessors", accessor);
+    }
+
+    Json::Value m_root;
+    Json::Value m_sceneNodes = Json::Value(Json::arrayValue);
+    Json::Value m_animation;
+    std::vector<uint8_t> m_data;
+};
+
+// A unit panel in the XZ plane, subdivided into a grid until it has the requested number of triangles.
+// The panel faces down so that it lights the ground plane.
+static void BuildPanel(uint32_t triangleCount, std::vector<float3>& positions, std::vector<float3>& normals, std::vector<uint32_t>& indices)
+{
+    const uint32_t quadsPerSide = std::max(1u, uint32_t(std::ceil(std::sqrt(float(triangleCount) * 0.5f))));
+    const uint32_t verticesPerSide = quadsPerSide + 1;
+
+    for (uint32_t z = 0; z < verticesPerSide; z++)
+    {
+        for (uint32_t x = 0; x < verticesPerSide; x++)
+        {
+            positions.push_back(float3(float(x) / float(quadsPerSide) - 0.5f, 0.f, float(z) / float(quadsPerSide) - 0.5f));
+            normals.push_back(float3(0.f, -1.f, 0.f));
+        }
+    }
+
+    for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+    {
+        const uint32_t quad = triangle / 2;
+        const uint32_t x = quad % quadsPerSide;
+        const uint32_t z = quad / quadsPerSide;
+        const uint32_t v00 = z * verticesPerSide + x;
+        const uint32_t v10 = v00 + 1;
+        const uint32_t v01 = v00 + verticesPerSide;
+        const uint32_t v11 = v01 + 1;
+
+        if (triangle & 1)
+            indices.insert(indices.end(), { v10, v11, v01 });
+        else
+            indices.insert(indices.end(), { v00, v10, v01 });
+    }
+}
+
+static float4 AxisAngle(float3 axis, float angle)
+{
+    return float4(axis * std::sin(angle * 0.5f), std::cos(angle * 0.5f));
+}
+
+static float4 MultiplyQuaternions(float4 a, float4 b)
+{
+    return float4(
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z);
+}
+
+static float3 HueToColor(float hue)
+{
+    return float3(
+        0.5f + 0.5f * std::cos(hue * 6.2831f),
+        0.5f + 0.5f * std::cos(hue * 6.2831f + 2.094f),
+        0.5f + 0.5f * std::cos(hue * 6.2831f + 4.188f));
+}
+
+// Keyframes of a horizontal circle around the origin, closed so that the animation loops without a jump.
+static void BuildCircle(float3 center, float radius, float period, float phase, std::vector<float>& times, std::vector<float3>& translations)
+{
+    const uint32_t keyCount = 9;
+    for (uint32_t key = 0; key < keyCount; key++)
+    {
+        const float t = float(key) / float(keyCount - 1);
+        const float angle = phase + t * 6.2831f;
+        times.push_back(t * period);
+        translations.push_back(center + float3(std::cos(angle), 0.f, std::sin(angle)) * radius);
+    }
+}
+
+class SceneBuilder
+{
+public:
+    explicit SceneBuilder(const Arguments& args)
+        : m_args(args)
+        , m_random(args.seed)
+        , m_graph(Json::arrayValue)
+        , m_lightChannels(Json::arrayValue)
+    {
+    }
+
+    void Build()
+    {
+        BuildGeometry();
+
+        const float4 facingDown = AxisAngle(float3(1.f, 0.f, 0.f), radians(-90.f));
+
+        // Point lights with a zero radius are delta lights, the ones with a radius are sphere lights
+        for (uint32_t i = 0; i < m_args.pointLights + m_args.sphereLights; i++)
+        {
+            const bool sphere = i >= m_args.pointLights;
+            Json::Value& light = AddLight(sphere ? "SphereLight" : "PointLight", i, "PointLight", facingDown);
+            light["intensity"] = Uniform(2.f, 20.f);
+            light["radius"] = sphere ? Uniform(0.05f, 0.3f) : 0.f;
+        }
+
+        for (uint32_t i = 0; i < m_args.spotLights; i++)
+        {
+            Json::Value& light = AddLight("SpotLight", i, "SpotLight", facingDown);
+            const float outerAngle = Uniform(20.f, 60.f);
+            light["intensity"] = Uniform(5.f, 50.f);
+            light["radius"] = Uniform(0.f, 0.2f);
+            light["innerAngle"] = outerAngle * 0.7f;
+            light["outerAngle"] = outerAngle;
+        }
+
+        for (uint32_t i = 0; i < m_args.cylinderLights; i++)
+        {
+            const float4 rotation = AxisAngle(float3(0.f, 1.f, 0.f), Uniform(0.f, 6.2831f));
+            Json::Value& light = AddLight("CylinderLight", i, "CylinderLight", rotation);
+            light["flux"] = Uniform(20.f, 200.f);
+            light["radius"] = Uniform(0.02f, 0.1f);
+            light["length"] = Uniform(0.5f, 3.f);
+        }
+
+        for (uint32_t i = 0; i < m_args.diskLights; i++)
+        {
+            Json::Value& light = AddLight("DiskLight", i, "DiskLight", facingDown);
+            light["flux"] = Uniform(20.f, 200.f);
+            light["radius"] = Uniform(0.1f, 0.5f);
+        }
+
+        for (uint32_t i = 0; i < m_args.rectLights; i++)
+        {
+            Json::Value& light = AddLight("RectLight", i, "RectLight", facingDown);
+            light["flux"] = Uniform(20.f, 200.f);
+            light["width"] = Uniform(0.2f, 1.f);
+            light["height"] = Uniform(0.2f, 1.f);
+        }
+
+        // Directional lights don't move, they have no position
+        for (uint32_t i = 0; i < m_args.directionalLights; i++)
+        {
+            const float4 rotation = MultiplyQuaternions(
+                AxisAngle(float3(0.f, 1.f, 0.f), Uniform(0.f, 6.2831f)),
+                AxisAngle(float3(1.f, 0.f, 0.f), radians(Uniform(-80.f, -30.f))));
+
+            Json::Value light(Json::objectValue);
+            light["name"] = "DirectionalLight" + std::to_string(i);
+            light["type"] = "DirectionalLight";
+            light["rotation"] = GltfBuilder::ToJson(rotation);
+            light["color"] = GltfBuilder::ToJson(HueToColor(Uniform(0.f, 1.f)) * 0.2f + 0.8f);
+            light["irradiance"] = 2.f / float(m_args.directionalLights);
+            light["angularSize"] = 0.53f;
+            m_graph.append(light);
+        }
+
+        AddCamera();
+    }
+
+    bool Write() const
+    {
+        const std::filesystem::path directory = m_args.outputDirectory;
+        std::filesystem::create_directories(directory);
+
+        if (!m_gltf.Write(directory / (m_args.name + ".gltf")))
+            return false;
+
+        Json::Value root(Json::objectValue);
+        root["models"].append(m_args.name + ".gltf");
+
+        Json::Value geometry(Json::objectValue);
+        geometry["name"] = "Geometry";
+        geometry["model"] = 0;
+
+        root["graph"] = Json::Value(Json::arrayValue);
+        root["graph"].append(geometry);
+        for (const Json::Value& node : m_graph)
+            root["graph"].append(node);
+
+        root["animations"].append(m_benchmarkAnimation);
+        if (!m_lightChannels.empty())
+        {
+            Json::Value lights(Json::objectValue);
+            lights["name"] = "Primitive Lights";
+            lights["channels"] = m_lightChannels;
+            root["animations"].append(lights);
+        }
+
+        return GltfBuilder::WriteJson(root, directory / (m_args.name + ".scene.json"));
+    }
+
+    void LogSummary() const
+    {
+        const uint32_t instances = m_args.emissiveMeshes * m_args.instancesPerMesh;
+        donut::log::info("Emissive meshes: %u x %u instances, %u triangles each, %llu emissive triangles in total",
+            m_args.emissiveMeshes, m_args.instancesPerMesh, m_args.trianglesPerMesh,
+            (unsigned long long)instances * m_args.trianglesPerMesh);
+        donut::log::info("Primitive lights: %u point, %u sphere, %u spot, %u cylinder, %u disk, %u rect, %u directional",
+            m_args.pointLights, m_args.sphereLights, m_args.spotLights, m_args.cylinderLights, m_args.diskLights,
+            m_args.rectLights, m_args.directionalLights);
+        donut::log::info("Animated: %u emissive instances, %u primitive lights", m_animatedInstances, m_lightChannels.size());
+    }
+
+private:
+    float Uniform(float a, float b)
+    {
+        return std::uniform_real_distribution<float>(a, b)(m_random);
+    }
+
+    float3 RandomPosition(float minHeight, float maxHeight)
+    {
+        const float extent = m_args.size * 0.5f;
+        return float3(Uniform(-extent, extent), Uniform(minHeight, maxHeight), Uniform(-extent, extent));
+    }
+
+    bool IsAnimated()
+    {
+        return Uniform(0.f, 1.f) < m_args.animatedFraction;
+    }
+
+    void BuildGeometry()
+    {
+        // Ground plane
+        {
+            const float extent = m_args.size * 0.6f;
+            const std::vector<float3> positions = {
+                float3(-extent, 0.f, -extent), float3(extent, 0.f, -extent),
+                float3(-extent, 0.f, extent), float3(extent, 0.f, extent) };
+            const std::vector<float3> normals(4, float3(0.f, 1.f, 0.f));
+            const std::vector<uint32_t> indices = { 0, 2, 1, 1, 2, 3 };
+
+            const uint32_t material = m_gltf.AddMaterial("Ground", float3(0.5f), float3(0.f), 0.f);
+            const uint32_t mesh = m_gltf.AddMesh("Ground", m_gltf.AddGeometry(positions, normals, indices), material);
+            m_gltf.AddNode("Ground", mesh, float3(0.f), float4(0.f, 0.f, 0.f, 1.f), float3(1.f));
+        }
+
+        if (m_args.trianglesPerMesh == 0)
+            return;
+
+        std::vector<float3> positions;
+        std::vector<float3> normals;
+        std::vector<uint32_t> indices;
+        BuildPanel(m_args.trianglesPerMesh, positions, normals, indices);
+        const GltfBuilder::Geometry panel = m_gltf.AddGeometry(positions, normals, indices);
+
+        for (uint32_t meshIndex = 0; meshIndex < m_args.emissiveMeshes; meshIndex++)
+        {
+            // Each mesh gets its own material so that the meshes are distinct light sources for the light preparation
+            const std::string name = "Emissive" + std::to_string(meshIndex);
+            const float3 color = HueToColor(Uniform(0.f, 1.f));
+            const uint32_t material = m_gltf.AddMaterial(name, float3(0.8f), color, Uniform(5.f, 30.f));
+            const uint32_t mesh = m_gltf.AddMesh(name, panel, material);
+
+            for (uint32_t instance = 0; instance < m_args.instancesPerMesh; instance++)
+            {
+                const float3 translation = RandomPosition(2.f, 6.f);
+                const float4 rotation = AxisAngle(float3(0.f, 1.f, 0.f), Uniform(0.f, 6.2831f));
+                const float size = Uniform(0.5f, 2.f);
+                const uint32_t node = m_gltf.AddNode(name + "_" + std::to_string(instance), mesh, translation, rotation, float3(size, 1.f, size));
+
+                if (IsAnimated())
+                {
+                    std::vector<float> times;
+                    std::vector<float3> translations;
+                    BuildCircle(translation, Uniform(0.5f, 3.f), Uniform(2.f, 8.f), Uniform(0.f, 6.2831f), times, translations);
+                    m_gltf.AddTranslationAnimation(node, times, translations);
+                    m_animatedInstances++;
+                }
+            }
+        }
+    }
+
+    Json::Value& AddLight(const char* baseName, uint32_t index, const char* type, float4 rotation)
+    {
+        const std::string name = baseName + std::to_string(index);
+        const float3 translation = RandomPosition(0.5f, 8.f);
+
+        Json::Value light(Json::objectValue);
+        light["name"] = name;
+        light["type"] = type;
+        light["translation"] = GltfBuilder::ToJson(translation);
+        light["rotation"] = GltfBuilder::ToJson(rotation);
+        light["color"] = GltfBuilder::ToJson(HueToColor(Uniform(0.f, 1.f)));
+
+        if (IsAnimated())
+        {
+            std::vector<float> times;
+            std::vector<float3> translations;
+            BuildCircle(translation, Uniform(0.5f, 3.f), Uniform(2.f, 8.f), Uniform(0.f, 6.2831f), times, translations);
+            m_lightChannels.append(MakeChannel(name, "translation", "linear", times, translations));
+        }
+
+        return m_graph.append(light);
+    }
+
+    static Json::Value MakeChannel(const std::string& target, const char* attribute, const char* mode,
+        const std::vector<float>& times, const std::vector<float3>& values)
+    {
+        Json::Value channel(Json::objectValue);
+        channel["target"] = target;
+        channel["attribute"] = attribute;
+        channel["mode"] = mode;
+
+        Json::Value& data = channel["data"] = Json::Value(Json::arrayValue);
+        for (size_t key = 0; key < times.size(); key++)
+        {
+            Json::Value& keyframe = data.append(Json::Value(Json::objectValue));
+            keyframe["time"] = times[key];
+            // The keyframes are read as 4-component vectors
+            keyframe["value"] = GltfBuilder::ToJson(float4(values[key], 0.f));
+        }
+
+        return channel;
+    }
+
+    // The camera looks down at the scene and moves across it along X for the duration of the benchmark.
+    void AddCamera()
+    {
+        const float extent = m_args.size * 0.5f;
+        const float height = std::max(4.f, m_args.size * 0.1f);
+        const float3 start = float3(-extent, height, extent * 1.2f);
+        const float3 end = float3(extent, height, extent * 1.2f);
+
+        Json::Value camera(Json::objectValue);
+        camera["name"] = "BenchmarkCamera";
+        camera["type"] = "PerspectiveCamera";
+        camera["translation"] = GltfBuilder::ToJson(start);
+        camera["rotation"] = GltfBuilder::ToJson(AxisAngle(float3(1.f, 0.f, 0.f), radians(-25.f)));
+        camera["verticalFov"] = radians(60.f);
+        camera["zNear"] = 0.1f;
+        m_graph.append(camera);
+
+        m_benchmarkAnimation = Json::Value(Json::objectValue);
+        m_benchmarkAnimation["name"] = "Benchmark";
+        m_benchmarkAnimation["channels"].append(MakeChannel("BenchmarkCamera", "translation", "linear",
+            { 0.f, m_args.benchmarkSeconds }, { start, end }));
+    }
+
+    const Arguments& m_args;
+    std::mt19937 m_random;
+    GltfBuilder m_gltf;
+    Json::Value m_graph;
+    Json::Value m_lightChannels;
+    Json::Value m_benchmarkAnimation;
+    uint32_t m_animatedInstances = 0;
+};
+
+static bool ProcessCommandLine(int argc, char** argv, Arguments& args)
+{
+    try
+    {
+        using cxxopts::value;
+
+        cxxopts::Options options("RtxdiSceneGenerator", "Generates procedural many-light scenes for the FullSample benchmark");
+        bool help = false;
+
+        options.add_options()
+            ("animated-fraction", "Fraction of the emissive instances and primitive lights that move, 0 to 1", value(args.animatedFraction))
+            ("benchmark-seconds", "Duration of the camera animation used by --benchmark", value(args.benchmarkSeconds))
+            ("cylinder-lights", "Number of cylinder lights", value(args.cylinderLights))
+            ("directional-lights", "Number of directional lights", value(args.directionalLights))
+            ("disk-lights", "Number of disk lights", value(args.diskLights))
+            ("emissive-meshes", "Number of distinct emissive meshes", value(args.emissiveMeshes))
+            ("h,help", "Display this help message", value(help))
+            ("instances", "Number of instances of each emissive mesh", value(args.instancesPerMesh))
+            ("name", "Base name of the generated files", value(args.name))
+            ("output", "Output directory", value(args.outputDirectory))
+            ("point-lights", "Number of point lights with a zero radius", value(args.pointLights))
+            ("rect-lights", "Number of rectangular lights", value(args.rectLights))
+            ("seed", "Seed of the random placement", value(args.seed))
+            ("size", "Side of the square area covered by the lights, in meters", value(args.size))
+            ("sphere-lights", "Number of point lights with a radius", value(args.sphereLights))
+            ("spot-lights", "Number of spot lights", value(args.spotLights))
+            ("triangles-per-mesh", "Number of emissive triangles in each mesh", value(args.trianglesPerMesh));
+
+        options.parse(argc, argv);
+
+        if (help)
+        {
+            printf("%s", options.help().c_str());
+            return false;
+        }
+    }
+    catch (const cxxopts::exceptions::exception& e)
+    {
+        donut::log::error("%s", e.what());
+        return false;
+    }
+
+    if (args.name.empty() || args.size <= 0.f || args.benchmarkSeconds <= 0.f)
+    {
+        donut::log::error("The name, size and benchmark duration must not be empty or zero.");
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    Arguments args;
+    if (!ProcessCommandLine(argc, argv, args))
+        return 1;
+
+    SceneBuilder builder(args);
+    builder.Build();
+
+    if (!builder.Write())
+        return 1;
+
+    builder.LogSummary();
+    donut::log::info("Wrote %s.scene.json to '%s'", args.name.c_str(), args.outputDirectory.c_str());
+    return 0;
+}
@@ -0,0 +1,176 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Unit tests for the CPU reference of the ReSTIR DI pipeline: the reservoir packing, which must match
+// RTXDI_PackedDIReservoir bit for bit so that the buffers can be compared with GPU captures, and a few
+// frames of the full pipeline on a tiny scene. Run without arguments to run all tests, or pass test names
+// to run only those.
+
+#include "ReSTIRDIPipeline.h"
+#include "TestFramework.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace donut::math;
+using namespace cpuref;
+
+namespace
+{
+    bool IsFinite(float3 value)
+    {
+        return std::isfinite(value.x) && std::isfinite(value.y) && std::isfinite(value.z);
+    }
+}
+
+TEST_CASE(PackedReservoirLayout)
+{
+    DIReservoir reservoir;
+    reservoir.lightData = 42 | c_DIReservoirLightValidBit;
+    reservoir.M = 5.f;
+    RTXDI_StoreVisibilityInDIReservoir(reservoir, float3(1.f, 0.f, 1.f), false);
+
+    // Visibility takes the low 18 bits, 6 per channel, and M is stored above it
+    const PackedDIReservoir packed = RTXDI_PackDIReservoir(reservoir);
+    CHECK((packed.mVisibility >> 18) == 5);
+    CHECK((packed.mVisibility & 0x3ffff) == (0x3fu | (0x3fu << 12)));
+    CHECK(packed.lightData == reservoir.lightData);
+
+    // M saturates instead of overflowing into other fields
+    reservoir.M = 100000.f;
+    CHECK((RTXDI_PackDIReservoir(reservoir).mVisibility >> c_PackedDIReservoirMShift) == c_PackedDIReservoirMaxM);
+    CHECK((RTXDI_PackDIReservoir(reservoir).mVisibility & c_PackedDIReservoirVisibilityMask) == reservoir.packedVisibility);
+}
+
+TEST_CASE(PackedReservoirRoundTrip)
+{
+    DIReservoir reservoir;
+    reservoir.lightData = 1234 | c_DIReservoirLightValidBit;
+    reservoir.uvData = 0x8000c000;
+    reservoir.weightSum = 0.25f;
+    reservoir.targetPdf = 3.5f;
+    reservoir.M = 17.f;
+    RTXDI_StoreVisibilityInDIReservoir(reservoir, float3(0.5f, 1.f, 0.25f), false);
+    reservoir.spatialDistance = int2(-3, 7);
+    reservoir.age = 9;
+
+    const DIReservoir unpacked = RTXDI_UnpackDIReservoir(RTXDI_PackDIReservoir(reservoir));
+    CHECK(unpacked.lightData == reservoir.lightData);
+    CHECK(unpacked.uvData == reservoir.uvData);
+    CHECK(unpacked.weightSum == reservoir.weightSum);
+    CHECK(unpacked.targetPdf == reservoir.targetPdf);
+    CHECK(unpacked.M == reservoir.M);
+    CHECK(unpacked.packedVisibility == reservoir.packedVisibility);
+    CHECK(all(unpacked.spatialDistance == reservoir.spatialDistance));
+    CHECK(unpacked.age == reservoir.age);
+
+    // Out of range distances and ages are clamped
+    reservoir.spatialDistance = int2(-500, 500);
+    reservoir.age = 1000;
+    const DIReservoir clamped = RTXDI_UnpackDIReservoir(RTXDI_PackDIReservoir(reservoir));
+    CHECK(all(clamped.spatialDistance == int2(-c_PackedDIReservoirMaxDistance, c_PackedDIReservoirMaxDistance)));
+    CHECK(clamped.age == c_PackedDIReservoirMaxAge);
+
+    // Reservoirs with non-finite weights are discarded on load
+    reservoir.weightSum = std::numeric_limits<float>::infinity();
+    CHECK(!RTXDI_IsValidDIReservoir(RTXDI_UnpackDIReservoir(RTXDI_PackDIReservoir(reservoir))));
+}
+
+TEST_CASE(ReservoirBufferRoundTrip)
+{
+    ReservoirBuffer buffer(40, 20, 2);
+
+    DIReservoir reservoir;
+    reservoir.lightData = 7 | c_DIReservoirLightValidBit;
+    reservoir.weightSum = 2.f;
+    reservoir.M = 3.f;
+
+    buffer.Store(reservoir, uint2(37, 18), 1);
+    CHECK(buffer.Load(uint2(37, 18), 1).lightData == reservoir.lightData);
+    CHECK(buffer.Load(uint2(37, 18), 1).M == reservoir.M);
+    CHECK(!RTXDI_IsValidDIReservoir(buffer.Load(uint2(37, 18), 0)));
+    CHECK(buffer.PositionToPointer(uint2(37, 18), 1) - buffer.PositionToPointer(uint2(37, 18), 0) == buffer.GetArrayPitch());
+}
+
+TEST_CASE(TinyScene)
+{
+    RAB_Material white;
+    white.diffuseAlbedo = float3(0.7f);
+    white.specularF0 = float3(0.04f);
+    white.roughness = 0.5f;
+
+    // A floor, a back wall and a ceiling with one light in the middle, the same orientations as the command line tool's box
+    const float size = 10.f;
+    Scene scene;
+    scene.AddQuad(float3(0.f, 0.f, 0.f), float3(size, 0.f, 0.f), float3(0.f, 0.f, size), white);
+    scene.AddQuad(float3(0.f, size, 0.f), float3(0.f, 0.f, size), float3(size, 0.f, 0.f), white);
+    scene.AddQuad(float3(0.f, 0.f, size), float3(size, 0.f, 0.f), float3(0.f, size, 0.f), white);
+    scene.AddQuad(float3(4.f, size - 0.01f, 4.f), float3(2.f, 0.f, 0.f), float3(0.f, 0.f, 2.f), white, float3(20.f));
+    scene.Finalize();
+
+    if (!CHECK(scene.GetLights().size() == 2))
+        return;
+
+    Camera camera;
+    camera.position = float3(5.f, 5.f, 0.5f);
+    camera.forward = normalize(float3(0.f, -0.1f, 1.f));
+    camera.verticalFov = radians(60.f);
+
+    const uint2 viewportSize = uint2(32, 32);
+    ReSTIRDIPipeline pipeline(viewportSize, nullptr);
+
+    GBuffer previousGBuffer;
+    GBuffer gbuffer;
+    for (uint32_t frameIndex = 0; frameIndex < 3; frameIndex++)
+    {
+        gbuffer = scene.RenderGBuffer(camera, &camera, viewportSize, nullptr);
+        pipeline.Render(scene, gbuffer, frameIndex > 0 ? &previousGBuffer : nullptr, frameIndex);
+        previousGBuffer = gbuffer;
+    }
+
+    uint32_t validSurfaces = 0;
+    uint32_t validReservoirs = 0;
+    float totalDiffuse = 0.f;
+
+    for (uint32_t y = 0; y < viewportSize.y; y++)
+    {
+        for (uint32_t x = 0; x < viewportSize.x; x++)
+        {
+            const size_t index = size_t(y) * viewportSize.x + x;
+            if (!RAB_IsSurfaceValid(gbuffer.surfaces[index]))
+                continue;
+
+            ++validSurfaces;
+            CHECK(IsFinite(pipeline.GetDiffuseOutput()[index]));
+            CHECK(IsFinite(pipeline.GetSpecularOutput()[index]));
+            totalDiffuse += RTXDI_Luminance(pipeline.GetDiffuseOutput()[index]);
+
+            const DIReservoir reservoir = pipeline.GetReservoirs().Load(uint2(x, y), pipeline.GetShadingArrayIndex());
+            if (!RTXDI_IsValidDIReservoir(reservoir))
+                continue;
+
+            // M accumulates over the frames and the spatial neighbors, but within the history limits
+            ++validReservoirs;
+            CHECK(RTXDI_GetDIReservoirLightIndex(reservoir) < scene.GetLights().size());
+            CHECK(reservoir.M >= 1.f);
+            CHECK(reservoir.M <= float(c_PackedDIReservoirMaxM));
+            CHECK(reservoir.packedVisibility <= c_PackedDIReservoirVisibilityMask);
+        }
+    }
+
+    CHECK(validSurfaces > 0);
+    CHECK(validReservoirs > 0);
+    CHECK(totalDiffuse > 0.f);
+}
+
+int main(int argc, char** argv)
+{
+    return test::RunTests(argc, argv);
+}
@@ -0,0 +1,159 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Micro-benchmarks of the CPU work that the FullSample does per frame and on scene load, measured on the
+// null device so that they run on machines without a GPU. With --budget-ms, the exit code is nonzero
+// when the per-frame light preparation takes longer than the budget, which lets CI catch regressions.
+
+#include "HostFixture.h"
+
+#include "RenderPasses/PrepareLightsPass.h"
+#include "RtxdiResources.h"
+
+#include <donut/core/log.h>
+#include <cxxopts.hpp>
+
+#include <chrono>
+
+using namespace donut;
+
+struct Arguments
+{
+    SyntheticSceneParameters scene;
+    uint32_t iterations = 100;
+    float budgetMs = 0.f;
+    bool instancedMeshLights = true;
+};
+
+class Timer
+{
+public:
+    Timer() : m_start(std::chrono::high_resolution_clock::now()) { }
+
+    [[nodiscard]] double GetMilliseconds() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_start).count();
+    }
+
+private:
+    std::chrono::high_resolution_clock::time_point m_start;
+};
+
+static bool ProcessCommandLine(int argc, char** argv, Arguments& args)
+{
+    try
+    {
+        using cxxopts::value;
+
+        cxxopts::Options options("FullSampleHostBenchmark", "Measures the host side of the light preparation on a null device");
+        bool help = false;
+        bool noInstancedMeshLights = false;
+
+        options.add_options()
+            ("budget-ms", "Fail when PrepareLightsPass::Process takes longer than this on average, 0 to disable", value(args.budgetMs))
+            ("cylinder-lights", "Number of cylinder lights", value(args.scene.cylinderLights))
+            ("directional-lights", "Number of directional lights", value(args.scene.directionalLights))
+            ("disk-lights", "Number of disk lights", value(args.scene.diskLights))
+            ("emissive-meshes", "Number of distinct emissive meshes", value(args.scene.emissiveMeshes))
+            ("h,help", "Display this help message", value(help))
+            ("instances", "Number of instances of each emissive mesh", value(args.scene.instancesPerMesh))
+            ("iterations", "Number of frames to average the per-frame timings over", value(args.iterations))
+            ("no-instanced-mesh-lights", "Store every instance of the emissive meshes separately", value(noInstancedMeshLights))
+            ("opaque-meshes", "Number of non-emissive meshes", value(args.scene.opaqueMeshes))
+            ("point-lights", "Number of point lights", value(args.scene.pointLights))
+            ("rect-lights", "Number of rectangular lights", value(args.scene.rectLights))
+            ("seed", "Seed of the random placement", value(args.scene.seed))
+            ("spot-lights", "Number of spot lights", value(args.scene.spotLights))
+            ("triangles-per-mesh", "Number of emissive triangles in each mesh", value(args.scene.trianglesPerMesh));
+
+        options.parse(argc, argv);
+
+        if (help)
+        {
+            printf("%s", options.help().c_str());
+            return false;
+        }
+
+        args.instancedMeshLights = !noInstancedMeshLights;
+    }
+    catch (const cxxopts::exceptions::exception& e)
+    {
+        log::error("%s", e.what());
+        return false;
+    }
+
+    if (args.iterations == 0)
+    {
+        log::error("The number of iterations must not be zero.");
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    Arguments args;
+    if (!ProcessCommandLine(argc, argv, args))
+        return 1;
+
+    SetHostLogSeverity(log::Severity::Warning);
+
+    Timer sceneTimer;
+    HostFixture fixture(args.scene, args.instancedMeshLights);
+    const double sceneMs = sceneTimer.GetMilliseconds();
+
+    Timer countTimer;
+    const PrepareLightsPass::EmissiveLightCounts counts = fixture.prepareLightsPass->CountLightsInScene(args.instancedMeshLights);
+    const double countMs = countTimer.GetMilliseconds();
+
+    Timer resourcesTimer;
+    fixture.CreateResources();
+    const double resourcesMs = resourcesTimer.GetMilliseconds();
+
+    Timer blasTimer;
+    fixture.scene->BuildMeshBLASes(fixture.device.Get());
+    const double blasMs = blasTimer.GetMilliseconds();
+
+    // The first frame fills the previous offset maps, keep it out of the average
+    fixture.PrepareLights();
+
+    Timer prepareLightsTimer;
+    for (uint32_t i = 0; i < args.iterations; i++)
+        fixture.PrepareLights();
+    const double prepareLightsMs = prepareLightsTimer.GetMilliseconds() / args.iterations;
+
+    Timer tlasTimer;
+    for (uint32_t i = 0; i < args.iterations; i++)
+        fixture.BuildTopLevelAccelStruct();
+    const double tlasMs = tlasTimer.GetMilliseconds() / args.iterations;
+
+    const uint32_t numPrimitiveLights = uint32_t(fixture.scene->GetSceneGraph()->GetLights().size());
+    const nullrhi::Device::Statistics statistics = fixture.device->GetStatistics();
+
+    log::info("Scene: %u emissive meshes (%u instanced), %u emissive triangles, %u instanced lights, %u primitive lights",
+        counts.meshes, counts.instancedMeshes, counts.triangles, counts.instancedLights, numPrimitiveLights);
+    log::info("Device: %u buffers (%.1f MB), %u acceleration structures",
+        statistics.buffers, double(statistics.bufferBytes) / (1024.0 * 1024.0), statistics.accelStructs);
+    log::info("Scene build:                %8.3f ms", sceneMs);
+    log::info("CountLightsInScene:         %8.3f ms", countMs);
+    log::info("RtxdiResources:             %8.3f ms", resourcesMs);
+    log::info("BuildMeshBLASes:            %8.3f ms", blasMs);
+    log::info("PrepareLightsPass::Process: %8.3f ms per frame", prepareLightsMs);
+    log::info("BuildTopLevelAccelStruct:   %8.3f ms per frame", tlasMs);
+
+    if (args.budgetMs > 0.f && prepareLightsMs > args.budgetMs)
+    {
+        log::error("PrepareLightsPass::Process took %.3f ms per frame, the budget is %.3f ms", prepareLightsMs, args.budgetMs);
+        return 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,126 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "HostFixture.h"
+
+#include "RenderPasses/PrepareLightsPass.h"
+#include "RtxdiResources.h"
+
+#include <donut/core/log.h>
+#include <donut/core/vfs/VFS.h>
+#include <donut/engine/CommonRenderPasses.h>
+#include <donut/engine/DescriptorTableManager.h>
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/TextureCache.h>
+
+#include <cstdio>
+
+using namespace donut;
+
+HostFixture::HostFixture(const SyntheticSceneParameters& sceneParams, bool enableInstancedMeshLights)
+    : enableInstancedMeshLights(enableInstancedMeshLights)
+{
+    device = nvrhi::RefCountPtr<nullrhi::Device>::Create(new nullrhi::Device());
+    commandList = device->createCommandList(nvrhi::CommandListParameters());
+
+    auto rootFs = std::make_shared<vfs::RootFileSystem>();
+    shaderFactory = std::make_shared<engine::ShaderFactory>(device.Get(), rootFs, "/shaders");
+    commonPasses = std::make_shared<engine::CommonRenderPasses>(device.Get(), shaderFactory);
+
+    nvrhi::BindlessLayoutDesc bindlessLayoutDesc;
+    bindlessLayoutDesc.firstSlot = 0;
+    bindlessLayoutDesc.registerSpaces = {
+        nvrhi::BindingLayoutItem::RawBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::Texture_SRV(2),
+        nvrhi::BindingLayoutItem::Texture_UAV(3)
+    };
+    bindlessLayoutDesc.visibility = nvrhi::ShaderType::All;
+    bindlessLayoutDesc.maxCapacity = 1024;
+    m_bindlessLayout = device->createBindlessLayout(bindlessLayoutDesc);
+
+    descriptorTable = std::make_shared<engine::DescriptorTableManager>(device.Get(), m_bindlessLayout);
+    textureCache = std::make_shared<engine::TextureCache>(device.Get(), rootFs, descriptorTable);
+
+    scene = std::make_shared<SyntheticScene>(device.Get(), *shaderFactory, rootFs, textureCache, descriptorTable, std::make_shared<SampleSceneTypeFactory>());
+    scene->Build(sceneParams, frameIndex);
+
+    rtxdi::ImportanceSamplingContext_StaticParameters isStaticParams;
+    isStaticParams.renderWidth = 64;
+    isStaticParams.renderHeight = 64;
+    isContext = std::make_unique<rtxdi::ImportanceSamplingContext>(isStaticParams);
+
+    prepareLightsPass = std::make_unique<PrepareLightsPass>(device.Get(), shaderFactory, commonPasses, scene, m_bindlessLayout);
+    prepareLightsPass->CreatePipeline();
+}
+
+HostFixture::~HostFixture() = default;
+
+void HostFixture::CreateResources()
+{
+    const PrepareLightsPass::EmissiveLightCounts counts = prepareLightsPass->CountLightsInScene(enableInstancedMeshLights);
+    const uint32_t numPrimitiveLights = uint32_t(scene->GetSceneGraph()->GetLights().size());
+    const uint32_t numGeometryInstances = uint32_t(scene->GetSceneGraph()->GetGeometryInstancesCount());
+
+    const rtxdi::ReSTIRDIContext& restirDIContext = isContext->GetReSTIRDIContext();
+
+    resources = nullptr;
+    resources = std::make_unique<RtxdiResources>(
+        device.Get(),
+        restirDIContext,
+        isContext->GetRISBufferSegmentAllocator(),
+        RtxdiResources::GetLightCapacities(counts, numPrimitiveLights, numGeometryInstances),
+        64, 32,
+        restirDIContext.GetReservoirBufferParameters().reservoirArrayPitch);
+
+    prepareLightsPass->CreateBindingSet(*resources);
+}
+
+RTXDI_LightBufferParameters HostFixture::PrepareLights()
+{
+    commandList->open();
+
+    const RTXDI_LightBufferParameters lightBufferParams = prepareLightsPass->Process(
+        commandList,
+        isContext->GetReSTIRDIContext(),
+        scene->GetSceneGraph()->GetLights(),
+        false,
+        enableInstancedMeshLights);
+
+    commandList->close();
+    device->executeCommandList(commandList);
+
+    return lightBufferParams;
+}
+
+void HostFixture::BuildTopLevelAccelStruct()
+{
+    commandList->open();
+    scene->BuildTopLevelAccelStruct(commandList);
+    commandList->close();
+    device->executeCommandList(commandList);
+}
+
+nullrhi::CommandList& HostFixture::GetRecordedCommands() const
+{
+    return *static_cast<nullrhi::CommandList*>(commandList.Get());
+}
+
+static log::Severity g_minSeverity = log::Severity::Info;
+
+void SetHostLogSeverity(log::Severity minSeverity)
+{
+    g_minSeverity = minSeverity;
+
+    log::SetCallback([](log::Severity severity, const char* message)
+    {
+        if (severity >= g_minSeverity)
+            fprintf(severity >= log::Severity::Error ? stderr : stdout, "%s\n", message);
+    });
+}
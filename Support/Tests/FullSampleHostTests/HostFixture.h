@@ -0,0 +1,69 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "NullDevice.h"
+#include "SyntheticScene.h"
+
+#include <Rtxdi/ImportanceSamplingContext.h>
+#include <memory>
+
+namespace donut::engine
+{
+    class CommonRenderPasses;
+    class DescriptorTableManager;
+    class ShaderFactory;
+    class TextureCache;
+}
+
+class PrepareLightsPass;
+class RtxdiResources;
+
+// Creates the objects that the light preparation needs on the null device, the same way SceneRenderer does.
+// The shaders are not loaded, the null device accepts pipelines without them.
+class HostFixture
+{
+public:
+    explicit HostFixture(const SyntheticSceneParameters& sceneParams, bool enableInstancedMeshLights = true);
+    ~HostFixture();
+
+    // Sizes the RTXDI resources for the scene with RtxdiResources::GetLightCapacities, like SceneRenderer::SetupRenderPasses.
+    void CreateResources();
+
+    // Records PrepareLightsPass::Process into the fixture's command list and executes it.
+    RTXDI_LightBufferParameters PrepareLights();
+
+    // Records SampleScene::BuildTopLevelAccelStruct into the fixture's command list and executes it.
+    void BuildTopLevelAccelStruct();
+
+    [[nodiscard]] nullrhi::CommandList& GetRecordedCommands() const;
+
+    nvrhi::RefCountPtr<nullrhi::Device> device;
+    nvrhi::CommandListHandle commandList;
+    std::shared_ptr<donut::engine::ShaderFactory> shaderFactory;
+    std::shared_ptr<donut::engine::CommonRenderPasses> commonPasses;
+    std::shared_ptr<donut::engine::DescriptorTableManager> descriptorTable;
+    std::shared_ptr<donut::engine::TextureCache> textureCache;
+    std::shared_ptr<SyntheticScene> scene;
+    std::unique_ptr<rtxdi::ImportanceSamplingContext> isContext;
+    std::unique_ptr<RtxdiResources> resources;
+    std::unique_ptr<PrepareLightsPass> prepareLightsPass;
+
+    bool enableInstancedMeshLights;
+    uint32_t frameIndex = 0;
+
+private:
+    nvrhi::BindingLayoutHandle m_bindlessLayout;
+};
+
+// Drops the log messages below the given severity, for the tests and benchmarks that create many objects
+// whose shaders cannot be found.
+void SetHostLogSeverity(donut::log::Severity minSeverity);
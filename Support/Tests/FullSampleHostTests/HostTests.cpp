@@ -0,0 +1,1012 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Unit tests for the host side of the FullSample on the null device: the task and light buffers that
+// PrepareLightsPass uploads, the RTXDI resource sizes, the TLAS build, the frame graph compilation and
+// transient heap, and the IES profile baking. Run without arguments to run all tests, or pass test names
+// to run only those.
+
+#include "HostFixture.h"
+
+#include "FrameGraph.h"
+#include "IesProfileAtlas.h"
+#include "RenderPasses/PrepareLightsPass.h"
+#include "RtxdiResources.h"
+#include "TestFramework.h"
+
+#include <donut/core/log.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "../Shaders/ShaderParameters.h"
+
+using namespace donut;
+
+namespace
+{
+    PrepareLightsConstants GetPushConstants(const nullrhi::Command& dispatch)
+    {
+        PrepareLightsConstants constants = {};
+        if (dispatch.pushConstants.size() == sizeof(constants))
+            memcpy(&constants, dispatch.pushConstants.data(), sizeof(constants));
+        return constants;
+    }
+
+    uint32_t GetLightType(const PolymorphicLightInfo& lightInfo)
+    {
+        return (lightInfo.colorTypeAndFlags >> kPolymorphicLightTypeShift) & kPolymorphicLightTypeMask;
+    }
+
+    uint32_t CountTasks(HostFixture& fixture)
+    {
+        const auto& params = fixture.scene->GetParameters();
+        return params.emissiveMeshes * params.instancesPerMesh * params.geometriesPerMesh + params.pointLights + params.spotLights + params.rectLights
+            + params.diskLights + params.cylinderLights + params.directionalLights;
+    }
+}
+
+TEST_CASE(TaskBufferLayout)
+{
+    SyntheticSceneParameters params;
+    params.emissiveMeshes = 4;
+    params.trianglesPerMesh = 8;
+    params.opaqueMeshes = 2;
+    params.pointLights = 2;
+    params.spotLights = 1;
+    params.directionalLights = 1;
+
+    HostFixture fixture(params, false);
+    fixture.CreateResources();
+    const RTXDI_LightBufferParameters lightBufferParams = fixture.PrepareLights();
+
+    const uint32_t numTasks = CountTasks(fixture);
+    const auto tasks = nullrhi::ReadBuffer<PrepareLightsTask>(fixture.resources->TaskBuffer, numTasks);
+    if (!CHECK(tasks.size() == numTasks))
+        return;
+
+    // The emissive meshes come first and the lights follow without gaps
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < numTasks; i++)
+    {
+        const bool isPrimitiveLight = (tasks[i].instanceIndex & TASK_PRIMITIVE_LIGHT_BIT) != 0;
+        CHECK(isPrimitiveLight == (i >= params.emissiveMeshes));
+        CHECK(tasks[i].lightBufferOffset == offset);
+        CHECK(tasks[i].previousLightBufferOffset == -1);
+        CHECK(tasks[i].instancedLightOffset == ~0u);
+        offset += isPrimitiveLight ? 1 : params.trianglesPerMesh;
+    }
+
+    // The infinite lights are sorted after the local lights
+    const uint32_t numPrimitiveLights = numTasks - params.emissiveMeshes;
+    const auto primitiveLights = nullrhi::ReadBuffer<PolymorphicLightInfo>(fixture.resources->PrimitiveLightBuffer, numPrimitiveLights);
+    if (CHECK(primitiveLights.size() == numPrimitiveLights))
+    {
+        for (uint32_t i = 0; i < numPrimitiveLights; i++)
+        {
+            const bool isDirectional = GetLightType(primitiveLights[i]) == uint32_t(PolymorphicLightType::kDirectional);
+            CHECK(isDirectional == (i >= numPrimitiveLights - params.directionalLights));
+        }
+    }
+
+    const uint32_t numLocalLights = params.emissiveMeshes * params.trianglesPerMesh + params.pointLights + params.spotLights;
+    CHECK(lightBufferParams.localLightBufferRegion.firstLightIndex == 0);
+    CHECK(lightBufferParams.localLightBufferRegion.numLights == numLocalLights);
+    CHECK(lightBufferParams.infiniteLightBufferRegion.firstLightIndex == numLocalLights);
+    CHECK(lightBufferParams.infiniteLightBufferRegion.numLights == params.directionalLights);
+    CHECK(lightBufferParams.environmentLightParams.lightPresent == 0);
+
+    // One dispatch with a thread per light, the last task ends at the end of the dispatch
+    const auto dispatches = fixture.GetRecordedCommands().GetCommands(nullrhi::CommandType::Dispatch);
+    if (CHECK(dispatches.size() == 1))
+    {
+        CHECK(dispatches[0]->groups[0] == dm::div_ceil(offset, 256));
+        CHECK(GetPushConstants(*dispatches[0]).tasksEndOffset == offset);
+    }
+}
+
+TEST_CASE(WideTaskIndices)
+{
+    // More geometries in a mesh than the 12 bits that the tasks used to have for them
+    SyntheticSceneParameters params;
+    params.emissiveMeshes = 2;
+    params.trianglesPerMesh = 2;
+    params.geometriesPerMesh = 5000;
+    params.opaqueMeshes = 1;
+    params.pointLights = 1;
+
+    HostFixture fixture(params, false);
+    fixture.CreateResources();
+    const RTXDI_LightBufferParameters lightBufferParams = fixture.PrepareLights();
+
+    const uint32_t numTasks = CountTasks(fixture);
+    const auto tasks = nullrhi::ReadBuffer<PrepareLightsTask>(fixture.resources->TaskBuffer, numTasks);
+    if (!CHECK(tasks.size() == numTasks))
+        return;
+
+    uint32_t taskIndex = 0;
+    for (const auto& instance : fixture.scene->GetSceneGraph()->GetMeshInstances())
+    {
+        const auto& mesh = instance->GetMesh();
+        if (!any(mesh->geometries[0]->material->emissiveColor != 0.f))
+            continue;
+
+        for (uint32_t geometryIndex = 0; geometryIndex < params.geometriesPerMesh; geometryIndex++)
+        {
+            const PrepareLightsTask& task = tasks[taskIndex];
+            CHECK(task.instanceIndex == uint32_t(instance->GetInstanceIndex()));
+            CHECK(task.geometryIndex == geometryIndex);
+            CHECK(task.lightBufferOffset == taskIndex * params.trianglesPerMesh);
+            ++taskIndex;
+        }
+    }
+
+    CHECK(tasks[taskIndex].instanceIndex == TASK_PRIMITIVE_LIGHT_BIT);
+    CHECK(lightBufferParams.localLightBufferRegion.numLights == taskIndex * params.trianglesPerMesh + params.pointLights);
+}
+
+TEST_CASE(LightsOverCapacityAreSkipped)
+{
+    SyntheticSceneParameters params;
+    params.emissiveMeshes = 1;
+    params.trianglesPerMesh = 4;
+    params.pointLights = 1;
+
+    HostFixture fixture(params, false);
+    fixture.CreateResources();
+    const uint32_t maxPrimitiveLights = fixture.resources->GetMaxPrimitiveLights();
+
+    // Add more lights than the resources have room for, without recreating them
+    for (uint32_t i = 0; i < maxPrimitiveLights; i++)
+    {
+        auto light = std::make_shared<engine::PointLight>();
+        light->intensity = 1.f;
+        fixture.scene->AddLight(light, dm::float3(float(i), 1.f, 0.f));
+    }
+
+    SetHostLogSeverity(log::Severity::Fatal);
+    const RTXDI_LightBufferParameters lightBufferParams = fixture.PrepareLights();
+    SetHostLogSeverity(log::Severity::Warning);
+
+    // The tasks stop at the capacity, so neither the upload nor the shader write past the buffers
+    CHECK(lightBufferParams.localLightBufferRegion.numLights == params.trianglesPerMesh + maxPrimitiveLights);
+
+    for (const nullrhi::Command* write : fixture.GetRecordedCommands().GetCommands(nullrhi::CommandType::WriteBuffer))
+    {
+        const auto* buffer = static_cast<nvrhi::IBuffer*>(write->resource);
+        CHECK(write->byteSize <= buffer->getDesc().byteSize);
+    }
+
+    const auto dispatches = fixture.GetRecordedCommands().GetCommands(nullrhi::CommandType::Dispatch);
+    if (CHECK(dispatches.size() == 1))
+    {
+        const PrepareLightsConstants constants = GetPushConstants(*dispatches[0]);
+        CHECK(constants.numTasks == params.emissiveMeshes + maxPrimitiveLights);
+        CHECK(constants.tasksEndOffset == params.trianglesPerMesh + maxPrimitiveLights);
+    }
+}
+
+TEST_CASE(LightDataStaysInsideItsHalf)
+{
+    // The resources have room for instanced lights, but this frame has none: every emissive triangle
+    // needs a LightDataBuffer entry, and there are fewer of those than the light buffer capacity.
+    SyntheticSceneParameters params;
+    params.emissiveMeshes = 1;
+    params.trianglesPerMesh = 100;
+    params.instancesPerMesh = 2;
+    params.pointLights = 1;
+
+    HostFixture fixture(params, true);
+    fixture.CreateResources();
+    const RtxdiResources& resources = *fixture.resources;
+    if (!CHECK(resources.GetMaxInstancedLights() > 0 && resources.GetMaxEmissiveTriangles() == 0))
+        return;
+
+    const uint32_t maxLightDataEntries = uint32_t(resources.LightDataBuffer->getDesc().byteSize / sizeof(PolymorphicLightInfo) / 2);
+    CHECK(maxLightDataEntries == resources.GetLightBufferCapacity() - resources.GetMaxInstancedLights());
+
+    fixture.enableInstancedMeshLights = false;
+
+    for (int frame = 0; frame < 2; frame++)
+    {
+        SetHostLogSeverity(log::Severity::Fatal);
+        const RTXDI_LightBufferParameters lightBufferParams = fixture.PrepareLights();
+        SetHostLogSeverity(log::Severity::Warning);
+
+        const auto dispatches = fixture.GetRecordedCommands().GetCommands(nullrhi::CommandType::Dispatch);
+        if (!CHECK(dispatches.size() == 1))
+            return;
+
+        // The shader writes the non-instanced lights at currentFrameDataOffset + offset - numInstancedLights
+        const PrepareLightsConstants constants = GetPushConstants(*dispatches[0]);
+        CHECK(constants.numInstancedLights == 0);
+        CHECK(constants.tasksEndOffset - constants.numInstancedLights <= maxLightDataEntries);
+        CHECK(constants.currentFrameDataOffset + constants.tasksEndOffset - constants.numInstancedLights <= maxLightDataEntries * 2);
+
+        // The second instance doesn't fit, the point light still does
+        CHECK(lightBufferParams.localLightBufferRegion.numLights == params.trianglesPerMesh + params.pointLights);
+    }
+}
+
+TEST_CASE(PrimitiveLightsStayInsideTheirHalf)
+{
+    SyntheticSceneParameters params;
+    params.emissiveMeshes = 1;
+    params.trianglesPerMesh = 100;
+    params.pointLights = 64;
+
+    HostFixture fixture(params, true);
+
+    // Room for every point light in the primitive light buffer and for many instanced lights, but the frame
+    // has no instanced lights, so the emissive triangles and the point lights share 128 LightDataBuffer entries
+    const uint32_t maxPrimitiveLights = 128;
+    const rtxdi::ReSTIRDIContext& restirDIContext = fixture.isContext->GetReSTIRDIContext();
+    fixture.resources = std::make_unique<RtxdiResources>(
+        fixture.device.Get(), restirDIContext, fixture.isContext->GetRISBufferSegmentAllocator(),
+        params.emissiveMeshes, 0, maxPrimitiveLights, params.emissiveMeshes, 1024, 1024,
+        uint32_t(fixture.scene->GetSceneGraph()->GetGeometryInstancesCount()),
+        64, 32, restirDIContext.GetReservoirBufferParameters().reservoirArrayPitch);
+    fixture.prepareLightsPass->CreateBindingSet(*fixture.resources);
+    fixture.enableInstancedMeshLights = false;
+
+    SetHostLogSeverity(log::Severity::Fatal);
+    const RTXDI_LightBufferParameters lightBufferParams = fixture.PrepareLights();
+    SetHostLogSeverity(log::Severity::Warning);
+
+    // The point lights are skipped by the LightDataBuffer check before the primitive light buffer is full
+    const uint32_t numAcceptedPointLights = maxPrimitiveLights - params.trianglesPerMesh;
+    CHECK(numAcceptedPointLights < params.pointLights);
+    CHECK(lightBufferParams.localLightBufferRegion.numLights == maxPrimitiveLights);
+
+    for (const nullrhi::Command* write : fixture.GetRecordedCommands().GetCommands(nullrhi::CommandType::WriteBuffer))
+    {
+        const auto* buffer = static_cast<nvrhi::IBuffer*>(write->resource);
+        CHECK(write->byteSize <= buffer->getDesc().byteSize);
+    }
+
+    const auto dispatches = fixture.GetRecordedCommands().GetCommands(nullrhi::CommandType::Dispatch);
+    if (CHECK(dispatches.size() == 1))
+    {
+        const PrepareLightsConstants constants = GetPushConstants(*dispatches[0]);
+        CHECK(constants.numInstancedLights == 0);
+        CHECK(constants.numTasks == params.emissiveMeshes + numAcceptedPointLights);
+        CHECK(constants.tasksEndOffset == maxPrimitiveLights);
+        CHECK(constants.currentFrameDataOffset + constants.tasksEndOffset <= maxPrimitiveLights * 2);
+    }
+}
+
+TEST_CASE(InstancedGeometryOverBakeCapacityIsSkipped)
+{
+    SyntheticSceneParameters params;
+    params.emissiveMeshes = 2;
+    params.trianglesPerMesh = 600;
+    params.instancesPerMesh = 2;
+
+    HostFixture fixture(params, true);
+
+    // Room for all instanced lights, but the local space triangles of only one of the two geometries
+    const rtxdi::ReSTIRDIContext& restirDIContext = fixture.isContext->GetReSTIRDIContext();
+    fixture.resources = std::make_unique<RtxdiResources>(
+        fixture.device.Get(), restirDIContext, fixture.isContext->GetRISBufferSegmentAllocator(),
+        128, 0, 128, params.emissiveMeshes, 1024, 4096,
+        uint32_t(fixture.scene->GetSceneGraph()->GetGeometryInstancesCount()),
+        64, 32, restirDIContext.GetReservoirBufferParameters().reservoirArrayPitch);
+    fixture.prepareLightsPass->CreateBindingSet(*fixture.resources);
+
+    SetHostLogSeverity(log::Severity::Fatal);
+    fixture.PrepareLights();
+    SetHostLogSeverity(log::Severity::Warning);
+
+    // Both instances of the second geometry are skipped because it can't be baked
+    const uint32_t numInstancedLights = params.instancesPerMesh * params.trianglesPerMesh;
+    CHECK(fixture.prepareLightsPass->GetInstancedLightCounts().x == numInstancedLights);
+
+    const auto dispatches = fixture.GetRecordedCommands().GetCommands(nullrhi::CommandType::Dispatch);
+    if (CHECK(dispatches.size() == 2))
+    {
+        const PrepareLightsConstants bakeConstants = GetPushConstants(*dispatches[0]);
+        CHECK(bakeConstants.numTasks == 1);
+        CHECK(bakeConstants.tasksEndOffset <= fixture.resources->GetMaxInstancedMeshTriangles());
+        CHECK(GetPushConstants(*dispatches[1]).numTasks == params.instancesPerMesh);
+    }
+}
+
+TEST_CASE(PreviousFrameOffsets)
+{
+    SyntheticSceneParameters params;
+    params.emissiveMeshes = 3;
+    params.pointLights = 2;
+
+    HostFixture fixture(params, false);
+    fixture.CreateResources();
+    const uint32_t capacity = fixture.resources->GetLightBufferCapacity();
+    const uint32_t numTasks = CountTasks(fixture);
+
+    fixture.PrepareLights();
+    const auto firstFrameTasks = nullrhi::ReadBuffer<PrepareLightsTask>(fixture.resources->TaskBuffer, numTasks);
+
+    auto dispatches = fixture.GetRecordedCommands().GetCommands(nullrhi::CommandType::Dispatch);
+    if (CHECK(dispatches.size() == 1))
+    {
+        const PrepareLightsConstants constants = GetPushConstants(*dispatches[0]);
+        CHECK(constants.currentFrameLightOffset == 0);
+        CHECK(constants.previousFrameLightOffset == capacity);
+        CHECK(constants.numTasks == numTasks);
+    }
+
+    const RTXDI_LightBufferParameters lightBufferParams = fixture.PrepareLights();
+    const auto secondFrameTasks = nullrhi::ReadBuffer<PrepareLightsTask>(fixture.resources->TaskBuffer, numTasks);
+
+    // Nothing moved, so every task finds its own offset from the previous frame
+    if (CHECK(firstFrameTasks.size() == numTasks && secondFrameTasks.size() == numTasks))
+    {
+        for (uint32_t i = 0; i < numTasks; i++)
+            CHECK(secondFrameTasks[i].previousLightBufferOffset == int(firstFrameTasks[i].lightBufferOffset));
+    }
+
+    dispatches = fixture.GetRecordedCommands().GetCommands(nullrhi::CommandType::Dispatch);
+    if (CHECK(dispatches.size() == 1))
+    {
+        const PrepareLightsConstants constants = GetPushConstants(*dispatches[0]);
+        CHECK(constants.currentFrameLightOffset == capacity);
+        CHECK(constants.previousFrameLightOffset == 0);
+    }
+
+    CHECK(lightBufferParams.localLightBufferRegion.firstLightIndex == capacity);
+}
+
+TEST_CASE(AddedLightHasNoPreviousOffset)
+{
+    SyntheticSceneParameters params;
+    params.emissiveMeshes = 2;
+    params.pointLights = 1;
+
+    HostFixture fixture(params, false);
+    fixture.CreateResources();
+    fixture.PrepareLights();
+
+    auto light = std::make_shared<engine::PointLight>();
+    light->intensity = 1.f;
+    fixture.scene->AddLight(light, dm::float3(0.f, 1.f, 0.f));
+    fixture.CreateResources();
+    fixture.PrepareLights();
+
+    const uint32_t numTasks = CountTasks(fixture) + 1;
+    const auto tasks = nullrhi::ReadBuffer<PrepareLightsTask>(fixture.resources->TaskBuffer, numTasks);
+    if (!CHECK(tasks.size() == numTasks))
+        return;
+
+    for (uint32_t i = 0; i < numTasks - 1; i++)
+        CHECK(tasks[i].previousLightBufferOffset == int(tasks[i].lightBufferOffset));
+
+    CHECK(tasks[numTasks - 1].previousLightBufferOffset == -1);
+}
+
+TEST_CASE(InstancedMeshLights)
+{
+    SyntheticSceneParameters params;
+    params.emissiveMeshes = 3;
+    params.trianglesPerMesh = 4;
+    params.instancesPerMesh = 3;
+    params.opaqueMeshes = 1;
+    params.pointLights = 1;
+
+    HostFixture fixture(params, true);
+    fixture.CreateResources();
+
+    const PrepareLightsPass::EmissiveLightCounts counts = fixture.prepareLightsPass->CountLightsInScene(true);
+    CHECK(counts.meshes == params.emissiveMeshes * params.instancesPerMesh);
+    CHECK(counts.triangles == 0);
+    CHECK(counts.instancedMeshes == params.emissiveMeshes);
+    CHECK(counts.instancedMeshTriangles == params.emissiveMeshes * params.trianglesPerMesh);
+    CHECK(counts.instancedLights == params.emissiveMeshes * params.instancesPerMesh * params.trianglesPerMesh);
+
+    fixture.PrepareLights();
+
+    const uint32_t numLightTasks = CountTasks(fixture);
+    const uint32_t numBakeTasks = params.emissiveMeshes;
+    const auto tasks = nullrhi::ReadBuffer<PrepareLightsTask>(fixture.resources->TaskBuffer, numLightTasks + numBakeTasks);
+    if (!CHECK(tasks.size() == numLightTasks + numBakeTasks))
+        return;
+
+    const uint32_t numMeshTasks = params.emissiveMeshes * params.instancesPerMesh;
+    for (uint32_t i = 0; i < numMeshTasks; i++)
+    {
+        CHECK(tasks[i].instancedLightOffset != ~0u);
+        CHECK(tasks[i].instancedLightOffset % params.trianglesPerMesh == 0);
+    }
+    CHECK(tasks[numMeshTasks].instancedLightOffset == ~0u);
+
+    // One bake task per geometry, each with its own range of local space triangles
+    for (uint32_t i = 0; i < numBakeTasks; i++)
+    {
+        const PrepareLightsTask& bakeTask = tasks[numLightTasks + i];
+        CHECK(bakeTask.instancedLightOffset == i * params.trianglesPerMesh);
+        CHECK(bakeTask.lightBufferOffset == bakeTask.instancedLightOffset);
+        CHECK(bakeTask.previousLightBufferOffset == -1);
+    }
+
+    const uint32_t numInstancedLights = numMeshTasks * params.trianglesPerMesh;
+    CHECK(fixture.prepareLightsPass->GetInstancedLightCounts().x == numInstancedLights);
+
+    // The bake dispatch runs before the light dispatch
+    const auto dispatches = fixture.GetRecordedCommands().GetCommands(nullrhi::CommandType::Dispatch);
+    if (CHECK(dispatches.size() == 2))
+    {
+        const PrepareLightsConstants bakeConstants = GetPushConstants(*dispatches[0]);
+        CHECK(bakeConstants.bakeInstancedLights == 1);
+        CHECK(bakeConstants.firstTask == numLightTasks);
+        CHECK(bakeConstants.numTasks == numBakeTasks);
+
+        const PrepareLightsConstants lightConstants = GetPushConstants(*dispatches[1]);
+        CHECK(lightConstants.bakeInstancedLights == 0);
+        CHECK(lightConstants.firstTask == 0);
+        CHECK(lightConstants.numTasks == numLightTasks);
+        CHECK(lightConstants.numInstancedLights == numInstancedLights);
+    }
+
+    // The odd frame stores its instanced lights in the second half of the buffers
+    fixture.PrepareLights();
+    CHECK(fixture.prepareLightsPass->GetInstancedLightCounts().y == numInstancedLights);
+
+    const auto oddFrameDispatches = fixture.GetRecordedCommands().GetCommands(nullrhi::CommandType::Dispatch);
+    if (CHECK(oddFrameDispatches.size() == 2))
+    {
+        const PrepareLightsConstants constants = GetPushConstants(*oddFrameDispatches[1]);
+        const uint32_t capacity = fixture.resources->GetLightBufferCapacity();
+        const uint32_t maxInstancedLights = fixture.resources->GetMaxInstancedLights();
+        CHECK(constants.currentFrameLightOffset == capacity);
+        CHECK(constants.currentFrameDataOffset == capacity - maxInstancedLights);
+        CHECK(constants.currentFrameInstancedLightOffset == maxInstancedLights);
+    }
+}
+
+TEST_CASE(InstancedMeshLightsDisabled)
+{
+    SyntheticSceneParameters params;
+    params.emissiveMeshes = 3;
+    params.trianglesPerMesh = 4;
+    params.instancesPerMesh = 3;
+
+    HostFixture fixture(params, false);
+    fixture.CreateResources();
+
+    const PrepareLightsPass::EmissiveLightCounts counts = fixture.prepareLightsPass->CountLightsInScene(false);
+    CHECK(counts.instancedMeshes == 0);
+    CHECK(counts.instancedLights == 0);
+    CHECK(counts.triangles == params.emissiveMeshes * params.instancesPerMesh * params.trianglesPerMesh);
+
+    fixture.PrepareLights();
+
+    const uint32_t numTasks = CountTasks(fixture);
+    const auto tasks = nullrhi::ReadBuffer<PrepareLightsTask>(fixture.resources->TaskBuffer, numTasks);
+    for (const PrepareLightsTask& task : tasks)
+        CHECK(task.instancedLightOffset == ~0u);
+
+    CHECK(fixture.GetRecordedCommands().GetCommands(nullrhi::CommandType::Dispatch).size() == 1);
+    CHECK(fixture.prepareLightsPass->GetInstancedLightCounts().x == 0);
+}
+
+TEST_CASE(GeometryInstanceToLight)
+{
+    SyntheticSceneParameters params;
+    params.emissiveMeshes = 2;
+    params.trianglesPerMesh = 6;
+    params.opaqueMeshes = 3;
+
+    HostFixture fixture(params, false);
+    fixture.CreateResources();
+    fixture.PrepareLights();
+
+    const auto& sceneGraph = fixture.scene->GetSceneGraph();
+    const auto mapping = nullrhi::ReadBuffer<uint32_t>(fixture.resources->GeometryInstanceToLightBuffer, sceneGraph->GetGeometryInstancesCount());
+    if (!CHECK(mapping.size() == sceneGraph->GetGeometryInstancesCount()))
+        return;
+
+    uint32_t expectedOffset = 0;
+    for (const auto& instance : sceneGraph->GetMeshInstances())
+    {
+        const auto& mesh = instance->GetMesh();
+        for (size_t geometryIndex = 0; geometryIndex < mesh->geometries.size(); geometryIndex++)
+        {
+            const auto& geometry = mesh->geometries[geometryIndex];
+            const uint32_t lightIndex = mapping[instance->GetGeometryInstanceIndex() + geometryIndex];
+
+            if (any(geometry->material->emissiveColor != 0.f) && geometry->material->emissiveIntensity > 0.f)
+            {
+                CHECK(lightIndex == expectedOffset);
+                expectedOffset += geometry->numIndices / 3;
+            }
+            else
+                CHECK(lightIndex == RTXDI_INVALID_LIGHT_INDEX);
+        }
+    }
+}
+
+TEST_CASE(ResourceSizes)
+{
+    SyntheticSceneParameters params;
+    params.emissiveMeshes = 5;
+    params.trianglesPerMesh = 300;
+    params.instancesPerMesh = 2;
+    params.pointLights = 130;
+    params.rectLights = 2;
+
+    HostFixture fixture(params, true);
+    fixture.CreateResources();
+    const RtxdiResources& resources = *fixture.resources;
+
+    // The allocation quanta round everything up
+    CHECK(resources.GetMaxEmissiveMeshes() == 128);
+    CHECK(resources.GetMaxPrimitiveLights() == 256);
+    CHECK(resources.GetMaxInstancedMeshTriangles() == 2048);
+    CHECK(resources.GetMaxInstancedLights() == 3072);
+    CHECK(resources.GetLightBufferCapacity() == resources.GetMaxEmissiveTriangles() + resources.GetMaxPrimitiveLights() + resources.GetMaxInstancedLights());
+
+    // The light buffers hold both frames, and the instanced lights have no light data entries
+    const uint32_t capacity = resources.GetLightBufferCapacity();
+    const uint32_t dataCapacity = capacity - resources.GetMaxInstancedLights();
+    CHECK(resources.LightDataBuffer->getDesc().byteSize == sizeof(PolymorphicLightInfo) * dataCapacity * 2);
+    CHECK(resources.LightIndexMappingBuffer->getDesc().byteSize == sizeof(uint32_t) * capacity * 2);
+    CHECK(resources.TaskBuffer->getDesc().byteSize >= sizeof(PrepareLightsTask) * (CountTasks(fixture) + params.emissiveMeshes));
+    CHECK(resources.GeometryInstanceToLightBuffer->getDesc().byteSize == sizeof(uint32_t) * fixture.scene->GetSceneGraph()->GetGeometryInstancesCount());
+
+    // Every buffer that RtxdiResources creates is visible to the null device by its debug name
+    CHECK(fixture.device->FindBuffer("TaskBuffer") == resources.TaskBuffer.Get());
+    CHECK(fixture.device->FindBuffer("InstancedLightBuffer") == resources.InstancedLightBuffer.Get());
+}
+
+TEST_CASE(LightCapacities)
+{
+    PrepareLightsPass::EmissiveLightCounts counts;
+    counts.meshes = 128;
+    counts.triangles = 1025;
+    counts.instancedMeshes = 3;
+    counts.instancedMeshTriangles = 0;
+    counts.instancedLights = 1;
+
+    // Exact multiples stay, everything else rounds up, and the per-instance counts are not rounded
+    const RtxdiResources::LightCapacities capacities = RtxdiResources::GetLightCapacities(counts, 129, 7);
+    CHECK(capacities.maxEmissiveMeshes == 128);
+    CHECK(capacities.maxEmissiveTriangles == 2048);
+    CHECK(capacities.maxPrimitiveLights == 256);
+    CHECK(capacities.maxInstancedMeshes == 3);
+    CHECK(capacities.maxInstancedMeshTriangles == 0);
+    CHECK(capacities.maxInstancedLights == 1024);
+    CHECK(capacities.maxGeometryInstances == 7);
+}
+
+TEST_CASE(TopLevelAccelStruct)
+{
+    SyntheticSceneParameters params;
+    params.emissiveMeshes = 4;
+    params.instancesPerMesh = 2;
+    params.opaqueMeshes = 3;
+
+    HostFixture fixture(params);
+    fixture.scene->BuildMeshBLASes(fixture.device.Get());
+    CHECK(fixture.scene->GetTopLevelAS() != nullptr);
+    CHECK(fixture.scene->GetPrevTopLevelAS() != nullptr);
+
+    fixture.BuildTopLevelAccelStruct();
+
+    const size_t numInstances = fixture.scene->GetSceneGraph()->GetMeshInstances().size();
+    const auto builds = fixture.GetRecordedCommands().GetCommands(nullrhi::CommandType::BuildTopLevelAccelStruct);
+    if (CHECK(builds.size() == 1))
+    {
+        CHECK(builds[0]->resource == fixture.scene->GetTopLevelAS());
+        CHECK(builds[0]->elementCount == numInstances);
+    }
+}
+
+namespace
+{
+    nvrhi::TextureDesc MakeTextureDesc(const char* debugName, nvrhi::Format format, uint32_t width = 1280, uint32_t height = 720)
+    {
+        nvrhi::TextureDesc desc;
+        desc.width = width;
+        desc.height = height;
+        desc.format = format;
+        desc.isUAV = true;
+        desc.isRenderTarget = true;
+        desc.debugName = debugName;
+        return desc;
+    }
+
+    struct SampleGraphSettings
+    {
+        bool enableIndirectLighting = true;
+        bool enableVisualization = true;
+        bool showDebugColor = false;
+    };
+
+    struct SampleGraphTextures
+    {
+        nvrhi::TextureHandle giLighting;
+        nvrhi::TextureHandle hdrColor;
+        nvrhi::TextureHandle resolvedColor;
+        nvrhi::TextureHandle ldrColor;
+        nvrhi::TextureHandle backBuffer;
+
+        explicit SampleGraphTextures(nvrhi::IDevice* device)
+        {
+            giLighting = device->createTexture(MakeTextureDesc("GIDiffuseLighting", nvrhi::Format::RGBA16_FLOAT, 640, 360));
+            hdrColor = device->createTexture(MakeTextureDesc("HdrColor", nvrhi::Format::RGBA16_FLOAT));
+            resolvedColor = device->createTexture(MakeTextureDesc("ResolvedColor", nvrhi::Format::RGBA16_FLOAT));
+            ldrColor = device->createTexture(MakeTextureDesc("LdrColor", nvrhi::Format::SRGBA8_UNORM));
+            backBuffer = device->createTexture(MakeTextureDesc("BackBuffer", nvrhi::Format::SRGBA8_UNORM));
+        }
+    };
+
+    // Builds a graph with the shape of the one in SceneRenderer::RenderScene, with the final ReSTIR GI shading
+    // in front of it that only feeds the compositing when indirect lighting is enabled.
+    void BuildSampleGraph(FrameGraph& graph, const SampleGraphTextures& textures, const SampleGraphSettings& settings)
+    {
+        FrameGraphTexture giLighting = graph.ImportTexture(textures.giLighting);
+        FrameGraphTexture hdrColor = graph.ImportTexture(textures.hdrColor);
+        FrameGraphTexture resolvedColor = graph.ImportTexture(textures.resolvedColor);
+        FrameGraphTexture ldrColor = graph.ImportTexture(textures.ldrColor);
+        FrameGraphTexture backBuffer = graph.ImportTexture(textures.backBuffer);
+        FrameGraphTexture debugColor = graph.CreateTexture(MakeTextureDesc("DebugColor", nvrhi::Format::RGBA16_FLOAT));
+
+        graph.MarkOutput(backBuffer);
+
+        graph.AddPass("GIFinalShading",
+            [&](FrameGraphBuilder& builder) { builder.Write(giLighting); },
+            nullptr);
+
+        graph.AddPass("Compositing",
+            [&](FrameGraphBuilder& builder)
+            {
+                if (settings.enableIndirectLighting)
+                    builder.Read(giLighting);
+                builder.Write(hdrColor);
+            },
+            nullptr);
+
+        graph.AddPass("Resolve",
+            [&](FrameGraphBuilder& builder)
+            {
+                builder.Read(hdrColor);
+                builder.Write(resolvedColor, nvrhi::ResourceStates::RenderTarget);
+                builder.SetSideEffects();
+            },
+            nullptr);
+
+        graph.AddPass("ToneMapping",
+            [&](FrameGraphBuilder& builder)
+            {
+                builder.Read(resolvedColor);
+                builder.Write(ldrColor, nvrhi::ResourceStates::RenderTarget);
+            },
+            nullptr);
+
+        if (settings.enableVisualization)
+        {
+            graph.AddPass("Visualization",
+                [&](FrameGraphBuilder& builder) { builder.ReadWrite(ldrColor, nvrhi::ResourceStates::RenderTarget); },
+                nullptr);
+        }
+
+        graph.AddPass("UnpackGBuffer",
+            [&](FrameGraphBuilder& builder) { builder.Write(debugColor); },
+            nullptr);
+
+        graph.AddPass("DisplayOutput",
+            [&](FrameGraphBuilder& builder)
+            {
+                builder.Read(settings.showDebugColor ? debugColor : ldrColor);
+                builder.Write(backBuffer, nvrhi::ResourceStates::RenderTarget);
+            },
+            nullptr);
+    }
+
+    void ExecuteGraph(FrameGraph& graph, nvrhi::ICommandList* commandList, FrameGraphResourcePool& pool)
+    {
+        commandList->open();
+        graph.Compile([&pool](const nvrhi::TextureDesc& desc) { return pool.GetMemoryRequirements(desc); });
+        graph.Execute(commandList, pool);
+        commandList->close();
+    }
+
+    // A graph with one transient texture of the given size that is only written and displayed when 'used' is set
+    void ExecuteDebugOutputGraph(nvrhi::ITexture* backBufferTexture, uint32_t size, bool used, nvrhi::ICommandList* commandList, FrameGraphResourcePool& pool)
+    {
+        FrameGraph graph;
+        FrameGraphTexture backBuffer = graph.ImportTexture(backBufferTexture);
+        FrameGraphTexture debugColor = graph.CreateTexture(MakeTextureDesc("DebugColor", nvrhi::Format::RGBA16_FLOAT, size, size));
+        graph.MarkOutput(backBuffer);
+
+        graph.AddPass("UnpackGBuffer", [&](FrameGraphBuilder& builder) { builder.Write(debugColor); }, nullptr);
+        graph.AddPass("DisplayOutput",
+            [&](FrameGraphBuilder& builder)
+            {
+                if (used)
+                    builder.Read(debugColor);
+                builder.Write(backBuffer, nvrhi::ResourceStates::RenderTarget);
+            },
+            nullptr);
+
+        ExecuteGraph(graph, commandList, pool);
+    }
+}
+
+TEST_CASE(FrameGraphCulling)
+{
+    nvrhi::RefCountPtr<nullrhi::Device> device = nvrhi::RefCountPtr<nullrhi::Device>::Create(new nullrhi::Device());
+    SampleGraphTextures textures(device);
+
+    // Everything that contributes to the displayed LDR image is live, the G-buffer unpacking is not
+    {
+        FrameGraph graph;
+        BuildSampleGraph(graph, textures, SampleGraphSettings());
+        graph.Compile();
+
+        CHECK(!graph.IsPassCulled("GIFinalShading"));
+        CHECK(!graph.IsPassCulled("Compositing"));
+        CHECK(!graph.IsPassCulled("ToneMapping"));
+        CHECK(!graph.IsPassCulled("Visualization"));
+        CHECK(!graph.IsPassCulled("DisplayOutput"));
+        CHECK(graph.IsPassCulled("UnpackGBuffer"));
+        CHECK(graph.GetStatistics().numCulledPasses == 1);
+        CHECK(graph.GetStatistics().numCulledTransientTextures == 1);
+        CHECK(graph.GetStatistics().transientHeapSize == 0);
+    }
+
+    // Without indirect lighting, nothing reads the GI output
+    {
+        SampleGraphSettings settings;
+        settings.enableIndirectLighting = false;
+
+        FrameGraph graph;
+        BuildSampleGraph(graph, textures, settings);
+        graph.Compile();
+
+        CHECK(graph.IsPassCulled("GIFinalShading"));
+        CHECK(!graph.IsPassCulled("Compositing"));
+        CHECK(graph.GetStatistics().numCulledPasses == 2);
+    }
+
+    // When a G-buffer channel is displayed, tone mapping and visualization are culled,
+    // but the resolve is kept because it updates the TAA history
+    {
+        SampleGraphSettings settings;
+        settings.showDebugColor = true;
+
+        FrameGraph graph;
+        BuildSampleGraph(graph, textures, settings);
+        graph.Compile();
+
+        CHECK(graph.IsPassCulled("ToneMapping"));
+        CHECK(graph.IsPassCulled("Visualization"));
+        CHECK(!graph.IsPassCulled("UnpackGBuffer"));
+        CHECK(!graph.IsPassCulled("Resolve"));
+        CHECK(!graph.IsPassCulled("Compositing"));
+        CHECK(graph.GetStatistics().numCulledTransientTextures == 0);
+        CHECK(graph.GetStatistics().transientHeapSize > 0);
+    }
+}
+
+TEST_CASE(FrameGraphBarriers)
+{
+    nvrhi::RefCountPtr<nullrhi::Device> device = nvrhi::RefCountPtr<nullrhi::Device>::Create(new nullrhi::Device());
+    nvrhi::CommandListHandle commandList = device->createCommandList(nvrhi::CommandListParameters());
+    FrameGraphResourcePool pool(device);
+
+    nvrhi::TextureHandle inputTexture = device->createTexture(MakeTextureDesc("Input", nvrhi::Format::RGBA16_FLOAT));
+    nvrhi::TextureHandle outputTexture = device->createTexture(MakeTextureDesc("Output", nvrhi::Format::SRGBA8_UNORM));
+
+    FrameGraph graph;
+    FrameGraphTexture input = graph.ImportTexture(inputTexture, nvrhi::ResourceStates::ShaderResource, nvrhi::ResourceStates::ShaderResource);
+    FrameGraphTexture output = graph.ImportTexture(outputTexture, nvrhi::ResourceStates::Unknown, nvrhi::ResourceStates::ShaderResource);
+    // Only UAV textures can skip the first-use clear, render targets are always cleared
+    nvrhi::TextureDesc lightingDesc = MakeTextureDesc("Lighting", nvrhi::Format::RGBA16_FLOAT);
+    lightingDesc.isRenderTarget = false;
+
+    FrameGraphTexture lighting = graph.CreateTexture(lightingDesc);
+    FrameGraphTexture overlay = graph.CreateTexture(MakeTextureDesc("Overlay", nvrhi::Format::RGBA8_UNORM));
+    graph.MarkOutput(output);
+
+    nvrhi::ITexture* realizedLighting = nullptr;
+    nvrhi::ITexture* realizedOverlay = nullptr;
+
+    // Fully written on first use: no clear, one transition out of the initial state
+    graph.AddPass("Shading",
+        [&](FrameGraphBuilder& builder) { builder.Write(lighting); },
+        [&](nvrhi::ICommandList*, const FrameGraphResources& resources) { realizedLighting = resources.GetTexture(lighting); });
+
+    // Same UAV state as the previous write: only a UAV barrier
+    graph.AddPass("Denoising",
+        [&](FrameGraphBuilder& builder) { builder.ReadWrite(lighting); },
+        nullptr);
+
+    // Partially written on first use: cleared, and the clear is ordered before the write
+    graph.AddPass("Overlay",
+        [&](FrameGraphBuilder& builder) { builder.Write(overlay, nvrhi::ResourceStates::UnorderedAccess, false); },
+        [&](nvrhi::ICommandList*, const FrameGraphResources& resources) { realizedOverlay = resources.GetTexture(overlay); });
+
+    // The input is already in the SRV state: no barrier
+    graph.AddPass("Composite",
+        [&](FrameGraphBuilder& builder)
+        {
+            builder.Read(input);
+            builder.Read(lighting);
+            builder.Read(overlay);
+            builder.Write(output, nvrhi::ResourceStates::RenderTarget);
+        },
+        nullptr);
+
+    ExecuteGraph(graph, commandList, pool);
+
+    const FrameGraph::Statistics& statistics = graph.GetStatistics();
+    CHECK(statistics.numBarriers == 7);
+    CHECK(statistics.numClears == 1);
+    CHECK(statistics.numSkippedClears == 1);
+    CHECK(statistics.numAliasingBarriers == 0);
+
+    const auto& recorded = *static_cast<nullrhi::CommandList*>(commandList.Get());
+    const auto barriers = recorded.GetCommands(nullrhi::CommandType::TextureBarrier);
+    const auto clears = recorded.GetCommands(nullrhi::CommandType::ClearTexture);
+    if (!CHECK(barriers.size() == 7) || !CHECK(clears.size() == 1))
+        return;
+
+    // The clears and barriers are recorded between the passes, outside of their markers
+    CHECK(clears[0]->resource == realizedOverlay);
+    CHECK(clears[0]->marker.empty());
+
+    auto checkBarrier = [&](size_t index, nvrhi::IResource* resource, nvrhi::ResourceStates state)
+    {
+        CHECK(barriers[index]->resource == resource);
+        CHECK(barriers[index]->state == state);
+        CHECK(barriers[index]->marker.empty());
+    };
+
+    checkBarrier(0, realizedLighting, nvrhi::ResourceStates::UnorderedAccess);
+    checkBarrier(1, realizedLighting, nvrhi::ResourceStates::UnorderedAccess);
+    checkBarrier(2, realizedOverlay, nvrhi::ResourceStates::UnorderedAccess);
+    checkBarrier(3, realizedLighting, nvrhi::ResourceStates::ShaderResource);
+    checkBarrier(4, realizedOverlay, nvrhi::ResourceStates::ShaderResource);
+    checkBarrier(5, outputTexture, nvrhi::ResourceStates::RenderTarget);
+    checkBarrier(6, outputTexture, nvrhi::ResourceStates::ShaderResource);
+
+    for (const nullrhi::Command* barrier : barriers)
+        CHECK(barrier->resource != inputTexture.Get());
+}
+
+TEST_CASE(FrameGraphAliasing)
+{
+    nvrhi::RefCountPtr<nullrhi::Device> device = nvrhi::RefCountPtr<nullrhi::Device>::Create(new nullrhi::Device());
+    nvrhi::CommandListHandle commandList = device->createCommandList(nvrhi::CommandListParameters());
+    FrameGraphResourcePool pool(device);
+
+    nvrhi::TextureHandle outputTexture = device->createTexture(MakeTextureDesc("Output", nvrhi::Format::RGBA16_FLOAT));
+
+    // A chain of equally sized transients: each one is only alive while it's produced and consumed,
+    // so the first and the last can share their memory
+    FrameGraph graph;
+    FrameGraphTexture output = graph.ImportTexture(outputTexture);
+    FrameGraphTexture first = graph.CreateTexture(MakeTextureDesc("First", nvrhi::Format::RGBA16_FLOAT));
+    FrameGraphTexture second = graph.CreateTexture(MakeTextureDesc("Second", nvrhi::Format::RGBA16_FLOAT));
+    FrameGraphTexture third = graph.CreateTexture(MakeTextureDesc("Third", nvrhi::Format::RGBA16_FLOAT));
+    graph.MarkOutput(output);
+
+    graph.AddPass("First", [&](FrameGraphBuilder& builder) { builder.Write(first); }, nullptr);
+    graph.AddPass("Second", [&](FrameGraphBuilder& builder) { builder.Read(first); builder.Write(second); }, nullptr);
+    graph.AddPass("Third", [&](FrameGraphBuilder& builder) { builder.Read(second); builder.Write(third); }, nullptr);
+    graph.AddPass("Output", [&](FrameGraphBuilder& builder) { builder.Read(third); builder.Write(output); }, nullptr);
+
+    ExecuteGraph(graph, commandList, pool);
+
+    const FrameGraph::Statistics& statistics = graph.GetStatistics();
+    CHECK(graph.IsTextureAllocated(first));
+    CHECK(graph.IsTextureAllocated(second));
+    CHECK(graph.IsTextureAllocated(third));
+    CHECK(graph.GetTransientTextureOffset(first) == graph.GetTransientTextureOffset(third));
+    CHECK(graph.GetTransientTextureOffset(first) != graph.GetTransientTextureOffset(second));
+    CHECK(statistics.transientHeapSize * 3 == statistics.unaliasedTransientSize * 2);
+
+    // The render targets are cleared even though they are fully written. The third texture takes over the
+    // memory of the first one, and the first one takes it back from the third one in the next frame.
+    CHECK(statistics.numClears == 3);
+    CHECK(statistics.numSkippedClears == 0);
+    CHECK(statistics.numAliasingBarriers == 2);
+
+    // The pool backs the graph with one heap of exactly the aliased size
+    CHECK(pool.GetHeapSize() == statistics.transientHeapSize);
+    CHECK(device->GetStatistics().heaps == 1);
+    CHECK(device->GetStatistics().heapBytes == statistics.transientHeapSize);
+}
+
+TEST_CASE(FrameGraphPoolReleasesHeap)
+{
+    nvrhi::RefCountPtr<nullrhi::Device> device = nvrhi::RefCountPtr<nullrhi::Device>::Create(new nullrhi::Device());
+    nvrhi::CommandListHandle commandList = device->createCommandList(nvrhi::CommandListParameters());
+    nvrhi::TextureHandle backBuffer = device->createTexture(MakeTextureDesc("BackBuffer", nvrhi::Format::SRGBA8_UNORM));
+    FrameGraphResourcePool pool(device);
+
+    // The placed textures and the heap are reused while the layout stays the same
+    ExecuteDebugOutputGraph(backBuffer, 1024, true, commandList, pool);
+    const uint64_t largeHeapSize = pool.GetHeapSize();
+    const uint32_t generation = pool.GetGeneration();
+    CHECK(largeHeapSize > 0);
+
+    ExecuteDebugOutputGraph(backBuffer, 1024, true, commandList, pool);
+    CHECK(pool.GetGeneration() == generation);
+    CHECK(device->GetStatistics().heaps == 1);
+
+    // No transient textures: the heap is released right away, and not re-created in the following frames
+    ExecuteDebugOutputGraph(backBuffer, 1024, false, commandList, pool);
+    CHECK(pool.GetHeapSize() == 0);
+    const uint32_t releasedGeneration = pool.GetGeneration();
+    CHECK(releasedGeneration != generation);
+
+    ExecuteDebugOutputGraph(backBuffer, 1024, false, commandList, pool);
+    CHECK(pool.GetGeneration() == releasedGeneration);
+    CHECK(device->GetStatistics().heaps == 1);
+
+    // A smaller layout fits into the large heap for a while, then the heap shrinks to fit
+    ExecuteDebugOutputGraph(backBuffer, 1024, true, commandList, pool);
+    CHECK(pool.GetHeapSize() == largeHeapSize);
+
+    for (uint32_t frame = 1; frame < FrameGraphResourcePool::c_HeapShrinkDelay; frame++)
+    {
+        ExecuteDebugOutputGraph(backBuffer, 256, true, commandList, pool);
+        CHECK(pool.GetHeapSize() == largeHeapSize);
+    }
+
+    ExecuteDebugOutputGraph(backBuffer, 256, true, commandList, pool);
+    CHECK(pool.GetHeapSize() > 0);
+    CHECK(pool.GetHeapSize() < largeHeapSize);
+    CHECK(device->GetStatistics().heaps == 3);
+}
+
+TEST_CASE(IesProfileBakeScale)
+{
+    // Candela multiplier 2, vertical angles 0, 90 and 180, one horizontal angle
+    const char* text =
+        "IESNA:LM-63-2002\n"
+        "[TEST] symmetric\n"
+        "TILT=NONE\n"
+        "1 1000 2 3 1 1 1 0 0 0\n"
+        "1 1 100\n"
+        "0 90 180\n"
+        "0\n"
+        "100 50 0\n";
+
+    IesProfile profile;
+    if (!CHECK(profile.Parse(text, strlen(text))))
+        return;
+
+    CHECK(profile.symmetric);
+    CHECK(profile.maxCandela == 200.f);
+
+    // The baked values are candela including the multiplier, not normalized to the peak
+    profile.Bake1D();
+    if (CHECK(profile.bakedData.size() == IES_PROFILE_ATLAS_WIDTH))
+    {
+        CHECK(profile.bakedData.front() == 0.f);
+        CHECK(profile.bakedData.back() == 200.f);
+        CHECK(*std::max_element(profile.bakedData.begin(), profile.bakedData.end()) == profile.maxCandela);
+    }
+
+    profile.Bake2D();
+    if (CHECK(profile.bakedData.size() == IesProfile::c_TextureWidth * IesProfile::c_TextureHeight))
+    {
+        const float peak = *std::max_element(profile.bakedData.begin(), profile.bakedData.end());
+        CHECK(peak > 100.f && peak <= profile.maxCandela);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    SetHostLogSeverity(log::Severity::Warning);
+
+    return test::RunTests(argc, argv);
+}
@@ -0,0 +1,542 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "NullDevice.h"
+
+#include <cassert>
+
+namespace nullrhi
+{
+    class Shader : public nvrhi::RefCounter<nvrhi::IShader>
+    {
+    public:
+        Shader(const nvrhi::ShaderDesc& desc, const void* binary, size_t binarySize)
+            : m_desc(desc)
+            , m_bytecode(static_cast<const uint8_t*>(binary), static_cast<const uint8_t*>(binary) + binarySize)
+        {
+        }
+
+        [[nodiscard]] const nvrhi::ShaderDesc& getDesc() const override { return m_desc; }
+
+        void getBytecode(const void** ppBytecode, size_t* pSize) const override
+        {
+            if (ppBytecode) *ppBytecode = m_bytecode.data();
+            if (pSize) *pSize = m_bytecode.size();
+        }
+
+    private:
+        nvrhi::ShaderDesc m_desc;
+        std::vector<uint8_t> m_bytecode;
+    };
+
+    class Sampler : public nvrhi::RefCounter<nvrhi::ISampler>
+    {
+    public:
+        explicit Sampler(const nvrhi::SamplerDesc& desc) : m_desc(desc) { }
+
+        [[nodiscard]] const nvrhi::SamplerDesc& getDesc() const override { return m_desc; }
+
+    private:
+        nvrhi::SamplerDesc m_desc;
+    };
+
+    class ComputePipeline : public nvrhi::RefCounter<nvrhi::IComputePipeline>
+    {
+    public:
+        explicit ComputePipeline(const nvrhi::ComputePipelineDesc& desc) : m_desc(desc) { }
+
+        [[nodiscard]] const nvrhi::ComputePipelineDesc& getDesc() const override { return m_desc; }
+
+    private:
+        nvrhi::ComputePipelineDesc m_desc;
+    };
+
+    class BindingLayout : public nvrhi::RefCounter<nvrhi::IBindingLayout>
+    {
+    public:
+        explicit BindingLayout(const nvrhi::BindingLayoutDesc& desc) : m_desc(desc) { }
+        explicit BindingLayout(const nvrhi::BindlessLayoutDesc& desc) : m_bindlessDesc(desc), m_isBindless(true) { }
+
+        [[nodiscard]] const nvrhi::BindingLayoutDesc* getDesc() const override { return m_isBindless ? nullptr : &m_desc; }
+        [[nodiscard]] const nvrhi::BindlessLayoutDesc* getBindlessDesc() const override { return m_isBindless ? &m_bindlessDesc : nullptr; }
+
+    private:
+        nvrhi::BindingLayoutDesc m_desc;
+        nvrhi::BindlessLayoutDesc m_bindlessDesc;
+        bool m_isBindless = false;
+    };
+
+    class BindingSet : public nvrhi::RefCounter<nvrhi::IBindingSet>
+    {
+    public:
+        BindingSet(const nvrhi::BindingSetDesc& desc, nvrhi::IBindingLayout* layout) : m_desc(desc), m_layout(layout) { }
+
+        [[nodiscard]] const nvrhi::BindingSetDesc* getDesc() const override { return &m_desc; }
+        [[nodiscard]] nvrhi::IBindingLayout* getLayout() const override { return m_layout; }
+
+    private:
+        nvrhi::BindingSetDesc m_desc;
+        nvrhi::BindingLayoutHandle m_layout;
+    };
+
+    class DescriptorTable : public nvrhi::RefCounter<nvrhi::IDescriptorTable>
+    {
+    public:
+        explicit DescriptorTable(nvrhi::IBindingLayout* layout) : m_layout(layout) { }
+
+        [[nodiscard]] const nvrhi::BindingSetDesc* getDesc() const override { return nullptr; }
+        [[nodiscard]] nvrhi::IBindingLayout* getLayout() const override { return m_layout; }
+        [[nodiscard]] uint32_t getCapacity() const override { return m_capacity; }
+        [[nodiscard]] uint32_t getFirstDescriptorIndexInHeap() const override { return 0; }
+
+        void Resize(uint32_t capacity) { m_capacity = capacity; }
+
+    private:
+        nvrhi::BindingLayoutHandle m_layout;
+        uint32_t m_capacity = 0;
+    };
+
+    class AccelStruct : public nvrhi::RefCounter<nvrhi::rt::IAccelStruct>
+    {
+    public:
+        explicit AccelStruct(const nvrhi::rt::AccelStructDesc& desc) : m_desc(desc) { }
+
+        [[nodiscard]] const nvrhi::rt::AccelStructDesc& getDesc() const override { return m_desc; }
+        [[nodiscard]] bool isCompacted() const override { return false; }
+        [[nodiscard]] uint64_t getDeviceAddress() const override { return 0; }
+
+    private:
+        nvrhi::rt::AccelStructDesc m_desc;
+    };
+
+    class EventQuery : public nvrhi::RefCounter<nvrhi::IEventQuery> { };
+    class TimerQuery : public nvrhi::RefCounter<nvrhi::ITimerQuery> { };
+
+    std::vector<uint8_t>& Buffer::GetContents()
+    {
+        if (m_contents.size() != m_desc.byteSize)
+            m_contents.resize(m_desc.byteSize);
+
+        return m_contents;
+    }
+
+    void Buffer::Write(const void* data, size_t size, uint64_t offset)
+    {
+        assert(offset + size <= m_desc.byteSize);
+
+        std::vector<uint8_t>& contents = GetContents();
+        memcpy(contents.data() + offset, data, size);
+        m_writeCount++;
+    }
+
+    void Buffer::Clear(uint32_t value)
+    {
+        std::vector<uint8_t>& contents = GetContents();
+        for (size_t offset = 0; offset + sizeof(uint32_t) <= contents.size(); offset += sizeof(uint32_t))
+            memcpy(contents.data() + offset, &value, sizeof(uint32_t));
+        m_writeCount++;
+    }
+
+    Buffer* Device::FindBuffer(const std::string& debugName)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (auto it = m_buffers.rbegin(); it != m_buffers.rend(); ++it)
+        {
+            if ((*it)->getDesc().debugName == debugName)
+                return it->Get();
+        }
+
+        return nullptr;
+    }
+
+    Device::Statistics Device::GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+    void Device::ReleaseUnusedBuffers()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // The device holds one reference, AddRef + Release tells how many there are
+        m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(), [](const nvrhi::RefCountPtr<Buffer>& buffer)
+        {
+            buffer->AddRef();
+            return buffer->Release() == 1;
+        }), m_buffers.end());
+    }
+
+    nvrhi::TextureHandle Device::createTexture(const nvrhi::TextureDesc& d)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.textures++;
+        return nvrhi::TextureHandle::Create(new Texture(d));
+    }
+
+    nvrhi::HeapHandle Device::createHeap(const nvrhi::HeapDesc& d)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.heaps++;
+        m_statistics.heapBytes += d.capacity;
+        return nvrhi::HeapHandle::Create(new Heap(d));
+    }
+
+    nvrhi::MemoryRequirements Device::getTextureMemoryRequirements(nvrhi::ITexture* texture)
+    {
+        const nvrhi::TextureDesc& desc = texture->getDesc();
+        const nvrhi::FormatInfo& formatInfo = nvrhi::getFormatInfo(desc.format);
+
+        nvrhi::MemoryRequirements requirements;
+        requirements.size = uint64_t(desc.width) * desc.height * desc.depth * desc.arraySize * formatInfo.bytesPerBlock;
+        requirements.alignment = 65536;
+        return requirements;
+    }
+
+    nvrhi::TextureHandle Device::createHandleForNativeTexture(nvrhi::ObjectType objectType, nvrhi::Object texture, const nvrhi::TextureDesc& desc)
+    {
+        return createTexture(desc);
+    }
+
+    nvrhi::BufferHandle Device::createBuffer(const nvrhi::BufferDesc& d)
+    {
+        nvrhi::RefCountPtr<Buffer> buffer = nvrhi::RefCountPtr<Buffer>::Create(new Buffer(d));
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_buffers.push_back(buffer);
+        m_statistics.buffers++;
+        m_statistics.bufferBytes += d.byteSize;
+
+        return nvrhi::BufferHandle(buffer.Get());
+    }
+
+    void* Device::mapBuffer(nvrhi::IBuffer* buffer, nvrhi::CpuAccessMode cpuAccess)
+    {
+        return static_cast<Buffer*>(buffer)->GetContents().data();
+    }
+
+    nvrhi::MemoryRequirements Device::getBufferMemoryRequirements(nvrhi::IBuffer* buffer)
+    {
+        nvrhi::MemoryRequirements requirements;
+        requirements.size = buffer->getDesc().byteSize;
+        requirements.alignment = 256;
+        return requirements;
+    }
+
+    nvrhi::BufferHandle Device::createHandleForNativeBuffer(nvrhi::ObjectType objectType, nvrhi::Object buffer, const nvrhi::BufferDesc& desc)
+    {
+        return createBuffer(desc);
+    }
+
+    nvrhi::ShaderHandle Device::createShader(const nvrhi::ShaderDesc& d, const void* binary, size_t binarySize)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.shaders++;
+        return nvrhi::ShaderHandle::Create(new Shader(d, binary, binarySize));
+    }
+
+    nvrhi::ShaderHandle Device::createShaderSpecialization(nvrhi::IShader* baseShader, const nvrhi::ShaderSpecialization* constants, uint32_t numConstants)
+    {
+        const void* bytecode = nullptr;
+        size_t size = 0;
+        baseShader->getBytecode(&bytecode, &size);
+        return createShader(baseShader->getDesc(), bytecode, size);
+    }
+
+    nvrhi::SamplerHandle Device::createSampler(const nvrhi::SamplerDesc& d)
+    {
+        return nvrhi::SamplerHandle::Create(new Sampler(d));
+    }
+
+    nvrhi::EventQueryHandle Device::createEventQuery()
+    {
+        return nvrhi::EventQueryHandle::Create(new EventQuery());
+    }
+
+    nvrhi::TimerQueryHandle Device::createTimerQuery()
+    {
+        return nvrhi::TimerQueryHandle::Create(new TimerQuery());
+    }
+
+    nvrhi::ComputePipelineHandle Device::createComputePipeline(const nvrhi::ComputePipelineDesc& desc)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.pipelines++;
+        return nvrhi::ComputePipelineHandle::Create(new ComputePipeline(desc));
+    }
+
+    nvrhi::BindingLayoutHandle Device::createBindingLayout(const nvrhi::BindingLayoutDesc& desc)
+    {
+        return nvrhi::BindingLayoutHandle::Create(new BindingLayout(desc));
+    }
+
+    nvrhi::BindingLayoutHandle Device::createBindlessLayout(const nvrhi::BindlessLayoutDesc& desc)
+    {
+        return nvrhi::BindingLayoutHandle::Create(new BindingLayout(desc));
+    }
+
+    nvrhi::BindingSetHandle Device::createBindingSet(const nvrhi::BindingSetDesc& desc, nvrhi::IBindingLayout* layout)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.bindingSets++;
+        return nvrhi::BindingSetHandle::Create(new BindingSet(desc, layout));
+    }
+
+    nvrhi::DescriptorTableHandle Device::createDescriptorTable(nvrhi::IBindingLayout* layout)
+    {
+        return nvrhi::DescriptorTableHandle::Create(new DescriptorTable(layout));
+    }
+
+    void Device::resizeDescriptorTable(nvrhi::IDescriptorTable* descriptorTable, uint32_t newSize, bool keepContents)
+    {
+        static_cast<DescriptorTable*>(descriptorTable)->Resize(newSize);
+    }
+
+    nvrhi::rt::AccelStructHandle Device::createAccelStruct(const nvrhi::rt::AccelStructDesc& desc)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.accelStructs++;
+        return nvrhi::rt::AccelStructHandle::Create(new AccelStruct(desc));
+    }
+
+    nvrhi::MemoryRequirements Device::getAccelStructMemoryRequirements(nvrhi::rt::IAccelStruct* as)
+    {
+        // A rough estimate, the exact size only matters for the heap allocation on real devices
+        const nvrhi::rt::AccelStructDesc& desc = as->getDesc();
+        uint64_t primitives = desc.topLevelMaxInstances;
+        for (const nvrhi::rt::GeometryDesc& geometry : desc.bottomLevelGeometries)
+            primitives += geometry.geometryData.triangles.indexCount / 3;
+
+        nvrhi::MemoryRequirements requirements;
+        requirements.size = std::max<uint64_t>(primitives * 64, 256);
+        requirements.alignment = 256;
+        return requirements;
+    }
+
+    nvrhi::CommandListHandle Device::createCommandList(const nvrhi::CommandListParameters& params)
+    {
+        return nvrhi::CommandListHandle::Create(new CommandList(this, params));
+    }
+
+    uint64_t Device::executeCommandLists(nvrhi::ICommandList* const* pCommandLists, size_t numCommandLists, nvrhi::CommandQueue executionQueue)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_statistics.executedCommandLists += uint32_t(numCommandLists);
+        }
+
+        return ++m_submissionIndex;
+    }
+
+    bool Device::queryFeatureSupport(nvrhi::Feature feature, void* pInfo, size_t infoSize)
+    {
+        switch (feature)
+        {
+        case nvrhi::Feature::RayTracingAccelStruct:
+        case nvrhi::Feature::RayTracingPipeline:
+        case nvrhi::Feature::RayQuery:
+        case nvrhi::Feature::VirtualResources:
+        case nvrhi::Feature::ComputeQueue:
+        case nvrhi::Feature::CopyQueue:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    nvrhi::FormatSupport Device::queryFormatSupport(nvrhi::Format format)
+    {
+        return nvrhi::FormatSupport::Buffer | nvrhi::FormatSupport::Texture | nvrhi::FormatSupport::ShaderLoad |
+            nvrhi::FormatSupport::ShaderSample | nvrhi::FormatSupport::ShaderUavLoad | nvrhi::FormatSupport::ShaderUavStore |
+            nvrhi::FormatSupport::RenderTarget;
+    }
+
+    CommandList::CommandList(Device* device, const nvrhi::CommandListParameters& params)
+        : m_device(device)
+        , m_params(params)
+    {
+    }
+
+    std::vector<const Command*> CommandList::GetCommands(CommandType type) const
+    {
+        std::vector<const Command*> result;
+        for (const Command& command : m_commands)
+        {
+            if (command.type == type)
+                result.push_back(&command);
+        }
+        return result;
+    }
+
+    Command& CommandList::Record(CommandType type, nvrhi::IResource* resource)
+    {
+        Command& command = m_commands.emplace_back();
+        command.type = type;
+        command.resource = resource;
+        if (!m_markers.empty())
+            command.marker = m_markers.back();
+        return command;
+    }
+
+    void CommandList::open()
+    {
+        m_commands.clear();
+        m_markers.clear();
+        m_pushConstants.clear();
+    }
+
+    void CommandList::clearTextureFloat(nvrhi::ITexture* t, nvrhi::TextureSubresourceSet subresources, const nvrhi::Color& clearColor)
+    {
+        Record(CommandType::ClearTexture, t);
+    }
+
+    void CommandList::clearDepthStencilTexture(nvrhi::ITexture* t, nvrhi::TextureSubresourceSet subresources, bool clearDepth, float depth, bool clearStencil, uint8_t stencil)
+    {
+        Record(CommandType::ClearTexture, t);
+    }
+
+    void CommandList::clearTextureUInt(nvrhi::ITexture* t, nvrhi::TextureSubresourceSet subresources, uint32_t clearColor)
+    {
+        Record(CommandType::ClearTexture, t);
+    }
+
+    void CommandList::copyTexture(nvrhi::ITexture* dest, const nvrhi::TextureSlice& destSlice, nvrhi::ITexture* src, const nvrhi::TextureSlice& srcSlice)
+    {
+        Record(CommandType::CopyTexture, dest);
+    }
+
+    void CommandList::copyTexture(nvrhi::ITexture* dest, const nvrhi::TextureSlice& destSlice, nvrhi::IStagingTexture* src, const nvrhi::TextureSlice& srcSlice)
+    {
+        Record(CommandType::CopyTexture, dest);
+    }
+
+    void CommandList::writeTexture(nvrhi::ITexture* dest, uint32_t arraySlice, uint32_t mipLevel, const void* data, size_t rowPitch, size_t depthPitch)
+    {
+        Record(CommandType::WriteTexture, dest).byteSize = depthPitch ? depthPitch : rowPitch;
+    }
+
+    void CommandList::writeBuffer(nvrhi::IBuffer* b, const void* data, size_t dataSize, uint64_t destOffsetBytes)
+    {
+        static_cast<Buffer*>(b)->Write(data, dataSize, destOffsetBytes);
+        Record(CommandType::WriteBuffer, b).byteSize = dataSize;
+    }
+
+    void CommandList::clearBufferUInt(nvrhi::IBuffer* b, uint32_t clearValue)
+    {
+        static_cast<Buffer*>(b)->Clear(clearValue);
+        Record(CommandType::ClearBuffer, b).byteSize = b->getDesc().byteSize;
+    }
+
+    void CommandList::copyBuffer(nvrhi::IBuffer* dest, uint64_t destOffsetBytes, nvrhi::IBuffer* src, uint64_t srcOffsetBytes, uint64_t dataSizeBytes)
+    {
+        const std::vector<uint8_t>& source = static_cast<Buffer*>(src)->GetContents();
+        static_cast<Buffer*>(dest)->Write(source.data() + srcOffsetBytes, dataSizeBytes, destOffsetBytes);
+        Record(CommandType::CopyBuffer, dest).byteSize = dataSizeBytes;
+    }
+
+    void CommandList::setPushConstants(const void* data, size_t byteSize)
+    {
+        m_pushConstants.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + byteSize);
+    }
+
+    void CommandList::setGraphicsState(const nvrhi::GraphicsState& state)
+    {
+        Record(CommandType::SetGraphicsState);
+    }
+
+    void CommandList::draw(const nvrhi::DrawArguments& args)
+    {
+        Record(CommandType::Draw).elementCount = args.instanceCount;
+    }
+
+    void CommandList::drawIndexed(const nvrhi::DrawArguments& args)
+    {
+        Record(CommandType::Draw).elementCount = args.instanceCount;
+    }
+
+    void CommandList::drawIndirect(uint32_t offsetBytes, uint32_t drawCount)
+    {
+        Record(CommandType::DrawIndirect).elementCount = drawCount;
+    }
+
+    void CommandList::drawIndexedIndirect(uint32_t offsetBytes, uint32_t drawCount)
+    {
+        Record(CommandType::DrawIndirect).elementCount = drawCount;
+    }
+
+    void CommandList::setComputeState(const nvrhi::ComputeState& state)
+    {
+        Record(CommandType::SetComputeState, state.pipeline);
+    }
+
+    void CommandList::dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ)
+    {
+        Command& command = Record(CommandType::Dispatch);
+        command.groups[0] = groupsX;
+        command.groups[1] = groupsY;
+        command.groups[2] = groupsZ;
+        command.pushConstants = m_pushConstants;
+    }
+
+    void CommandList::dispatchIndirect(uint32_t offsetBytes)
+    {
+        Record(CommandType::DispatchIndirect).pushConstants = m_pushConstants;
+    }
+
+    void CommandList::setRayTracingState(const nvrhi::rt::State& state)
+    {
+        Record(CommandType::SetRayTracingState);
+    }
+
+    void CommandList::dispatchRays(const nvrhi::rt::DispatchRaysArguments& args)
+    {
+        Command& command = Record(CommandType::DispatchRays);
+        command.groups[0] = args.width;
+        command.groups[1] = args.height;
+        command.groups[2] = args.depth;
+        command.pushConstants = m_pushConstants;
+    }
+
+    void CommandList::buildBottomLevelAccelStruct(nvrhi::rt::IAccelStruct* as, const nvrhi::rt::GeometryDesc* pGeometries, size_t numGeometries,
+        nvrhi::rt::AccelStructBuildFlags buildFlags)
+    {
+        Record(CommandType::BuildBottomLevelAccelStruct, as).elementCount = numGeometries;
+    }
+
+    void CommandList::buildTopLevelAccelStruct(nvrhi::rt::IAccelStruct* as, const nvrhi::rt::InstanceDesc* pInstances, size_t numInstances,
+        nvrhi::rt::AccelStructBuildFlags buildFlags)
+    {
+        Command& command = Record(CommandType::BuildTopLevelAccelStruct, as);
+        command.elementCount = numInstances;
+        command.byteSize = numInstances * sizeof(nvrhi::rt::InstanceDesc);
+    }
+
+    void CommandList::buildTopLevelAccelStructFromBuffer(nvrhi::rt::IAccelStruct* as, nvrhi::IBuffer* instanceBuffer, uint64_t instanceBufferOffset,
+        size_t numInstances, nvrhi::rt::AccelStructBuildFlags buildFlags)
+    {
+        Record(CommandType::BuildTopLevelAccelStruct, as).elementCount = numInstances;
+    }
+
+    void CommandList::beginTimerQuery(nvrhi::ITimerQuery* query)
+    {
+        Record(CommandType::TimerQuery, query);
+    }
+
+    void CommandList::setTextureState(nvrhi::ITexture* texture, nvrhi::TextureSubresourceSet subresources, nvrhi::ResourceStates stateBits)
+    {
+        Record(CommandType::TextureBarrier, texture).state = stateBits;
+    }
+
+    void CommandList::setBufferState(nvrhi::IBuffer* buffer, nvrhi::ResourceStates stateBits)
+    {
+        Record(CommandType::BufferBarrier, buffer).state = stateBits;
+    }
+}
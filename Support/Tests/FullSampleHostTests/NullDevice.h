@@ -0,0 +1,334 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <nvrhi/common/aftermath.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// An nvrhi device without a GPU. It creates the resources that the host-side code of the sample needs,
+// keeps the contents of the buffers in memory, and records the commands instead of executing them.
+// The transfers (writeBuffer, clearBufferUInt, copyBuffer) are applied to the buffer contents when they are recorded,
+// so the tests can inspect what a pass uploaded right after it returns.
+//
+// Only the object types used by the host paths are implemented: the other create functions return null handles.
+// When nvrhi adds a function to IDevice or ICommandList, add a no-op override here.
+namespace nullrhi
+{
+    enum class CommandType
+    {
+        WriteBuffer,
+        ClearBuffer,
+        CopyBuffer,
+        ClearTexture,
+        WriteTexture,
+        CopyTexture,
+        SetComputeState,
+        SetGraphicsState,
+        SetRayTracingState,
+        Dispatch,
+        DispatchIndirect,
+        Draw,
+        DrawIndirect,
+        DispatchRays,
+        BuildBottomLevelAccelStruct,
+        BuildTopLevelAccelStruct,
+        TimerQuery,
+        TextureBarrier,
+        BufferBarrier
+    };
+
+    struct Command
+    {
+        CommandType type;
+        nvrhi::IResource* resource = nullptr; // The written or built resource, if any
+        uint64_t byteSize = 0;                // Size of the transfer
+        uint32_t groups[3] = { 0, 0, 0 };     // Dispatch dimensions
+        size_t elementCount = 0;              // Instances or geometries of an acceleration structure build
+        std::vector<uint8_t> pushConstants;   // The push constants that were set at the time of a dispatch
+        std::string marker;                   // Innermost marker around the command
+        nvrhi::ResourceStates state = nvrhi::ResourceStates::Unknown; // The requested state of a barrier
+    };
+
+    class Buffer : public nvrhi::RefCounter<nvrhi::IBuffer>
+    {
+    public:
+        explicit Buffer(const nvrhi::BufferDesc& desc) : m_desc(desc) { }
+
+        [[nodiscard]] const nvrhi::BufferDesc& getDesc() const override { return m_desc; }
+        [[nodiscard]] nvrhi::GpuVirtualAddress getGpuVirtualAddress() const override { return 0; }
+
+        // The contents are allocated on the first write, so that large buffers that are never written cost nothing.
+        std::vector<uint8_t>& GetContents();
+        [[nodiscard]] const std::vector<uint8_t>& GetContents() const { return m_contents; }
+        [[nodiscard]] uint32_t GetWriteCount() const { return m_writeCount; }
+
+        void Write(const void* data, size_t size, uint64_t offset);
+        void Clear(uint32_t value);
+
+    private:
+        nvrhi::BufferDesc m_desc;
+        std::vector<uint8_t> m_contents;
+        uint32_t m_writeCount = 0;
+    };
+
+    class Texture : public nvrhi::RefCounter<nvrhi::ITexture>
+    {
+    public:
+        explicit Texture(const nvrhi::TextureDesc& desc) : m_desc(desc) { }
+
+        [[nodiscard]] const nvrhi::TextureDesc& getDesc() const override { return m_desc; }
+        nvrhi::Object getNativeView(nvrhi::ObjectType objectType, nvrhi::Format format, nvrhi::TextureSubresourceSet subresources,
+            nvrhi::TextureDimension dimension, bool isReadOnlyDSV) override { return nullptr; }
+
+    private:
+        nvrhi::TextureDesc m_desc;
+    };
+
+    class Heap : public nvrhi::RefCounter<nvrhi::IHeap>
+    {
+    public:
+        explicit Heap(const nvrhi::HeapDesc& desc) : m_desc(desc) { }
+
+        [[nodiscard]] const nvrhi::HeapDesc& getDesc() override { return m_desc; }
+
+    private:
+        nvrhi::HeapDesc m_desc;
+    };
+
+    class CommandList;
+
+    class Device : public nvrhi::RefCounter<nvrhi::IDevice>
+    {
+    public:
+        struct Statistics
+        {
+            uint32_t buffers = 0;
+            uint32_t textures = 0;
+            uint32_t shaders = 0;
+            uint32_t pipelines = 0;
+            uint32_t bindingSets = 0;
+            uint32_t accelStructs = 0;
+            uint32_t heaps = 0;
+            uint64_t bufferBytes = 0;
+            uint64_t heapBytes = 0;
+            uint32_t executedCommandLists = 0;
+        };
+
+        explicit Device(nvrhi::GraphicsAPI graphicsApi = nvrhi::GraphicsAPI::VULKAN) : m_graphicsApi(graphicsApi) { }
+
+        // Finds the last created buffer with this debug name, or returns nullptr.
+        Buffer* FindBuffer(const std::string& debugName);
+        [[nodiscard]] Statistics GetStatistics();
+
+        // Forgets the buffers that are not referenced from outside of the device anymore.
+        void ReleaseUnusedBuffers();
+
+        // IDevice
+
+        nvrhi::HeapHandle createHeap(const nvrhi::HeapDesc& d) override;
+        nvrhi::TextureHandle createTexture(const nvrhi::TextureDesc& d) override;
+        nvrhi::MemoryRequirements getTextureMemoryRequirements(nvrhi::ITexture* texture) override;
+        bool bindTextureMemory(nvrhi::ITexture* texture, nvrhi::IHeap* heap, uint64_t offset) override { return true; }
+        nvrhi::TextureHandle createHandleForNativeTexture(nvrhi::ObjectType objectType, nvrhi::Object texture, const nvrhi::TextureDesc& desc) override;
+        nvrhi::StagingTextureHandle createStagingTexture(const nvrhi::TextureDesc& d, nvrhi::CpuAccessMode cpuAccess) override { return nullptr; }
+        void* mapStagingTexture(nvrhi::IStagingTexture* tex, const nvrhi::TextureSlice& slice, nvrhi::CpuAccessMode cpuAccess, size_t* outRowPitch) override { return nullptr; }
+        void unmapStagingTexture(nvrhi::IStagingTexture* tex) override { }
+        void getTextureTiling(nvrhi::ITexture* texture, uint32_t* numTiles, nvrhi::PackedMipDesc* desc, nvrhi::TileShape* tileShape,
+            uint32_t* subresourceTilingsNum, nvrhi::SubresourceTiling* subresourceTilings) override { }
+        void updateTextureTileMappings(nvrhi::ITexture* texture, const nvrhi::TextureTilesMapping* tileMappings, uint32_t numTileMappings,
+            nvrhi::CommandQueue executionQueue) override { }
+        nvrhi::SamplerFeedbackTextureHandle createSamplerFeedbackTexture(nvrhi::ITexture* pairedTexture, const nvrhi::SamplerFeedbackTextureDesc& desc) override { return nullptr; }
+        nvrhi::SamplerFeedbackTextureHandle createSamplerFeedbackForNativeTexture(nvrhi::ObjectType objectType, nvrhi::Object texture, nvrhi::ITexture* pairedTexture) override { return nullptr; }
+
+        nvrhi::BufferHandle createBuffer(const nvrhi::BufferDesc& d) override;
+        void* mapBuffer(nvrhi::IBuffer* buffer, nvrhi::CpuAccessMode cpuAccess) override;
+        void unmapBuffer(nvrhi::IBuffer* buffer) override { }
+        nvrhi::MemoryRequirements getBufferMemoryRequirements(nvrhi::IBuffer* buffer) override;
+        bool bindBufferMemory(nvrhi::IBuffer* buffer, nvrhi::IHeap* heap, uint64_t offset) override { return true; }
+        nvrhi::BufferHandle createHandleForNativeBuffer(nvrhi::ObjectType objectType, nvrhi::Object buffer, const nvrhi::BufferDesc& desc) override;
+
+        nvrhi::ShaderHandle createShader(const nvrhi::ShaderDesc& d, const void* binary, size_t binarySize) override;
+        nvrhi::ShaderHandle createShaderSpecialization(nvrhi::IShader* baseShader, const nvrhi::ShaderSpecialization* constants, uint32_t numConstants) override;
+        nvrhi::ShaderLibraryHandle createShaderLibrary(const void* binary, size_t binarySize) override { return nullptr; }
+        nvrhi::SamplerHandle createSampler(const nvrhi::SamplerDesc& d) override;
+        nvrhi::InputLayoutHandle createInputLayout(const nvrhi::VertexAttributeDesc* d, uint32_t attributeCount, nvrhi::IShader* vertexShader) override { return nullptr; }
+
+        nvrhi::EventQueryHandle createEventQuery() override;
+        void setEventQuery(nvrhi::IEventQuery* query, nvrhi::CommandQueue queue) override { }
+        bool pollEventQuery(nvrhi::IEventQuery* query) override { return true; }
+        void waitEventQuery(nvrhi::IEventQuery* query) override { }
+        void resetEventQuery(nvrhi::IEventQuery* query) override { }
+
+        nvrhi::TimerQueryHandle createTimerQuery() override;
+        bool pollTimerQuery(nvrhi::ITimerQuery* query) override { return true; }
+        float getTimerQueryTime(nvrhi::ITimerQuery* query) override { return 0.f; }
+        void resetTimerQuery(nvrhi::ITimerQuery* query) override { }
+
+        nvrhi::GraphicsAPI getGraphicsAPI() override { return m_graphicsApi; }
+
+        nvrhi::FramebufferHandle createFramebuffer(const nvrhi::FramebufferDesc& desc) override { return nullptr; }
+        nvrhi::GraphicsPipelineHandle createGraphicsPipeline(const nvrhi::GraphicsPipelineDesc& desc, nvrhi::IFramebuffer* fb) override { return nullptr; }
+        nvrhi::ComputePipelineHandle createComputePipeline(const nvrhi::ComputePipelineDesc& desc) override;
+        nvrhi::MeshletPipelineHandle createMeshletPipeline(const nvrhi::MeshletPipelineDesc& desc, nvrhi::IFramebuffer* fb) override { return nullptr; }
+        nvrhi::rt::PipelineHandle createRayTracingPipeline(const nvrhi::rt::PipelineDesc& desc) override { return nullptr; }
+
+        nvrhi::BindingLayoutHandle createBindingLayout(const nvrhi::BindingLayoutDesc& desc) override;
+        nvrhi::BindingLayoutHandle createBindlessLayout(const nvrhi::BindlessLayoutDesc& desc) override;
+        nvrhi::BindingSetHandle createBindingSet(const nvrhi::BindingSetDesc& desc, nvrhi::IBindingLayout* layout) override;
+        nvrhi::DescriptorTableHandle createDescriptorTable(nvrhi::IBindingLayout* layout) override;
+        void resizeDescriptorTable(nvrhi::IDescriptorTable* descriptorTable, uint32_t newSize, bool keepContents) override;
+        bool writeDescriptorTable(nvrhi::IDescriptorTable* descriptorTable, const nvrhi::BindingSetItem& item) override { return true; }
+
+        nvrhi::rt::OpacityMicromapHandle createOpacityMicromap(const nvrhi::rt::OpacityMicromapDesc& desc) override { return nullptr; }
+        nvrhi::rt::AccelStructHandle createAccelStruct(const nvrhi::rt::AccelStructDesc& desc) override;
+        nvrhi::MemoryRequirements getAccelStructMemoryRequirements(nvrhi::rt::IAccelStruct* as) override;
+        bool bindAccelStructMemory(nvrhi::rt::IAccelStruct* as, nvrhi::IHeap* heap, uint64_t offset) override { return true; }
+
+        nvrhi::CommandListHandle createCommandList(const nvrhi::CommandListParameters& params) override;
+        uint64_t executeCommandLists(nvrhi::ICommandList* const* pCommandLists, size_t numCommandLists, nvrhi::CommandQueue executionQueue) override;
+        void queueWaitForCommandList(nvrhi::CommandQueue waitQueue, nvrhi::CommandQueue executionQueue, uint64_t instance) override { }
+        bool waitForIdle() override { return true; }
+        void runGarbageCollection() override { }
+        bool queryFeatureSupport(nvrhi::Feature feature, void* pInfo, size_t infoSize) override;
+        nvrhi::FormatSupport queryFormatSupport(nvrhi::Format format) override;
+        nvrhi::Object getNativeQueue(nvrhi::ObjectType objectType, nvrhi::CommandQueue queue) override { return nullptr; }
+        nvrhi::IMessageCallback* getMessageCallback() override { return nullptr; }
+        bool isAftermathEnabled() override { return false; }
+        nvrhi::AftermathCrashDumpHelper& getAftermathCrashDumpHelper() override { return m_aftermathCrashDumpHelper; }
+
+    private:
+        nvrhi::GraphicsAPI m_graphicsApi;
+        nvrhi::AftermathCrashDumpHelper m_aftermathCrashDumpHelper;
+
+        std::mutex m_mutex;
+        std::vector<nvrhi::RefCountPtr<Buffer>> m_buffers;
+        Statistics m_statistics;
+        std::atomic<uint64_t> m_submissionIndex = 0;
+    };
+
+    class CommandList : public nvrhi::RefCounter<nvrhi::ICommandList>
+    {
+    public:
+        CommandList(Device* device, const nvrhi::CommandListParameters& params);
+
+        [[nodiscard]] const std::vector<Command>& GetCommands() const { return m_commands; }
+        [[nodiscard]] std::vector<const Command*> GetCommands(CommandType type) const;
+
+        // ICommandList
+
+        void open() override;
+        void close() override { }
+        void clearState() override { }
+
+        void clearTextureFloat(nvrhi::ITexture* t, nvrhi::TextureSubresourceSet subresources, const nvrhi::Color& clearColor) override;
+        void clearDepthStencilTexture(nvrhi::ITexture* t, nvrhi::TextureSubresourceSet subresources, bool clearDepth, float depth, bool clearStencil, uint8_t stencil) override;
+        void clearTextureUInt(nvrhi::ITexture* t, nvrhi::TextureSubresourceSet subresources, uint32_t clearColor) override;
+        void clearSamplerFeedbackTexture(nvrhi::ISamplerFeedbackTexture* texture) override { }
+        void decodeSamplerFeedbackTexture(nvrhi::IBuffer* buffer, nvrhi::ISamplerFeedbackTexture* texture, nvrhi::Format format) override { }
+        void setSamplerFeedbackTextureState(nvrhi::ISamplerFeedbackTexture* texture, nvrhi::ResourceStates stateBits) override { }
+
+        void copyTexture(nvrhi::ITexture* dest, const nvrhi::TextureSlice& destSlice, nvrhi::ITexture* src, const nvrhi::TextureSlice& srcSlice) override;
+        void copyTexture(nvrhi::IStagingTexture* dest, const nvrhi::TextureSlice& destSlice, nvrhi::ITexture* src, const nvrhi::TextureSlice& srcSlice) override { }
+        void copyTexture(nvrhi::ITexture* dest, const nvrhi::TextureSlice& destSlice, nvrhi::IStagingTexture* src, const nvrhi::TextureSlice& srcSlice) override;
+        void writeTexture(nvrhi::ITexture* dest, uint32_t arraySlice, uint32_t mipLevel, const void* data, size_t rowPitch, size_t depthPitch) override;
+        void resolveTexture(nvrhi::ITexture* dest, const nvrhi::TextureSubresourceSet& dstSubresources, nvrhi::ITexture* src, const nvrhi::TextureSubresourceSet& srcSubresources) override { }
+
+        void writeBuffer(nvrhi::IBuffer* b, const void* data, size_t dataSize, uint64_t destOffsetBytes) override;
+        void clearBufferUInt(nvrhi::IBuffer* b, uint32_t clearValue) override;
+        void copyBuffer(nvrhi::IBuffer* dest, uint64_t destOffsetBytes, nvrhi::IBuffer* src, uint64_t srcOffsetBytes, uint64_t dataSizeBytes) override;
+
+        void setPushConstants(const void* data, size_t byteSize) override;
+
+        void setGraphicsState(const nvrhi::GraphicsState& state) override;
+        void draw(const nvrhi::DrawArguments& args) override;
+        void drawIndexed(const nvrhi::DrawArguments& args) override;
+        void drawIndirect(uint32_t offsetBytes, uint32_t drawCount) override;
+        void drawIndexedIndirect(uint32_t offsetBytes, uint32_t drawCount) override;
+
+        void setComputeState(const nvrhi::ComputeState& state) override;
+        void dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ) override;
+        void dispatchIndirect(uint32_t offsetBytes) override;
+
+        void setMeshletState(const nvrhi::MeshletState& state) override { }
+        void dispatchMesh(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ) override { }
+
+        void setRayTracingState(const nvrhi::rt::State& state) override;
+        void dispatchRays(const nvrhi::rt::DispatchRaysArguments& args) override;
+
+        void buildOpacityMicromap(nvrhi::rt::IOpacityMicromap* omm, const nvrhi::rt::OpacityMicromapDesc& desc) override { }
+        void buildBottomLevelAccelStruct(nvrhi::rt::IAccelStruct* as, const nvrhi::rt::GeometryDesc* pGeometries, size_t numGeometries,
+            nvrhi::rt::AccelStructBuildFlags buildFlags) override;
+        void compactBottomLevelAccelStructs() override { }
+        void buildTopLevelAccelStruct(nvrhi::rt::IAccelStruct* as, const nvrhi::rt::InstanceDesc* pInstances, size_t numInstances,
+            nvrhi::rt::AccelStructBuildFlags buildFlags) override;
+        void buildTopLevelAccelStructFromBuffer(nvrhi::rt::IAccelStruct* as, nvrhi::IBuffer* instanceBuffer, uint64_t instanceBufferOffset,
+            size_t numInstances, nvrhi::rt::AccelStructBuildFlags buildFlags) override;
+
+        void beginTimerQuery(nvrhi::ITimerQuery* query) override;
+        void endTimerQuery(nvrhi::ITimerQuery* query) override { }
+
+        void beginMarker(const char* name) override { m_markers.push_back(name); }
+        void endMarker() override { if (!m_markers.empty()) m_markers.pop_back(); }
+
+        void setEnableAutomaticBarriers(bool enable) override { }
+        void setResourceStatesForBindingSet(nvrhi::IBindingSet* bindingSet) override { }
+        void setResourceStatesForFramebuffer(nvrhi::IFramebuffer* framebuffer) override { }
+        void setEnableUavBarriersForTexture(nvrhi::ITexture* texture, bool enableBarriers) override { }
+        void setEnableUavBarriersForBuffer(nvrhi::IBuffer* buffer, bool enableBarriers) override { }
+        void beginTrackingTextureState(nvrhi::ITexture* texture, nvrhi::TextureSubresourceSet subresources, nvrhi::ResourceStates stateBits) override { }
+        void beginTrackingBufferState(nvrhi::IBuffer* buffer, nvrhi::ResourceStates stateBits) override { }
+        void setTextureState(nvrhi::ITexture* texture, nvrhi::TextureSubresourceSet subresources, nvrhi::ResourceStates stateBits) override;
+        void setBufferState(nvrhi::IBuffer* buffer, nvrhi::ResourceStates stateBits) override;
+        void setAccelStructState(nvrhi::rt::IAccelStruct* as, nvrhi::ResourceStates stateBits) override { }
+        void setPermanentTextureState(nvrhi::ITexture* texture, nvrhi::ResourceStates stateBits) override { }
+        void setPermanentBufferState(nvrhi::IBuffer* buffer, nvrhi::ResourceStates stateBits) override { }
+        void commitBarriers() override { }
+        nvrhi::ResourceStates getTextureSubresourceState(nvrhi::ITexture* texture, nvrhi::ArraySlice arraySlice, nvrhi::MipLevel mipLevel) override { return nvrhi::ResourceStates::Common; }
+        nvrhi::ResourceStates getBufferState(nvrhi::IBuffer* buffer) override { return nvrhi::ResourceStates::Common; }
+
+        nvrhi::IDevice* getDevice() override { return m_device; }
+        const nvrhi::CommandListParameters& getDesc() override { return m_params; }
+
+    private:
+        Command& Record(CommandType type, nvrhi::IResource* resource = nullptr);
+
+        Device* m_device;
+        nvrhi::CommandListParameters m_params;
+        std::vector<Command> m_commands;
+        std::vector<std::string> m_markers;
+        std::vector<uint8_t> m_pushConstants;
+    };
+
+    // Returns the in-memory contents of a buffer created by the null device.
+    inline const std::vector<uint8_t>& GetBufferContents(nvrhi::IBuffer* buffer)
+    {
+        return static_cast<Buffer*>(buffer)->GetContents();
+    }
+
+    template<typename T>
+    std::vector<T> ReadBuffer(nvrhi::IBuffer* buffer, size_t count)
+    {
+        const std::vector<uint8_t>& contents = GetBufferContents(buffer);
+        count = std::min(count, contents.size() / sizeof(T));
+        std::vector<T> result(count);
+        if (count)
+            memcpy(result.data(), contents.data(), count * sizeof(T));
+        return result;
+    }
+}
@@ -0,0 +1,179 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "SyntheticScene.h"
+
+#include <donut/engine/SceneGraph.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace donut::math;
+using namespace donut::engine;
+
+std::shared_ptr<MeshInfo> SyntheticScene::CreateGridMesh(const std::string& name, uint32_t triangleCount, uint32_t geometryCount,
+    const std::shared_ptr<Material>& material)
+{
+    const uint32_t quadsPerSide = std::max(1u, uint32_t(std::ceil(std::sqrt(float(triangleCount) * 0.5f))));
+    const uint32_t verticesPerSide = quadsPerSide + 1;
+
+    auto buffers = std::make_shared<BufferGroup>();
+
+    for (uint32_t z = 0; z < verticesPerSide; z++)
+    {
+        for (uint32_t x = 0; x < verticesPerSide; x++)
+            buffers->positionData.push_back(float3(float(x) / float(quadsPerSide) - 0.5f, 0.f, float(z) / float(quadsPerSide) - 0.5f));
+    }
+
+    for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+    {
+        const uint32_t quad = triangle / 2;
+        const uint32_t v00 = (quad / quadsPerSide) * verticesPerSide + quad % quadsPerSide;
+        const uint32_t v10 = v00 + 1;
+        const uint32_t v01 = v00 + verticesPerSide;
+        const uint32_t v11 = v01 + 1;
+
+        if (triangle & 1)
+            buffers->indexData.insert(buffers->indexData.end(), { v10, v11, v01 });
+        else
+            buffers->indexData.insert(buffers->indexData.end(), { v00, v10, v01 });
+    }
+
+    const box3 bounds(float3(-0.5f, 0.f, -0.5f), float3(0.5f, 0.f, 0.5f));
+
+    auto mesh = std::make_shared<SampleMesh>();
+    mesh->name = name;
+    mesh->buffers = buffers;
+    mesh->objectSpaceBounds = bounds;
+    mesh->totalIndices = uint32_t(buffers->indexData.size());
+    mesh->totalVertices = uint32_t(buffers->positionData.size());
+
+    for (uint32_t geometryIndex = 0; geometryIndex < geometryCount; geometryIndex++)
+    {
+        auto geometry = std::make_shared<MeshGeometry>();
+        geometry->material = material;
+        geometry->numIndices = mesh->totalIndices;
+        geometry->numVertices = mesh->totalVertices;
+        geometry->objectSpaceBounds = bounds;
+        mesh->geometries.push_back(geometry);
+    }
+
+    return mesh;
+}
+
+void SyntheticScene::Build(const SyntheticSceneParameters& params, uint32_t frameIndex)
+{
+    m_params = params;
+
+    std::mt19937 random(params.seed);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+    m_SceneGraph = std::make_shared<SceneGraph>();
+    auto root = std::make_shared<SceneGraphNode>();
+    m_SceneGraph->SetRootNode(root);
+
+    auto addInstance = [this, &root, &random, &uniform](const std::shared_ptr<SceneGraphLeaf>& leaf)
+    {
+        auto node = std::make_shared<SceneGraphNode>();
+        node->SetTranslation(double3(uniform(random) * 100.0 - 50.0, uniform(random) * 5.0 + 1.0, uniform(random) * 100.0 - 50.0));
+        node->SetLeaf(leaf);
+        m_SceneGraph->Attach(root, node);
+    };
+
+    for (uint32_t meshIndex = 0; meshIndex < params.emissiveMeshes; meshIndex++)
+    {
+        auto material = std::make_shared<Material>();
+        material->name = "Emissive" + std::to_string(meshIndex);
+        material->emissiveColor = float3(uniform(random), uniform(random), uniform(random)) * 0.5f + 0.5f;
+        material->emissiveIntensity = 10.f;
+
+        auto mesh = CreateGridMesh(material->name, params.trianglesPerMesh, params.geometriesPerMesh, material);
+
+        for (uint32_t instance = 0; instance < params.instancesPerMesh; instance++)
+            addInstance(std::make_shared<MeshInstance>(mesh));
+    }
+
+    for (uint32_t meshIndex = 0; meshIndex < params.opaqueMeshes; meshIndex++)
+    {
+        auto material = std::make_shared<Material>();
+        material->name = "Opaque" + std::to_string(meshIndex);
+
+        addInstance(std::make_shared<MeshInstance>(CreateGridMesh(material->name, 2, 1, material)));
+    }
+
+    for (uint32_t i = 0; i < params.pointLights; i++)
+    {
+        auto light = std::make_shared<PointLight>();
+        light->color = float3(1.f);
+        light->intensity = 10.f;
+        light->radius = (i & 1) ? 0.1f : 0.f;
+        addInstance(light);
+    }
+
+    for (uint32_t i = 0; i < params.spotLights; i++)
+    {
+        auto light = std::make_shared<SpotLightWithProfile>();
+        light->color = float3(1.f);
+        light->intensity = 20.f;
+        light->radius = 0.05f;
+        light->innerAngle = 20.f;
+        light->outerAngle = 30.f;
+        addInstance(light);
+    }
+
+    for (uint32_t i = 0; i < params.rectLights; i++)
+    {
+        auto light = std::make_shared<RectLight>();
+        light->color = float3(1.f);
+        light->width = 0.5f;
+        light->height = 0.5f;
+        light->flux = 50.f;
+        addInstance(light);
+    }
+
+    for (uint32_t i = 0; i < params.diskLights; i++)
+    {
+        auto light = std::make_shared<DiskLight>();
+        light->color = float3(1.f);
+        light->radius = 0.3f;
+        light->flux = 50.f;
+        addInstance(light);
+    }
+
+    for (uint32_t i = 0; i < params.cylinderLights; i++)
+    {
+        auto light = std::make_shared<CylinderLight>();
+        light->color = float3(1.f);
+        light->radius = 0.05f;
+        light->length = 1.f;
+        light->flux = 50.f;
+        addInstance(light);
+    }
+
+    for (uint32_t i = 0; i < params.directionalLights; i++)
+    {
+        auto light = std::make_shared<DirectionalLight>();
+        light->color = float3(1.f);
+        light->irradiance = 1.f;
+        light->angularSize = 0.53f;
+        addInstance(light);
+    }
+
+    FinishedLoading(frameIndex);
+}
+
+void SyntheticScene::AddLight(const std::shared_ptr<Light>& light, float3 position)
+{
+    auto node = std::make_shared<SceneGraphNode>();
+    node->SetTranslation(double3(position));
+    node->SetLeaf(light);
+    m_SceneGraph->Attach(m_SceneGraph->GetRootNode(), node);
+}
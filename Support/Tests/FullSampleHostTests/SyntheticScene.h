@@ -0,0 +1,53 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "SampleScene.h"
+
+struct SyntheticSceneParameters
+{
+    uint32_t emissiveMeshes = 16;
+    uint32_t trianglesPerMesh = 32;
+    uint32_t geometriesPerMesh = 1;
+    uint32_t instancesPerMesh = 1;
+    uint32_t opaqueMeshes = 4;
+    uint32_t pointLights = 0;
+    uint32_t spotLights = 0;
+    uint32_t rectLights = 0;
+    uint32_t diskLights = 0;
+    uint32_t cylinderLights = 0;
+    uint32_t directionalLights = 0;
+    uint32_t seed = 1;
+};
+
+// A scene that is built in memory instead of being loaded from files, for the tests and benchmarks on the null device.
+// The emissive meshes are grids of triangles, each with its own emissive material, and every mesh gets
+// 'instancesPerMesh' instances in the scene graph. Every geometry of an emissive mesh has 'trianglesPerMesh'
+// triangles, the geometries share the index and vertex data. The opaque meshes are never emissive.
+class SyntheticScene : public SampleScene
+{
+public:
+    using SampleScene::SampleScene;
+
+    // Replaces the scene graph and creates the scene buffers, like FinishedLoading does after a load.
+    void Build(const SyntheticSceneParameters& params, uint32_t frameIndex = 0);
+
+    // Adds a light to the scene after it's built, for the tests that change the lights between frames.
+    void AddLight(const std::shared_ptr<donut::engine::Light>& light, dm::float3 position);
+
+    [[nodiscard]] const SyntheticSceneParameters& GetParameters() const { return m_params; }
+
+private:
+    std::shared_ptr<donut::engine::MeshInfo> CreateGridMesh(const std::string& name, uint32_t triangleCount, uint32_t geometryCount,
+        const std::shared_ptr<donut::engine::Material>& material);
+
+    SyntheticSceneParameters m_params;
+};
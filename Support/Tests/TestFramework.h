@@ -0,0 +1,94 @@
+/***************************************************************************
+ # Copyright (c) 2024, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+// A minimal test framework shared by the host-side test executables. Tests are registered with TEST_CASE,
+// CHECK records failures without aborting the test and returns the condition, and RunTests runs all tests,
+// or only those named on the command line.
+
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+namespace test
+{
+    struct TestCase
+    {
+        const char* name;
+        std::function<void()> function;
+    };
+
+    inline std::vector<TestCase>& GetTestCases()
+    {
+        static std::vector<TestCase> testCases;
+        return testCases;
+    }
+
+    struct TestRegistration
+    {
+        TestRegistration(const char* name, std::function<void()> function)
+        {
+            GetTestCases().push_back({ name, std::move(function) });
+        }
+    };
+
+    inline int g_failedChecks = 0;
+
+    inline bool Check(bool condition, const char* expression, const char* file, int line)
+    {
+        if (!condition)
+        {
+            fprintf(stderr, "%s(%d): check failed: %s\n", file, line, expression);
+            ++g_failedChecks;
+        }
+        return condition;
+    }
+
+    // Returns the process exit code: 0 if at least one test ran and all of them passed
+    inline int RunTests(int argc, char** argv)
+    {
+        int failedTests = 0;
+        int executedTests = 0;
+
+        for (const TestCase& testCase : GetTestCases())
+        {
+            if (argc > 1)
+            {
+                bool selected = false;
+                for (int i = 1; i < argc; i++)
+                    selected |= strcmp(argv[i], testCase.name) == 0;
+                if (!selected)
+                    continue;
+            }
+
+            const int failedChecks = g_failedChecks;
+            testCase.function();
+            ++executedTests;
+
+            const bool passed = failedChecks == g_failedChecks;
+            printf("[%s] %s\n", passed ? "PASS" : "FAIL", testCase.name);
+            if (!passed)
+                ++failedTests;
+        }
+
+        printf("%d of %d tests passed\n", executedTests - failedTests, executedTests);
+
+        return failedTests == 0 && executedTests > 0 ? 0 : 1;
+    }
+}
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static test::TestRegistration name##Registration(#name, name); \
+    static void name()
+
+#define CHECK(expression) test::Check((expression), #expression, __FILE__, __LINE__)